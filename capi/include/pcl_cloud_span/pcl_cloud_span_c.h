@@ -0,0 +1,256 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2023 Ilia Kovalev
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+/**
+ * \file
+ * \brief C interface to create point cloud spans over foreign buffers and run span
+ * algorithms on them
+ * \details Inputs are spans over caller memory, outputs are spans or index arrays over
+ * memory owned by the library, so buffers cross the language boundary without copies.
+ * Every function returns a status, a description of the last error of the calling
+ * thread is available from pcs_last_error().
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#if defined(_WIN32)
+#if defined(PCS_BUILDING_LIBRARY)
+#define PCS_API __declspec(dllexport)
+#else
+#define PCS_API __declspec(dllimport)
+#endif
+#else
+#define PCS_API __attribute__((visibility("default")))
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** \brief Result of a call. */
+typedef enum pcs_status {
+  PCS_OK = 0,
+  /** \brief An argument is null or out of range. */
+  PCS_INVALID_ARGUMENT = 1,
+  /** \brief The point layout matches none of the supported layouts. */
+  PCS_UNSUPPORTED_LAYOUT = 2,
+  /** \brief Memory allocation failed. */
+  PCS_OUT_OF_MEMORY = 3,
+  /** \brief The algorithm failed, see pcs_last_error(). */
+  PCS_ERROR = 4
+} pcs_status;
+
+/** \brief Field data types, same values as in pcl::PCLPointField and PointCloud2. */
+typedef enum pcs_datatype {
+  PCS_INT8 = 1,
+  PCS_UINT8 = 2,
+  PCS_INT16 = 3,
+  PCS_UINT16 = 4,
+  PCS_INT32 = 5,
+  PCS_UINT32 = 6,
+  PCS_FLOAT32 = 7,
+  PCS_FLOAT64 = 8
+} pcs_datatype;
+
+/** \brief Description of a field of a point. */
+typedef struct pcs_field {
+  /** \brief Null-terminated field name. */
+  const char* name;
+  /** \brief Offset of the field from the beginning of a point in bytes. */
+  uint32_t offset;
+  /** \brief One of pcs_datatype. */
+  uint8_t datatype;
+  /** \brief Number of elements in the field. */
+  uint32_t count;
+} pcs_field;
+
+/**
+ * \brief Description of the memory layout of points
+ * \details Supported layouts have float32 fields x, y, z at offsets 0, 4 and 8 and
+ * optionally intensity at offset 12 or 16, with a point step of 12 or 16 bytes
+ * (without intensity) or 16 or 32 bytes (with intensity). Step 16 without intensity
+ * and step 32 with intensity are the layouts of pcl::PointXYZ and pcl::PointXYZI.
+ */
+typedef struct pcs_layout {
+  /** \brief Size of a point in bytes. */
+  uint32_t point_step;
+  /** \brief Number of fields. */
+  uint32_t field_count;
+  /** \brief Fields of a point. */
+  const pcs_field* fields;
+} pcs_layout;
+
+/**
+ * \brief Function called when the library no longer uses a caller buffer
+ * \param data the buffer passed to pcs_span_create
+ * \param user_data the user data passed to pcs_span_create
+ */
+typedef void (*pcs_release_callback)(void* data, void* user_data);
+
+/** \brief Point cloud span, opaque. */
+typedef struct pcs_span pcs_span;
+
+/** \brief Array of point indices owned by the library, opaque. */
+typedef struct pcs_indices pcs_indices;
+
+/** \brief Description of the last error of the calling thread. */
+PCS_API const char*
+pcs_last_error(void);
+
+/**
+ * \brief Create a span over a caller buffer
+ * \param data buffer of width * height points, aligned to 4 bytes (16 bytes for the
+ * point steps 16 and 32)
+ * \param width point cloud width
+ * \param height point cloud height
+ * \param layout layout of points, copied
+ * \param release called with data and user_data when the span is destroyed, may be
+ * null
+ * \param user_data passed to release
+ * \param span resulting span, destroy with pcs_span_destroy
+ */
+PCS_API pcs_status
+pcs_span_create(void* data,
+                uint32_t width,
+                uint32_t height,
+                const pcs_layout* layout,
+                pcs_release_callback release,
+                void* user_data,
+                pcs_span** span);
+
+/** \brief Destroy a span, releasing its buffer. Null is ignored. */
+PCS_API void
+pcs_span_destroy(pcs_span* span);
+
+/** \brief Number of points of a span. */
+PCS_API uint64_t
+pcs_span_size(const pcs_span* span);
+
+/** \brief Width of a span. */
+PCS_API uint32_t
+pcs_span_width(const pcs_span* span);
+
+/** \brief Height of a span. */
+PCS_API uint32_t
+pcs_span_height(const pcs_span* span);
+
+/** \brief Points of a span, valid until the span is destroyed. */
+PCS_API void*
+pcs_span_data(const pcs_span* span);
+
+/** \brief Layout of points of a span, valid until the span is destroyed. */
+PCS_API const pcs_layout*
+pcs_span_layout(const pcs_span* span);
+
+/** \brief Number of indices. */
+PCS_API uint64_t
+pcs_indices_size(const pcs_indices* indices);
+
+/** \brief Indices, valid until the array is destroyed. */
+PCS_API const int32_t*
+pcs_indices_data(const pcs_indices* indices);
+
+/** \brief Destroy an index array. Null is ignored. */
+PCS_API void
+pcs_indices_destroy(pcs_indices* indices);
+
+/**
+ * \brief Transform points of a span in place
+ * \param span span to transform
+ * \param matrix row-major 4x4 rigid transform
+ * \param threads number of threads, 0 means the number of cores
+ */
+PCS_API pcs_status
+pcs_transform(pcs_span* span, const float matrix[16], unsigned int threads);
+
+/**
+ * \brief Downsample a span to the voxel centroids of pcl::VoxelGrid
+ * \details Spans of packed 12-byte xyz points are downsampled without reading past
+ * their last point, with cubic leaves only (PCS_INVALID_ARGUMENT otherwise). Their
+ * voxels are ordered by voxel coordinates.
+ * \param input span to downsample
+ * \param leaf_x leaf size along x
+ * \param leaf_y leaf size along y
+ * \param leaf_z leaf size along z
+ * \param min_points_per_voxel minimum number of points in an output voxel
+ * \param output resulting span with the layout of input, destroy with pcs_span_destroy
+ */
+PCS_API pcs_status
+pcs_voxel_grid(const pcs_span* input,
+               float leaf_x,
+               float leaf_y,
+               float leaf_z,
+               uint32_t min_points_per_voxel,
+               pcs_span** output);
+
+/**
+ * \brief Inliers of statistical outlier removal
+ * \param input span to filter
+ * \param mean_k number of neighbors to compute the mean distance of a point
+ * \param stddev_mul standard deviation multiplier of the distance threshold
+ * \param threads number of threads, 0 means the number of cores
+ * \param inliers resulting sorted indices, destroy with pcs_indices_destroy
+ */
+PCS_API pcs_status
+pcs_statistical_outlier_removal(const pcs_span* input,
+                                int mean_k,
+                                double stddev_mul,
+                                unsigned int threads,
+                                pcs_indices** inliers);
+
+/**
+ * \brief Inliers of radius outlier removal
+ * \param input span to filter
+ * \param radius search radius
+ * \param min_neighbors minimum number of neighbors of an inlier
+ * \param threads number of threads, 0 means the number of cores
+ * \param inliers resulting sorted indices, destroy with pcs_indices_destroy
+ */
+PCS_API pcs_status
+pcs_radius_outlier_removal(const pcs_span* input,
+                           double radius,
+                           int min_neighbors,
+                           unsigned int threads,
+                           pcs_indices** inliers);
+
+/**
+ * \brief Copy selected points of a span
+ * \param input source span
+ * \param indices indices of points to copy
+ * \param count number of indices
+ * \param output resulting unorganized span with the layout of input, destroy with
+ * pcs_span_destroy
+ */
+PCS_API pcs_status
+pcs_extract_indices(const pcs_span* input,
+                    const int32_t* indices,
+                    uint64_t count,
+                    pcs_span** output);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,572 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2023 Ilia Kovalev
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <pcl_cloud_span/pcl_cloud_span.h>
+
+#include <pcl_cloud_span/pcl_cloud_span_c.h>
+#include <pcl_cloud_span/pyramid.h>
+#include <pcl_cloud_span/radius_outlier_removal.h>
+#include <pcl_cloud_span/statistical_outlier_removal.h>
+#include <pcl_cloud_span/transforms.h>
+
+#include <pcl/exceptions.h>
+#include <pcl/filters/voxel_grid.h>
+#include <pcl/point_types.h>
+#include <pcl/register_point_struct.h>
+
+#include <Eigen/Core>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <exception>
+#include <limits>
+#include <memory>
+#include <new>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace pcs {
+
+/**
+ * \brief Packed point with x, y and z
+ * \details Only 3D Eigen maps are provided, 4D maps would read past the last point of
+ * a caller buffer. Algorithms using them (e.g. pcl::VoxelGrid) do not compile for this
+ * type.
+ */
+struct PointXYZ {
+  union {
+    float data[3];
+    struct {
+      float x;
+      float y;
+      float z;
+    };
+  };
+
+  pcl::Vector3fMap
+  getVector3fMap()
+  {
+    return pcl::Vector3fMap(data);
+  }
+
+  pcl::Vector3fMapConst
+  getVector3fMap() const
+  {
+    return pcl::Vector3fMapConst(data);
+  }
+
+  pcl::Array3fMap
+  getArray3fMap()
+  {
+    return pcl::Array3fMap(data);
+  }
+
+  pcl::Array3fMapConst
+  getArray3fMap() const
+  {
+    return pcl::Array3fMapConst(data);
+  }
+};
+
+/** \brief Packed point with x, y, z and intensity. */
+struct PointXYZI {
+  union {
+    float data[4];
+    struct {
+      float x;
+      float y;
+      float z;
+      float intensity;
+    };
+  };
+  PCL_ADD_EIGEN_MAPS_POINT4D
+};
+
+} // namespace pcs
+
+// cppcheck-suppress unknownMacro
+POINT_CLOUD_REGISTER_POINT_STRUCT(pcl_cloud_span::Spannable<pcs::PointXYZ>,
+                                  (float, x, x)(float, y, y)(float, z, z))
+// cppcheck-suppress unknownMacro
+POINT_CLOUD_REGISTER_POINT_STRUCT(pcl_cloud_span::Spannable<pcs::PointXYZI>,
+                                  (float, x, x)(float, y, y)(float, z, z)(float,
+                                                                          intensity,
+                                                                          intensity))
+// cppcheck-suppress unknownMacro
+POINT_CLOUD_REGISTER_POINT_STRUCT(pcl_cloud_span::Spannable<pcl::PointXYZ>,
+                                  (float, x, x)(float, y, y)(float, z, z))
+// cppcheck-suppress unknownMacro
+POINT_CLOUD_REGISTER_POINT_STRUCT(pcl_cloud_span::Spannable<pcl::PointXYZI>,
+                                  (float, x, x)(float, y, y)(float, z, z)(float,
+                                                                          intensity,
+                                                                          intensity))
+
+static_assert(sizeof(pcl::index_t) == sizeof(std::int32_t),
+              "The C interface requires 32-bit PCL indices");
+
+/** \brief Point types of supported layouts. */
+enum class PointType { xyz12, xyz16, xyzi16, xyzi32 };
+
+struct pcs_span {
+  PointType type;
+  std::uint32_t width = 0;
+  std::uint32_t height = 0;
+  void* data = nullptr;
+  pcs_release_callback release = nullptr;
+  void* user_data = nullptr;
+  /** \brief Points owned by the library, empty for spans over caller buffers. */
+  std::shared_ptr<void> storage;
+  std::vector<std::string> names;
+  std::vector<pcs_field> fields;
+  pcs_layout layout{};
+};
+
+struct pcs_indices {
+  pcl::Indices indices;
+};
+
+namespace pcs {
+namespace {
+
+using pcl_cloud_span::Spannable;
+
+thread_local std::string last_error;
+
+template <typename PointT>
+struct Tag {
+  using type = PointT;
+};
+
+/** \brief Run a function with the point type of a layout as a tag argument. */
+template <typename Function>
+void
+dispatch(PointType type, Function&& function)
+{
+  switch (type) {
+  case PointType::xyz12:
+    function(Tag<PointXYZ>{});
+    break;
+  case PointType::xyz16:
+    function(Tag<pcl::PointXYZ>{});
+    break;
+  case PointType::xyzi16:
+    function(Tag<PointXYZI>{});
+    break;
+  case PointType::xyzi32:
+    function(Tag<pcl::PointXYZI>{});
+    break;
+  }
+}
+
+/** \brief Run a function translating exceptions into statuses. */
+template <typename Function>
+pcs_status
+guarded(Function&& function)
+{
+  try {
+    return function();
+  } catch (const std::bad_alloc&) {
+    last_error = "Out of memory";
+    return PCS_OUT_OF_MEMORY;
+  } catch (const std::exception& e) {
+    last_error = e.what();
+    return PCS_ERROR;
+  } catch (...) {
+    last_error = "Unknown error";
+    return PCS_ERROR;
+  }
+}
+
+pcs_status
+fail(pcs_status status, const char* message)
+{
+  last_error = message;
+  return status;
+}
+
+const pcs_field*
+findField(const pcs_layout& layout, const char* name)
+{
+  for (std::uint32_t i = 0; i < layout.field_count; ++i)
+    if (layout.fields[i].name && std::strcmp(layout.fields[i].name, name) == 0)
+      return &layout.fields[i];
+  return nullptr;
+}
+
+bool
+hasFloatField(const pcs_layout& layout, const char* name, std::uint32_t offset)
+{
+  const auto* field = findField(layout, name);
+  return field && field->offset == offset && field->datatype == PCS_FLOAT32 &&
+         field->count == 1;
+}
+
+/** \brief Point type matching a layout, false if there is none. */
+bool
+matchLayout(const pcs_layout& layout, PointType& type)
+{
+  if (!hasFloatField(layout, "x", 0) || !hasFloatField(layout, "y", 4) ||
+      !hasFloatField(layout, "z", 8))
+    return false;
+  if (layout.field_count == 3) {
+    if (layout.point_step == sizeof(PointXYZ))
+      type = PointType::xyz12;
+    else if (layout.point_step == sizeof(pcl::PointXYZ))
+      type = PointType::xyz16;
+    else
+      return false;
+    return true;
+  }
+  if (layout.field_count == 4) {
+    if (layout.point_step == sizeof(PointXYZI) &&
+        hasFloatField(layout, "intensity", offsetof(PointXYZI, intensity)))
+      type = PointType::xyzi16;
+    else if (layout.point_step == sizeof(pcl::PointXYZI) &&
+             hasFloatField(layout, "intensity", offsetof(pcl::PointXYZI, intensity)))
+      type = PointType::xyzi32;
+    else
+      return false;
+    return true;
+  }
+  return false;
+}
+
+/** \brief Store a copy of a layout in a span. */
+void
+setLayout(pcs_span& span, const pcs_layout& layout)
+{
+  span.names.resize(layout.field_count);
+  span.fields.assign(layout.fields, layout.fields + layout.field_count);
+  for (std::uint32_t i = 0; i < layout.field_count; ++i) {
+    span.names[i] = layout.fields[i].name;
+    span.fields[i].name = span.names[i].c_str();
+  }
+  span.layout = {layout.point_step, layout.field_count, span.fields.data()};
+}
+
+template <typename PointT>
+typename pcl::PointCloud<Spannable<PointT>>::Ptr
+makeCloud(const pcs_span& span)
+{
+  auto cloud = pcl_cloud_span::makeCloudSpanPtr(
+      static_cast<PointT*>(span.data), span.width, span.height);
+  cloud->is_dense = false;
+  return cloud;
+}
+
+/** \brief Create a span owning the points of a cloud without copying them. */
+template <typename PointT>
+pcs_span*
+makeSpan(const pcs_span& input, pcl::PointCloud<Spannable<PointT>>&& cloud)
+{
+  auto points = std::make_shared<pcl::PointCloud<PointT>>(
+      pcl_cloud_span::convertToPCL(std::move(cloud)));
+  std::unique_ptr<pcs_span> span(new pcs_span);
+  span->type = input.type;
+  span->width = points->width;
+  span->height = points->height;
+  span->data = points->data();
+  span->storage = std::move(points);
+  setLayout(*span, input.layout);
+  return span.release();
+}
+
+/** \brief Downsample with pcl::VoxelGrid, which reads 4 floats per point. */
+template <typename PointT>
+pcl::PointCloud<Spannable<PointT>>
+voxelGrid(Tag<PointT>,
+          const pcs_span& input,
+          const Eigen::Vector3f& leaf_size,
+          std::uint32_t min_points_per_voxel)
+{
+  pcl::VoxelGrid<Spannable<PointT>> filter;
+  filter.setInputCloud(makeCloud<PointT>(input));
+  filter.setLeafSize(leaf_size.x(), leaf_size.y(), leaf_size.z());
+  filter.setMinimumPointsNumberPerVoxel(min_points_per_voxel);
+  pcl::PointCloud<Spannable<PointT>> cloud;
+  filter.filter(cloud);
+  return cloud;
+}
+
+/**
+ * \brief Downsample packed xyz points with the finest level of a voxel pyramid
+ * \details The level has the centroids of pcl::VoxelGrid, but is computed from point
+ * fields only. Leaves are cubic, the caller checks that leaf sizes are equal.
+ */
+pcl::PointCloud<Spannable<PointXYZ>>
+voxelGrid(Tag<PointXYZ>,
+          const pcs_span& input,
+          const Eigen::Vector3f& leaf_size,
+          std::uint32_t min_points_per_voxel)
+{
+  pcl_cloud_span::VoxelPyramid<PointXYZ> pyramid;
+  pyramid.setInputCloud(makeCloud<PointXYZ>(input));
+  pyramid.setLeafSize(leaf_size.x());
+  const auto& voxels = *pyramid.getLevel(0);
+  const auto& counts = pyramid.getPointCounts(0);
+  pcl::PointCloud<Spannable<PointXYZ>> cloud;
+  for (std::size_t i = 0; i < voxels.size(); ++i)
+    if (counts[i] >= min_points_per_voxel)
+      cloud.push_back(voxels[i]);
+  return cloud;
+}
+
+pcs_indices*
+makeIndices(pcl::Indices&& indices)
+{
+  return new pcs_indices{std::move(indices)};
+}
+
+} // namespace
+} // namespace pcs
+
+extern "C" {
+
+const char*
+pcs_last_error(void)
+{
+  return pcs::last_error.c_str();
+}
+
+pcs_status
+pcs_span_create(void* data,
+                uint32_t width,
+                uint32_t height,
+                const pcs_layout* layout,
+                pcs_release_callback release,
+                void* user_data,
+                pcs_span** span)
+{
+  if (!layout || !span || (!layout->fields && layout->field_count != 0))
+    return pcs::fail(PCS_INVALID_ARGUMENT, "Layout and span must not be null");
+  if (!data && static_cast<std::uint64_t>(width) * height != 0)
+    return pcs::fail(PCS_INVALID_ARGUMENT, "Data must not be null");
+  PointType type;
+  if (!pcs::matchLayout(*layout, type))
+    return pcs::fail(PCS_UNSUPPORTED_LAYOUT, "Point layout is not supported");
+  const std::uintptr_t alignment = layout->point_step == sizeof(pcs::PointXYZ) ? 4 : 16;
+  if (reinterpret_cast<std::uintptr_t>(data) % alignment != 0)
+    return pcs::fail(PCS_INVALID_ARGUMENT, "Data is not aligned for the layout");
+
+  return pcs::guarded([&] {
+    std::unique_ptr<pcs_span> result(new pcs_span);
+    result->type = type;
+    result->width = width;
+    result->height = height;
+    result->data = data;
+    result->release = release;
+    result->user_data = user_data;
+    pcs::setLayout(*result, *layout);
+    *span = result.release();
+    return PCS_OK;
+  });
+}
+
+void
+pcs_span_destroy(pcs_span* span)
+{
+  if (!span)
+    return;
+  if (span->release)
+    span->release(span->data, span->user_data);
+  delete span;
+}
+
+uint64_t
+pcs_span_size(const pcs_span* span)
+{
+  return span ? static_cast<std::uint64_t>(span->width) * span->height : 0;
+}
+
+uint32_t
+pcs_span_width(const pcs_span* span)
+{
+  return span ? span->width : 0;
+}
+
+uint32_t
+pcs_span_height(const pcs_span* span)
+{
+  return span ? span->height : 0;
+}
+
+void*
+pcs_span_data(const pcs_span* span)
+{
+  return span ? span->data : nullptr;
+}
+
+const pcs_layout*
+pcs_span_layout(const pcs_span* span)
+{
+  return span ? &span->layout : nullptr;
+}
+
+uint64_t
+pcs_indices_size(const pcs_indices* indices)
+{
+  return indices ? indices->indices.size() : 0;
+}
+
+const int32_t*
+pcs_indices_data(const pcs_indices* indices)
+{
+  return indices ? indices->indices.data() : nullptr;
+}
+
+void
+pcs_indices_destroy(pcs_indices* indices)
+{
+  delete indices;
+}
+
+pcs_status
+pcs_transform(pcs_span* span, const float matrix[16], unsigned int threads)
+{
+  if (!span || !matrix)
+    return pcs::fail(PCS_INVALID_ARGUMENT, "Span and matrix must not be null");
+  return pcs::guarded([&] {
+    const Eigen::Matrix4f transform =
+        Eigen::Map<const Eigen::Matrix<float, 4, 4, Eigen::RowMajor>>(matrix);
+    pcs::dispatch(span->type, [&](auto tag) {
+      using PointT = typename decltype(tag)::type;
+      pcl_cloud_span::transformPointCloudInPlace(
+          *pcs::makeCloud<PointT>(*span), transform, threads);
+    });
+    return PCS_OK;
+  });
+}
+
+pcs_status
+pcs_voxel_grid(const pcs_span* input,
+               float leaf_x,
+               float leaf_y,
+               float leaf_z,
+               uint32_t min_points_per_voxel,
+               pcs_span** output)
+{
+  if (!input || !output)
+    return pcs::fail(PCS_INVALID_ARGUMENT, "Input and output must not be null");
+  if (!(leaf_x > 0 && leaf_y > 0 && leaf_z > 0))
+    return pcs::fail(PCS_INVALID_ARGUMENT, "Leaf sizes must be positive");
+  if (input->type == PointType::xyz12 &&
+      std::max({leaf_x, leaf_y, leaf_z}) > std::min({leaf_x, leaf_y, leaf_z}))
+    return pcs::fail(PCS_INVALID_ARGUMENT,
+                     "Packed xyz spans are downsampled with equal leaf sizes only");
+  return pcs::guarded([&] {
+    pcs::dispatch(input->type, [&](auto tag) {
+      const Eigen::Vector3f leaf_size(leaf_x, leaf_y, leaf_z);
+      *output = pcs::makeSpan(
+          *input, pcs::voxelGrid(tag, *input, leaf_size, min_points_per_voxel));
+    });
+    return PCS_OK;
+  });
+}
+
+pcs_status
+pcs_statistical_outlier_removal(const pcs_span* input,
+                                int mean_k,
+                                double stddev_mul,
+                                unsigned int threads,
+                                pcs_indices** inliers)
+{
+  if (!input || !inliers)
+    return pcs::fail(PCS_INVALID_ARGUMENT, "Input and inliers must not be null");
+  if (mean_k < 1)
+    return pcs::fail(PCS_INVALID_ARGUMENT, "Number of neighbors must be positive");
+  return pcs::guarded([&] {
+    pcl::Indices indices;
+    pcs::dispatch(input->type, [&](auto tag) {
+      using PointT = typename decltype(tag)::type;
+      pcl_cloud_span::StatisticalOutlierRemoval<PointT> filter;
+      filter.setInputCloud(pcs::makeCloud<PointT>(*input));
+      filter.setMeanK(mean_k);
+      filter.setStddevMulThresh(stddev_mul);
+      filter.setNumberOfThreads(threads);
+      filter.filter(indices);
+    });
+    *inliers = pcs::makeIndices(std::move(indices));
+    return PCS_OK;
+  });
+}
+
+pcs_status
+pcs_radius_outlier_removal(const pcs_span* input,
+                           double radius,
+                           int min_neighbors,
+                           unsigned int threads,
+                           pcs_indices** inliers)
+{
+  if (!input || !inliers)
+    return pcs::fail(PCS_INVALID_ARGUMENT, "Input and inliers must not be null");
+  if (!(radius > 0))
+    return pcs::fail(PCS_INVALID_ARGUMENT, "Radius must be positive");
+  return pcs::guarded([&] {
+    pcl::Indices indices;
+    pcs::dispatch(input->type, [&](auto tag) {
+      using PointT = typename decltype(tag)::type;
+      pcl_cloud_span::RadiusOutlierRemoval<PointT> filter;
+      filter.setInputCloud(pcs::makeCloud<PointT>(*input));
+      filter.setRadiusSearch(radius);
+      filter.setMinNeighborsInRadius(min_neighbors);
+      filter.setNumberOfThreads(threads);
+      filter.filter(indices);
+    });
+    *inliers = pcs::makeIndices(std::move(indices));
+    return PCS_OK;
+  });
+}
+
+pcs_status
+pcs_extract_indices(const pcs_span* input,
+                    const int32_t* indices,
+                    uint64_t count,
+                    pcs_span** output)
+{
+  if (!input || !output || (!indices && count != 0))
+    return pcs::fail(PCS_INVALID_ARGUMENT, "Arguments must not be null");
+  if (count > std::numeric_limits<std::uint32_t>::max())
+    return pcs::fail(PCS_INVALID_ARGUMENT, "Too many indices");
+  const std::uint64_t size = pcs_span_size(input);
+  for (std::uint64_t i = 0; i < count; ++i)
+    if (indices[i] < 0 || static_cast<std::uint64_t>(indices[i]) >= size)
+      return pcs::fail(PCS_INVALID_ARGUMENT, "Index out of range");
+  return pcs::guarded([&] {
+    pcs::dispatch(input->type, [&](auto tag) {
+      using PointT = typename decltype(tag)::type;
+      const auto cloud = pcs::makeCloud<PointT>(*input);
+      pcl::PointCloud<pcl_cloud_span::Spannable<PointT>> selected;
+      selected.resize(static_cast<std::size_t>(count));
+      for (std::size_t i = 0; i < selected.size(); ++i)
+        selected[i] = (*cloud)[static_cast<std::size_t>(indices[i])];
+      *output = pcs::makeSpan(*input, std::move(selected));
+    });
+    return PCS_OK;
+  });
+}
+
+} // extern "C"
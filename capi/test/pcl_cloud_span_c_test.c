@@ -0,0 +1,192 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2023 Ilia Kovalev
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/* for MAP_ANONYMOUS in strict C modes */
+#define _DEFAULT_SOURCE
+
+#include <pcl_cloud_span/pcl_cloud_span_c.h>
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/mman.h>
+#include <unistd.h>
+#define HAVE_GUARD_PAGE
+#endif
+
+#define CHECK(condition)                                                               \
+  do {                                                                                 \
+    if (!(condition)) {                                                                \
+      fprintf(stderr, "%s:%d: check failed: %s (%s)\n",                               \
+              __FILE__, __LINE__, #condition, pcs_last_error());                       \
+      return 1;                                                                        \
+    }                                                                                  \
+  } while (0)
+
+typedef struct Point {
+  float x;
+  float y;
+  float z;
+} Point;
+
+static void
+countRelease(void* data, void* user_data)
+{
+  (void)data;
+  ++*(int*)user_data;
+}
+
+static int
+testSpan(void)
+{
+  enum { size = 1000 };
+  static Point points[size];
+  const pcs_field fields[] = {
+      {"x", 0, PCS_FLOAT32, 1}, {"y", 4, PCS_FLOAT32, 1}, {"z", 8, PCS_FLOAT32, 1}};
+  const pcs_layout layout = {sizeof(Point), 3, fields};
+  const float matrix[16] = {1, 0, 0, 1, 0, 1, 0, 2, 0, 0, 1, 3, 0, 0, 0, 1};
+  pcs_span* span = NULL;
+  pcs_span* downsampled = NULL;
+  pcs_span* selected = NULL;
+  pcs_indices* inliers = NULL;
+  int released = 0;
+  int i;
+
+  for (i = 0; i < size; ++i) {
+    points[i].x = (float)(i % 10);
+    points[i].y = (float)(i / 10 % 10);
+    points[i].z = (float)(i / 100);
+  }
+
+  CHECK(pcs_span_create(points, size, 1, &layout, countRelease, &released, &span) ==
+        PCS_OK);
+  CHECK(pcs_span_size(span) == size);
+  CHECK(pcs_span_data(span) == points);
+  CHECK(pcs_span_layout(span)->field_count == 3);
+
+  CHECK(pcs_voxel_grid(span, 2, 2, 2, 0, &downsampled) == PCS_OK);
+  CHECK(pcs_span_size(downsampled) == 125);
+  CHECK(pcs_span_layout(downsampled)->point_step == sizeof(Point));
+
+  CHECK(pcs_statistical_outlier_removal(span, 8, 1., 1, &inliers) == PCS_OK);
+  CHECK(pcs_indices_size(inliers) > 0);
+  CHECK(pcs_extract_indices(span,
+                            pcs_indices_data(inliers),
+                            pcs_indices_size(inliers),
+                            &selected) == PCS_OK);
+  CHECK(pcs_span_size(selected) == pcs_indices_size(inliers));
+  CHECK(((const Point*)pcs_span_data(selected))[0].x ==
+        points[pcs_indices_data(inliers)[0]].x);
+
+  CHECK(pcs_transform(span, matrix, 1) == PCS_OK);
+  CHECK(fabsf(points[999].x - 10) < 1e-5f && fabsf(points[999].z - 12) < 1e-5f);
+
+  pcs_indices_destroy(inliers);
+  pcs_span_destroy(selected);
+  pcs_span_destroy(downsampled);
+  CHECK(released == 0);
+  pcs_span_destroy(span);
+  CHECK(released == 1);
+  return 0;
+}
+
+#ifdef HAVE_GUARD_PAGE
+/* packed points end at a page without access, so reading past them crashes */
+static int
+testGuardPage(void)
+{
+  enum { size = 100 };
+  const size_t page = (size_t)sysconf(_SC_PAGESIZE);
+  const pcs_field fields[] = {
+      {"x", 0, PCS_FLOAT32, 1}, {"y", 4, PCS_FLOAT32, 1}, {"z", 8, PCS_FLOAT32, 1}};
+  const pcs_layout layout = {sizeof(Point), 3, fields};
+  pcs_span* span = NULL;
+  pcs_span* downsampled = NULL;
+  pcs_indices* inliers = NULL;
+  char* pages;
+  Point* points;
+  int i;
+
+  pages = (char*)mmap(
+      NULL, 2 * page, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  CHECK(pages != MAP_FAILED);
+  CHECK(mprotect(pages + page, page, PROT_NONE) == 0);
+  points = (Point*)(pages + page) - size;
+  for (i = 0; i < size; ++i) {
+    points[i].x = (float)(i % 10);
+    points[i].y = (float)(i / 10);
+    points[i].z = 0;
+  }
+
+  CHECK(pcs_span_create(points, size, 1, &layout, NULL, NULL, &span) == PCS_OK);
+  CHECK(pcs_voxel_grid(span, 2, 2, 2, 0, &downsampled) == PCS_OK);
+  CHECK(pcs_span_size(downsampled) == 25);
+  pcs_span_destroy(downsampled);
+  downsampled = NULL;
+  CHECK(pcs_voxel_grid(span, 1, 2, 2, 0, &downsampled) == PCS_INVALID_ARGUMENT);
+  CHECK(downsampled == NULL);
+
+  CHECK(pcs_statistical_outlier_removal(span, 8, 1., 1, &inliers) == PCS_OK);
+  pcs_indices_destroy(inliers);
+  CHECK(pcs_radius_outlier_removal(span, 1.5, 2, 1, &inliers) == PCS_OK);
+  CHECK(pcs_indices_size(inliers) == size);
+  pcs_indices_destroy(inliers);
+
+  pcs_span_destroy(span);
+  CHECK(munmap(pages, 2 * page) == 0);
+  return 0;
+}
+#endif
+
+static int
+testErrors(void)
+{
+  float data[4] = {0};
+  const pcs_field fields[] = {
+      {"x", 0, PCS_FLOAT32, 1}, {"y", 4, PCS_FLOAT64, 1}, {"z", 8, PCS_FLOAT32, 1}};
+  const pcs_layout layout = {12, 3, fields};
+  pcs_span* span = NULL;
+
+  CHECK(pcs_span_create(data, 1, 1, &layout, NULL, NULL, &span) ==
+        PCS_UNSUPPORTED_LAYOUT);
+  CHECK(span == NULL);
+  CHECK(pcs_span_create(data, 1, 1, NULL, NULL, NULL, &span) == PCS_INVALID_ARGUMENT);
+  CHECK(pcs_voxel_grid(NULL, 1, 1, 1, 0, &span) == PCS_INVALID_ARGUMENT);
+  return 0;
+}
+
+int
+main(void)
+{
+  if (testSpan() != 0 || testErrors() != 0)
+    return EXIT_FAILURE;
+#ifdef HAVE_GUARD_PAGE
+  if (testGuardPage() != 0)
+    return EXIT_FAILURE;
+#endif
+  printf("All tests passed\n");
+  return EXIT_SUCCESS;
+}
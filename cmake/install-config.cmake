@@ -1,3 +1,6 @@
 include(CMakeFindDependencyMacro)
 
+find_package(OpenMP QUIET)
+find_package(zstd CONFIG QUIET)
+
 include("${CMAKE_CURRENT_LIST_DIR}/pcl_cloud_spanTargets.cmake")
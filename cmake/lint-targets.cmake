@@ -4,6 +4,8 @@ set(
     include/*.hpp
     test/*.cpp test/*.hpp
     example/*.cpp example/*.hpp
+    python/*.cpp python/*.hpp
+    capi/*.c capi/*.cpp capi/*.h
     CACHE STRING
     "; separated patterns relative to the project source dir to format"
 )
@@ -13,6 +13,8 @@ default(
     include/*.hpp
     test/*.cpp test/*.hpp
     example/*.cpp example/*.hpp
+    python/*.cpp python/*.hpp
+    capi/*.c capi/*.cpp capi/*.h
 )
 default(FIX NO)
 
@@ -0,0 +1,214 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2023 Ilia Kovalev
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include <pcl_cloud_span/pcl_cloud_span.h>
+
+#include <pcl/exceptions.h>
+
+#include "impl/parallel.h"
+#include "impl/point_count.h"
+#include "impl/voxel_key.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+namespace pcl_cloud_span {
+
+/**
+ * \brief Detects voxels that appeared or disappeared between consecutive span frames
+ * \details Replacement of pcl::octree::OctreePointCloudChangeDetector that indexes
+ * frames without copying points. Each frame is stored as an array of (voxel key, point
+ * index) pairs sorted by key, computed and sorted in parallel. Two such arrays are
+ * kept and swapped on every frame, so their memory is reused. Changes are found by a
+ * single merge of both arrays.
+ *
+ * Voxels form a grid with the origin at zero. A voxel is occupied in a frame if it
+ * contains at least the minimal number of points. Points with non-finite coordinates
+ * are ignored.
+ * \tparam PointT point type
+ */
+template <typename PointT>
+class ChangeDetector {
+public:
+  using PointCloud = pcl::PointCloud<Spannable<PointT>>;
+
+  /**
+   * \brief Set the voxel size, forgets added frames
+   * \param resolution voxel size
+   * \throws pcl::BadArgumentException if resolution is not positive
+   */
+  void
+  setResolution(float resolution)
+  {
+    if (!(resolution > 0))
+      PCL_THROW_EXCEPTION(pcl::BadArgumentException, "Resolution must be positive");
+    resolution_ = resolution;
+    reset();
+  }
+
+  /**
+   * \brief Set the minimal number of points in an occupied voxel
+   * \param min_points minimal number of points, 1 by default
+   */
+  void
+  setMinPointsPerVoxel(std::size_t min_points)
+  {
+    min_points_ = std::max<std::size_t>(min_points, 1);
+  }
+
+  /**
+   * \brief Set the number of threads to use
+   * \param nr_threads the number of hardware threads to use (0 sets the value back to
+   * automatic)
+   */
+  void
+  setNumberOfThreads(unsigned int nr_threads = 0)
+  {
+    threads_ = detail::resolveNumberOfThreads(nr_threads);
+  }
+
+  /**
+   * \brief Add the next frame, the current frame becomes the previous one
+   * \details Only point indices are stored, the frame may be released after the call.
+   * \param cloud point cloud span of the frame
+   * \throws pcl::BadArgumentException if the cloud is too large for pcl::index_t
+   */
+  void
+  addFrame(const PointCloud& cloud)
+  {
+    detail::checkIndexable(cloud.size());
+    std::swap(previous_, current_);
+    has_previous_ = has_current_;
+    has_current_ = true;
+
+    const auto size = static_cast<std::ptrdiff_t>(cloud.size());
+    const float inverse_resolution = 1.f / resolution_;
+    current_.resize(cloud.size());
+#pragma omp parallel for num_threads(threads_) schedule(static)
+    for (std::ptrdiff_t i = 0; i < size; ++i) {
+      const auto point = static_cast<std::size_t>(i);
+      auto& entry = current_[point];
+      entry.second =
+          detail::computeVoxelKey(cloud[point], inverse_resolution, entry.first)
+              ? static_cast<pcl::index_t>(i)
+              : -1;
+    }
+    current_.erase(std::remove_if(current_.begin(),
+                                  current_.end(),
+                                  [](const Entry& entry) { return entry.second < 0; }),
+                   current_.end());
+    detail::parallelSort(current_.begin(), current_.end(), compareEntries, threads_);
+  }
+
+  /** \brief Whether two frames were added since the last reset. */
+  bool
+  hasPreviousFrame() const
+  {
+    return has_previous_;
+  }
+
+  /** \brief Forget added frames keeping allocated memory. */
+  void
+  reset()
+  {
+    previous_.clear();
+    current_.clear();
+    has_previous_ = has_current_ = false;
+  }
+
+  /**
+   * \brief Get indices of points of the current frame in voxels that are occupied in
+   * the current frame but not in the previous one
+   * \details If there is no previous frame, all points of occupied voxels are new.
+   * \param indices sorted indices into the current frame
+   */
+  void
+  getNewPoints(pcl::Indices& indices) const
+  {
+    difference(current_, previous_, indices);
+  }
+
+  /**
+   * \brief Get indices of points of the previous frame in voxels that are occupied in
+   * the previous frame but not in the current one
+   * \param indices sorted indices into the previous frame
+   */
+  void
+  getRemovedPoints(pcl::Indices& indices) const
+  {
+    difference(previous_, current_, indices);
+  }
+
+private:
+  using Entry = std::pair<detail::VoxelKey, pcl::index_t>;
+
+  static bool
+  compareEntries(const Entry& a, const Entry& b)
+  {
+    return a.first < b.first || (a.first == b.first && a.second < b.second);
+  }
+
+  /** \brief Collect points of voxels occupied in `a` but not in `b`. */
+  void
+  difference(const std::vector<Entry>& a,
+             const std::vector<Entry>& b,
+             pcl::Indices& indices) const
+  {
+    indices.clear();
+    std::size_t j = 0;
+    for (std::size_t begin = 0; begin < a.size();) {
+      const auto& key = a[begin].first;
+      std::size_t end = begin + 1;
+      while (end < a.size() && a[end].first == key)
+        ++end;
+
+      while (j < b.size() && b[j].first < key)
+        ++j;
+      std::size_t count_b = 0;
+      while (j + count_b < b.size() && b[j + count_b].first == key)
+        ++count_b;
+
+      if (end - begin >= min_points_ && count_b < min_points_)
+        for (std::size_t i = begin; i < end; ++i)
+          indices.push_back(a[i].second);
+      begin = end;
+    }
+    std::sort(indices.begin(), indices.end());
+  }
+
+  float resolution_ = 1.f;
+  std::size_t min_points_ = 1;
+  unsigned int threads_ = 1;
+
+  std::vector<Entry> previous_;
+  std::vector<Entry> current_;
+  bool has_previous_ = false;
+  bool has_current_ = false;
+};
+
+} // namespace pcl_cloud_span
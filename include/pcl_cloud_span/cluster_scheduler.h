@@ -0,0 +1,242 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2023 Ilia Kovalev
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include <pcl_cloud_span/pcl_cloud_span.h>
+#include <pcl_cloud_span/ragged_point_cloud.h>
+
+#include <pcl/exceptions.h>
+
+#include "impl/parallel.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <type_traits>
+#include <vector>
+
+namespace pcl_cloud_span {
+
+/**
+ * \brief Runs an operation on every cloud of a RaggedPointCloud in parallel with
+ * size-aware load balancing
+ * \details Clusters are processed largest first and handed out to threads one by one,
+ * so a single huge cluster starts early instead of finishing last. If the operation
+ * can be computed on parts of a cluster and the partial results combined, clusters
+ * larger than the split size are split into parts processed independently. Results are
+ * written into preallocated slots, one per cluster.
+ * \tparam PointT point type
+ */
+template <typename PointT>
+class ClusterScheduler {
+public:
+  using PointCloud = pcl::PointCloud<Spannable<PointT>>;
+
+  /**
+   * \brief Set the number of threads to use
+   * \param nr_threads the number of hardware threads to use (0 sets the value back to
+   * automatic)
+   */
+  void
+  setNumberOfThreads(unsigned int nr_threads = 0)
+  {
+    threads_ = detail::resolveNumberOfThreads(nr_threads);
+  }
+
+  /**
+   * \brief Set the maximal number of points in a part of a split cluster
+   * \param split_size maximal part size, 65536 by default
+   * \throws pcl::BadArgumentException if split size is zero
+   */
+  void
+  setSplitSize(std::size_t split_size)
+  {
+    if (split_size == 0)
+      PCL_THROW_EXCEPTION(pcl::BadArgumentException, "Split size must be positive");
+    split_size_ = split_size;
+  }
+
+  /**
+   * \brief Run an operation on every cluster
+   * \param clusters clusters to process
+   * \param operation callable `ResultT(PointCloud& cluster)`, called concurrently
+   * \param results result of each cluster, resized to the number of clusters
+   * \tparam ResultT result type, anything but bool since elements of std::vector<bool>
+   * can not be written concurrently
+   */
+  template <typename ResultT, typename Operation>
+  void
+  run(RaggedPointCloud<PointT>& clusters,
+      Operation operation,
+      std::vector<ResultT>& results)
+  {
+    static_assert(!std::is_same<ResultT, bool>::value,
+                  "Results are written concurrently, use e.g. std::uint8_t for flags");
+    makeTasks(clusters, false);
+    results.resize(clusters.size());
+
+    const auto nr_tasks = static_cast<std::ptrdiff_t>(tasks_.size());
+#pragma omp parallel for num_threads(threads_) schedule(dynamic, 1)
+    for (std::ptrdiff_t i = 0; i < nr_tasks; ++i) {
+      const auto cluster = tasks_[order_[static_cast<std::size_t>(i)]].cluster;
+      auto span = clusters.at(cluster);
+      results[cluster] = operation(span);
+    }
+  }
+
+  /**
+   * \brief Run a splittable operation on every cluster
+   * \details Large clusters are split into parts of at most the split size, the partial
+   * operation is run on every part and partial results are combined in the order of
+   * parts.
+   * \param clusters clusters to process
+   * \param partial callable `ResultT(PointCloud& part)`, called concurrently
+   * \param combine callable `void(ResultT& result, const ResultT& part)` merging a
+   * partial result into the result of a cluster, called concurrently for different
+   * clusters
+   * \param results result of each cluster, resized to the number of clusters
+   * \tparam ResultT result type, anything but bool since elements of std::vector<bool>
+   * can not be written concurrently
+   */
+  template <typename ResultT, typename PartialOperation, typename CombineOperation>
+  void
+  run(RaggedPointCloud<PointT>& clusters,
+      PartialOperation partial,
+      CombineOperation combine,
+      std::vector<ResultT>& results)
+  {
+    static_assert(!std::is_same<ResultT, bool>::value,
+                  "Results are written concurrently, use e.g. std::uint8_t for flags");
+    makeTasks(clusters, true);
+    results.resize(clusters.size());
+    auto& parts = partialResults<ResultT>();
+    parts.resize(tasks_.size());
+
+    const auto nr_tasks = static_cast<std::ptrdiff_t>(tasks_.size());
+#pragma omp parallel for num_threads(threads_) schedule(dynamic, 1)
+    for (std::ptrdiff_t i = 0; i < nr_tasks; ++i) {
+      const auto task_index = order_[static_cast<std::size_t>(i)];
+      const auto& task = tasks_[task_index];
+      auto cluster = clusters.at(task.cluster);
+      auto part = makeCloudSpan(reinterpret_cast<PointT*>(cluster.data()) + task.begin,
+                                static_cast<std::uint32_t>(task.end - task.begin));
+      part.header = cluster.header;
+      part.is_dense = cluster.is_dense;
+      if (task.part == 0)
+        results[task.cluster] = partial(part);
+      else
+        parts[task_index] = partial(part);
+    }
+
+    const auto nr_clusters = static_cast<std::ptrdiff_t>(clusters.size());
+#pragma omp parallel for num_threads(threads_) schedule(dynamic, 16)
+    for (std::ptrdiff_t i = 0; i < nr_clusters; ++i) {
+      const auto cluster = static_cast<std::size_t>(i);
+      for (auto task = first_task_[cluster] + 1; task < first_task_[cluster + 1];
+           ++task)
+        combine(results[cluster], parts[task]);
+    }
+  }
+
+private:
+  /** \brief Type-erased storage of partial results kept between run calls. */
+  struct PartialResultsBase {
+    virtual ~PartialResultsBase() = default;
+  };
+
+  template <typename ResultT>
+  struct PartialResults : PartialResultsBase {
+    std::vector<ResultT> results;
+  };
+
+  /**
+   * \brief Get the buffer of partial results of the given type
+   * \details The buffer is reused by all run calls with the same result type, so
+   * per-frame calls do not allocate once it has grown to the number of tasks.
+   */
+  template <typename ResultT>
+  std::vector<ResultT>&
+  partialResults()
+  {
+    auto* parts = dynamic_cast<PartialResults<ResultT>*>(partial_results_.get());
+    if (!parts) {
+      parts = new PartialResults<ResultT>;
+      partial_results_.reset(parts);
+    }
+    return parts->results;
+  }
+
+  struct Task {
+    std::size_t cluster;
+    std::size_t part;
+    std::size_t begin;
+    std::size_t end;
+  };
+
+  /**
+   * \brief Split clusters into tasks and order tasks largest first
+   * \details Tasks of a cluster are stored contiguously starting at `first_task_`,
+   * `order_` is the processing order of tasks.
+   */
+  void
+  makeTasks(const RaggedPointCloud<PointT>& clusters, bool split)
+  {
+    tasks_.clear();
+    first_task_.resize(clusters.size() + 1);
+    for (std::size_t cluster = 0; cluster < clusters.size(); ++cluster) {
+      const std::size_t size = clusters.getCloudSize(cluster);
+      const std::size_t nr_parts =
+          split && size > split_size_ ? (size + split_size_ - 1) / split_size_ : 1;
+      first_task_[cluster] = tasks_.size();
+      for (std::size_t part = 0; part < nr_parts; ++part)
+        tasks_.push_back({cluster,
+                          part,
+                          size * part / nr_parts,
+                          size * (part + 1) / nr_parts});
+    }
+    first_task_.back() = tasks_.size();
+
+    order_.resize(tasks_.size());
+    for (std::size_t i = 0; i < order_.size(); ++i)
+      order_[i] = i;
+    const auto task_size = [this](std::size_t task) {
+      return tasks_[task].end - tasks_[task].begin;
+    };
+    std::stable_sort(order_.begin(), order_.end(), [&](std::size_t a, std::size_t b) {
+      return task_size(a) > task_size(b);
+    });
+  }
+
+  std::size_t split_size_ = 65536;
+  unsigned int threads_ = 1;
+
+  std::vector<std::size_t> order_;
+  std::vector<Task> tasks_;
+  std::vector<std::size_t> first_task_;
+  std::unique_ptr<PartialResultsBase> partial_results_;
+};
+
+} // namespace pcl_cloud_span
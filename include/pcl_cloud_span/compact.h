@@ -0,0 +1,72 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2023 Ilia Kovalev
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include <pcl_cloud_span/pcl_cloud_span.h>
+
+#include <pcl/types.h>
+
+#include "impl/point_count.h"
+
+#include <cassert>
+#include <cstdint>
+
+namespace pcl_cloud_span {
+
+/**
+ * \brief Move selected points of a span to the front of its buffer
+ * \details Point `indices[i]` is moved to position `i`, so selecting points needs
+ * neither an allocation nor a second buffer. Points of the buffer past the selected
+ * ones are left in an unspecified state. Header, density and sensor pose are copied to
+ * the result.
+ * \tparam PointT point type
+ * \param cloud point cloud span to compact
+ * \param indices strictly increasing indices of points to keep
+ * \return unorganized point cloud span over the selected points at the beginning of
+ * the buffer of `cloud`
+ * \throws pcl::BadArgumentException if more points are selected than fit the width
+ */
+template <typename PointT>
+pcl::PointCloud<Spannable<PointT>>
+compactInPlace(pcl::PointCloud<Spannable<PointT>>& cloud, const pcl::Indices& indices)
+{
+  detail::checkChunkSize(indices.size());
+  auto* data = cloud.data();
+  for (std::size_t i = 0; i < indices.size(); ++i) {
+    assert(static_cast<std::size_t>(indices[i]) >= i);
+    if (static_cast<std::size_t>(indices[i]) != i)
+      data[i] = data[indices[i]];
+  }
+
+  auto compacted = makeCloudSpan(reinterpret_cast<PointT*>(data),
+                                 static_cast<std::uint32_t>(indices.size()));
+  compacted.header = cloud.header;
+  compacted.is_dense = cloud.is_dense;
+  compacted.sensor_origin_ = cloud.sensor_origin_;
+  compacted.sensor_orientation_ = cloud.sensor_orientation_;
+  return compacted;
+}
+
+} // namespace pcl_cloud_span
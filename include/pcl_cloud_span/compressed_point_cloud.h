@@ -0,0 +1,740 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2023 Ilia Kovalev
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include <pcl_cloud_span/pcl_cloud_span.h>
+
+#include <pcl/PCLHeader.h>
+#include <pcl/common/io.h>
+#include <pcl/exceptions.h>
+
+#include <Eigen/Core>
+
+#include "impl/field_access.h"
+#include "impl/parallel.h"
+#include "impl/point_count.h"
+
+#ifdef PCL_CLOUD_SPAN_WITH_ZSTD
+#include <zstd.h>
+#endif
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <istream>
+#include <limits>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace pcl_cloud_span {
+namespace detail {
+
+/**
+ * \brief Append PackBits run-length encoding of bytes to a buffer
+ * \details A control byte `c < 128` is followed by `c + 1` literal bytes, a control
+ * byte `c > 128` is followed by one byte repeated `257 - c` times.
+ */
+inline void
+packBits(const std::uint8_t* data, std::size_t size, std::vector<std::uint8_t>& out)
+{
+  std::size_t i = 0;
+  while (i < size) {
+    std::size_t run = 1;
+    while (i + run < size && run < 128 && data[i + run] == data[i])
+      ++run;
+    if (run >= 3) {
+      out.push_back(static_cast<std::uint8_t>(257 - run));
+      out.push_back(data[i]);
+      i += run;
+      continue;
+    }
+
+    // literals until a run of three equal bytes starts
+    std::size_t end = i;
+    while (end < size && end - i < 128 &&
+           !(end + 2 < size && data[end] == data[end + 1] &&
+             data[end] == data[end + 2]))
+      ++end;
+    end = std::max(end, i + 1);
+    out.push_back(static_cast<std::uint8_t>(end - i - 1));
+    out.insert(out.end(), data + i, data + end);
+    i = end;
+  }
+}
+
+/**
+ * \brief Decode PackBits data into a buffer
+ * \details Literals are copied and runs are filled as a whole.
+ * \param data encoded bytes
+ * \param size number of encoded bytes
+ * \param out buffer of `expected` bytes
+ * \param expected number of decoded bytes
+ * \return false if the data is malformed or decodes to other than `expected` bytes
+ */
+inline bool
+unpackBits(const std::uint8_t* data,
+           std::size_t size,
+           std::uint8_t* out,
+           std::size_t expected)
+{
+  std::size_t i = 0;
+  std::size_t decoded = 0;
+  while (i < size) {
+    const std::uint8_t control = data[i++];
+    if (control < 128) {
+      const std::size_t count = control + 1u;
+      if (count > size - i || count > expected - decoded)
+        return false;
+      std::memcpy(out + decoded, data + i, count);
+      i += count;
+      decoded += count;
+    }
+    else if (control > 128) {
+      const std::size_t count = 257u - control;
+      if (i >= size || count > expected - decoded)
+        return false;
+      std::memset(out + decoded, data[i], count);
+      ++i;
+      decoded += count;
+    }
+  }
+  return decoded == expected;
+}
+
+/**
+ * \brief Gather byte b of every element into plane b
+ * \tparam Step size of an element in bytes
+ * \param elements `size` elements
+ * \param size number of elements
+ * \param planes output of `Step` planes of `size` bytes
+ */
+template <std::size_t Step>
+void
+shuffleBytes(const std::uint8_t* elements, std::size_t size, std::uint8_t* planes)
+{
+  // blocks of elements keep the strided side in cache
+  constexpr std::size_t block = 256;
+  for (std::size_t begin = 0; begin < size; begin += block) {
+    const std::size_t end = std::min(size, begin + block);
+    for (std::size_t b = 0; b < Step; ++b) {
+      auto* plane = planes + b * size;
+      for (std::size_t i = begin; i < end; ++i)
+        plane[i] = elements[i * Step + b];
+    }
+  }
+}
+
+/** \brief Scatter planes gathered by shuffleBytes back into elements. */
+template <std::size_t Step>
+void
+unshuffleBytes(const std::uint8_t* planes, std::size_t size, std::uint8_t* elements)
+{
+  constexpr std::size_t block = 256;
+  for (std::size_t begin = 0; begin < size; begin += block) {
+    const std::size_t end = std::min(size, begin + block);
+    for (std::size_t b = 0; b < Step; ++b) {
+      const auto* plane = planes + b * size;
+      for (std::size_t i = begin; i < end; ++i)
+        elements[i * Step + b] = plane[i];
+    }
+  }
+}
+
+} // namespace detail
+
+/** \brief Entropy coder applied to the shuffled bytes of a chunk. */
+enum class CompressionCodec {
+  /** \brief PackBits run-length encoding, always available. */
+  run_length,
+  /** \brief Zstandard, available if built with PCL_CLOUD_SPAN_WITH_ZSTD. */
+  zstd
+};
+
+/**
+ * \brief Compressed point cloud stored in independently compressed chunks
+ * \details Points are split into chunks of a fixed number of points. Each chunk is
+ * compressed on its own: x, y and z are optionally quantized to a fixed resolution
+ * relative to the chunk minimum and delta-coded, bytes of points are shuffled so that
+ * equal bytes of consecutive points are adjacent, and the result is encoded with
+ * the selected codec: run-length encoding by default or Zstandard if the library is
+ * built with the optional zstd feature. Chunks are compressed and decompressed in
+ * parallel and can be decompressed one by one for random access. Decompression writes
+ * points directly into a caller-owned arena reused between calls and returns a span
+ * over it.
+ *
+ * Chunks with non-finite coordinates or a coordinate range too large for the
+ * resolution are stored without quantization. The serialized form uses the native
+ * byte order.
+ * \tparam PointT point type
+ */
+template <typename PointT>
+class CompressedPointCloud {
+public:
+  using PointCloud = pcl::PointCloud<Spannable<PointT>>;
+  using VectorType =
+      std::vector<Spannable<PointT>, Eigen::aligned_allocator<Spannable<PointT>>>;
+
+  /** \brief Header of the compressed cloud, restored on decompression. */
+  pcl::PCLHeader header;
+
+  /**
+   * \brief Set the number of points in a chunk for the following compression
+   * \param chunk_size number of points, 65536 by default
+   * \throws pcl::BadArgumentException if chunk_size is zero
+   */
+  void
+  setChunkSize(std::uint32_t chunk_size)
+  {
+    if (chunk_size == 0)
+      PCL_THROW_EXCEPTION(pcl::BadArgumentException, "Chunk size must be positive");
+    chunk_size_ = chunk_size;
+  }
+
+  /**
+   * \brief Set the quantization resolution of x, y and z for the following compression
+   * \param resolution quantization step, 0 (default) stores coordinates losslessly
+   * \throws pcl::BadArgumentException if resolution is negative
+   */
+  void
+  setResolution(double resolution)
+  {
+    if (!(resolution >= 0))
+      PCL_THROW_EXCEPTION(pcl::BadArgumentException,
+                          "Resolution must not be negative");
+    resolution_ = resolution;
+  }
+
+  /**
+   * \brief Set the codec of chunks for the following compression
+   * \details Run-length encoding mostly compresses quantized coordinates and constant
+   * fields, Zstandard also compresses lossless coordinates but compresses slower.
+   * Chunks of either codec are decompressed regardless of this setting.
+   * \param codec CompressionCodec::run_length (default) or CompressionCodec::zstd
+   * \throws pcl::BadArgumentException if zstd is selected but not built in
+   */
+  void
+  setCodec(CompressionCodec codec)
+  {
+#ifndef PCL_CLOUD_SPAN_WITH_ZSTD
+    if (codec == CompressionCodec::zstd)
+      PCL_THROW_EXCEPTION(pcl::BadArgumentException,
+                          "Built without zstd, enable PCL_CLOUD_SPAN_WITH_ZSTD");
+#endif
+    codec_ = codec;
+  }
+
+  /**
+   * \brief Set the number of threads to use
+   * \param nr_threads the number of hardware threads to use (0 sets the value back to
+   * automatic)
+   */
+  void
+  setNumberOfThreads(unsigned int nr_threads = 0)
+  {
+    threads_ = detail::resolveNumberOfThreads(nr_threads);
+  }
+
+  /** \brief Number of points. */
+  std::size_t
+  size() const
+  {
+    return nr_points_;
+  }
+
+  bool
+  empty() const
+  {
+    return nr_points_ == 0;
+  }
+
+  /** \brief Number of chunks. */
+  std::size_t
+  getNumberOfChunks() const
+  {
+    return chunk_offsets_.size() - 1;
+  }
+
+  /**
+   * \brief Number of points of a chunk
+   * \param chunk chunk number
+   */
+  std::size_t
+  getChunkSize(std::size_t chunk) const
+  {
+    return std::min<std::size_t>(stored_chunk_size_,
+                                 nr_points_ - chunk * stored_chunk_size_);
+  }
+
+  /** \brief Size of the compressed data in bytes. */
+  std::size_t
+  getCompressedSize() const
+  {
+    return data_.size();
+  }
+
+  /**
+   * \brief Compress a point cloud replacing the current content
+   * \param cloud pcl::PointCloud or point cloud span
+   */
+  template <typename CloudT>
+  void
+  compress(const CloudT& cloud)
+  {
+    initLayout();
+    nr_points_ = cloud.size();
+    width_ = cloud.width;
+    height_ = cloud.height;
+    is_dense_ = cloud.is_dense;
+    header = cloud.header;
+    stored_chunk_size_ = chunk_size_;
+    stored_resolution_ = resolution_;
+    stored_codec_ = codec_;
+
+    const std::size_t nr_chunks = (nr_points_ + chunk_size_ - 1) / chunk_size_;
+    std::vector<std::vector<std::uint8_t>> chunks(nr_chunks);
+    const auto* points = reinterpret_cast<const std::uint8_t*>(cloud.data());
+    const auto chunks_count = static_cast<std::ptrdiff_t>(nr_chunks);
+#pragma omp parallel for num_threads(threads_) schedule(dynamic, 1)
+    for (std::ptrdiff_t i_chunk = 0; i_chunk < chunks_count; ++i_chunk) {
+      const auto chunk = static_cast<std::size_t>(i_chunk);
+      compressChunk(points + chunk * chunk_size_ * sizeof(PointT),
+                    getChunkSize(chunk),
+                    chunks[chunk]);
+    }
+
+    chunk_offsets_.assign(nr_chunks + 1, 0);
+    for (std::size_t chunk = 0; chunk < nr_chunks; ++chunk)
+      chunk_offsets_[chunk + 1] = chunk_offsets_[chunk] + chunks[chunk].size();
+    data_.resize(chunk_offsets_.back());
+#pragma omp parallel for num_threads(threads_) schedule(static)
+    for (std::ptrdiff_t i_chunk = 0; i_chunk < chunks_count; ++i_chunk) {
+      const auto chunk = static_cast<std::size_t>(i_chunk);
+      std::copy(chunks[chunk].begin(),
+                chunks[chunk].end(),
+                data_.begin() + static_cast<std::ptrdiff_t>(chunk_offsets_[chunk]));
+    }
+  }
+
+  /**
+   * \brief Decompress all chunks in parallel
+   * \param arena storage for points, resized to the number of points
+   * \return point cloud span over the arena with the original dimensions and header
+   * \throws pcl::BadArgumentException if the cloud is unorganized and exceeds the
+   * 32-bit width, decompress it chunk by chunk instead
+   * \throws pcl::IOException if the compressed data is corrupted
+   */
+  PointCloud
+  decompress(VectorType& arena) const
+  {
+    const bool organized = static_cast<std::size_t>(width_) * height_ == nr_points_;
+    if (!organized)
+      detail::checkChunkSize(nr_points_);
+    arena.resize(nr_points_);
+    auto* points = reinterpret_cast<std::uint8_t*>(arena.data());
+    const auto nr_chunks = static_cast<std::ptrdiff_t>(getNumberOfChunks());
+    const std::size_t chunk_bytes = stored_chunk_size_ * sizeof(PointT);
+    bool valid = true;
+#pragma omp parallel num_threads(threads_) reduction(&& : valid)
+    {
+      std::vector<std::uint8_t> planes;
+#pragma omp for schedule(dynamic)
+      for (std::ptrdiff_t i_chunk = 0; i_chunk < nr_chunks; ++i_chunk) {
+        const auto chunk = static_cast<std::size_t>(i_chunk);
+        valid = decompressChunk(chunk, points + chunk * chunk_bytes, planes) && valid;
+      }
+    }
+    if (!valid)
+      PCL_THROW_EXCEPTION(pcl::IOException, "Compressed point data is corrupted");
+
+    const auto width = organized ? width_ : static_cast<std::uint32_t>(nr_points_);
+    auto cloud = makeCloudSpan(
+        reinterpret_cast<PointT*>(arena.data()), width, organized ? height_ : 1);
+    cloud.header = header;
+    cloud.is_dense = is_dense_;
+    return cloud;
+  }
+
+  /**
+   * \brief Decompress one chunk
+   * \param chunk chunk number
+   * \param arena storage for points, resized to the number of points of the chunk
+   * \return unorganized point cloud span over the arena
+   * \throws pcl::BadArgumentException if the chunk does not exist
+   * \throws pcl::IOException if the compressed data is corrupted
+   */
+  PointCloud
+  decompressChunk(std::size_t chunk, VectorType& arena) const
+  {
+    if (chunk >= getNumberOfChunks())
+      PCL_THROW_EXCEPTION(pcl::BadArgumentException, "No chunk " << chunk);
+    arena.resize(getChunkSize(chunk));
+    detail::checkChunkSize(arena.size());
+    std::vector<std::uint8_t> planes;
+    if (!decompressChunk(chunk, reinterpret_cast<std::uint8_t*>(arena.data()), planes))
+      PCL_THROW_EXCEPTION(pcl::IOException, "Compressed point data is corrupted");
+
+    auto cloud = makeCloudSpan(reinterpret_cast<PointT*>(arena.data()),
+                               static_cast<std::uint32_t>(arena.size()));
+    cloud.header = header;
+    cloud.is_dense = is_dense_;
+    return cloud;
+  }
+
+  /**
+   * \brief Write the compressed cloud to a stream
+   * \param stream binary output stream
+   */
+  void
+  save(std::ostream& stream) const
+  {
+    stream.write(magic_, sizeof(magic_));
+    write(stream, version_);
+    write(stream, static_cast<std::uint32_t>(sizeof(PointT)));
+    write(stream, static_cast<std::uint32_t>(fields_.size()));
+    for (const auto& field : fields_) {
+      writeString(stream, field.name);
+      write(stream, field.offset);
+      write(stream, field.datatype);
+      write(stream, field.count);
+    }
+    write(stream, header.seq);
+    write(stream, header.stamp);
+    writeString(stream, header.frame_id);
+    write(stream, width_);
+    write(stream, height_);
+    write(stream, static_cast<std::uint8_t>(is_dense_));
+    write(stream, static_cast<std::uint64_t>(nr_points_));
+    write(stream, stored_chunk_size_);
+    write(stream, stored_resolution_);
+    write(stream, static_cast<std::uint64_t>(getNumberOfChunks()));
+    for (const auto offset : chunk_offsets_)
+      write(stream, static_cast<std::uint64_t>(offset));
+    stream.write(reinterpret_cast<const char*>(data_.data()),
+                 static_cast<std::streamsize>(data_.size()));
+  }
+
+  /**
+   * \brief Read a compressed cloud written by save
+   * \param stream binary input stream
+   * \throws pcl::IOException if the stream is not a compressed cloud of PointT or
+   * holds Zstandard chunks and zstd is not built in
+   */
+  void
+  load(std::istream& stream)
+  {
+    initLayout();
+    char magic[sizeof(magic_)];
+    stream.read(magic, sizeof(magic));
+    const auto version = read<std::uint32_t>(stream);
+    if (!stream || std::memcmp(magic, magic_, sizeof(magic)) != 0 || version < 1 ||
+        version > version_)
+      PCL_THROW_EXCEPTION(pcl::IOException, "Not a compressed point cloud");
+    if (read<std::uint32_t>(stream) != sizeof(PointT) ||
+        read<std::uint32_t>(stream) != fields_.size())
+      PCL_THROW_EXCEPTION(pcl::IOException, "Point type does not match");
+    for (const auto& field : fields_)
+      if (readString(stream) != field.name ||
+          read<std::uint32_t>(stream) != field.offset ||
+          read<std::uint8_t>(stream) != field.datatype ||
+          read<std::uint32_t>(stream) != field.count)
+        PCL_THROW_EXCEPTION(pcl::IOException, "Point type does not match");
+
+    header.seq = read<decltype(header.seq)>(stream);
+    header.stamp = read<decltype(header.stamp)>(stream);
+    header.frame_id = readString(stream);
+    width_ = read<std::uint32_t>(stream);
+    height_ = read<std::uint32_t>(stream);
+    is_dense_ = read<std::uint8_t>(stream) != 0;
+    nr_points_ = static_cast<std::size_t>(read<std::uint64_t>(stream));
+    stored_chunk_size_ = read<std::uint32_t>(stream);
+    stored_resolution_ = read<double>(stream);
+    const auto nr_chunks = read<std::uint64_t>(stream);
+    if (!stream || stored_chunk_size_ == 0 ||
+        nr_chunks != (nr_points_ + stored_chunk_size_ - 1) / stored_chunk_size_)
+      PCL_THROW_EXCEPTION(pcl::IOException, "Corrupted compressed point cloud");
+
+    chunk_offsets_.resize(static_cast<std::size_t>(nr_chunks) + 1);
+    for (auto& offset : chunk_offsets_)
+      offset = static_cast<std::size_t>(read<std::uint64_t>(stream));
+    if (!stream || chunk_offsets_.front() != 0 ||
+        !std::is_sorted(chunk_offsets_.begin(), chunk_offsets_.end()))
+      PCL_THROW_EXCEPTION(pcl::IOException, "Corrupted compressed point cloud");
+    data_.resize(chunk_offsets_.back());
+    stream.read(reinterpret_cast<char*>(data_.data()),
+                static_cast<std::streamsize>(data_.size()));
+    if (!stream)
+      PCL_THROW_EXCEPTION(pcl::IOException, "Truncated compressed point cloud");
+#ifndef PCL_CLOUD_SPAN_WITH_ZSTD
+    for (std::size_t chunk = 0; chunk < nr_chunks; ++chunk)
+      if (chunk_offsets_[chunk] < chunk_offsets_[chunk + 1] &&
+          (data_[chunk_offsets_[chunk]] & zstd_))
+        PCL_THROW_EXCEPTION(pcl::IOException,
+                            "Chunks use zstd, enable PCL_CLOUD_SPAN_WITH_ZSTD");
+#endif
+  }
+
+private:
+  /** \brief Chunk flag: x, y and z are quantized and delta-coded. */
+  static constexpr std::uint8_t quantized_ = 1;
+  /** \brief Chunk flag: shuffled bytes are Zstandard frames, not run-length encoded. */
+  static constexpr std::uint8_t zstd_ = 2;
+
+  static constexpr char magic_[8] = {'P', 'C', 'S', 'C', 'H', 'U', 'N', 'K'};
+  /** \brief Format version, 2 added zstd chunks and reads version 1 as well. */
+  static constexpr std::uint32_t version_ = 2;
+
+  /** \brief Read the registered layout of the point type. */
+  void
+  initLayout()
+  {
+    if (!fields_.empty())
+      return;
+    fields_ = pcl::getFields<Spannable<PointT>>();
+    for (std::size_t axis = 0; axis < 3; ++axis) {
+      const auto field =
+          detail::findField<Spannable<PointT>>(std::string(1, "xyz"[axis]));
+      if (field.datatype != pcl::PCLPointField::FLOAT32)
+        PCL_THROW_EXCEPTION(pcl::BadArgumentException,
+                            "Coordinates of the point type are not float");
+      xyz_offsets_[axis] = field.offset;
+    }
+  }
+
+  void
+  compressChunk(const std::uint8_t* points,
+                std::size_t size,
+                std::vector<std::uint8_t>& out) const
+  {
+    constexpr std::size_t step = sizeof(PointT);
+    std::vector<std::uint8_t> planes(size * step);
+    std::vector<std::uint8_t> values(points, points + size * step);
+
+    std::array<double, 3> origin{};
+    std::uint8_t flags = quantize(values.data(), size, origin) ? quantized_ : 0;
+    if (stored_codec_ == CompressionCodec::zstd)
+      flags |= zstd_;
+    out.push_back(flags);
+    if (flags & quantized_) {
+      const auto* bytes = reinterpret_cast<const std::uint8_t*>(origin.data());
+      out.insert(out.end(), bytes, bytes + sizeof(origin));
+    }
+
+    detail::shuffleBytes<step>(values.data(), size, planes.data());
+#ifdef PCL_CLOUD_SPAN_WITH_ZSTD
+    if (flags & zstd_) {
+      const std::size_t header = out.size();
+      out.resize(header + ZSTD_compressBound(planes.size()));
+      const std::size_t written = ZSTD_compress(out.data() + header,
+                                                out.size() - header,
+                                                planes.data(),
+                                                planes.size(),
+                                                ZSTD_CLEVEL_DEFAULT);
+      if (!ZSTD_isError(written)) {
+        out.resize(header + written);
+        return;
+      }
+      // out of memory in zstd, fall back to run-length encoding
+      out.resize(header);
+      out.front() &= static_cast<std::uint8_t>(~zstd_);
+    }
+#endif
+    detail::packBits(planes.data(), planes.size(), out);
+  }
+
+  /**
+   * \brief Replace coordinates by deltas of quantized values
+   * \return false if the chunk has to be stored losslessly
+   */
+  bool
+  quantize(std::uint8_t* points, std::size_t size, std::array<double, 3>& origin) const
+  {
+    if (!(stored_resolution_ > 0) || size == 0)
+      return false;
+    constexpr double max_range = std::numeric_limits<std::uint32_t>::max();
+    for (std::size_t axis = 0; axis < 3; ++axis) {
+      double min = std::numeric_limits<double>::infinity();
+      double max = -std::numeric_limits<double>::infinity();
+      for (std::size_t i = 0; i < size; ++i) {
+        const auto* data = points + i * sizeof(PointT) + xyz_offsets_[axis];
+        const double value = readFloat(data);
+        if (!std::isfinite(value))
+          return false;
+        min = std::min(min, value);
+        max = std::max(max, value);
+      }
+      if (!((max - min) / stored_resolution_ < max_range))
+        return false;
+      origin[axis] = min;
+    }
+
+    for (std::size_t axis = 0; axis < 3; ++axis) {
+      std::uint32_t previous = 0;
+      for (std::size_t i = 0; i < size; ++i) {
+        auto* value = points + i * sizeof(PointT) + xyz_offsets_[axis];
+        const auto quantized = static_cast<std::uint32_t>(
+            std::llround((readFloat(value) - origin[axis]) / stored_resolution_));
+        const std::uint32_t delta = quantized - previous;
+        std::memcpy(value, &delta, sizeof(delta));
+        previous = quantized;
+      }
+    }
+    return true;
+  }
+
+  /**
+   * \brief Decompress a chunk into the memory of its points
+   * \param planes scratch buffer for the shuffled bytes, reused between chunks
+   */
+  bool
+  decompressChunk(std::size_t chunk,
+                  std::uint8_t* points,
+                  std::vector<std::uint8_t>& planes) const
+  {
+    constexpr std::size_t step = sizeof(PointT);
+    const std::size_t size = getChunkSize(chunk);
+    const std::uint8_t* data = data_.data() + chunk_offsets_[chunk];
+    const std::uint8_t* end = data_.data() + chunk_offsets_[chunk + 1];
+    if (data == end)
+      return false;
+    const std::uint8_t flags = *data++;
+    std::array<double, 3> origin{};
+    if (flags & quantized_) {
+      if (end - data < static_cast<std::ptrdiff_t>(sizeof(origin)))
+        return false;
+      std::memcpy(origin.data(), data, sizeof(origin));
+      data += sizeof(origin);
+    }
+
+    planes.resize(size * step);
+    const auto encoded = static_cast<std::size_t>(end - data);
+    if (flags & zstd_) {
+#ifdef PCL_CLOUD_SPAN_WITH_ZSTD
+      const std::size_t decoded =
+          ZSTD_decompress(planes.data(), planes.size(), data, encoded);
+      if (ZSTD_isError(decoded) || decoded != planes.size())
+        return false;
+#else
+      return false;
+#endif
+    }
+    else if (!detail::unpackBits(data, encoded, planes.data(), planes.size()))
+      return false;
+    detail::unshuffleBytes<step>(planes.data(), size, points);
+    if (!(flags & quantized_))
+      return true;
+
+    for (std::size_t axis = 0; axis < 3; ++axis) {
+      std::uint32_t quantized = 0;
+      for (std::size_t k = 0; k < size; ++k) {
+        auto* value = points + k * step + xyz_offsets_[axis];
+        std::uint32_t delta;
+        std::memcpy(&delta, value, sizeof(delta));
+        quantized += delta;
+        const auto coordinate =
+            static_cast<float>(origin[axis] + quantized * stored_resolution_);
+        std::memcpy(value, &coordinate, sizeof(coordinate));
+      }
+    }
+    return true;
+  }
+
+  static double
+  readFloat(const std::uint8_t* data)
+  {
+    float value;
+    std::memcpy(&value, data, sizeof(value));
+    return value;
+  }
+
+  template <typename T>
+  static void
+  write(std::ostream& stream, const T& value)
+  {
+    stream.write(reinterpret_cast<const char*>(&value), sizeof(T));
+  }
+
+  static void
+  writeString(std::ostream& stream, const std::string& value)
+  {
+    write(stream, static_cast<std::uint32_t>(value.size()));
+    stream.write(value.data(), static_cast<std::streamsize>(value.size()));
+  }
+
+  template <typename T>
+  static T
+  read(std::istream& stream)
+  {
+    T value{};
+    stream.read(reinterpret_cast<char*>(&value), sizeof(T));
+    return value;
+  }
+
+  static std::string
+  readString(std::istream& stream)
+  {
+    const auto size = read<std::uint32_t>(stream);
+    if (!stream || size > (1u << 16))
+      PCL_THROW_EXCEPTION(pcl::IOException, "Corrupted compressed point cloud");
+    std::string value(size, '\0');
+    stream.read(&value[0], size);
+    return value;
+  }
+
+  std::uint32_t chunk_size_ = 65536;
+  double resolution_ = 0;
+  CompressionCodec codec_ = CompressionCodec::run_length;
+  unsigned int threads_ = 1;
+
+  std::vector<pcl::PCLPointField> fields_;
+  std::array<std::uint32_t, 3> xyz_offsets_{};
+
+  std::size_t nr_points_ = 0;
+  std::uint32_t width_ = 0;
+  std::uint32_t height_ = 0;
+  bool is_dense_ = true;
+  std::uint32_t stored_chunk_size_ = 65536;
+  double stored_resolution_ = 0;
+  CompressionCodec stored_codec_ = CompressionCodec::run_length;
+  std::vector<std::size_t> chunk_offsets_ = {0};
+  std::vector<std::uint8_t> data_;
+};
+
+template <typename PointT>
+constexpr std::uint8_t CompressedPointCloud<PointT>::quantized_;
+
+template <typename PointT>
+constexpr std::uint8_t CompressedPointCloud<PointT>::zstd_;
+
+template <typename PointT>
+constexpr char CompressedPointCloud<PointT>::magic_[8];
+
+template <typename PointT>
+constexpr std::uint32_t CompressedPointCloud<PointT>::version_;
+
+} // namespace pcl_cloud_span
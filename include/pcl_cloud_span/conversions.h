@@ -0,0 +1,192 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2023 Ilia Kovalev
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include <pcl_cloud_span/pcl_cloud_span.h>
+
+#include <pcl/PCLPointCloud2.h>
+#include <pcl/common/io.h>
+#include <pcl/exceptions.h>
+#include <pcl/types.h>
+
+#include "impl/parallel.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+namespace pcl_cloud_span {
+namespace detail {
+
+/**
+ * \brief Set fields and dimensions of a PCLPointCloud2 for points of a spannable type
+ * and resize its data
+ */
+template <typename PointT>
+void
+setPCLPointCloud2Layout(pcl::PCLPointCloud2& msg,
+                        std::uint32_t width,
+                        std::uint32_t height)
+{
+  msg.fields = pcl::getFields<Spannable<PointT>>();
+  msg.width = width;
+  msg.height = height;
+  msg.point_step = sizeof(PointT);
+  msg.row_step = static_cast<std::uint32_t>(sizeof(PointT) * width);
+  msg.data.resize(sizeof(PointT) * width * static_cast<std::size_t>(height));
+}
+
+} // namespace detail
+
+/**
+ * \brief Lay out a PCLPointCloud2 for points of a spannable type and create a span
+ * over its data
+ * \details Fields are built from the registration of Spannable<PointT>, the data is
+ * resized (reusing its capacity) and left uninitialized. Algorithms writing into a
+ * span (e.g. pcl_cloud_span::transformPointCloud, InPlaceFeature::computeInPlace)
+ * fill the message directly, and convertToPCLPointCloud2 of the span into the same
+ * message does not copy anything.
+ * \tparam PointT point type
+ * \param msg message to lay out
+ * \param width point cloud width
+ * \param height point cloud height
+ * \return point cloud span over the data of `msg`
+ * \throws pcl::BadArgumentException if the data is not aligned for PointT
+ */
+template <typename PointT>
+pcl::PointCloud<Spannable<PointT>>
+makePCLPointCloud2Span(pcl::PCLPointCloud2& msg,
+                       std::uint32_t width,
+                       std::uint32_t height = 1)
+{
+  detail::setPCLPointCloud2Layout<PointT>(msg, width, height);
+  if (reinterpret_cast<std::uintptr_t>(msg.data.data()) % alignof(PointT) != 0)
+    PCL_THROW_EXCEPTION(pcl::BadArgumentException,
+                        "Data of the message is not aligned for the point type");
+  return makeCloudSpan(reinterpret_cast<PointT*>(msg.data.data()), width, height);
+}
+
+/**
+ * \brief Convert point cloud span to PCLPointCloud2 copying point bytes once
+ * \details Unlike converting to pcl::PointCloud and then serializing, point bytes are
+ * copied straight into the data of `out`, reusing its capacity. If `in` is a span over
+ * the data of `out` created by makePCLPointCloud2Span, nothing is copied.
+ * \tparam PointT point type
+ * \param in point cloud span
+ * \param out resulting message
+ * \throws pcl::BadArgumentException if an unorganized cloud exceeds the 32-bit width
+ */
+template <typename PointT>
+void
+convertToPCLPointCloud2(const pcl::PointCloud<Spannable<PointT>>& in,
+                        pcl::PCLPointCloud2& out)
+{
+  // an unorganized cloud is stored as a single row, as in pcl::toPCLPointCloud2
+  std::uint32_t width = in.width;
+  std::uint32_t height = in.height;
+  if (static_cast<std::size_t>(width) * height != in.size()) {
+    detail::checkChunkSize(in.size());
+    width = static_cast<std::uint32_t>(in.size());
+    height = 1;
+  }
+
+  const auto* in_data = reinterpret_cast<const std::uint8_t*>(in.data());
+  const bool in_place = in_data == out.data.data() && !in.empty();
+  detail::setPCLPointCloud2Layout<PointT>(out, width, height);
+  if (!in_place && !in.empty())
+    std::memcpy(out.data.data(), in_data, out.data.size());
+
+  out.header = in.header;
+  out.is_dense = in.is_dense;
+}
+
+/**
+ * \brief Convert point cloud span to a new PCLPointCloud2
+ * \tparam PointT point type
+ * \param in point cloud span
+ * \return new message with point bytes copied from `in`
+ */
+template <typename PointT>
+pcl::PCLPointCloud2
+convertToPCLPointCloud2(const pcl::PointCloud<Spannable<PointT>>& in)
+{
+  pcl::PCLPointCloud2 out;
+  convertToPCLPointCloud2(in, out);
+  return out;
+}
+
+/**
+ * \brief Convert point cloud span to a new PCLPointCloud2 consuming the input
+ * \details PCLPointCloud2 stores its data as a byte vector that can not adopt a buffer
+ * of points, so point bytes are copied once. Storage owned by `in` is released right
+ * after the copy, so the points are not held twice longer than needed.
+ * \tparam PointT point type
+ * \param in point cloud span
+ * \return new message with point bytes copied from `in`
+ */
+template <typename PointT>
+pcl::PCLPointCloud2
+convertToPCLPointCloud2(pcl::PointCloud<Spannable<PointT>>&& in)
+{
+  pcl::PCLPointCloud2 out;
+  convertToPCLPointCloud2(in, out);
+  pcl::PointCloud<Spannable<PointT>>().swap(in);
+  return out;
+}
+
+/**
+ * \brief Copy selected points of a span directly into a PCLPointCloud2
+ * \details Typical use is publishing the result of an algorithm returning indices
+ * (e.g. a pcl::FilterIndices filter) with a single write of the output points.
+ * \tparam PointT point type
+ * \param in point cloud span
+ * \param indices indices of points to copy
+ * \param out resulting unorganized message
+ * \param nr_threads number of threads to use (0 means the number of cores)
+ * \throws pcl::BadArgumentException if there are more indices than fit the width
+ */
+template <typename PointT>
+void
+extractToPCLPointCloud2(const pcl::PointCloud<Spannable<PointT>>& in,
+                        const pcl::Indices& indices,
+                        pcl::PCLPointCloud2& out,
+                        unsigned int nr_threads = 0)
+{
+  detail::checkChunkSize(indices.size());
+  auto span =
+      makePCLPointCloud2Span<PointT>(out, static_cast<std::uint32_t>(indices.size()));
+  const auto size = static_cast<std::ptrdiff_t>(indices.size());
+  const unsigned int threads = detail::resolveNumberOfThreads(nr_threads);
+#pragma omp parallel for num_threads(threads) schedule(static)
+  for (std::ptrdiff_t i = 0; i < size; ++i) {
+    const auto point = static_cast<std::size_t>(i);
+    span[point] = in[static_cast<std::size_t>(indices[point])];
+  }
+
+  out.header = in.header;
+  out.is_dense = in.is_dense;
+}
+
+} // namespace pcl_cloud_span
@@ -0,0 +1,338 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2023 Ilia Kovalev
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include <pcl_cloud_span/pcl_cloud_span.h>
+
+#include <pcl/exceptions.h>
+
+#include <Eigen/Geometry>
+
+#include "impl/field_access.h"
+#include "impl/parallel.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <limits>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace pcl_cloud_span {
+
+/**
+ * \brief Timestamped sensor poses used to interpolate the sensor motion
+ */
+class Trajectory {
+public:
+  using Ptr = std::shared_ptr<Trajectory>;
+  using ConstPtr = std::shared_ptr<const Trajectory>;
+
+  /**
+   * \brief Append a pose to the trajectory
+   * \param time timestamp of the pose in seconds
+   * \param pose transform from the sensor frame to the world frame at `time`
+   * \throws pcl::BadArgumentException if `time` is not greater than the timestamp of
+   * the last pose
+   */
+  void
+  addPose(double time, const Eigen::Isometry3d& pose)
+  {
+    if (!times_.empty() && !(time > times_.back()))
+      PCL_THROW_EXCEPTION(pcl::BadArgumentException,
+                          "Poses must be added in increasing order of time");
+    times_.push_back(time);
+    rotations_.emplace_back(pose.linear());
+    translations_.push_back(pose.translation());
+  }
+
+  /** \brief Number of poses in the trajectory. */
+  std::size_t
+  size() const
+  {
+    return times_.size();
+  }
+
+  /** \brief Whether the trajectory has no poses. */
+  bool
+  empty() const
+  {
+    return times_.empty();
+  }
+
+  /** \brief Remove all poses. */
+  void
+  clear()
+  {
+    times_.clear();
+    rotations_.clear();
+    translations_.clear();
+  }
+
+  /**
+   * \brief Interpolate the pose at a given time
+   * \details Rotation is interpolated spherically and translation linearly between the
+   * two closest poses. Times outside of the trajectory are clamped to its ends.
+   * \param time timestamp in seconds
+   * \return transform from the sensor frame to the world frame at `time`
+   */
+  Eigen::Isometry3d
+  interpolate(double time) const
+  {
+    Eigen::Isometry3d pose = Eigen::Isometry3d::Identity();
+    if (times_.empty())
+      return pose;
+
+    const auto upper = std::upper_bound(times_.begin(), times_.end(), time);
+    if (upper == times_.begin() || upper == times_.end()) {
+      const auto i = upper == times_.begin() ? 0 : times_.size() - 1;
+      pose.linear() = rotations_[i].toRotationMatrix();
+      pose.translation() = translations_[i];
+      return pose;
+    }
+
+    const auto i = static_cast<std::size_t>(upper - times_.begin());
+    const double ratio = (time - times_[i - 1]) / (times_[i] - times_[i - 1]);
+    pose.linear() = rotations_[i - 1].slerp(ratio, rotations_[i]).toRotationMatrix();
+    pose.translation() =
+        (1 - ratio) * translations_[i - 1] + ratio * translations_[i];
+    return pose;
+  }
+
+private:
+  std::vector<double> times_;
+  std::vector<Eigen::Quaterniond, Eigen::aligned_allocator<Eigen::Quaterniond>>
+      rotations_;
+  std::vector<Eigen::Vector3d> translations_;
+};
+
+/**
+ * \brief Removes motion distortion of a lidar sweep in place
+ * \details Every point is moved from the sensor frame at its own timestamp to the
+ * sensor frame at the reference time using poses interpolated from a trajectory. The
+ * timestamp is read from a registered point field, so any point type with a time field
+ * is supported. Poses are interpolated once per time bin of configurable resolution,
+ * so the per-point work is one table lookup and one affine transform; points are
+ * processed in parallel. Only x, y and z are modified.
+ * \tparam PointT point type with a time field
+ */
+template <typename PointT>
+class MotionDeskew {
+public:
+  using PointCloud = pcl::PointCloud<Spannable<PointT>>;
+
+  /**
+   * \brief Set the sensor trajectory
+   * \param trajectory trajectory covering the sweep
+   */
+  void
+  setTrajectory(const Trajectory::ConstPtr& trajectory)
+  {
+    trajectory_ = trajectory;
+  }
+
+  /**
+   * \brief Set the name of the field holding point timestamps
+   * \details Timestamp of a point is `offset + scale * value`, see setTimeScale and
+   * setTimeOffset. The field may have any numeric type. Default name is "time".
+   * \param name field name
+   */
+  void
+  setTimeField(const std::string& name)
+  {
+    time_field_ = name;
+  }
+
+  /**
+   * \brief Set the factor converting field values to seconds
+   * \param scale time scale, e.g. 1e-9 for nanoseconds (1 by default)
+   */
+  void
+  setTimeScale(double scale)
+  {
+    time_scale_ = scale;
+  }
+
+  /**
+   * \brief Set the time added to scaled field values
+   * \details Useful when the field holds time relative to the sweep start.
+   * \param offset time offset in seconds (0 by default)
+   */
+  void
+  setTimeOffset(double offset)
+  {
+    time_offset_ = offset;
+  }
+
+  /**
+   * \brief Set the time of the frame points are moved to
+   * \param time reference time in seconds, NaN (default) means the time of the latest
+   * point of the sweep
+   */
+  void
+  setReferenceTime(double time)
+  {
+    reference_time_ = time;
+  }
+
+  /**
+   * \brief Set the resolution of the pose table
+   * \details Points whose timestamps fall into the same bin share the interpolated
+   * pose. The number of bins is limited, so the resolution is coarsened for very long
+   * sweeps.
+   * \param resolution bin width in seconds (1e-4 by default)
+   */
+  void
+  setTimeResolution(double resolution)
+  {
+    if (!(resolution > 0))
+      PCL_THROW_EXCEPTION(pcl::BadArgumentException,
+                          "Time resolution must be positive");
+    resolution_ = resolution;
+  }
+
+  /**
+   * \brief Set the number of threads to use
+   * \param nr_threads the number of hardware threads to use (0 sets the value back to
+   * automatic)
+   */
+  void
+  setNumberOfThreads(unsigned int nr_threads = 0)
+  {
+    threads_ = detail::resolveNumberOfThreads(nr_threads);
+  }
+
+  /**
+   * \brief Deskew a point cloud span in place
+   * \details Points with non-finite coordinates or timestamps are left unchanged.
+   * \param cloud point cloud span to deskew
+   * \throws pcl::InitFailedException if the trajectory is not set or empty
+   * \throws pcl::BadArgumentException if the point type has no time field
+   */
+  void
+  deskew(PointCloud& cloud)
+  {
+    if (!trajectory_ || trajectory_->empty())
+      PCL_THROW_EXCEPTION(pcl::InitFailedException,
+                          "[pcl_cloud_span::MotionDeskew::deskew] Trajectory is not "
+                          "set");
+    const auto field = detail::findField<Spannable<PointT>>(time_field_);
+    if (cloud.empty())
+      return;
+
+    readTimes(cloud, field);
+    if (!(max_time_ >= min_time_))
+      return;
+    buildPoseTable();
+
+    const auto size = static_cast<std::ptrdiff_t>(cloud.size());
+    const bool is_dense = cloud.is_dense;
+#pragma omp parallel for num_threads(threads_) schedule(static)
+    for (std::ptrdiff_t i = 0; i < size; ++i) {
+      auto& point = cloud[static_cast<std::size_t>(i)];
+      const double time = times_[static_cast<std::size_t>(i)];
+      if (!std::isfinite(time) ||
+          (!is_dense && !(std::isfinite(point.x) && std::isfinite(point.y) &&
+                          std::isfinite(point.z))))
+        continue;
+
+      const auto bin = static_cast<std::size_t>((time - min_time_) / bin_width_ + .5);
+      const auto& m = poses_[bin];
+      const float x = point.x, y = point.y, z = point.z;
+      point.x = m[0] * x + m[1] * y + m[2] * z + m[3];
+      point.y = m[4] * x + m[5] * y + m[6] * z + m[7];
+      point.z = m[8] * x + m[9] * y + m[10] * z + m[11];
+    }
+  }
+
+private:
+  /** \brief Upper bound of the number of interpolated poses per sweep. */
+  static constexpr std::size_t max_bins_ = 1 << 16;
+
+  void
+  readTimes(const PointCloud& cloud, const detail::FieldAccessor& field)
+  {
+    const auto size = static_cast<std::ptrdiff_t>(cloud.size());
+    times_.resize(cloud.size());
+#pragma omp parallel for num_threads(threads_) schedule(static)
+    for (std::ptrdiff_t i = 0; i < size; ++i) {
+      const auto point = static_cast<std::size_t>(i);
+      times_[point] = time_offset_ + time_scale_ * field.read(&cloud[point]);
+    }
+
+    min_time_ = std::numeric_limits<double>::max();
+    max_time_ = std::numeric_limits<double>::lowest();
+    for (const double time : times_) {
+      if (!std::isfinite(time))
+        continue;
+      min_time_ = std::min(min_time_, time);
+      max_time_ = std::max(max_time_, time);
+    }
+  }
+
+  void
+  buildPoseTable()
+  {
+    const double duration = max_time_ - min_time_;
+    bin_width_ = std::max(resolution_, duration / static_cast<double>(max_bins_ - 1));
+    const auto bins = static_cast<std::size_t>(duration / bin_width_ + .5) + 1;
+    poses_.resize(bins);
+
+    const double reference_time =
+        std::isnan(reference_time_) ? max_time_ : reference_time_;
+    const Eigen::Isometry3d to_reference =
+        trajectory_->interpolate(reference_time).inverse();
+
+    const auto nr_bins = static_cast<std::ptrdiff_t>(bins);
+#pragma omp parallel for num_threads(threads_) schedule(static)
+    for (std::ptrdiff_t bin = 0; bin < nr_bins; ++bin) {
+      const double time = min_time_ + static_cast<double>(bin) * bin_width_;
+      const Eigen::Isometry3d pose = to_reference * trajectory_->interpolate(time);
+      auto& m = poses_[static_cast<std::size_t>(bin)];
+      for (int row = 0; row < 3; ++row)
+        for (int col = 0; col < 4; ++col)
+          m[static_cast<std::size_t>(row * 4 + col)] =
+              static_cast<float>(pose(row, col));
+    }
+  }
+
+  Trajectory::ConstPtr trajectory_;
+  std::string time_field_ = "time";
+  double time_scale_ = 1;
+  double time_offset_ = 0;
+  double reference_time_ = std::numeric_limits<double>::quiet_NaN();
+  double resolution_ = 1e-4;
+  unsigned int threads_ = 1;
+
+  std::vector<double> times_;
+  std::vector<std::array<float, 12>> poses_;
+  double min_time_ = 0;
+  double max_time_ = 0;
+  double bin_width_ = 1;
+};
+
+} // namespace pcl_cloud_span
@@ -0,0 +1,241 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2023 Ilia Kovalev
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include <pcl_cloud_span/pcl_cloud_span.h>
+
+#include <pcl_cloud_span/compact.h>
+
+#include <pcl/common/io.h>
+#include <pcl/types.h>
+
+#include "impl/field_access.h"
+#include "impl/parallel.h"
+#include "impl/point_count.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace pcl_cloud_span {
+
+/**
+ * \brief Removal of exact duplicate points
+ * \details Points are compared by the bytes of their registered fields (or of selected
+ * fields), so padding is ignored and values are compared bitwise: 0 and -0 differ and
+ * NaNs with equal bits are equal. Hashes of all points are computed in parallel, sorted
+ * in parallel, and points with equal hashes are compared byte by byte, so hash
+ * collisions never merge distinct points. The first occurrence of every point is kept.
+ * \tparam PointT point type
+ */
+template <typename PointT>
+class DuplicateRemoval {
+public:
+  using PointCloud = pcl::PointCloud<Spannable<PointT>>;
+
+  /**
+   * \brief Set fields that define equality of points
+   * \param fields names of registered fields, all registered fields if empty (default)
+   * \throws pcl::BadArgumentException if the point type has no such field
+   */
+  void
+  setFields(const std::vector<std::string>& fields)
+  {
+    std::vector<detail::FieldAccessor> accessors;
+    if (fields.empty())
+      for (const auto& field : pcl::getFields<Spannable<PointT>>())
+        accessors.push_back(detail::findField<Spannable<PointT>>(field.name));
+    else
+      for (const auto& field : fields)
+        accessors.push_back(detail::findField<Spannable<PointT>>(field));
+    setRanges(accessors);
+  }
+
+  /**
+   * \brief Set the number of threads to use
+   * \param nr_threads the number of hardware threads to use (0 sets the value back to
+   * automatic)
+   */
+  void
+  setNumberOfThreads(unsigned int nr_threads = 0)
+  {
+    threads_ = detail::resolveNumberOfThreads(nr_threads);
+  }
+
+  /**
+   * \brief Find the first occurrence of every distinct point
+   * \tparam IndexT pcl::index_t or std::uint64_t for LargeIndices
+   * \param cloud pcl::PointCloud or point cloud span
+   * \param indices indices of unique points in ascending order
+   * \throws pcl::BadArgumentException if the cloud is too large for IndexT
+   */
+  template <typename CloudT, typename IndexT>
+  void
+  findUnique(const CloudT& cloud, std::vector<IndexT>& indices)
+  {
+    detail::checkIndexable<IndexT>(cloud.size());
+    if (ranges_.empty())
+      setFields({});
+
+    const auto size = static_cast<std::ptrdiff_t>(cloud.size());
+    const auto* points = reinterpret_cast<const std::uint8_t*>(cloud.data());
+    entries_.resize(cloud.size());
+#pragma omp parallel for num_threads(threads_) schedule(static)
+    for (std::ptrdiff_t i_point = 0; i_point < size; ++i_point) {
+      const auto i = static_cast<std::size_t>(i_point);
+      entries_[i] = {hash(points + i * sizeof(PointT)), static_cast<std::uint64_t>(i)};
+    }
+    detail::parallelSort(
+        entries_.begin(), entries_.end(), std::less<Entry>(), threads_);
+
+    // every group of equal hashes is resolved by the task that meets its first entry
+    unique_.assign(cloud.size(), 0);
+#pragma omp parallel num_threads(threads_)
+    {
+      std::vector<std::size_t> distinct;
+#pragma omp for schedule(dynamic, 4096)
+      for (std::ptrdiff_t i_entry = 0; i_entry < size; ++i_entry) {
+        const auto i = static_cast<std::size_t>(i_entry);
+        if (i > 0 && entries_[i].first == entries_[i - 1].first)
+          continue;
+        std::size_t end = i + 1;
+        while (end < entries_.size() && entries_[end].first == entries_[i].first)
+          ++end;
+        resolveGroup(points, i, end, distinct);
+      }
+    }
+
+    indices.clear();
+    for (std::size_t i = 0; i < unique_.size(); ++i)
+      if (unique_[i])
+        indices.push_back(static_cast<IndexT>(i));
+  }
+
+  /**
+   * \brief Remove duplicates moving unique points to the front of the span buffer
+   * \param cloud point cloud span
+   * \return unorganized point cloud span over unique points at the beginning of the
+   * buffer of `cloud`
+   */
+  PointCloud
+  removeInPlace(PointCloud& cloud)
+  {
+    findUnique(cloud, indices_);
+    return compactInPlace(cloud, indices_);
+  }
+
+private:
+  /** \brief Hash of point bytes and point index, ordered by hash then index. */
+  using Entry = std::pair<std::uint64_t, std::uint64_t>;
+
+  /** \brief Contiguous bytes of compared fields. */
+  struct ByteRange {
+    std::size_t offset;
+    std::size_t size;
+  };
+
+  void
+  setRanges(std::vector<detail::FieldAccessor> fields)
+  {
+    std::sort(fields.begin(),
+              fields.end(),
+              [](const detail::FieldAccessor& a, const detail::FieldAccessor& b) {
+                return a.offset < b.offset;
+              });
+    ranges_.clear();
+    for (const auto& field : fields) {
+      const std::size_t begin = field.offset;
+      const std::size_t end = begin + field.elementSize() * field.count;
+      if (!ranges_.empty() && ranges_.back().offset + ranges_.back().size >= begin)
+        ranges_.back().size =
+            std::max(ranges_.back().offset + ranges_.back().size, end) -
+            ranges_.back().offset;
+      else
+        ranges_.push_back({begin, end - begin});
+    }
+  }
+
+  /** \brief 64-bit hash of the compared bytes of a point, 8 bytes at a time. */
+  std::uint64_t
+  hash(const std::uint8_t* point) const
+  {
+    std::uint64_t h = 0x9e3779b97f4a7c15ull;
+    for (const auto& range : ranges_)
+      for (std::size_t i = 0; i < range.size; i += 8) {
+        std::uint64_t word = 0;
+        const std::size_t bytes = std::min<std::size_t>(8, range.size - i);
+        std::memcpy(&word, point + range.offset + i, bytes);
+        h ^= word * 0xbf58476d1ce4e5b9ull;
+        h = (h ^ (h >> 31)) * 0x94d049bb133111ebull;
+      }
+    return h ^ (h >> 29);
+  }
+
+  bool
+  equal(const std::uint8_t* a, const std::uint8_t* b) const
+  {
+    for (const auto& range : ranges_)
+      if (std::memcmp(a + range.offset, b + range.offset, range.size) != 0)
+        return false;
+    return true;
+  }
+
+  /** \brief Mark first occurrences of points in a group of entries with equal hash. */
+  void
+  resolveGroup(const std::uint8_t* points,
+               std::size_t begin,
+               std::size_t end,
+               std::vector<std::size_t>& distinct)
+  {
+    // entries are sorted by index, so the first occurrence comes first; distinct
+    // points in one group are hash collisions, so a point is compared with few others
+    distinct.clear();
+    for (std::size_t i = begin; i < end; ++i) {
+      const auto index = static_cast<std::size_t>(entries_[i].second);
+      const auto* point = points + index * sizeof(PointT);
+      bool duplicate = false;
+      for (std::size_t j = 0; j < distinct.size() && !duplicate; ++j)
+        duplicate = equal(points + distinct[j] * sizeof(PointT), point);
+      if (!duplicate) {
+        distinct.push_back(index);
+        unique_[index] = 1;
+      }
+    }
+  }
+
+  unsigned int threads_ = 1;
+  std::vector<ByteRange> ranges_;
+
+  std::vector<Entry> entries_;
+  std::vector<std::uint8_t> unique_;
+  pcl::Indices indices_;
+};
+
+} // namespace pcl_cloud_span
@@ -0,0 +1,436 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2023 Ilia Kovalev
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include <pcl_cloud_span/pcl_cloud_span.h>
+
+#include <pcl_cloud_span/ragged_point_cloud.h>
+
+#include <pcl/PointIndices.h>
+#include <pcl/exceptions.h>
+
+#include <Eigen/Core>
+
+#include "impl/parallel.h"
+#include "impl/point_count.h"
+#include "impl/voxel_key.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <numeric>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace pcl_cloud_span {
+
+/**
+ * \brief Euclidean cluster extraction over point cloud spans using a voxel grid
+ * \details Produces the same clusters as pcl::EuclideanClusterExtraction: two points
+ * are connected if their distance is less than the tolerance, clusters are connected
+ * components of points. Points are binned into a grid with cells small enough for all
+ * points of a cell to be connected, so only pairs of neighboring cells are checked
+ * for a connecting pair of points. The checks run in parallel and connected cells are
+ * merged with union-find afterwards.
+ *
+ * As in PCL, clusters with a number of points out of [min, max] are dropped, clusters
+ * are ordered by size, largest first (ties by the smallest point index), and indices
+ * in a cluster are sorted. Points with non-finite coordinates never belong to a
+ * cluster.
+ * \tparam PointT point type
+ */
+template <typename PointT>
+class EuclideanClusterExtraction {
+public:
+  using PointCloud = pcl::PointCloud<Spannable<PointT>>;
+
+  /**
+   * \brief Set the spatial cluster tolerance
+   * \param tolerance maximal distance between connected points
+   * \throws pcl::BadArgumentException if tolerance is not positive
+   */
+  void
+  setClusterTolerance(double tolerance)
+  {
+    if (!(tolerance > 0))
+      PCL_THROW_EXCEPTION(pcl::BadArgumentException,
+                          "Cluster tolerance must be positive");
+    tolerance_ = tolerance;
+  }
+
+  /**
+   * \brief Set the minimum number of points of a cluster
+   * \param min_cluster_size minimum cluster size, 1 by default
+   */
+  void
+  setMinClusterSize(std::size_t min_cluster_size)
+  {
+    min_cluster_size_ = min_cluster_size;
+  }
+
+  /**
+   * \brief Set the maximum number of points of a cluster
+   * \param max_cluster_size maximum cluster size, unlimited by default
+   */
+  void
+  setMaxClusterSize(std::size_t max_cluster_size)
+  {
+    max_cluster_size_ = max_cluster_size;
+  }
+
+  /**
+   * \brief Set the number of threads to use
+   * \param nr_threads the number of hardware threads to use (0 sets the value back to
+   * automatic)
+   */
+  void
+  setNumberOfThreads(unsigned int nr_threads = 0)
+  {
+    threads_ = detail::resolveNumberOfThreads(nr_threads);
+  }
+
+  /**
+   * \brief Extract clusters as ranges of one index array
+   * \param cloud point cloud span
+   * \param indices point indices of all clusters back to back
+   * \param offsets cluster `i` occupies `[offsets[i], offsets[i + 1])` of `indices`
+   * \throws pcl::InitFailedException if the tolerance is not set
+   * \throws pcl::BadArgumentException if the tolerance is too small for the extent of
+   * the cloud or the cloud is too large for pcl::index_t
+   */
+  void
+  extract(const PointCloud& cloud,
+          pcl::Indices& indices,
+          std::vector<std::size_t>& offsets)
+  {
+    if (!(tolerance_ > 0))
+      PCL_THROW_EXCEPTION(pcl::InitFailedException, "Cluster tolerance is not set");
+    detail::checkIndexable(cloud.size());
+
+    buildGrid(cloud);
+    connectCells(cloud);
+    labelClusters();
+
+    // visiting points in ascending order keeps indices of every cluster sorted
+    offsets.assign(cluster_sizes_.size() + 1, 0);
+    for (std::size_t i = 0; i < cluster_sizes_.size(); ++i)
+      offsets[i + 1] = offsets[i] + cluster_sizes_[i];
+    indices.resize(offsets.back());
+    positions_.assign(offsets.begin(), offsets.end() - 1);
+    for (std::size_t i = 0; i < point_cells_.size(); ++i) {
+      const auto cell = point_cells_[i];
+      if (cell < 0)
+        continue;
+      const auto cluster = cell_clusters_[static_cast<std::size_t>(cell)];
+      if (cluster < 0)
+        continue;
+      indices[positions_[static_cast<std::size_t>(cluster)]++] =
+          static_cast<pcl::index_t>(i);
+    }
+  }
+
+  /**
+   * \brief Extract clusters as pcl::EuclideanClusterExtraction does
+   * \param cloud point cloud span
+   * \param clusters indices of points of each cluster
+   */
+  void
+  extract(const PointCloud& cloud, std::vector<pcl::PointIndices>& clusters)
+  {
+    extract(cloud, indices_, offsets_);
+    clusters.resize(offsets_.size() - 1);
+    for (std::size_t i = 0; i < clusters.size(); ++i) {
+      clusters[i].header = cloud.header;
+      clusters[i].indices.assign(
+          indices_.begin() + static_cast<std::ptrdiff_t>(offsets_[i]),
+          indices_.begin() + static_cast<std::ptrdiff_t>(offsets_[i + 1]));
+    }
+  }
+
+  /**
+   * \brief Extract clusters copying their points into a ragged collection
+   * \param cloud point cloud span
+   * \param clusters collection of cluster clouds
+   */
+  void
+  extract(const PointCloud& cloud, RaggedPointCloud<PointT>& clusters)
+  {
+    extract(cloud, indices_, offsets_);
+    clusters.assign(cloud, indices_, offsets_, threads_);
+  }
+
+private:
+  using Entry = std::pair<detail::VoxelKey, pcl::index_t>;
+
+  /** \brief Cells around a cell that may contain points connected to its points. */
+  static constexpr std::int32_t reach_ = 2;
+
+  /** \brief Limit of cell coordinates keeping neighbor coordinates in range. */
+  static constexpr std::int32_t max_coordinate_ = 1 << 30;
+
+  /** \brief Bin finite points into cells of the size tolerance / sqrt(3). */
+  void
+  buildGrid(const PointCloud& cloud)
+  {
+    // slightly smaller than tolerance / sqrt(3), so rounding of distances between
+    // points of one cell can not reach the tolerance
+    const double cell_size = tolerance_ / std::sqrt(3.) * 0.999;
+    const auto grid = detail::makeCellGrid(cloud, cell_size, threads_);
+    const auto size = static_cast<std::ptrdiff_t>(cloud.size());
+
+    entries_.resize(cloud.size());
+    bool valid = true;
+#pragma omp parallel for num_threads(threads_) schedule(static) reduction(&& : valid)
+    for (std::ptrdiff_t i = 0; i < size; ++i) {
+      const auto& point = cloud[static_cast<std::size_t>(i)];
+      auto& entry = entries_[static_cast<std::size_t>(i)];
+      entry.second = static_cast<pcl::index_t>(i);
+      if (!detail::computeCellKey(point, grid, entry.first)) {
+        entry.second = -1;
+        valid = valid && !(std::isfinite(point.x) && std::isfinite(point.y) &&
+                           std::isfinite(point.z));
+      }
+      else {
+        const auto& key = entry.first;
+        valid = valid && std::abs(key.x) < max_coordinate_ &&
+                std::abs(key.y) < max_coordinate_ && std::abs(key.z) < max_coordinate_;
+      }
+    }
+    if (!valid)
+      PCL_THROW_EXCEPTION(pcl::BadArgumentException,
+                          "Cluster tolerance is too small for the extent of the cloud");
+
+    entries_.erase(std::remove_if(entries_.begin(),
+                                  entries_.end(),
+                                  [](const Entry& entry) { return entry.second < 0; }),
+                   entries_.end());
+    detail::parallelSort(
+        entries_.begin(), entries_.end(), std::less<Entry>(), threads_);
+
+    cell_begins_.clear();
+    cells_.clear();
+    point_cells_.assign(cloud.size(), -1);
+    for (std::size_t i = 0; i < entries_.size(); ++i) {
+      if (i == 0 || entries_[i].first != entries_[i - 1].first) {
+        cells_.emplace(entries_[i].first, cell_begins_.size());
+        cell_begins_.push_back(i);
+      }
+      point_cells_[static_cast<std::size_t>(entries_[i].second)] =
+          static_cast<pcl::index_t>(cell_begins_.size() - 1);
+    }
+    cell_begins_.push_back(entries_.size());
+  }
+
+  /**
+   * \brief Find pairs of neighboring cells with connected points
+   * \details Each cell checks the half of its neighborhood with greater keys, results
+   * are stored as a bit per neighbor offset.
+   */
+  void
+  connectCells(const PointCloud& cloud)
+  {
+    const auto nr_cells = static_cast<std::ptrdiff_t>(cell_begins_.size() - 1);
+    bounds_.resize(cell_begins_.size() - 1);
+#pragma omp parallel for num_threads(threads_) schedule(dynamic, 64)
+    for (std::ptrdiff_t i_cell = 0; i_cell < nr_cells; ++i_cell) {
+      const auto cell = static_cast<std::size_t>(i_cell);
+      auto& bounds = bounds_[cell];
+      bounds.min = bounds.max = pointAt(cloud, cell_begins_[cell]).getArray3fMap();
+      for (std::size_t i = cell_begins_[cell] + 1; i < cell_begins_[cell + 1]; ++i) {
+        const auto point = pointAt(cloud, i).getArray3fMap();
+        bounds.min = bounds.min.min(point);
+        bounds.max = bounds.max.max(point);
+      }
+    }
+
+    // PCL searches neighbors with a float squared radius (exclusive)
+    const auto sqr_tolerance = static_cast<float>(tolerance_ * tolerance_);
+    links_.resize(cell_begins_.size() - 1);
+#pragma omp parallel for num_threads(threads_) schedule(dynamic, 64)
+    for (std::ptrdiff_t i_cell = 0; i_cell < nr_cells; ++i_cell) {
+      const auto cell = static_cast<std::size_t>(i_cell);
+      std::uint64_t links = 0;
+      const auto& key = entries_[cell_begins_[cell]].first;
+      forEachFollowingCell(key, [&](int bit, std::size_t neighbor) {
+        if (boundsDistance(bounds_[cell], bounds_[neighbor]) >= sqr_tolerance)
+          return;
+        for (std::size_t i = cell_begins_[cell]; i < cell_begins_[cell + 1]; ++i) {
+          const auto& point = pointAt(cloud, i);
+          const std::size_t end = cell_begins_[neighbor + 1];
+          for (std::size_t j = cell_begins_[neighbor]; j < end; ++j) {
+            const auto& other = pointAt(cloud, j);
+            const float dx = point.x - other.x;
+            const float dy = point.y - other.y;
+            const float dz = point.z - other.z;
+            if (dx * dx + dy * dy + dz * dz < sqr_tolerance) {
+              links |= std::uint64_t{1} << bit;
+              return;
+            }
+          }
+        }
+      });
+      links_[cell] = links;
+    }
+  }
+
+  /** \brief Point of the entry at a position of the sorted entries. */
+  const Spannable<PointT>&
+  pointAt(const PointCloud& cloud, std::size_t entry) const
+  {
+    return cloud[static_cast<std::size_t>(entries_[entry].second)];
+  }
+
+  /** \brief Merge linked cells and assign cluster numbers to cells. */
+  void
+  labelClusters()
+  {
+    const std::size_t nr_cells = cell_begins_.size() - 1;
+    parents_.resize(nr_cells);
+    std::iota(parents_.begin(), parents_.end(), 0);
+    for (std::size_t cell = 0; cell < nr_cells; ++cell) {
+      if (links_[cell] == 0)
+        continue;
+      forEachFollowingCell(entries_[cell_begins_[cell]].first,
+                           [&](int bit, std::size_t neighbor) {
+                             if (links_[cell] & (std::uint64_t{1} << bit))
+                               unite(cell, neighbor);
+                           });
+    }
+
+    // sizes and smallest point indices of components, stored at their roots
+    component_sizes_.assign(nr_cells, 0);
+    component_firsts_.assign(nr_cells, std::numeric_limits<pcl::index_t>::max());
+    for (std::size_t cell = 0; cell < nr_cells; ++cell) {
+      const std::size_t root = find(cell);
+      component_sizes_[root] += cell_begins_[cell + 1] - cell_begins_[cell];
+      // entries of a cell are sorted by index
+      component_firsts_[root] =
+          std::min(component_firsts_[root], entries_[cell_begins_[cell]].second);
+    }
+
+    roots_.clear();
+    for (std::size_t cell = 0; cell < nr_cells; ++cell)
+      if (parents_[cell] == cell && component_sizes_[cell] >= min_cluster_size_ &&
+          component_sizes_[cell] <= max_cluster_size_)
+        roots_.push_back(cell);
+    std::sort(roots_.begin(), roots_.end(), [this](std::size_t a, std::size_t b) {
+      if (component_sizes_[a] != component_sizes_[b])
+        return component_sizes_[a] > component_sizes_[b];
+      return component_firsts_[a] < component_firsts_[b];
+    });
+
+    // component_firsts_ is reused for cluster numbers of roots
+    std::fill(component_firsts_.begin(), component_firsts_.end(), -1);
+    cluster_sizes_.resize(roots_.size());
+    for (std::size_t i = 0; i < roots_.size(); ++i) {
+      component_firsts_[roots_[i]] = static_cast<pcl::index_t>(i);
+      cluster_sizes_[i] = component_sizes_[roots_[i]];
+    }
+    cell_clusters_.resize(nr_cells);
+    for (std::size_t cell = 0; cell < nr_cells; ++cell)
+      cell_clusters_[cell] = component_firsts_[parents_[cell]];
+  }
+
+  /** \brief Root of a union-find tree, with path halving. */
+  std::size_t
+  find(std::size_t cell)
+  {
+    while (parents_[cell] != cell) {
+      parents_[cell] = parents_[parents_[cell]];
+      cell = parents_[cell];
+    }
+    return cell;
+  }
+
+  void
+  unite(std::size_t a, std::size_t b)
+  {
+    a = find(a);
+    b = find(b);
+    if (a < b)
+      parents_[b] = a;
+    else if (b < a)
+      parents_[a] = b;
+  }
+
+  /**
+   * \brief Call a function for each existing cell of the half of the neighborhood with
+   * greater keys, passing the number of the neighbor offset (less than 64) and the cell
+   */
+  template <typename Function>
+  void
+  forEachFollowingCell(const detail::VoxelKey& key, Function function) const
+  {
+    int bit = 0;
+    for (std::int32_t dx = 0; dx <= reach_; ++dx)
+      for (std::int32_t dy = dx == 0 ? 0 : -reach_; dy <= reach_; ++dy)
+        for (std::int32_t dz = dx == 0 && dy == 0 ? 1 : -reach_; dz <= reach_; ++dz) {
+          const auto it = cells_.find({key.x + dx, key.y + dy, key.z + dz});
+          if (it != cells_.end())
+            function(bit, it->second);
+          ++bit;
+        }
+  }
+
+  struct Bounds {
+    Eigen::Array3f min;
+    Eigen::Array3f max;
+  };
+
+  /** \brief Squared distance between bounding boxes of two cells. */
+  static float
+  boundsDistance(const Bounds& a, const Bounds& b)
+  {
+    const Eigen::Array3f gap = (a.min - b.max).max(b.min - a.max).max(0.f);
+    return gap.square().sum();
+  }
+
+  double tolerance_ = 0;
+  std::size_t min_cluster_size_ = 1;
+  std::size_t max_cluster_size_ = std::numeric_limits<std::size_t>::max();
+  unsigned int threads_ = 1;
+
+  std::vector<Entry> entries_;
+  std::vector<std::size_t> cell_begins_;
+  std::unordered_map<detail::VoxelKey, std::size_t, detail::VoxelKeyHash> cells_;
+  std::vector<pcl::index_t> point_cells_;
+  std::vector<Bounds> bounds_;
+  std::vector<std::uint64_t> links_;
+  std::vector<std::size_t> parents_;
+  std::vector<std::size_t> component_sizes_;
+  std::vector<pcl::index_t> component_firsts_;
+  std::vector<std::size_t> roots_;
+  std::vector<pcl::index_t> cell_clusters_;
+  std::vector<std::size_t> cluster_sizes_;
+  std::vector<std::size_t> positions_;
+  pcl::Indices indices_;
+  std::vector<std::size_t> offsets_;
+};
+
+} // namespace pcl_cloud_span
@@ -0,0 +1,191 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2023 Ilia Kovalev
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include <pcl_cloud_span/pcl_cloud_span.h>
+
+#include <pcl_cloud_span/kdtree.h>
+
+#include <pcl/exceptions.h>
+#include <pcl/features/fpfh_omp.h>
+#include <pcl/features/normal_3d_omp.h>
+#include <pcl/features/shot_lrf_omp.h>
+#include <pcl/features/shot_omp.h>
+
+#include <memory>
+#include <utility>
+
+namespace pcl_cloud_span {
+
+/**
+ * \brief Feature estimator that writes results into existing storage of a point
+ * cloud span
+ * \details pcl::Feature::compute resizes the output cloud if its size differs from the
+ * number of processed points. For a span over a caller-provided buffer this silently
+ * moves results into newly allocated memory. computeInPlace checks the size before
+ * the computation, so results are always written into the caller's buffer.
+ * The non-copying search::KdTree is used as a default search method.
+ * \tparam FeatureT PCL feature estimator with point cloud span input and output types,
+ * e.g. pcl::NormalEstimationOMP<Spannable<PointT>, Spannable<pcl::Normal>>
+ */
+template <typename FeatureT>
+class InPlaceFeature : public FeatureT {
+public:
+  using PointCloudIn = typename FeatureT::PointCloudIn;
+  using PointCloudOut = typename FeatureT::PointCloudOut;
+  using PointInT = typename PointCloudIn::PointType;
+
+  /**
+   * \brief Constructor
+   * \param args arguments forwarded to the constructor of FeatureT
+   */
+  template <typename... Args>
+  explicit InPlaceFeature(Args&&... args) : FeatureT(std::forward<Args>(args)...)
+  {
+    this->setSearchMethod(std::make_shared<search::KdTree<PointInT>>(false));
+  }
+
+  /**
+   * \brief Compute features writing them into the existing storage of `output`
+   * \param output point cloud span over a buffer that has exactly one point for each
+   * processed input point (for each index if indices are set)
+   * \throws pcl::BadArgumentException if size of `output` does not match number of
+   * processed points
+   */
+  void
+  computeInPlace(PointCloudOut& output)
+  {
+    if (this->input_) {
+      const auto expected = (this->indices_ && !this->fake_indices_)
+                                ? this->indices_->size()
+                                : this->input_->size();
+      if (output.size() != expected)
+        PCL_THROW_EXCEPTION(pcl::BadArgumentException,
+                            "Output span has " << output.size()
+                                               << " points, but " << expected
+                                               << " points are expected");
+    }
+    this->compute(output);
+  }
+};
+
+/**
+ * \brief Parallel normal estimation of a point cloud span into a normals span
+ * \details Spannable<PointOutT> has to be registered with
+ * POINT_CLOUD_REGISTER_POINT_STRUCT as any other spannable point type.
+ * \tparam PointInT input point type
+ * \tparam PointOutT output normal type
+ */
+template <typename PointInT, typename PointOutT = pcl::Normal>
+using NormalEstimationOMP = InPlaceFeature<
+    pcl::NormalEstimationOMP<Spannable<PointInT>, Spannable<PointOutT>>>;
+
+/**
+ * \brief Parallel FPFH estimation of point cloud and normals spans into a descriptors
+ * span
+ * \details Spannable<PointNT> and Spannable<PointOutT> have to be registered with
+ * POINT_CLOUD_REGISTER_POINT_STRUCT as any other spannable point type.
+ * \tparam PointInT input point type
+ * \tparam PointNT input normal type
+ * \tparam PointOutT output descriptor type
+ */
+template <typename PointInT,
+          typename PointNT = pcl::Normal,
+          typename PointOutT = pcl::FPFHSignature33>
+using FPFHEstimationOMP = InPlaceFeature<pcl::FPFHEstimationOMP<Spannable<PointInT>,
+                                                                Spannable<PointNT>,
+                                                                Spannable<PointOutT>>>;
+
+/**
+ * \brief Parallel SHOT estimation of point cloud and normals spans into a descriptors
+ * span
+ * \details Spannable<PointNT> and Spannable<PointOutT> have to be registered with
+ * POINT_CLOUD_REGISTER_POINT_STRUCT as any other spannable point type. Local reference
+ * frames are regular PCL point clouds because they are internal to the estimation.
+ * pcl::SHOTEstimationOMP estimates frames that are not set with an estimator of its
+ * own that falls back to a kd-tree copying the search surface. Here they are
+ * estimated with the non-copying search::KdTree instead, frames set with
+ * setInputReferenceFrames are used as given.
+ * \tparam PointInT input point type
+ * \tparam PointNT input normal type
+ * \tparam PointOutT output descriptor type
+ * \tparam PointRFT local reference frame type
+ */
+template <typename PointInT,
+          typename PointNT = pcl::Normal,
+          typename PointOutT = pcl::SHOT352,
+          typename PointRFT = pcl::ReferenceFrame>
+class SHOTEstimationOMP
+: public InPlaceFeature<pcl::SHOTEstimationOMP<Spannable<PointInT>,
+                                               Spannable<PointNT>,
+                                               Spannable<PointOutT>,
+                                               PointRFT>> {
+  using Base = InPlaceFeature<pcl::SHOTEstimationOMP<Spannable<PointInT>,
+                                                     Spannable<PointNT>,
+                                                     Spannable<PointOutT>,
+                                                     PointRFT>>;
+
+public:
+  /**
+   * \brief Constructor
+   * \param args arguments forwarded to the constructor of pcl::SHOTEstimationOMP
+   */
+  template <typename... Args>
+  explicit SHOTEstimationOMP(Args&&... args) : Base(std::forward<Args>(args)...)
+  {}
+
+protected:
+  bool
+  initCompute() override
+  {
+    // frames estimated by a previous call are estimated again for the current input
+    const bool estimate =
+        this->frames_never_defined_ || this->frames_ == estimated_frames_;
+    if (this->input_ && estimate) {
+      pcl::SHOTLocalReferenceFrameEstimationOMP<Spannable<PointInT>, PointRFT> lrf;
+      lrf.setRadiusSearch(this->lrf_radius_ > 0
+                              ? static_cast<double>(this->lrf_radius_)
+                              : this->search_radius_);
+      lrf.setSearchMethod(lrf_tree_);
+      lrf.setInputCloud(this->input_);
+      if (this->indices_ && !this->fake_indices_)
+        lrf.setIndices(this->indices_);
+      if (!this->fake_surface_)
+        lrf.setSearchSurface(this->surface_);
+      lrf.setNumberOfThreads(this->threads_);
+      lrf.compute(*estimated_frames_);
+      this->setInputReferenceFrames(estimated_frames_);
+    }
+    return Base::initCompute();
+  }
+
+private:
+  std::shared_ptr<search::KdTree<Spannable<PointInT>>> lrf_tree_ =
+      std::make_shared<search::KdTree<Spannable<PointInT>>>(false);
+  typename pcl::PointCloud<PointRFT>::Ptr estimated_frames_ =
+      std::make_shared<pcl::PointCloud<PointRFT>>();
+};
+
+} // namespace pcl_cloud_span
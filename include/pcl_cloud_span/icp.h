@@ -0,0 +1,396 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2023 Ilia Kovalev
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include <pcl_cloud_span/pcl_cloud_span.h>
+
+#include <pcl_cloud_span/kdtree.h>
+#include <pcl_cloud_span/transforms.h>
+
+#include <pcl/exceptions.h>
+
+#include <Eigen/Core>
+#include <Eigen/SVD>
+
+#include "impl/parallel.h"
+#include "impl/point_count.h"
+
+#include <cmath>
+#include <limits>
+#include <vector>
+
+namespace pcl_cloud_span {
+
+/**
+ * \brief Point-to-point ICP registration of point cloud spans
+ * \details The algorithm follows pcl::IterativeClosestPoint with SVD transformation
+ * estimation and default convergence criteria, but it is designed for repeated
+ * scan-to-map matching:
+ * - source and target are spans and are never copied;
+ * - the target is indexed with the non-copying search::KdTree once per
+ * setInputTarget call, so it can be reused by many align calls;
+ * - the source is transformed into a scratch buffer that is reused by all iterations
+ * and all align calls with clouds of the same size;
+ * - correspondences are stored in preallocated arrays and searched in parallel.
+ * \tparam PointSource source point type
+ * \tparam PointTarget target point type
+ * \tparam Scalar type of transformation coefficients
+ */
+template <typename PointSource,
+          typename PointTarget = PointSource,
+          typename Scalar = float>
+class IterativeClosestPoint {
+public:
+  using PointCloudSource = pcl::PointCloud<Spannable<PointSource>>;
+  using PointCloudTarget = pcl::PointCloud<Spannable<PointTarget>>;
+  using Matrix4 = Eigen::Matrix<Scalar, 4, 4>;
+
+  /**
+   * \brief Set the source point cloud span
+   * \param cloud source point cloud span
+   */
+  void
+  setInputSource(const typename PointCloudSource::ConstPtr& cloud)
+  {
+    source_ = cloud;
+  }
+
+  /**
+   * \brief Set the target point cloud span and build its search index
+   * \param cloud target point cloud span
+   */
+  void
+  setInputTarget(const typename PointCloudTarget::ConstPtr& cloud)
+  {
+    target_ = cloud;
+    tree_.setInputCloud(cloud);
+  }
+
+  /**
+   * \brief Set the maximum number of iterations
+   * \param nr_iterations maximum number of iterations
+   */
+  void
+  setMaximumIterations(int nr_iterations)
+  {
+    max_iterations_ = nr_iterations;
+  }
+
+  /**
+   * \brief Set the maximum distance between corresponding points
+   * \param distance_threshold maximum correspondence distance
+   */
+  void
+  setMaxCorrespondenceDistance(double distance_threshold)
+  {
+    max_sqr_distance_ = static_cast<float>(distance_threshold * distance_threshold);
+  }
+
+  /**
+   * \brief Set the maximum squared translation between two consecutive iterations to
+   * consider that the algorithm has converged
+   * \param epsilon transformation epsilon
+   */
+  void
+  setTransformationEpsilon(double epsilon)
+  {
+    transformation_epsilon_ = epsilon;
+  }
+
+  /**
+   * \brief Set the minimum cosine of rotation angle between two consecutive iterations
+   * to consider that the algorithm has converged
+   * \param epsilon transformation rotation epsilon, 0 means 1 minus the transformation
+   * epsilon as in PCL
+   */
+  void
+  setTransformationRotationEpsilon(double epsilon)
+  {
+    transformation_rotation_epsilon_ = epsilon;
+  }
+
+  /**
+   * \brief Set the maximum relative change of the mean squared correspondence distance
+   * between two consecutive iterations to consider that the algorithm has converged
+   * \param epsilon euclidean fitness epsilon
+   */
+  void
+  setEuclideanFitnessEpsilon(double epsilon)
+  {
+    euclidean_fitness_epsilon_ = epsilon;
+  }
+
+  /**
+   * \brief Set the number of threads to use
+   * \param nr_threads the number of hardware threads to use (0 sets the value back to
+   * automatic)
+   */
+  void
+  setNumberOfThreads(unsigned int nr_threads = 0)
+  {
+    threads_ = detail::resolveNumberOfThreads(nr_threads);
+  }
+
+  /**
+   * \brief Estimate the transformation aligning the source to the target
+   * \param guess initial transformation
+   * \throws pcl::InitFailedException if source or target is not set
+   * \throws pcl::BadArgumentException if the source exceeds the 32-bit width
+   */
+  void
+  align(const Matrix4& guess = Matrix4::Identity())
+  {
+    if (!source_ || !target_)
+      PCL_THROW_EXCEPTION(pcl::InitFailedException,
+                          "Source and target point clouds should be set");
+
+    const auto size = source_->size();
+    detail::checkChunkSize(size);
+    scratch_.resize(size);
+    transformed_ = makeCloudSpan(reinterpret_cast<PointSource*>(scratch_.data()),
+                                 static_cast<std::uint32_t>(size));
+    correspondences_.resize(size);
+    sqr_distances_.resize(size);
+
+    final_transformation_ = guess;
+    converged_ = false;
+    iterations_ = 0;
+    double previous_mse = std::numeric_limits<double>::max();
+
+    while (!converged_) {
+      pcl_cloud_span::transformPointCloud(
+          *source_, transformed_, final_transformation_, false, threads_);
+      findCorrespondences();
+
+      Matrix4 transformation;
+      double mse;
+      if (!estimateTransformation(transformation, mse)) {
+        PCL_ERROR("[pcl_cloud_span::IterativeClosestPoint::align] Not enough "
+                  "correspondences found. Relax your threshold parameters.\n");
+        return;
+      }
+
+      final_transformation_ = transformation * final_transformation_;
+      ++iterations_;
+
+      const double translation_sqr =
+          transformation.template block<3, 1>(0, 3).squaredNorm();
+      const double cos_angle =
+          (transformation.template block<3, 3>(0, 0).trace() - 1) / 2;
+      const double rotation_epsilon = transformation_rotation_epsilon_ > 0
+                                          ? transformation_rotation_epsilon_
+                                          : 1 - transformation_epsilon_;
+      const double mse_change = std::abs(mse - previous_mse);
+      converged_ = iterations_ >= max_iterations_ ||
+                   (translation_sqr <= transformation_epsilon_ &&
+                    cos_angle >= rotation_epsilon) ||
+                   mse_change < absolute_mse_epsilon ||
+                   mse_change / previous_mse < euclidean_fitness_epsilon_;
+      previous_mse = mse;
+    }
+  }
+
+  /**
+   * \brief Estimate the transformation and write the aligned source into a span
+   * \param output point cloud span with the same number of points as the source
+   * \param guess initial transformation
+   * \throws pcl::InitFailedException if source or target is not set
+   * \throws pcl::BadArgumentException if size of `output` differs from the source size
+   */
+  void
+  align(PointCloudSource& output, const Matrix4& guess = Matrix4::Identity())
+  {
+    align(guess);
+    pcl_cloud_span::transformPointCloud(
+        *source_, output, final_transformation_, true, threads_);
+  }
+
+  /** \brief Return true if the last align call has converged. */
+  bool
+  hasConverged() const
+  {
+    return converged_;
+  }
+
+  /** \brief Get the transformation estimated by the last align call. */
+  const Matrix4&
+  getFinalTransformation() const
+  {
+    return final_transformation_;
+  }
+
+  /** \brief Get the number of iterations made by the last align call. */
+  int
+  getIterations() const
+  {
+    return iterations_;
+  }
+
+  /**
+   * \brief Get correspondences found at the last iteration
+   * \return for each source point an index of the corresponding target point or -1
+   */
+  const pcl::Indices&
+  getCorrespondences() const
+  {
+    return correspondences_;
+  }
+
+  /**
+   * \brief Get the mean squared distance from the aligned source to the target
+   * \param max_range maximum distance between points to be taken into account
+   * \return fitness score
+   */
+  double
+  getFitnessScore(double max_range = std::numeric_limits<double>::max()) const
+  {
+    const auto max_sqr_range = max_range * max_range;
+    double sum = 0;
+    std::size_t count = 0;
+    const auto& transformation = final_transformation_;
+    for (const auto& point : *source_) {
+      const Eigen::Matrix<Scalar, 3, 1> aligned =
+          transformation.template block<3, 3>(0, 0) *
+              Eigen::Matrix<Scalar, 3, 1>(point.x, point.y, point.z) +
+          transformation.template block<3, 1>(0, 3);
+      const Query query{static_cast<float>(aligned.x()),
+                        static_cast<float>(aligned.y()),
+                        static_cast<float>(aligned.z())};
+      pcl::index_t index;
+      float sqr_distance;
+      if (tree_.nearestSearch(query, index, sqr_distance) &&
+          static_cast<double>(sqr_distance) <= max_sqr_range) {
+        sum += static_cast<double>(sqr_distance);
+        ++count;
+      }
+    }
+    return count > 0 ? sum / static_cast<double>(count)
+                     : std::numeric_limits<double>::max();
+  }
+
+private:
+  /** \brief Absolute change of the mean squared distance PCL considers converged. */
+  static constexpr double absolute_mse_epsilon = 1e-12;
+
+  struct Query {
+    float x;
+    float y;
+    float z;
+  };
+
+  /**
+   * \brief Find the nearest target point for each transformed source point
+   * \details Non-finite source points of a non-dense source get no correspondence.
+   */
+  void
+  findCorrespondences()
+  {
+    const auto size = static_cast<std::ptrdiff_t>(transformed_.size());
+#pragma omp parallel for num_threads(threads_) schedule(dynamic, 256)
+    for (std::ptrdiff_t i = 0; i < size; ++i) {
+      const auto point = static_cast<std::size_t>(i);
+      const auto& source_point = (*source_)[point];
+      const bool finite = source_->is_dense || (std::isfinite(source_point.x) &&
+                                                std::isfinite(source_point.y) &&
+                                                std::isfinite(source_point.z));
+      if (!finite ||
+          !tree_.nearestSearch(transformed_[point],
+                               correspondences_[point],
+                               sqr_distances_[point],
+                               max_sqr_distance_))
+        correspondences_[point] = -1;
+    }
+  }
+
+  bool
+  estimateTransformation(Matrix4& transformation, double& mse) const
+  {
+    Eigen::Vector3d sum_source = Eigen::Vector3d::Zero();
+    Eigen::Vector3d sum_target = Eigen::Vector3d::Zero();
+    Eigen::Matrix3d sum_cross = Eigen::Matrix3d::Zero();
+    double sum_sqr_distance = 0;
+    std::size_t count = 0;
+
+    for (std::size_t i = 0; i < transformed_.size(); ++i) {
+      if (correspondences_[i] < 0)
+        continue;
+      const auto& s = transformed_[i];
+      const auto& t = (*target_)[static_cast<std::size_t>(correspondences_[i])];
+      const Eigen::Vector3d source(s.x, s.y, s.z);
+      const Eigen::Vector3d target(t.x, t.y, t.z);
+      sum_source += source;
+      sum_target += target;
+      sum_cross += source * target.transpose();
+      sum_sqr_distance += static_cast<double>(sqr_distances_[i]);
+      ++count;
+    }
+    if (count < 3)
+      return false;
+
+    const auto n = static_cast<double>(count);
+    const Eigen::Vector3d centroid_source = sum_source / n;
+    const Eigen::Vector3d centroid_target = sum_target / n;
+    const Eigen::Matrix3d covariance =
+        sum_cross - n * centroid_source * centroid_target.transpose();
+
+    Eigen::JacobiSVD<Eigen::Matrix3d> svd(covariance,
+                                          Eigen::ComputeFullU | Eigen::ComputeFullV);
+    Eigen::Matrix3d u = svd.matrixU();
+    Eigen::Matrix3d v = svd.matrixV();
+    if (u.determinant() * v.determinant() < 0)
+      v.col(2) *= -1;
+    const Eigen::Matrix3d rotation = v * u.transpose();
+
+    transformation.setIdentity();
+    transformation.template block<3, 3>(0, 0) = rotation.cast<Scalar>();
+    transformation.template block<3, 1>(0, 3) =
+        (centroid_target - rotation * centroid_source).cast<Scalar>();
+    mse = sum_sqr_distance / n;
+    return true;
+  }
+
+  typename PointCloudSource::ConstPtr source_;
+  typename PointCloudTarget::ConstPtr target_;
+  search::KdTree<Spannable<PointTarget>> tree_;
+
+  std::vector<Spannable<PointSource>, Eigen::aligned_allocator<Spannable<PointSource>>>
+      scratch_;
+  PointCloudSource transformed_;
+  pcl::Indices correspondences_;
+  std::vector<float> sqr_distances_;
+
+  int max_iterations_ = 10;
+  float max_sqr_distance_ = std::numeric_limits<float>::max();
+  double transformation_epsilon_ = 0;
+  double transformation_rotation_epsilon_ = 0;
+  double euclidean_fitness_epsilon_ = -std::numeric_limits<double>::max();
+  unsigned int threads_ = 1;
+
+  Matrix4 final_transformation_ = Matrix4::Identity();
+  bool converged_ = false;
+  int iterations_ = 0;
+};
+
+} // namespace pcl_cloud_span
@@ -0,0 +1,165 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2023 Ilia Kovalev
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include <pcl/PCLPointField.h>
+#include <pcl/common/io.h>
+#include <pcl/exceptions.h>
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+namespace pcl_cloud_span {
+namespace detail {
+
+/**
+ * \brief Runtime accessor of a registered point field
+ * \details Field layout is taken from the point type registration, so any field can
+ * be read by name directly from span memory without knowing the point type.
+ */
+struct FieldAccessor {
+  /** \brief Field name. */
+  std::string name;
+  /** \brief Offset of the field from the beginning of a point in bytes. */
+  std::uint32_t offset = 0;
+  /** \brief Type of field elements, one of pcl::PCLPointField::PointFieldTypes. */
+  std::uint8_t datatype = pcl::PCLPointField::FLOAT32;
+  /** \brief Number of elements in the field. */
+  std::uint32_t count = 1;
+
+  /** \brief Size of one field element in bytes. */
+  std::size_t
+  elementSize() const
+  {
+    switch (datatype) {
+    case pcl::PCLPointField::INT8:
+    case pcl::PCLPointField::UINT8:
+      return 1;
+    case pcl::PCLPointField::INT16:
+    case pcl::PCLPointField::UINT16:
+      return 2;
+    case pcl::PCLPointField::FLOAT64:
+      return 8;
+    default:
+      return 4;
+    }
+  }
+
+  /**
+   * \brief Read a field element converting it to double
+   * \param point pointer to the beginning of a point
+   * \param element index of the element to read
+   * \return element value
+   */
+  double
+  read(const void* point, std::uint32_t element = 0) const
+  {
+    const auto* data = static_cast<const std::uint8_t*>(point) + offset +
+                       element * elementSize();
+    switch (datatype) {
+    case pcl::PCLPointField::INT8:
+      return readAs<std::int8_t>(data);
+    case pcl::PCLPointField::UINT8:
+      return readAs<std::uint8_t>(data);
+    case pcl::PCLPointField::INT16:
+      return readAs<std::int16_t>(data);
+    case pcl::PCLPointField::UINT16:
+      return readAs<std::uint16_t>(data);
+    case pcl::PCLPointField::INT32:
+      return readAs<std::int32_t>(data);
+    case pcl::PCLPointField::UINT32:
+      return readAs<std::uint32_t>(data);
+    case pcl::PCLPointField::FLOAT64:
+      return readAs<double>(data);
+    default:
+      return readAs<float>(data);
+    }
+  }
+
+private:
+  template <typename T>
+  static double
+  readAs(const std::uint8_t* data)
+  {
+    T value;
+    std::memcpy(&value, data, sizeof(T));
+    return static_cast<double>(value);
+  }
+};
+
+/**
+ * \brief Find a registered field of a point type
+ * \tparam PointT registered point type
+ * \param name field name
+ * \return accessor of the field
+ * \throws pcl::BadArgumentException if the point type has no such field or its type is
+ * not supported
+ */
+template <typename PointT>
+FieldAccessor
+findField(const std::string& name)
+{
+  for (const auto& field : pcl::getFields<PointT>()) {
+    if (field.name != name)
+      continue;
+    if (field.datatype < pcl::PCLPointField::INT8 ||
+        field.datatype > pcl::PCLPointField::FLOAT64)
+      PCL_THROW_EXCEPTION(pcl::BadArgumentException,
+                          "Field " << name << " has unsupported type");
+    FieldAccessor accessor;
+    accessor.name = field.name;
+    accessor.offset = field.offset;
+    accessor.datatype = field.datatype;
+    accessor.count = field.count;
+    return accessor;
+  }
+  PCL_THROW_EXCEPTION(pcl::BadArgumentException, "Point type has no field " << name);
+}
+
+/**
+ * \brief Get offsets of float field elements that are averaged when points are merged
+ * \details All FLOAT32 fields except packed colors ("rgb" and "rgba") are averaged.
+ * \tparam PointT registered point type
+ * \return byte offsets of averaged elements, including x, y and z
+ */
+template <typename PointT>
+std::vector<std::uint32_t>
+getAveragedFieldOffsets()
+{
+  std::vector<std::uint32_t> offsets;
+  for (const auto& field : pcl::getFields<PointT>()) {
+    if (field.datatype != pcl::PCLPointField::FLOAT32 || field.name == "rgb" ||
+        field.name == "rgba")
+      continue;
+    for (std::uint32_t i = 0; i < field.count; ++i)
+      offsets.push_back(field.offset + i * static_cast<std::uint32_t>(sizeof(float)));
+  }
+  return offsets;
+}
+
+} // namespace detail
+} // namespace pcl_cloud_span
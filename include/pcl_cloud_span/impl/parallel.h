@@ -0,0 +1,105 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2023 Ilia Kovalev
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include <pcl/pcl_macros.h>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include <algorithm>
+#include <cstddef>
+#include <vector>
+
+namespace pcl_cloud_span {
+namespace detail {
+
+/**
+ * \brief Resolve the number of threads requested by a user of parallel algorithms
+ * \param nr_threads requested number of threads, 0 means the number of cores
+ * \return number of threads to pass to OpenMP regions
+ */
+inline unsigned int
+resolveNumberOfThreads(unsigned int nr_threads)
+{
+#ifdef _OPENMP
+  if (nr_threads == 0)
+    return static_cast<unsigned int>(omp_get_num_procs());
+  return nr_threads;
+#else
+  if (nr_threads > 1)
+    PCL_WARN("OpenMP is not available. Keeping number of threads unchanged at 1\n");
+  return 1;
+#endif
+}
+
+/** \brief Minimal number of elements to split sorting between threads. */
+constexpr std::ptrdiff_t sort_parallel_threshold = 65536;
+
+/**
+ * \brief Sort a range splitting it into chunks sorted in parallel and merged pairwise
+ * \param first beginning of the range
+ * \param last end of the range
+ * \param comp comparison function object
+ * \param nr_threads number of threads (already resolved)
+ */
+template <typename RandomIt, typename Compare>
+void
+parallelSort(RandomIt first, RandomIt last, Compare comp, unsigned int nr_threads)
+{
+  const std::ptrdiff_t size = last - first;
+  const std::ptrdiff_t chunks =
+      size < sort_parallel_threshold ? 1 : static_cast<std::ptrdiff_t>(nr_threads);
+  if (chunks <= 1) {
+    std::sort(first, last, comp);
+    return;
+  }
+
+  std::vector<std::ptrdiff_t> bounds(static_cast<std::size_t>(chunks) + 1);
+  for (std::size_t chunk = 0; chunk < bounds.size(); ++chunk)
+    bounds[chunk] = size * static_cast<std::ptrdiff_t>(chunk) / chunks;
+  const auto bound = [&bounds](std::ptrdiff_t chunk) {
+    return bounds[static_cast<std::size_t>(chunk)];
+  };
+
+#pragma omp parallel for num_threads(nr_threads) schedule(static)
+  for (std::ptrdiff_t chunk = 0; chunk < chunks; ++chunk)
+    std::sort(first + bound(chunk), first + bound(chunk + 1), comp);
+
+  for (std::ptrdiff_t width = 1; width < chunks; width *= 2) {
+    const std::ptrdiff_t step = 2 * width;
+#pragma omp parallel for num_threads(nr_threads) schedule(static)
+    for (std::ptrdiff_t chunk = 0; chunk < chunks; chunk += step)
+      if (chunk + width < chunks)
+        std::inplace_merge(first + bound(chunk),
+                           first + bound(chunk + width),
+                           first + bound(std::min(chunk + step, chunks)),
+                           comp);
+  }
+}
+
+} // namespace detail
+} // namespace pcl_cloud_span
@@ -28,6 +28,8 @@
 
 #include <pcl/point_cloud.h>
 
+#include "point_count.h"
+
 #include <span_or_vector/span_or_vector.hpp>
 
 namespace pcl {
@@ -51,7 +53,7 @@ public:
   PointCloud() = default;
 
   PointCloud(PointT* data, std::uint32_t width_, std::uint32_t height_ = 1)
-  : points(data, static_cast<std::size_t>(width_ * height_))
+  : points(data, pcl_cloud_span::detail::pointCount(width_, height_))
   , width(width_)
   , height(height_)
   {}
@@ -83,7 +85,9 @@ public:
   PointCloud(std::uint32_t width_,
              std::uint32_t height_,
              const PointT& value_ = PointT())
-  : points(width_ * height_, value_), width(width_), height(height_)
+  : points(pcl_cloud_span::detail::pointCount(width_, height_), value_)
+  , width(width_)
+  , height(height_)
   {}
 
   // TODO: check if copy/move constructors/assignment operators are needed
@@ -145,7 +149,8 @@ public:
   at(int column, int row) const
   {
     if (this->height > 1)
-      return (points.at(row * this->width + column));
+      return (points.at(static_cast<std::size_t>(row) * this->width +
+                        static_cast<std::size_t>(column)));
     else
       throw UnorganizedPointCloudException(
           "Can't use 2D indexing with an unorganized point cloud");
@@ -159,7 +164,8 @@ public:
   at(int column, int row)
   {
     if (this->height > 1)
-      return (points.at(row * this->width + column));
+      return (points.at(static_cast<std::size_t>(row) * this->width +
+                        static_cast<std::size_t>(column)));
     else
       throw UnorganizedPointCloudException(
           "Can't use 2D indexing with an unorganized point cloud");
@@ -449,7 +455,7 @@ public:
   resize(std::size_t count)
   {
     points.resize(count);
-    if (width * height != count) {
+    if (std::uint64_t{width} * height != count) {
       width = static_cast<std::uint32_t>(count);
       height = 1;
     }
@@ -468,7 +474,7 @@ public:
   inline void
   resize(uindex_t new_width, uindex_t new_height)
   {
-    points.resize(new_width * new_height);
+    points.resize(pcl_cloud_span::detail::pointCount(new_width, new_height));
     width = new_width;
     height = new_height;
   }
@@ -489,7 +495,7 @@ public:
   resize(index_t count, const PointT& value)
   {
     points.resize(count, value);
-    if (width * height != count) {
+    if (std::uint64_t{width} * height != count) {
       width = count;
       height = 1;
     }
@@ -509,7 +515,7 @@ public:
   inline void
   resize(index_t new_width, index_t new_height, const PointT& value)
   {
-    points.resize(new_width * new_height, value);
+    points.resize(pcl_cloud_span::detail::pointCount(new_width, new_height), value);
     width = new_width;
     height = new_height;
   }
@@ -580,7 +586,7 @@ public:
   inline void
   assign(index_t new_width, index_t new_height, const PointT& value)
   {
-    points.assign(new_width * new_height, value);
+    points.assign(pcl_cloud_span::detail::pointCount(new_width, new_height), value);
     width = new_width;
     height = new_height;
   }
@@ -623,7 +629,7 @@ public:
     points.assign(std::move(first), std::move(last));
     width = new_width;
     height = size() / width;
-    if (width * height != size()) {
+    if (std::uint64_t{width} * height != size()) {
       PCL_WARN("Mismatch in assignment. Requested width (%zu) doesn't divide "
                "provided size (%zu) cleanly. Setting height to 1\n",
                static_cast<std::size_t>(width),
@@ -662,7 +668,7 @@ public:
     points.assign(std::move(ilist));
     width = new_width;
     height = size() / width;
-    if (width * height != size()) {
+    if (std::uint64_t{width} * height != size()) {
       PCL_WARN("Mismatch in assignment. Requested width (%zu) doesn't divide "
                "provided size (%zu) cleanly. Setting height to 1\n",
                static_cast<std::size_t>(width),
@@ -0,0 +1,118 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2023 Ilia Kovalev
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include <pcl/exceptions.h>
+#include <pcl/types.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <type_traits>
+#include <vector>
+
+namespace pcl_cloud_span {
+
+/**
+ * \brief 64-bit point indices
+ * \details Span-aware algorithms producing indices accept them in place of
+ * pcl::Indices for clouds with more points than pcl::index_t can address.
+ */
+using LargeIndices = std::vector<std::uint64_t>;
+
+namespace detail {
+
+/** \brief Maximal number of points of a cloud whose indices fit in pcl::index_t. */
+constexpr std::size_t max_indexable_points =
+    static_cast<std::uint64_t>(std::numeric_limits<pcl::index_t>::max()) <
+            std::numeric_limits<std::size_t>::max()
+        ? static_cast<std::size_t>(std::numeric_limits<pcl::index_t>::max())
+        : std::numeric_limits<std::size_t>::max();
+
+/** \brief Maximal number of points of a chunk addressable by the cloud width. */
+constexpr std::size_t max_chunk_points =
+    std::min<std::size_t>(max_indexable_points,
+                          std::numeric_limits<std::uint32_t>::max());
+
+/**
+ * \brief Number of points of a cloud with the given dimensions computed without
+ * overflow
+ * \param width cloud width
+ * \param height cloud height
+ * \return `width * height`
+ * \throws pcl::BadArgumentException if the number of points does not fit in size_t
+ */
+inline std::size_t
+pointCount(std::uint64_t width, std::uint64_t height)
+{
+  // dimensions of pcl::PointCloud are 32-bit, so the product fits in 64 bits
+  const std::uint64_t count = width * height;
+  if (count > std::numeric_limits<std::size_t>::max())
+    PCL_THROW_EXCEPTION(pcl::BadArgumentException,
+                        "Point cloud of " << width << "x" << height
+                                          << " points is too large");
+  return static_cast<std::size_t>(count);
+}
+
+/**
+ * \brief Check that every point of a cloud can be addressed by an index type
+ * \tparam IndexT index type, pcl::index_t by default
+ * \param size number of points
+ * \throws pcl::BadArgumentException if the cloud is too large
+ */
+template <typename IndexT = pcl::index_t>
+inline void
+checkIndexable(std::size_t size)
+{
+  static_assert(std::is_integral<IndexT>::value, "Indices must be integral");
+  if (static_cast<std::uint64_t>(size) >
+      static_cast<std::uint64_t>(std::numeric_limits<IndexT>::max()))
+    PCL_THROW_EXCEPTION(pcl::BadArgumentException,
+                        "Point cloud of " << size
+                                          << " points exceeds the range of its "
+                                             "indices, use LargeIndices, split it "
+                                             "with makeCloudSpanChunks or build PCL "
+                                             "with PCL_INDEX_SIZE=64");
+}
+
+/**
+ * \brief Check that an unorganized cloud of the given size fits the 32-bit width
+ * \param size number of points
+ * \throws pcl::BadArgumentException if the cloud is too large
+ */
+inline void
+checkChunkSize(std::size_t size)
+{
+  if (size > max_chunk_points)
+    PCL_THROW_EXCEPTION(pcl::BadArgumentException,
+                        "Unorganized point cloud of "
+                            << size
+                            << " points exceeds the 32-bit width, split it with "
+                               "makeCloudSpanChunks");
+}
+
+} // namespace detail
+} // namespace pcl_cloud_span
@@ -0,0 +1,194 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2023 Ilia Kovalev
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <tuple>
+
+namespace pcl_cloud_span {
+namespace detail {
+
+/**
+ * \brief Integer coordinates of a voxel of a grid with the origin at zero
+ */
+struct VoxelKey {
+  std::int32_t x;
+  std::int32_t y;
+  std::int32_t z;
+};
+
+inline bool
+operator==(const VoxelKey& a, const VoxelKey& b)
+{
+  return a.x == b.x && a.y == b.y && a.z == b.z;
+}
+
+inline bool
+operator!=(const VoxelKey& a, const VoxelKey& b)
+{
+  return !(a == b);
+}
+
+inline bool
+operator<(const VoxelKey& a, const VoxelKey& b)
+{
+  return std::tie(a.x, a.y, a.z) < std::tie(b.x, b.y, b.z);
+}
+
+/** \brief Hash of voxel keys for unordered containers. */
+struct VoxelKeyHash {
+  std::size_t
+  operator()(const VoxelKey& key) const
+  {
+    // Large primes from "Optimized Spatial Hashing for Collision Detection of
+    // Deformable Objects" (Teschner et al.)
+    return static_cast<std::size_t>(static_cast<std::uint32_t>(key.x) * 73856093u ^
+                                    static_cast<std::uint32_t>(key.y) * 19349669u ^
+                                    static_cast<std::uint32_t>(key.z) * 83492791u);
+  }
+};
+
+/**
+ * \brief Compute the key of the voxel containing a point
+ * \details Coordinates are computed the same way as in pcl::VoxelGrid, so the voxels
+ * partition points exactly as PCL does for the same leaf size.
+ * \param point point with x, y and z fields
+ * \param inverse_leaf_size inverse of the voxel size
+ * \param key resulting voxel key
+ * \return false if the point is not finite or out of the range of the grid
+ */
+template <typename PointT>
+inline bool
+computeVoxelKey(const PointT& point, float inverse_leaf_size, VoxelKey& key)
+{
+  constexpr float limit = static_cast<float>(std::numeric_limits<std::int32_t>::max());
+  const float x = std::floor(point.x * inverse_leaf_size);
+  const float y = std::floor(point.y * inverse_leaf_size);
+  const float z = std::floor(point.z * inverse_leaf_size);
+  // comparisons are false for NaN, so non-finite points are rejected as well
+  if (!(std::abs(x) < limit && std::abs(y) < limit && std::abs(z) < limit))
+    return false;
+  key = {static_cast<std::int32_t>(x),
+         static_cast<std::int32_t>(y),
+         static_cast<std::int32_t>(z)};
+  return true;
+}
+
+/**
+ * \brief Grid of cubic cells anchored at the minimum of a point cloud
+ * \details Used by algorithms that rely on all points of a cell being closer than a
+ * distance threshold. Keys are computed in double relative to the origin, so the
+ * cell size stays exact far from zero (e.g. for UTM coordinates), where rounding of
+ * float products exceeds a small fraction of the cell.
+ */
+struct CellGrid {
+  double origin[3] = {0., 0., 0.};
+  double inverse_cell_size = 1.;
+};
+
+/**
+ * \brief Make a grid anchored at the minimum of finite points of a cloud
+ * \param cloud point cloud or point cloud span
+ * \param cell_size size of grid cells
+ * \param nr_threads number of threads (already resolved)
+ * \return the grid, anchored at zero if the cloud has no finite points
+ */
+template <typename CloudT>
+inline CellGrid
+makeCellGrid(const CloudT& cloud, double cell_size, unsigned int nr_threads)
+{
+  float min_pt[3] = {std::numeric_limits<float>::infinity(),
+                     std::numeric_limits<float>::infinity(),
+                     std::numeric_limits<float>::infinity()};
+  const auto size = static_cast<std::ptrdiff_t>(cloud.size());
+#pragma omp parallel num_threads(nr_threads)
+  {
+    float local_min[3] = {min_pt[0], min_pt[1], min_pt[2]};
+#pragma omp for schedule(static) nowait
+    for (std::ptrdiff_t i = 0; i < size; ++i) {
+      const auto& point = cloud[static_cast<std::size_t>(i)];
+      if (!(std::isfinite(point.x) && std::isfinite(point.y) && std::isfinite(point.z)))
+        continue;
+      local_min[0] = std::min(local_min[0], point.x);
+      local_min[1] = std::min(local_min[1], point.y);
+      local_min[2] = std::min(local_min[2], point.z);
+    }
+#pragma omp critical
+    for (std::size_t axis = 0; axis < 3; ++axis)
+      min_pt[axis] = std::min(min_pt[axis], local_min[axis]);
+  }
+
+  CellGrid grid;
+  for (std::size_t axis = 0; axis < 3; ++axis)
+    if (std::isfinite(min_pt[axis]))
+      grid.origin[axis] = static_cast<double>(min_pt[axis]);
+  grid.inverse_cell_size = 1. / cell_size;
+  return grid;
+}
+
+/**
+ * \brief Compute the key of the cell of a CellGrid containing a point
+ * \param point point with x, y and z fields
+ * \param grid the grid
+ * \param key resulting cell key
+ * \return false if the point is not finite or out of the range of the grid
+ */
+template <typename PointT>
+inline bool
+computeCellKey(const PointT& point, const CellGrid& grid, VoxelKey& key)
+{
+  constexpr auto limit = static_cast<double>(std::numeric_limits<std::int32_t>::max());
+  const auto coordinate = [&grid](float value, std::size_t axis) {
+    return std::floor((static_cast<double>(value) - grid.origin[axis]) *
+                      grid.inverse_cell_size);
+  };
+  const double x = coordinate(point.x, 0);
+  const double y = coordinate(point.y, 1);
+  const double z = coordinate(point.z, 2);
+  // comparisons are false for NaN, so non-finite points are rejected as well
+  if (!(std::abs(x) < limit && std::abs(y) < limit && std::abs(z) < limit))
+    return false;
+  key = {static_cast<std::int32_t>(x),
+         static_cast<std::int32_t>(y),
+         static_cast<std::int32_t>(z)};
+  return true;
+}
+
+/** \brief Key of the voxel of a grid `factor` times coarser containing `key`. */
+inline VoxelKey
+coarsenVoxelKey(const VoxelKey& key, std::int32_t factor)
+{
+  const auto div = [factor](std::int32_t value) {
+    return value >= 0 ? value / factor : -((-value - 1) / factor) - 1;
+  };
+  return {div(key.x), div(key.y), div(key.z)};
+}
+
+} // namespace detail
+} // namespace pcl_cloud_span
@@ -0,0 +1,423 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2023 Ilia Kovalev
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include <pcl_cloud_span/pcl_cloud_span.h>
+
+#include <pcl/exceptions.h>
+#include <pcl/pcl_config.h>
+#include <pcl/search/search.h>
+
+#include "impl/point_count.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace pcl_cloud_span {
+namespace search {
+
+/**
+ * \brief Kd-tree search method that does not copy points of the input cloud
+ * \details pcl::search::KdTree copies coordinates of all input points into a FLANN
+ * matrix. This kd-tree stores only a permutation of point indices and split planes,
+ * so building it over a point cloud span costs 4 bytes per point plus nodes, and all
+ * distances are computed from the span memory directly. Returned indices refer to the
+ * input cloud, as in pcl::search::KdTree. Points with non-finite coordinates are not
+ * indexed. Queries are const and thread-safe.
+ * \tparam PointT point type with x, y and z fields
+ */
+template <typename PointT>
+class KdTree : public pcl::search::Search<PointT> {
+public:
+  using Ptr = pcl::shared_ptr<KdTree<PointT>>;
+  using ConstPtr = pcl::shared_ptr<const KdTree<PointT>>;
+  using PointCloud = typename pcl::search::Search<PointT>::PointCloud;
+  using PointCloudConstPtr = typename pcl::search::Search<PointT>::PointCloudConstPtr;
+  using IndicesConstPtr = pcl::IndicesConstPtr;
+
+  using pcl::search::Search<PointT>::nearestKSearch;
+  using pcl::search::Search<PointT>::radiusSearch;
+
+  /**
+   * \brief Constructor
+   * \param sorted set to true if the nearest neighbor search results need to be sorted
+   * in ascending order based on their distance to the query point
+   * \param max_leaf_size maximal number of points in a leaf node
+   */
+  explicit KdTree(bool sorted = true, std::uint32_t max_leaf_size = 16)
+  : pcl::search::Search<PointT>("SpanKdTree", sorted)
+  , max_leaf_size_(std::max<std::uint32_t>(max_leaf_size, 1))
+  {}
+
+  /**
+   * \brief Provide a pointer to the input dataset and build the tree
+   * \param cloud the const shared pointer to a point cloud
+   * \param indices the point indices subset that is to be used from \a cloud
+   */
+#if PCL_VERSION_COMPARE(>=, 1, 14, 0)
+  bool
+  setInputCloud(const PointCloudConstPtr& cloud,
+                const IndicesConstPtr& indices = IndicesConstPtr()) override
+  {
+    build(cloud, indices);
+    return true;
+  }
+#else
+  void
+  setInputCloud(const PointCloudConstPtr& cloud,
+                const IndicesConstPtr& indices = IndicesConstPtr()) override
+  {
+    build(cloud, indices);
+  }
+#endif
+
+  /**
+   * \brief Search for the k-nearest neighbors for the given query point
+   * \param[in] point the given query point
+   * \param[in] k the number of neighbors to search for
+   * \param[out] k_indices the resultant indices of the neighboring points
+   * \param[out] k_sqr_distances the resultant squared distances to the neighboring
+   * points
+   * \return number of neighbors found
+   */
+  int
+  nearestKSearch(const PointT& point,
+                 int k,
+                 pcl::Indices& k_indices,
+                 std::vector<float>& k_sqr_distances) const override
+  {
+    k_indices.clear();
+    k_sqr_distances.clear();
+    if (k <= 0 || nodes_.empty() || !isFinite(point))
+      return 0;
+
+    auto& results = scratch();
+    results.clear();
+    KnnCollector collector{results, static_cast<std::size_t>(k)};
+    const float query[3] = {point.x, point.y, point.z};
+    searchNode(0, query, collector);
+    return copyResults(results, k_indices, k_sqr_distances);
+  }
+
+  /**
+   * \brief Search for all the nearest neighbors of the query point in a given radius
+   * \param[in] point the given query point
+   * \param[in] radius the radius of the sphere bounding all of point's neighbors
+   * \param[out] k_indices the resultant indices of the neighboring points
+   * \param[out] k_sqr_distances the resultant squared distances to the neighboring
+   * points
+   * \param[in] max_nn if given, bounds the maximum returned neighbors to this value,
+   * the closest neighbors are returned in this case
+   * \return number of neighbors found in radius
+   */
+  int
+  radiusSearch(const PointT& point,
+               double radius,
+               pcl::Indices& k_indices,
+               std::vector<float>& k_sqr_distances,
+               unsigned int max_nn = 0) const override
+  {
+    k_indices.clear();
+    k_sqr_distances.clear();
+    if (nodes_.empty() || !isFinite(point))
+      return 0;
+
+    auto& results = scratch();
+    results.clear();
+    RadiusCollector collector{results, static_cast<float>(radius * radius)};
+    const float query[3] = {point.x, point.y, point.z};
+    searchNode(0, query, collector);
+
+    if (max_nn > 0 && results.size() > max_nn) {
+      std::partial_sort(results.begin(), results.begin() + max_nn, results.end());
+      results.resize(max_nn);
+    }
+    else if (this->sorted_results_)
+      std::sort(results.begin(), results.end());
+    return copyResults(results, k_indices, k_sqr_distances);
+  }
+
+  /**
+   * \brief Search for the nearest neighbor of the query point without allocations
+   * \tparam QueryPointT type of the query point with x, y and z fields
+   * \param[in] point the given query point
+   * \param[out] index index of the nearest point
+   * \param[out] sqr_distance squared distance to the nearest point
+   * \param[in] max_sqr_distance only points closer than this value are considered
+   * \return true if a neighbor was found
+   */
+  template <typename QueryPointT>
+  bool
+  nearestSearch(const QueryPointT& point,
+                pcl::index_t& index,
+                float& sqr_distance,
+                float max_sqr_distance = std::numeric_limits<float>::infinity()) const
+  {
+    if (nodes_.empty() || !isFinite(point))
+      return false;
+
+    NearestCollector collector{-1, max_sqr_distance};
+    const float query[3] = {point.x, point.y, point.z};
+    searchNode(0, query, collector);
+    if (collector.index < 0)
+      return false;
+    index = collector.index;
+    sqr_distance = collector.sqr_distance;
+    return true;
+  }
+
+private:
+  using Result = std::pair<float, pcl::index_t>;
+
+  struct Node {
+    std::uint32_t begin;
+    std::uint32_t end;
+    std::uint32_t left;
+    std::uint32_t right;
+    float split;
+    int axis; // -1 for leaves
+  };
+
+  struct KnnCollector {
+    std::vector<Result>& results;
+    std::size_t k;
+
+    float
+    bound() const
+    {
+      return results.size() < k ? std::numeric_limits<float>::infinity()
+                                : results.back().first;
+    }
+
+    void
+    add(float sqr_distance, pcl::index_t index)
+    {
+      if (results.size() == k) {
+        if (!(sqr_distance < results.back().first))
+          return;
+        results.pop_back();
+      }
+      const Result result{sqr_distance, index};
+      results.insert(std::upper_bound(results.begin(), results.end(), result), result);
+    }
+  };
+
+  struct RadiusCollector {
+    std::vector<Result>& results;
+    float sqr_radius;
+
+    float
+    bound() const
+    {
+      return sqr_radius;
+    }
+
+    void
+    add(float sqr_distance, pcl::index_t index)
+    {
+      if (sqr_distance <= sqr_radius)
+        results.emplace_back(sqr_distance, index);
+    }
+  };
+
+  struct NearestCollector {
+    pcl::index_t index;
+    float sqr_distance;
+
+    float
+    bound() const
+    {
+      return sqr_distance;
+    }
+
+    void
+    add(float sqr_distance_, pcl::index_t index_)
+    {
+      if (sqr_distance_ < sqr_distance) {
+        sqr_distance = sqr_distance_;
+        index = index_;
+      }
+    }
+  };
+
+  template <typename QueryPointT>
+  static bool
+  isFinite(const QueryPointT& point)
+  {
+    return std::isfinite(point.x) && std::isfinite(point.y) && std::isfinite(point.z);
+  }
+
+  static float
+  coordinate(const PointT& point, int axis)
+  {
+    return axis == 0 ? point.x : (axis == 1 ? point.y : point.z);
+  }
+
+  static const PointT&
+  pointAt(const PointCloud& cloud, pcl::index_t index)
+  {
+    return cloud[static_cast<std::size_t>(index)];
+  }
+
+  static std::vector<Result>&
+  scratch()
+  {
+    static thread_local std::vector<Result> results;
+    return results;
+  }
+
+  static int
+  copyResults(const std::vector<Result>& results,
+              pcl::Indices& k_indices,
+              std::vector<float>& k_sqr_distances)
+  {
+    k_indices.resize(results.size());
+    k_sqr_distances.resize(results.size());
+    for (std::size_t i = 0; i < results.size(); ++i) {
+      k_sqr_distances[i] = results[i].first;
+      k_indices[i] = results[i].second;
+    }
+    return static_cast<int>(results.size());
+  }
+
+  void
+  build(const PointCloudConstPtr& cloud, const IndicesConstPtr& indices)
+  {
+    this->input_ = cloud;
+    this->indices_ = indices;
+    order_.clear();
+    nodes_.clear();
+    if (!cloud)
+      return;
+    // nodes address points with 32-bit ranges
+    if (cloud->size() > detail::max_chunk_points)
+      PCL_THROW_EXCEPTION(pcl::BadArgumentException,
+                          "Point cloud is too large for the kd-tree, split it with "
+                          "makeCloudSpanChunks");
+
+    if (indices) {
+      order_.reserve(indices->size());
+      for (const auto index : *indices)
+        if (isFinite(pointAt(*cloud, index)))
+          order_.push_back(index);
+    }
+    else {
+      order_.reserve(cloud->size());
+      for (std::size_t i = 0; i < cloud->size(); ++i)
+        if (isFinite((*cloud)[i]))
+          order_.push_back(static_cast<pcl::index_t>(i));
+    }
+
+    if (!order_.empty()) {
+      nodes_.reserve(2 * (order_.size() / max_leaf_size_ + 1));
+      buildNode(0, static_cast<std::uint32_t>(order_.size()));
+    }
+  }
+
+  std::uint32_t
+  buildNode(std::uint32_t begin, std::uint32_t end)
+  {
+    const auto id = static_cast<std::uint32_t>(nodes_.size());
+    nodes_.push_back({begin, end, 0, 0, 0.f, -1});
+    if (end - begin <= max_leaf_size_)
+      return id;
+
+    const auto& cloud = *this->input_;
+    float min_pt[3], max_pt[3];
+    for (int axis = 0; axis < 3; ++axis) {
+      min_pt[axis] = std::numeric_limits<float>::infinity();
+      max_pt[axis] = -std::numeric_limits<float>::infinity();
+    }
+    for (auto i = begin; i < end; ++i) {
+      const auto& point = pointAt(cloud, order_[i]);
+      const float xyz[3] = {point.x, point.y, point.z};
+      for (int axis = 0; axis < 3; ++axis) {
+        min_pt[axis] = std::min(min_pt[axis], xyz[axis]);
+        max_pt[axis] = std::max(max_pt[axis], xyz[axis]);
+      }
+    }
+
+    int axis = 0;
+    for (int a = 1; a < 3; ++a)
+      if (max_pt[a] - min_pt[a] > max_pt[axis] - min_pt[axis])
+        axis = a;
+    if (!(max_pt[axis] > min_pt[axis]))
+      return id; // all points are equal
+
+    const auto mid = begin + (end - begin) / 2;
+    std::nth_element(order_.begin() + begin,
+                     order_.begin() + mid,
+                     order_.begin() + end,
+                     [&](pcl::index_t a, pcl::index_t b) {
+                       return coordinate(pointAt(cloud, a), axis) <
+                              coordinate(pointAt(cloud, b), axis);
+                     });
+
+    const float split = coordinate(pointAt(cloud, order_[mid]), axis);
+    const auto left = buildNode(begin, mid);
+    const auto right = buildNode(mid, end);
+    auto& node = nodes_[id];
+    node.left = left;
+    node.right = right;
+    node.split = split;
+    node.axis = axis;
+    return id;
+  }
+
+  template <typename Collector>
+  void
+  searchNode(std::uint32_t id, const float* query, Collector& collector) const
+  {
+    const auto& node = nodes_[id];
+    if (node.axis < 0) {
+      const auto& cloud = *this->input_;
+      for (auto i = node.begin; i < node.end; ++i) {
+        const auto& point = pointAt(cloud, order_[i]);
+        const float dx = point.x - query[0];
+        const float dy = point.y - query[1];
+        const float dz = point.z - query[2];
+        collector.add(dx * dx + dy * dy + dz * dz, order_[i]);
+      }
+      return;
+    }
+
+    const float diff = query[node.axis] - node.split;
+    searchNode(diff < 0.f ? node.left : node.right, query, collector);
+    if (diff * diff <= collector.bound())
+      searchNode(diff < 0.f ? node.right : node.left, query, collector);
+  }
+
+  std::uint32_t max_leaf_size_;
+  pcl::Indices order_;
+  std::vector<Node> nodes_;
+};
+
+} // namespace search
+} // namespace pcl_cloud_span
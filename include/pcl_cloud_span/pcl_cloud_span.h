@@ -31,6 +31,13 @@
 #include "impl/point_cloud.h"
 #include <span_or_vector/span_or_vector.hpp>
 
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <type_traits>
+#include <vector>
+
 namespace pcl_cloud_span {
 
 /**
@@ -90,8 +97,10 @@ convertToPCL(pcl::PointCloud<Spannable<PointT>>&& in)
  * \param width point cloud width to set to output pcl::PointCloud
  * \param height point cloud height to set to output pcl::PointCloud
  * \return point cloud span that can be used in PCL algorithms
+ * \throws pcl::BadArgumentException if `width * height` does not fit in size_t
  */
-template <typename PointT>
+template <typename PointT,
+          typename = std::enable_if_t<!std::is_const<PointT>::value>>
 pcl::PointCloud<Spannable<PointT>>
 makeCloudSpan(PointT* data, std::uint32_t width, std::uint32_t height = 1)
 {
@@ -105,8 +114,10 @@ makeCloudSpan(PointT* data, std::uint32_t width, std::uint32_t height = 1)
  * \param width point cloud width to set to output pcl::PointCloud
  * \param height point cloud height to set to output pcl::PointCloud
  * \return a pointer to a point cloud span that can be used in PCL algorithms
+ * \throws pcl::BadArgumentException if `width * height` does not fit in size_t
  */
-template <typename PointT>
+template <typename PointT,
+          typename = std::enable_if_t<!std::is_const<PointT>::value>>
 typename pcl::PointCloud<Spannable<PointT>>::Ptr
 makeCloudSpanPtr(PointT* data, std::uint32_t width, std::uint32_t height = 1)
 {
@@ -114,4 +125,222 @@ makeCloudSpanPtr(PointT* data, std::uint32_t width, std::uint32_t height = 1)
       makeCloudSpan(data, width, height));
 }
 
+/**
+ * \brief Read-only point cloud span over immutable points data
+ * \details The span is handed out only as a const point cloud, so it can be passed as
+ * input to any PCL algorithm but nothing writes to the spanned memory (e.g. a
+ * read-only memory map or a const message buffer). getMutableCloud() copies points to
+ * owned storage on first use, clouds handed out before keep referring to the original
+ * data.
+ * \tparam PointT point type
+ */
+template <typename PointT>
+class ConstCloudSpan {
+public:
+  using PointCloud = pcl::PointCloud<Spannable<PointT>>;
+
+  /**
+   * \brief Create a read-only span
+   * \param data pointer to points data
+   * \param width point cloud width
+   * \param height point cloud height
+   * \throws pcl::BadArgumentException if `width * height` does not fit in size_t
+   */
+  ConstCloudSpan(const PointT* data, std::uint32_t width, std::uint32_t height = 1)
+  // the cloud is never handed out as mutable while it spans the data
+  : cloud_(std::make_shared<PointCloud>(
+        reinterpret_cast<Spannable<PointT>*>(const_cast<PointT*>(data)),
+        width,
+        height))
+  {}
+
+  const PointCloud&
+  operator*() const
+  {
+    return *cloud_;
+  }
+
+  const PointCloud*
+  operator->() const
+  {
+    return cloud_.get();
+  }
+
+  /** \brief Pointer to the cloud for PCL algorithms taking the input by pointer. */
+  typename PointCloud::ConstPtr
+  getCloudPtr() const
+  {
+    return cloud_;
+  }
+
+  /** \brief Whether points were copied to owned storage by getMutableCloud(). */
+  bool
+  isOwned() const
+  {
+    return owned_;
+  }
+
+  /**
+   * \brief Set the header of the cloud
+   * \details Clouds handed out by getCloudPtr() before keep their header.
+   * \param header header
+   */
+  void
+  setHeader(const pcl::PCLHeader& header)
+  {
+    unshare();
+    cloud_->header = header;
+  }
+
+  /**
+   * \brief Set whether all points are finite
+   * \details Clouds handed out by getCloudPtr() before keep their density flag.
+   * \param is_dense true if all points are finite
+   */
+  void
+  setDense(bool is_dense)
+  {
+    unshare();
+    cloud_->is_dense = is_dense;
+  }
+
+  /**
+   * \brief Get the cloud for modification
+   * \details Points are copied to owned storage unless they are already owned and the
+   * cloud is not shared through getCloudPtr().
+   * \return mutable point cloud
+   */
+  PointCloud&
+  getMutableCloud()
+  {
+    if (!owned_ || cloud_.use_count() > 1) {
+      cloud_ = copyCloud(true);
+      owned_ = true;
+    }
+    return *cloud_;
+  }
+
+private:
+  /**
+   * \brief Replace the cloud by a copy if it is shared through getCloudPtr()
+   * \details A span over the original data stays a span, owned points are copied.
+   */
+  void
+  unshare()
+  {
+    if (cloud_.use_count() > 1)
+      cloud_ = copyCloud(owned_);
+  }
+
+  /** \brief Copy of the cloud with owned points or spanning the same points. */
+  std::shared_ptr<PointCloud>
+  copyCloud(bool copy_points) const
+  {
+    std::shared_ptr<PointCloud> cloud;
+    if (copy_points) {
+      cloud = std::make_shared<PointCloud>();
+      cloud->points.assign(cloud_->begin(), cloud_->end());
+      cloud->width = cloud_->width;
+      cloud->height = cloud_->height;
+    }
+    else
+      cloud = std::make_shared<PointCloud>(
+          cloud_->data(), cloud_->width, cloud_->height);
+    cloud->header = cloud_->header;
+    cloud->is_dense = cloud_->is_dense;
+    cloud->sensor_origin_ = cloud_->sensor_origin_;
+    cloud->sensor_orientation_ = cloud_->sensor_orientation_;
+    return cloud;
+  }
+
+  std::shared_ptr<PointCloud> cloud_;
+  bool owned_ = false;
+};
+
+/**
+ * \brief Create a read-only point cloud span over immutable points data
+ * \tparam PointT point type
+ * \param data pointer to points data
+ * \param width point cloud width to set to output pcl::PointCloud
+ * \param height point cloud height to set to output pcl::PointCloud
+ * \return read-only point cloud span
+ * \throws pcl::BadArgumentException if `width * height` does not fit in size_t
+ */
+template <typename PointT>
+ConstCloudSpan<PointT>
+makeCloudSpan(const PointT* data, std::uint32_t width, std::uint32_t height = 1)
+{
+  return {data, width, height};
+}
+
+/**
+ * \brief Create a read-only point cloud span over immutable points data
+ * \tparam PointT point type
+ * \param data pointer to points data
+ * \param width point cloud width to set to output pcl::PointCloud
+ * \param height point cloud height to set to output pcl::PointCloud
+ * \return a pointer to a const point cloud span that can be used as input of PCL
+ * algorithms
+ * \throws pcl::BadArgumentException if `width * height` does not fit in size_t
+ */
+template <typename PointT>
+typename pcl::PointCloud<Spannable<PointT>>::ConstPtr
+makeCloudSpanPtr(const PointT* data, std::uint32_t width, std::uint32_t height = 1)
+{
+  return ConstCloudSpan<PointT>(data, width, height).getCloudPtr();
+}
+
+/**
+ * \brief Create unorganized point cloud spans over consecutive chunks of points data
+ * \details Fallback for clouds with more points than pcl::PointCloud dimensions or
+ * pcl::index_t can address: each chunk can be passed to any PCL algorithm and chunk
+ * `i` starts at point `i * chunk_size` of `data`.
+ * \tparam PointT point type
+ * \param data pointer to points data
+ * \param size number of points
+ * \param chunk_size maximal number of points of a chunk, by default the largest
+ * number of points addressable by both the cloud width and pcl::index_t
+ * \return pointers to point cloud spans over the chunks
+ * \throws pcl::BadArgumentException if chunk_size is zero or exceeds the default
+ */
+template <typename PointT,
+          typename = std::enable_if_t<!std::is_const<PointT>::value>>
+std::vector<typename pcl::PointCloud<Spannable<PointT>>::Ptr>
+makeCloudSpanChunks(PointT* data,
+                    std::size_t size,
+                    std::size_t chunk_size = detail::max_chunk_points)
+{
+  if (chunk_size == 0 || chunk_size > detail::max_chunk_points)
+    PCL_THROW_EXCEPTION(pcl::BadArgumentException,
+                        "Chunk size must be in range [1, " << detail::max_chunk_points
+                                                           << "]");
+  std::vector<typename pcl::PointCloud<Spannable<PointT>>::Ptr> chunks;
+  chunks.reserve((size + chunk_size - 1) / chunk_size);
+  for (std::size_t first = 0; first < size; first += chunk_size)
+    chunks.push_back(makeCloudSpanPtr(
+        data + first, static_cast<std::uint32_t>(std::min(chunk_size, size - first))));
+  return chunks;
+}
+
+/**
+ * \brief Create read-only point cloud spans over consecutive chunks of immutable
+ * points data
+ * \details Same as the overload for mutable data.
+ * \tparam PointT point type
+ * \param data pointer to points data
+ * \param size number of points
+ * \param chunk_size maximal number of points of a chunk
+ * \return pointers to const point cloud spans over the chunks
+ * \throws pcl::BadArgumentException if chunk_size is zero or too large
+ */
+template <typename PointT>
+std::vector<typename pcl::PointCloud<Spannable<PointT>>::ConstPtr>
+makeCloudSpanChunks(const PointT* data,
+                    std::size_t size,
+                    std::size_t chunk_size = detail::max_chunk_points)
+{
+  const auto chunks = makeCloudSpanChunks(const_cast<PointT*>(data), size, chunk_size);
+  return {chunks.begin(), chunks.end()};
+}
+
 } // namespace pcl_cloud_span
@@ -31,6 +31,16 @@ namespace pcl_cloud_span {
  * \tparam PointT point type of used point data
  */
 template <typename PointT>
-struct Spannable : PointT {};
+struct Spannable : PointT {
+  using PointT::PointT;
+
+  Spannable() = default;
+
+  /**
+   * \brief Wrap a copy of a point
+   * \param point point to copy
+   */
+  explicit Spannable(const PointT& point) : PointT(point) {}
+};
 
 } // namespace pcl_cloud_span
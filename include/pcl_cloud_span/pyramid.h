@@ -0,0 +1,296 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2023 Ilia Kovalev
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include <pcl_cloud_span/pcl_cloud_span.h>
+
+#include <pcl/exceptions.h>
+
+#include <Eigen/Core>
+
+#include "impl/field_access.h"
+#include "impl/parallel.h"
+#include "impl/point_count.h"
+#include "impl/voxel_key.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <utility>
+#include <vector>
+
+namespace pcl_cloud_span {
+
+/**
+ * \brief Lazily computed multi-resolution voxel pyramid of a point cloud span
+ * \details Level 0 is the voxel grid of the input cloud with the base leaf size, every
+ * next level has a leaf `scale factor` times larger. Grids of all levels are aligned
+ * at the origin, so each voxel of a level is the union of voxels of the finer level
+ * and the level is computed from the finer one rather than from the input cloud. The
+ * number of input points per voxel is kept, so centroids of coarse levels are exact
+ * centroids of the input points, equal to what pcl::VoxelGrid produces for the same
+ * leaf size.
+ *
+ * All float fields except packed colors are averaged, other fields are copied from the
+ * first point of the voxel. Points with non-finite coordinates are ignored. Points of a
+ * level are ordered by voxel coordinates. Levels are computed on first request and
+ * cached until the input or parameters change.
+ * \tparam PointT point type
+ */
+template <typename PointT>
+class VoxelPyramid {
+public:
+  using PointCloud = pcl::PointCloud<Spannable<PointT>>;
+
+  /**
+   * \brief Set the input point cloud span, invalidates computed levels
+   * \param cloud input point cloud span
+   */
+  void
+  setInputCloud(const typename PointCloud::ConstPtr& cloud)
+  {
+    input_ = cloud;
+    levels_.clear();
+  }
+
+  /**
+   * \brief Set the leaf size of the finest level, invalidates computed levels
+   * \param leaf_size leaf size
+   * \throws pcl::BadArgumentException if leaf size is not positive
+   */
+  void
+  setLeafSize(float leaf_size)
+  {
+    if (!(leaf_size > 0))
+      PCL_THROW_EXCEPTION(pcl::BadArgumentException, "Leaf size must be positive");
+    leaf_size_ = leaf_size;
+    levels_.clear();
+  }
+
+  /**
+   * \brief Set the ratio between leaf sizes of consecutive levels, invalidates computed
+   * levels
+   * \param factor scale factor, 2 by default
+   * \throws pcl::BadArgumentException if factor is less than 2
+   */
+  void
+  setScaleFactor(unsigned int factor)
+  {
+    if (factor < 2)
+      PCL_THROW_EXCEPTION(pcl::BadArgumentException,
+                          "Scale factor must be at least 2");
+    factor_ = factor;
+    levels_.clear();
+  }
+
+  /**
+   * \brief Set the number of threads to use
+   * \param nr_threads the number of hardware threads to use (0 sets the value back to
+   * automatic)
+   */
+  void
+  setNumberOfThreads(unsigned int nr_threads = 0)
+  {
+    threads_ = detail::resolveNumberOfThreads(nr_threads);
+  }
+
+  /**
+   * \brief Get the leaf size of a level
+   * \param level level number, 0 is the finest
+   * \return leaf size
+   */
+  float
+  getLeafSize(std::size_t level) const
+  {
+    float leaf_size = leaf_size_;
+    for (std::size_t i = 0; i < level; ++i)
+      leaf_size *= static_cast<float>(factor_);
+    return leaf_size;
+  }
+
+  /** \brief Number of levels computed so far. */
+  std::size_t
+  getNumberOfComputedLevels() const
+  {
+    return levels_.size();
+  }
+
+  /**
+   * \brief Get a level, computing it and all finer levels that are not computed yet
+   * \details The returned cloud is a span over storage of the pyramid, it stays valid
+   * until the input or parameters of the pyramid change.
+   * \param level level number, 0 is the finest
+   * \return voxel centroids of the level
+   * \throws pcl::InitFailedException if the input cloud is not set
+   */
+  typename PointCloud::ConstPtr
+  getLevel(std::size_t level)
+  {
+    if (!input_)
+      PCL_THROW_EXCEPTION(pcl::InitFailedException,
+                          "[pcl_cloud_span::VoxelPyramid::getLevel] Input cloud is "
+                          "not set");
+    while (levels_.size() <= level)
+      computeNextLevel();
+    return levels_[level].cloud;
+  }
+
+  /**
+   * \brief Get the number of input points in each voxel of a level
+   * \param level level number, 0 is the finest
+   * \return point counts in the order of points of the level
+   */
+  const std::vector<std::uint32_t>&
+  getPointCounts(std::size_t level)
+  {
+    getLevel(level);
+    return levels_[level].counts;
+  }
+
+private:
+  using PointVector =
+      std::vector<Spannable<PointT>, Eigen::aligned_allocator<Spannable<PointT>>>;
+
+  struct Level {
+    PointVector points;
+    std::vector<detail::VoxelKey> keys;
+    std::vector<std::uint32_t> counts;
+    typename PointCloud::Ptr cloud;
+  };
+
+  using Entry = std::pair<detail::VoxelKey, pcl::index_t>;
+
+  void
+  computeNextLevel()
+  {
+    if (averaged_.empty())
+      averaged_ = detail::getAveragedFieldOffsets<Spannable<PointT>>();
+
+    entries_.clear();
+    if (levels_.empty()) {
+      const float inverse_leaf_size = 1.f / leaf_size_;
+      for (std::size_t i = 0; i < input_->size(); ++i) {
+        detail::VoxelKey key;
+        if (detail::computeVoxelKey((*input_)[i], inverse_leaf_size, key))
+          entries_.emplace_back(key, static_cast<pcl::index_t>(i));
+      }
+      std::sort(entries_.begin(), entries_.end(), compareEntries);
+      accumulate(input_->data(), nullptr);
+    }
+    else {
+      const auto& finer = levels_.back();
+      const auto factor = static_cast<std::int32_t>(factor_);
+      entries_.resize(finer.keys.size());
+      for (std::size_t i = 0; i < finer.keys.size(); ++i)
+        entries_[i] = {detail::coarsenVoxelKey(finer.keys[i], factor),
+                       static_cast<pcl::index_t>(i)};
+      std::sort(entries_.begin(), entries_.end(), compareEntries);
+      accumulate(finer.points.data(), finer.counts.data());
+    }
+  }
+
+  static bool
+  compareEntries(const Entry& a, const Entry& b)
+  {
+    return a.first < b.first || (a.first == b.first && a.second < b.second);
+  }
+
+  /**
+   * \brief Average sorted entries into a new level
+   * \param points points referenced by entries
+   * \param counts number of input points represented by each point, nullptr for one
+   */
+  void
+  accumulate(const Spannable<PointT>* points, const std::uint32_t* counts)
+  {
+    group_begins_.clear();
+    for (std::size_t i = 0; i < entries_.size(); ++i)
+      if (i == 0 || entries_[i].first != entries_[i - 1].first)
+        group_begins_.push_back(i);
+    group_begins_.push_back(entries_.size());
+
+    levels_.emplace_back();
+    auto& level = levels_.back();
+    const auto nr_voxels = static_cast<std::ptrdiff_t>(group_begins_.size() - 1);
+    level.points.resize(group_begins_.size() - 1);
+    level.keys.resize(level.points.size());
+    level.counts.resize(level.points.size());
+
+#pragma omp parallel num_threads(threads_)
+    {
+      std::vector<double> sums(averaged_.size());
+#pragma omp for schedule(static)
+      for (std::ptrdiff_t i_voxel = 0; i_voxel < nr_voxels; ++i_voxel) {
+        const auto voxel = static_cast<std::size_t>(i_voxel);
+        const std::size_t begin = group_begins_[voxel];
+        const std::size_t end = group_begins_[voxel + 1];
+        std::fill(sums.begin(), sums.end(), 0.);
+        std::uint64_t total = 0;
+        for (std::size_t i = begin; i < end; ++i) {
+          const auto* point = reinterpret_cast<const std::uint8_t*>(
+              points + entries_[i].second);
+          const std::uint32_t count = counts ? counts[entries_[i].second] : 1;
+          for (std::size_t f = 0; f < averaged_.size(); ++f) {
+            float value;
+            std::memcpy(&value, point + averaged_[f], sizeof(float));
+            sums[f] += static_cast<double>(count) * static_cast<double>(value);
+          }
+          total += count;
+        }
+
+        auto& out = level.points[voxel];
+        out = points[entries_[begin].second];
+        auto* out_bytes = reinterpret_cast<std::uint8_t*>(&out);
+        for (std::size_t f = 0; f < averaged_.size(); ++f) {
+          const auto value = static_cast<float>(sums[f] / static_cast<double>(total));
+          std::memcpy(out_bytes + averaged_[f], &value, sizeof(float));
+        }
+        level.keys[voxel] = entries_[begin].first;
+        level.counts[voxel] = static_cast<std::uint32_t>(total);
+      }
+    }
+
+    detail::checkChunkSize(level.points.size());
+    level.cloud = makeCloudSpanPtr(reinterpret_cast<PointT*>(level.points.data()),
+                                   static_cast<std::uint32_t>(level.points.size()));
+    level.cloud->header = input_->header;
+    level.cloud->sensor_origin_ = input_->sensor_origin_;
+    level.cloud->sensor_orientation_ = input_->sensor_orientation_;
+  }
+
+  typename PointCloud::ConstPtr input_;
+  float leaf_size_ = 1.f;
+  unsigned int factor_ = 2;
+  unsigned int threads_ = 1;
+
+  std::deque<Level> levels_;
+  std::vector<std::uint32_t> averaged_;
+  std::vector<Entry> entries_;
+  std::vector<std::size_t> group_begins_;
+};
+
+} // namespace pcl_cloud_span
@@ -0,0 +1,335 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2023 Ilia Kovalev
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include <pcl_cloud_span/pcl_cloud_span.h>
+
+#include <pcl_cloud_span/compact.h>
+#include <pcl_cloud_span/selection.h>
+
+#include <pcl/filters/radius_outlier_removal.h>
+
+#include "impl/parallel.h"
+#include "impl/voxel_key.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace pcl_cloud_span {
+
+/**
+ * \brief pcl::RadiusOutlierRemoval for point cloud spans accelerated by a voxel grid
+ * \details Drop-in replacement of the PCL filter producing the same inliers. Points
+ * are binned into a grid with cells small enough for all points of a cell to be
+ * neighbors of each other. A cell with more points than the neighbor threshold
+ * consists of inliers only, and a cell whose 5x5x5 neighborhood has too few points
+ * consists of outliers only. Distances are computed per point only in the remaining
+ * cells and only until the threshold is reached. Cells and points are processed in
+ * parallel. As in PCL, the neighbor count includes the point itself and points with
+ * non-finite coordinates are outliers.
+ * \tparam PointT point type
+ */
+template <typename PointT>
+class RadiusOutlierRemoval : public pcl::RadiusOutlierRemoval<Spannable<PointT>> {
+  using Base = pcl::RadiusOutlierRemoval<Spannable<PointT>>;
+
+public:
+  using PointCloud = typename Base::PointCloud;
+
+  /**
+   * \brief Constructor
+   * \param extract_removed_indices set to true if the filtered data indices should be
+   * saved in a separate list
+   */
+  explicit RadiusOutlierRemoval(bool extract_removed_indices = false)
+  : Base(extract_removed_indices)
+  {}
+
+  /**
+   * \brief Set the number of threads to use
+   * \param nr_threads the number of hardware threads to use (0 sets the value back to
+   * automatic)
+   */
+  void
+  setNumberOfThreads(unsigned int nr_threads = 0)
+  {
+    threads_ = detail::resolveNumberOfThreads(nr_threads);
+  }
+
+  /**
+   * \brief Filter a span in place
+   * \details The span becomes the input cloud, inliers are moved to the front of its
+   * buffer in their original order.
+   * \param cloud point cloud span to filter
+   * \return point cloud span over inliers at the beginning of the buffer of `cloud`
+   */
+  PointCloud
+  filterInPlace(const typename PointCloud::Ptr& cloud)
+  {
+    this->setInputCloud(cloud);
+    this->filter(inliers_);
+    if (!std::is_sorted(inliers_.begin(), inliers_.end()))
+      std::sort(inliers_.begin(), inliers_.end());
+    return compactInPlace(*cloud, inliers_);
+  }
+
+  /**
+   * \brief Filter the selected points of a span deselecting the rejected ones
+   * \details Selected points become the indices of the filter, unselected points stay
+   * unselected and are only considered as neighbors. Selections of several filters can
+   * be chained or combined and compacted once.
+   * \param cloud point cloud span to filter
+   * \param selection selection of points of the cloud to refine
+   * \throws pcl::BadArgumentException if the selection size differs from the cloud size
+   */
+  void
+  filterSelection(const typename PointCloud::ConstPtr& cloud, PointSelection& selection)
+  {
+    detail::filterSelection(*this, cloud, selection, selected_, inliers_, threads_);
+  }
+
+protected:
+  using Base::applyFilter;
+
+  /**
+   * \brief Filtered results are indexed by an indices array
+   * \param indices the resultant point cloud indices
+   */
+  void
+  applyFilter(pcl::Indices& indices) override
+  {
+    if (!(this->search_radius_ > 0)) {
+      PCL_ERROR("[pcl_cloud_span::RadiusOutlierRemoval::applyFilter] No radius "
+                "defined!\n");
+      indices.clear();
+      this->removed_indices_->clear();
+      return;
+    }
+    if (!buildGrid()) {
+      PCL_WARN("[pcl_cloud_span::RadiusOutlierRemoval::applyFilter] Radius is too "
+               "small for the grid, falling back to radius search\n");
+      Base::applyFilter(indices);
+      return;
+    }
+    classifyCells();
+
+    const auto& input_indices = *this->indices_;
+    const auto size = static_cast<std::ptrdiff_t>(input_indices.size());
+    inlier_.resize(input_indices.size());
+#pragma omp parallel for num_threads(threads_) schedule(dynamic, 256)
+    for (std::ptrdiff_t i = 0; i < size; ++i) {
+      const auto index = static_cast<std::size_t>(i);
+      const auto cell = point_cells_[static_cast<std::size_t>(input_indices[index])];
+      if (cell < 0)
+        inlier_[index] = false;
+      else if (cell_states_[static_cast<std::size_t>(cell)] != CellState::mixed)
+        inlier_[index] =
+            cell_states_[static_cast<std::size_t>(cell)] == CellState::inliers;
+      else
+        inlier_[index] = hasEnoughNeighbors(input_indices[index]);
+    }
+
+    indices.resize(input_indices.size());
+    this->removed_indices_->resize(input_indices.size());
+    std::size_t oii = 0, rii = 0;
+    for (std::size_t i = 0; i < input_indices.size(); ++i) {
+      if (static_cast<bool>(inlier_[i]) == this->negative_) {
+        if (this->extract_removed_indices_)
+          (*this->removed_indices_)[rii++] = input_indices[i];
+        continue;
+      }
+      indices[oii++] = input_indices[i];
+    }
+    indices.resize(oii);
+    this->removed_indices_->resize(rii);
+  }
+
+private:
+  enum class CellState : std::uint8_t { inliers, outliers, mixed };
+
+  using Entry = std::pair<detail::VoxelKey, pcl::index_t>;
+
+  /** \brief Cells around a cell that may contain neighbors of its points. */
+  static constexpr std::int32_t reach_ = 2;
+
+  /** \brief Limit of cell coordinates keeping neighbor coordinates in range. */
+  static constexpr std::int32_t max_coordinate_ = 1 << 30;
+
+  /**
+   * \brief Bin all points of the input cloud into cells of the size r / sqrt(3)
+   * \details The grid is anchored at the minimum of the cloud and keys are computed in
+   * double, so cells have the same size for coordinates far from zero.
+   * \return false if coordinates of some finite point are out of the grid range
+   */
+  bool
+  buildGrid()
+  {
+    const auto& input = *this->input_;
+    const auto size = static_cast<std::ptrdiff_t>(input.size());
+    // slightly smaller than r / sqrt(3), so rounding of distances between points of
+    // one cell can not reach the radius
+    const double cell_size = this->search_radius_ / std::sqrt(3.) * 0.999;
+    const auto grid = detail::makeCellGrid(input, cell_size, threads_);
+
+    entries_.resize(input.size());
+    bool valid = true;
+#pragma omp parallel for num_threads(threads_) schedule(static) reduction(&& : valid)
+    for (std::ptrdiff_t i = 0; i < size; ++i) {
+      const auto& point = input[static_cast<std::size_t>(i)];
+      auto& entry = entries_[static_cast<std::size_t>(i)];
+      entry.second = static_cast<pcl::index_t>(i);
+      if (!detail::computeCellKey(point, grid, entry.first)) {
+        entry.second = -1;
+        valid = valid && !(std::isfinite(point.x) && std::isfinite(point.y) &&
+                           std::isfinite(point.z));
+      }
+      else {
+        const auto& key = entry.first;
+        valid = valid && std::abs(key.x) < max_coordinate_ &&
+                std::abs(key.y) < max_coordinate_ && std::abs(key.z) < max_coordinate_;
+      }
+    }
+    if (!valid)
+      return false;
+
+    entries_.erase(std::remove_if(entries_.begin(),
+                                  entries_.end(),
+                                  [](const Entry& entry) { return entry.second < 0; }),
+                   entries_.end());
+    detail::parallelSort(
+        entries_.begin(),
+        entries_.end(),
+        [](const Entry& a, const Entry& b) { return a.first < b.first; },
+        threads_);
+
+    cell_begins_.clear();
+    cells_.clear();
+    point_cells_.assign(input.size(), -1);
+    for (std::size_t i = 0; i < entries_.size(); ++i) {
+      if (i == 0 || entries_[i].first != entries_[i - 1].first) {
+        cells_.emplace(entries_[i].first, cell_begins_.size());
+        cell_begins_.push_back(i);
+      }
+      point_cells_[static_cast<std::size_t>(entries_[i].second)] =
+          static_cast<pcl::index_t>(cell_begins_.size() - 1);
+    }
+    cell_begins_.push_back(entries_.size());
+    return true;
+  }
+
+  /** \brief Decide cells where all points are inliers or all are outliers. */
+  void
+  classifyCells()
+  {
+    const auto min_pts = static_cast<std::size_t>(std::max(this->min_pts_radius_, 0));
+    const auto nr_cells = static_cast<std::ptrdiff_t>(cell_begins_.size() - 1);
+    cell_states_.resize(cell_begins_.size() - 1);
+#pragma omp parallel for num_threads(threads_) schedule(dynamic, 64)
+    for (std::ptrdiff_t i = 0; i < nr_cells; ++i) {
+      const auto cell = static_cast<std::size_t>(i);
+      if (cellSize(cell) > min_pts) {
+        cell_states_[cell] = CellState::inliers;
+        continue;
+      }
+      std::size_t total = 0;
+      forEachNeighborCell(entries_[cell_begins_[cell]].first,
+                          [&](std::size_t neighbor) { total += cellSize(neighbor); });
+      cell_states_[cell] = total > min_pts ? CellState::mixed : CellState::outliers;
+    }
+  }
+
+  /** \brief Check the neighbor count of a single point. */
+  bool
+  hasEnoughNeighbors(pcl::index_t index) const
+  {
+    const auto& input = *this->input_;
+    const auto& point = input[static_cast<std::size_t>(index)];
+    const auto min_pts = static_cast<std::size_t>(std::max(this->min_pts_radius_, 0));
+    // PCL compares distances of k nearest neighbors with the squared radius in double
+    // for dense clouds and uses FLANN radius search with a float squared radius
+    // (exclusive) otherwise
+    const double sqr_radius = this->search_radius_ * this->search_radius_;
+    const auto float_sqr_radius = static_cast<float>(sqr_radius);
+    const bool dense = input.is_dense;
+
+    std::size_t count = 0;
+    const auto point_cell =
+        static_cast<std::size_t>(point_cells_[static_cast<std::size_t>(index)]);
+    forEachNeighborCell(
+        entries_[cell_begins_[point_cell]].first, [&](std::size_t cell) {
+          if (count > min_pts)
+            return;
+          for (std::size_t i = cell_begins_[cell]; i < cell_begins_[cell + 1]; ++i) {
+            const auto& neighbor =
+                input[static_cast<std::size_t>(entries_[i].second)];
+            const float dx = point.x - neighbor.x;
+            const float dy = point.y - neighbor.y;
+            const float dz = point.z - neighbor.z;
+            const float sqr_distance = dx * dx + dy * dy + dz * dz;
+            if (dense ? static_cast<double>(sqr_distance) <= sqr_radius
+                      : sqr_distance < float_sqr_radius)
+              ++count;
+          }
+        });
+    return count > min_pts;
+  }
+
+  std::size_t
+  cellSize(std::size_t cell) const
+  {
+    return cell_begins_[cell + 1] - cell_begins_[cell];
+  }
+
+  template <typename Function>
+  void
+  forEachNeighborCell(const detail::VoxelKey& key, Function function) const
+  {
+    for (std::int32_t dx = -reach_; dx <= reach_; ++dx)
+      for (std::int32_t dy = -reach_; dy <= reach_; ++dy)
+        for (std::int32_t dz = -reach_; dz <= reach_; ++dz) {
+          const auto it = cells_.find({key.x + dx, key.y + dy, key.z + dz});
+          if (it != cells_.end())
+            function(it->second);
+        }
+  }
+
+  unsigned int threads_ = 1;
+
+  std::vector<Entry> entries_;
+  std::vector<std::size_t> cell_begins_;
+  std::unordered_map<detail::VoxelKey, std::size_t, detail::VoxelKeyHash> cells_;
+  std::vector<pcl::index_t> point_cells_;
+  std::vector<CellState> cell_states_;
+  std::vector<std::uint8_t> inlier_;
+  pcl::Indices inliers_;
+  pcl::IndicesPtr selected_;
+};
+
+} // namespace pcl_cloud_span
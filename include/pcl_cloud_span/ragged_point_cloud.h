@@ -0,0 +1,323 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2023 Ilia Kovalev
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include <pcl_cloud_span/pcl_cloud_span.h>
+
+#include <pcl/PCLHeader.h>
+#include <pcl/PointIndices.h>
+#include <pcl/exceptions.h>
+
+#include <Eigen/Core>
+
+#include "impl/parallel.h"
+#include "impl/point_count.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace pcl_cloud_span {
+
+/**
+ * \brief Collection of point clouds stored in one contiguous buffer
+ * \details Points of all clouds are stored back to back, cloud `i` occupies the range
+ * `[getOffsets()[i], getOffsets()[i + 1])` of the buffer. Every cloud is handed out as
+ * a point cloud span over the buffer, so processing many small clouds (e.g. clusters)
+ * needs no per-cloud allocations. Spans are invalidated when clouds are added to the
+ * collection.
+ * \tparam PointT point type
+ */
+template <typename PointT>
+class RaggedPointCloud {
+public:
+  using PointCloud = pcl::PointCloud<Spannable<PointT>>;
+  using VectorType =
+      std::vector<Spannable<PointT>, Eigen::aligned_allocator<Spannable<PointT>>>;
+
+  /** \brief Header assigned to point clouds handed out by the collection. */
+  pcl::PCLHeader header;
+
+  /** \brief Whether all points of all clouds are finite. */
+  bool is_dense = true;
+
+  /** \brief Number of clouds. */
+  std::size_t
+  size() const
+  {
+    return offsets_.size() - 1;
+  }
+
+  /** \brief Whether the collection has no clouds. */
+  bool
+  empty() const
+  {
+    return size() == 0;
+  }
+
+  /** \brief Total number of points of all clouds. */
+  std::size_t
+  getNumberOfPoints() const
+  {
+    return points_.size();
+  }
+
+  /**
+   * \brief Number of points of a cloud
+   * \param cloud cloud number
+   */
+  std::size_t
+  getCloudSize(std::size_t cloud) const
+  {
+    return offsets_[cloud + 1] - offsets_[cloud];
+  }
+
+  /**
+   * \brief Offsets of clouds in the buffer
+   * \return `size() + 1` offsets, the last one is the total number of points
+   */
+  const std::vector<std::size_t>&
+  getOffsets() const
+  {
+    return offsets_;
+  }
+
+  /** \brief Points of all clouds. */
+  const VectorType&
+  getPoints() const
+  {
+    return points_;
+  }
+
+  /**
+   * \brief Reserve memory
+   * \param nr_clouds expected number of clouds
+   * \param nr_points expected total number of points
+   */
+  void
+  reserve(std::size_t nr_clouds, std::size_t nr_points)
+  {
+    offsets_.reserve(nr_clouds + 1);
+    points_.reserve(nr_points);
+  }
+
+  /** \brief Remove all clouds keeping allocated memory. */
+  void
+  clear()
+  {
+    offsets_.resize(1);
+    points_.clear();
+    is_dense = true;
+  }
+
+  /**
+   * \brief Append a cloud with the given points
+   * \param first iterator to the first point
+   * \param last iterator past the last point
+   */
+  template <typename InputIt>
+  void
+  append(InputIt first, InputIt last)
+  {
+    for (; first != last; ++first)
+      points_.emplace_back(static_cast<const PointT&>(*first));
+    offsets_.push_back(points_.size());
+  }
+
+  /**
+   * \brief Append a cloud with all points of a point cloud
+   * \param cloud pcl::PointCloud or point cloud span
+   */
+  template <typename CloudT>
+  void
+  append(const CloudT& cloud)
+  {
+    is_dense = is_dense && cloud.is_dense;
+    append(cloud.begin(), cloud.end());
+  }
+
+  /**
+   * \brief Append a cloud with a subset of points of a point cloud
+   * \param cloud pcl::PointCloud or point cloud span
+   * \param indices indices of points to append
+   */
+  template <typename CloudT>
+  void
+  append(const CloudT& cloud, const pcl::Indices& indices)
+  {
+    is_dense = is_dense && cloud.is_dense;
+    for (const auto index : indices)
+      points_.emplace_back(
+          static_cast<const PointT&>(cloud[static_cast<std::size_t>(index)]));
+    offsets_.push_back(points_.size());
+  }
+
+  /**
+   * \brief Replace the collection with subsets of a point cloud
+   * \details All points are copied in parallel into a single allocation. Typical use is
+   * storing clusters returned by pcl::EuclideanClusterExtraction.
+   * \param cloud pcl::PointCloud or point cloud span
+   * \param clusters point indices of each cloud
+   * \param nr_threads number of threads to use (0 means the number of cores)
+   */
+  template <typename CloudT>
+  void
+  assign(const CloudT& cloud,
+         const std::vector<pcl::PointIndices>& clusters,
+         unsigned int nr_threads = 0)
+  {
+    offsets_.resize(clusters.size() + 1);
+    for (std::size_t i = 0; i < clusters.size(); ++i)
+      offsets_[i + 1] = offsets_[i] + clusters[i].indices.size();
+    points_.resize(offsets_.back());
+    header = cloud.header;
+    is_dense = cloud.is_dense;
+
+    const auto nr_clusters = static_cast<std::ptrdiff_t>(clusters.size());
+    const unsigned int threads = detail::resolveNumberOfThreads(nr_threads);
+#pragma omp parallel for num_threads(threads) schedule(dynamic, 16)
+    for (std::ptrdiff_t i = 0; i < nr_clusters; ++i) {
+      const auto cluster = static_cast<std::size_t>(i);
+      auto* out = points_.data() + offsets_[cluster];
+      for (const auto index : clusters[cluster].indices)
+        *out++ = Spannable<PointT>(
+            static_cast<const PointT&>(cloud[static_cast<std::size_t>(index)]));
+    }
+  }
+
+  /**
+   * \brief Replace the collection with subsets of a point cloud given as ranges of one
+   * index array
+   * \details Same as the overload taking pcl::PointIndices, for cluster extractors that
+   * return all clusters in one index array with an offset table.
+   * \param cloud pcl::PointCloud or point cloud span
+   * \param indices point indices of all clouds back to back
+   * \param offsets offsets of clouds in `indices`, the number of clouds plus one
+   * \param nr_threads number of threads to use (0 means the number of cores)
+   * \throws pcl::BadArgumentException if offsets are empty or out of range of indices
+   */
+  template <typename CloudT>
+  void
+  assign(const CloudT& cloud,
+         const pcl::Indices& indices,
+         const std::vector<std::size_t>& offsets,
+         unsigned int nr_threads = 0)
+  {
+    if (offsets.empty() || offsets.back() > indices.size() ||
+        !std::is_sorted(offsets.begin(), offsets.end()))
+      PCL_THROW_EXCEPTION(pcl::BadArgumentException,
+                          "Offsets do not describe ranges of indices");
+
+    offsets_.resize(offsets.size());
+    for (std::size_t i = 0; i < offsets.size(); ++i)
+      offsets_[i] = offsets[i] - offsets.front();
+    points_.resize(offsets_.back());
+    header = cloud.header;
+    is_dense = cloud.is_dense;
+
+    const auto size = static_cast<std::ptrdiff_t>(points_.size());
+    const auto* first = indices.data() + offsets.front();
+    const unsigned int threads = detail::resolveNumberOfThreads(nr_threads);
+#pragma omp parallel for num_threads(threads) schedule(static)
+    for (std::ptrdiff_t i = 0; i < size; ++i)
+      points_[static_cast<std::size_t>(i)] = Spannable<PointT>(
+          static_cast<const PointT&>(cloud[static_cast<std::size_t>(first[i])]));
+  }
+
+  /**
+   * \brief Get a cloud as a span over the buffer
+   * \param cloud cloud number
+   * \return point cloud span
+   * \throws pcl::BadArgumentException if the cloud exceeds the 32-bit width
+   */
+  PointCloud
+  at(std::size_t cloud)
+  {
+    detail::checkChunkSize(getCloudSize(cloud));
+    auto span = makeCloudSpan(reinterpret_cast<PointT*>(points_.data()) +
+                                  offsets_[cloud],
+                              static_cast<std::uint32_t>(getCloudSize(cloud)));
+    span.header = header;
+    span.is_dense = is_dense;
+    return span;
+  }
+
+  /**
+   * \brief Get a cloud as a shared span over the buffer, for PCL algorithms that take
+   * the input cloud by pointer
+   * \details Every call allocates a new span object, in loops over many small clouds
+   * re-target one pointer with the overload below instead.
+   * \param cloud cloud number
+   * \return pointer to point cloud span
+   * \throws pcl::BadArgumentException if the cloud exceeds the 32-bit width
+   */
+  typename PointCloud::Ptr
+  getCloudPtr(std::size_t cloud)
+  {
+    return std::make_shared<PointCloud>(at(cloud));
+  }
+
+  /**
+   * \brief Re-target a shared span to a cloud of the buffer without allocating
+   * \details The span object is allocated on the first call only. Algorithms holding
+   * the pointer see the new points, but search structures built for the previous cloud
+   * are not updated, so set the input cloud again.
+   * \param cloud cloud number
+   * \param span pointer to the span to re-target, allocated if null
+   * \throws pcl::BadArgumentException if the cloud exceeds the 32-bit width
+   */
+  void
+  getCloudPtr(std::size_t cloud, typename PointCloud::Ptr& span)
+  {
+    if (span)
+      *span = at(cloud);
+    else
+      span = std::make_shared<PointCloud>(at(cloud));
+  }
+
+  /**
+   * \brief Get all points of all clouds as one span
+   * \return point cloud span over the whole buffer
+   * \throws pcl::BadArgumentException if the buffer exceeds the 32-bit width
+   */
+  PointCloud
+  getAllPoints()
+  {
+    detail::checkChunkSize(points_.size());
+    auto span = makeCloudSpan(reinterpret_cast<PointT*>(points_.data()),
+                              static_cast<std::uint32_t>(points_.size()));
+    span.header = header;
+    span.is_dense = is_dense;
+    return span;
+  }
+
+private:
+  std::vector<std::size_t> offsets_ = {0};
+  VectorType points_;
+};
+
+} // namespace pcl_cloud_span
@@ -0,0 +1,427 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2023 Ilia Kovalev
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include <pcl_cloud_span/pcl_cloud_span.h>
+
+#include <pcl/exceptions.h>
+
+#include "impl/parallel.h"
+#include "impl/point_count.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <memory>
+#include <vector>
+
+namespace pcl_cloud_span {
+
+/**
+ * \brief Value of IndexImage pixels that no point was projected to
+ */
+constexpr pcl::index_t EMPTY_PIXEL = -1;
+
+/**
+ * \brief Image of point indices built by projecting a point cloud
+ * \details Each pixel stores the index of the closest point projected to it and the
+ * range of that point. Empty pixels have index EMPTY_PIXEL and infinite range.
+ * The image is meant to be allocated once and reused for every frame: projecting a
+ * cloud into an image of the same size does not allocate.
+ */
+struct IndexImage {
+  /** \brief Image width in pixels. */
+  std::uint32_t width = 0;
+  /** \brief Image height in pixels. */
+  std::uint32_t height = 0;
+  /** \brief Row-major point indices. */
+  pcl::Indices indices;
+  /** \brief Row-major point ranges. */
+  std::vector<float> ranges;
+
+  /**
+   * \brief Resize the image keeping allocated memory if the size is not changed
+   * \param width_ new image width
+   * \param height_ new image height
+   */
+  void
+  resize(std::uint32_t width_, std::uint32_t height_)
+  {
+    const auto pixels = static_cast<std::size_t>(width_) * height_;
+    indices.resize(pixels);
+    ranges.resize(pixels);
+    width = width_;
+    height = height_;
+  }
+
+  /**
+   * \brief Get index of the point projected to a pixel
+   * \param column pixel column
+   * \param row pixel row
+   * \return point index or EMPTY_PIXEL
+   */
+  pcl::index_t
+  at(std::uint32_t column, std::uint32_t row) const
+  {
+    return indices[static_cast<std::size_t>(row) * width + column];
+  }
+
+  /**
+   * \brief Get range of the point projected to a pixel
+   * \param column pixel column
+   * \param row pixel row
+   * \return point range or infinity for empty pixels
+   */
+  float
+  rangeAt(std::uint32_t column, std::uint32_t row) const
+  {
+    return ranges[static_cast<std::size_t>(row) * width + column];
+  }
+};
+
+/**
+ * \brief Spherical projection model of a rotating lidar
+ * \details Columns go along azimuth from `min_azimuth` to `max_azimuth`, rows go from
+ * `max_elevation` (top row) to `min_elevation`. Range is the euclidean distance from
+ * the sensor origin.
+ */
+class SphericalProjection {
+public:
+  /**
+   * \brief Create spherical projection
+   * \param width number of image columns
+   * \param height number of image rows
+   * \param min_elevation minimal elevation angle in radians
+   * \param max_elevation maximal elevation angle in radians
+   * \param min_azimuth minimal azimuth angle in radians
+   * \param max_azimuth maximal azimuth angle in radians
+   */
+  SphericalProjection(std::uint32_t width,
+                      std::uint32_t height,
+                      float min_elevation,
+                      float max_elevation,
+                      float min_azimuth = -static_cast<float>(M_PI),
+                      float max_azimuth = static_cast<float>(M_PI))
+  : width_(width)
+  , height_(height)
+  , columns_(static_cast<float>(width))
+  , rows_(static_cast<float>(height))
+  , min_azimuth_(min_azimuth)
+  , max_elevation_(max_elevation)
+  , column_scale_(static_cast<float>(width) / (max_azimuth - min_azimuth))
+  , row_scale_(static_cast<float>(height) / (max_elevation - min_elevation))
+  {
+    if (!(max_azimuth > min_azimuth) || !(max_elevation > min_elevation))
+      PCL_THROW_EXCEPTION(pcl::BadArgumentException,
+                          "Spherical projection has an empty field of view");
+  }
+
+  /** \brief Get image width. */
+  std::uint32_t
+  getWidth() const
+  {
+    return width_;
+  }
+
+  /** \brief Get image height. */
+  std::uint32_t
+  getHeight() const
+  {
+    return height_;
+  }
+
+  /**
+   * \brief Project a point to the image
+   * \param[in] x, y, z point coordinates in the sensor frame
+   * \param[out] pixel row-major pixel index
+   * \param[out] range distance from the sensor origin
+   * \return false if the point is out of the field of view or is not finite
+   */
+  bool
+  project(float x, float y, float z, std::uint32_t& pixel, float& range) const
+  {
+    range = std::sqrt(x * x + y * y + z * z);
+    const float column = (std::atan2(y, x) - min_azimuth_) * column_scale_;
+    const float row = (max_elevation_ - std::asin(z / range)) * row_scale_;
+    if (!(column >= 0.f && column < columns_ && row >= 0.f && row < rows_))
+      return false;
+    pixel =
+        static_cast<std::uint32_t>(row) * width_ + static_cast<std::uint32_t>(column);
+    return true;
+  }
+
+private:
+  std::uint32_t width_;
+  std::uint32_t height_;
+  float columns_;
+  float rows_;
+  float min_azimuth_;
+  float max_elevation_;
+  float column_scale_;
+  float row_scale_;
+};
+
+/**
+ * \brief Pinhole camera projection model
+ * \details The camera looks along the z axis, x goes to the right and y goes down.
+ * Range is the depth of a point (its z coordinate).
+ */
+class PinholeProjection {
+public:
+  /**
+   * \brief Create pinhole projection
+   * \param width number of image columns
+   * \param height number of image rows
+   * \param fx, fy focal lengths in pixels
+   * \param cx, cy principal point in pixels
+   */
+  PinholeProjection(std::uint32_t width,
+                    std::uint32_t height,
+                    float fx,
+                    float fy,
+                    float cx,
+                    float cy)
+  : width_(width)
+  , height_(height)
+  , columns_(static_cast<float>(width))
+  , rows_(static_cast<float>(height))
+  , fx_(fx)
+  , fy_(fy)
+  , cx_(cx)
+  , cy_(cy)
+  {}
+
+  /** \brief Get image width. */
+  std::uint32_t
+  getWidth() const
+  {
+    return width_;
+  }
+
+  /** \brief Get image height. */
+  std::uint32_t
+  getHeight() const
+  {
+    return height_;
+  }
+
+  /**
+   * \brief Project a point to the image
+   * \param[in] x, y, z point coordinates in the camera frame
+   * \param[out] pixel row-major pixel index
+   * \param[out] range depth of the point
+   * \return false if the point is out of the field of view or is not finite
+   */
+  bool
+  project(float x, float y, float z, std::uint32_t& pixel, float& range) const
+  {
+    range = z;
+    const float inv_z = 1.f / z;
+    const float column = fx_ * x * inv_z + cx_;
+    const float row = fy_ * y * inv_z + cy_;
+    if (!(z > 0.f && column >= 0.f && column < columns_ && row >= 0.f &&
+          row < rows_))
+      return false;
+    pixel =
+        static_cast<std::uint32_t>(row) * width_ + static_cast<std::uint32_t>(column);
+    return true;
+  }
+
+private:
+  std::uint32_t width_;
+  std::uint32_t height_;
+  float columns_;
+  float rows_;
+  float fx_;
+  float fy_;
+  float cx_;
+  float cy_;
+};
+
+/**
+ * \brief Builder of index images from point cloud spans
+ * \details Points are projected in parallel directly from the span. If several
+ * points fall into the same pixel, the closest one wins; ties are resolved in favour
+ * of the smaller point index, so the result does not depend on the number of threads.
+ * Memory used for the projection is kept between calls, so building images of the
+ * same size does not allocate.
+ * \tparam PointT point type
+ * \tparam ProjectionT projection model, e.g. SphericalProjection or PinholeProjection
+ */
+template <typename PointT, typename ProjectionT>
+class RangeImageProjector {
+public:
+  using PointCloudSpan = pcl::PointCloud<Spannable<PointT>>;
+
+  /**
+   * \brief Create projector
+   * \param projection projection model
+   */
+  explicit RangeImageProjector(const ProjectionT& projection) : projection_(projection)
+  {}
+
+  /** \brief Set projection model. */
+  void
+  setProjection(const ProjectionT& projection)
+  {
+    projection_ = projection;
+  }
+
+  /** \brief Get projection model. */
+  const ProjectionT&
+  getProjection() const
+  {
+    return projection_;
+  }
+
+  /**
+   * \brief Set range limits, points out of them are not projected
+   * \param min_range minimal range
+   * \param max_range maximal range
+   */
+  void
+  setRangeLimits(float min_range, float max_range)
+  {
+    min_range_ = std::max(min_range, 0.f);
+    max_range_ = max_range;
+  }
+
+  /**
+   * \brief Set the number of threads to use
+   * \param nr_threads the number of hardware threads to use (0 sets the value back to
+   * automatic)
+   */
+  void
+  setNumberOfThreads(unsigned int nr_threads = 0)
+  {
+    threads_ = detail::resolveNumberOfThreads(nr_threads);
+  }
+
+  /**
+   * \brief Project a point cloud span to an index image
+   * \param[in] cloud input point cloud span
+   * \param[out] image output image, resized to the projection size if needed
+   * \throws pcl::BadArgumentException if the cloud has more points than a chunk of
+   * makeCloudSpanChunks
+   */
+  void
+  project(const PointCloudSpan& cloud, IndexImage& image)
+  {
+    // cells pack point indices into 32 bits
+    detail::checkChunkSize(cloud.size());
+
+    image.resize(projection_.getWidth(), projection_.getHeight());
+    const auto pixels = static_cast<std::ptrdiff_t>(image.indices.size());
+    if (cells_size_ < static_cast<std::size_t>(pixels)) {
+      cells_.reset(new std::atomic<std::uint64_t>[pixels]);
+      cells_size_ = static_cast<std::size_t>(pixels);
+    }
+
+    const auto points = static_cast<std::ptrdiff_t>(cloud.size());
+    const std::ptrdiff_t blocks = (points + block_size - 1) / block_size;
+
+#pragma omp parallel num_threads(threads_)
+    {
+#pragma omp for schedule(static)
+      for (std::ptrdiff_t i = 0; i < pixels; ++i)
+        cells_[static_cast<std::size_t>(i)].store(empty_cell,
+                                                  std::memory_order_relaxed);
+
+#pragma omp for schedule(static)
+      for (std::ptrdiff_t block = 0; block < blocks; ++block)
+        projectBlock(
+            cloud, block * block_size, std::min(points, (block + 1) * block_size));
+
+#pragma omp for schedule(static)
+      for (std::ptrdiff_t i = 0; i < pixels; ++i) {
+        const auto pixel = static_cast<std::size_t>(i);
+        const std::uint64_t cell = cells_[pixel].load(std::memory_order_relaxed);
+        if (cell == empty_cell) {
+          image.indices[pixel] = EMPTY_PIXEL;
+          image.ranges[pixel] = std::numeric_limits<float>::infinity();
+          continue;
+        }
+        const auto range_bits = static_cast<std::uint32_t>(cell >> 32);
+        image.indices[pixel] = static_cast<pcl::index_t>(cell & 0xffffffffu);
+        std::memcpy(&image.ranges[pixel], &range_bits, sizeof(float));
+      }
+    }
+  }
+
+private:
+  static constexpr std::ptrdiff_t block_size = 64;
+  static constexpr std::uint64_t empty_cell = std::numeric_limits<std::uint64_t>::max();
+  static constexpr std::uint32_t invalid_pixel =
+      std::numeric_limits<std::uint32_t>::max();
+
+  /**
+   * \brief Project points [begin, end) and update pixels
+   * \details Projection is done for the whole block first, so it is a tight loop
+   * without memory side effects that the compiler can vectorize. Pixels are updated
+   * afterwards with an atomic minimum of range and index packed into 64 bits (bits of
+   * non-negative floats are ordered the same way as the floats).
+   */
+  void
+  projectBlock(const PointCloudSpan& cloud, std::ptrdiff_t begin, std::ptrdiff_t end)
+  {
+    std::uint32_t pixels[block_size];
+    float ranges[block_size];
+    const std::ptrdiff_t count = end - begin;
+
+    for (std::ptrdiff_t i = 0; i < count; ++i) {
+      const auto& point = cloud[static_cast<std::size_t>(begin + i)];
+      const bool valid =
+          projection_.project(point.x, point.y, point.z, pixels[i], ranges[i]);
+      if (!valid || !(ranges[i] >= min_range_ && ranges[i] <= max_range_))
+        pixels[i] = invalid_pixel;
+    }
+
+    for (std::ptrdiff_t i = 0; i < count; ++i) {
+      if (pixels[i] == invalid_pixel)
+        continue;
+      std::uint32_t range_bits;
+      std::memcpy(&range_bits, &ranges[i], sizeof(float));
+      const std::uint64_t value = (static_cast<std::uint64_t>(range_bits) << 32) |
+                                  static_cast<std::uint32_t>(begin + i);
+      auto& cell = cells_[pixels[i]];
+      std::uint64_t current = cell.load(std::memory_order_relaxed);
+      while (value < current &&
+             !cell.compare_exchange_weak(current, value, std::memory_order_relaxed)) {
+      }
+    }
+  }
+
+  ProjectionT projection_;
+  float min_range_ = 0.f;
+  float max_range_ = std::numeric_limits<float>::infinity();
+  unsigned int threads_ = 1;
+  std::unique_ptr<std::atomic<std::uint64_t>[]> cells_;
+  std::size_t cells_size_ = 0;
+};
+
+} // namespace pcl_cloud_span
@@ -0,0 +1,478 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2023 Ilia Kovalev
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include <pcl_cloud_span/pcl_cloud_span.h>
+
+#include <pcl/ModelCoefficients.h>
+#include <pcl/PointIndices.h>
+#include <pcl/exceptions.h>
+
+#include <Eigen/Eigenvalues>
+
+#include "impl/parallel.h"
+#include "impl/point_count.h"
+#include "impl/random.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <numeric>
+#include <utility>
+#include <vector>
+
+namespace pcl_cloud_span {
+
+/**
+ * \brief RANSAC plane segmentation of a point cloud span
+ * \details Span-aware replacement of pcl::SACSegmentation with pcl::SACMODEL_PLANE and
+ * pcl::SAC_RANSAC. Hypotheses are scored preemptively: all hypotheses are scored on a
+ * block of points, the better half survives and is scored on the next, twice larger
+ * block, until one hypothesis remains. After the first block the number of hypotheses
+ * is reduced to the number RANSAC needs for the requested probability with the best
+ * inlier ratio seen. Hypotheses are scored in parallel on contiguous coordinate arrays
+ * (a reusable scratch buffer with points in pseudo-random order) so that the inner
+ * loop is vectorized by the compiler.
+ *
+ * Inliers of the winning plane are selected from the span directly and the plane is
+ * refined by least squares over inliers read through their indices, so no points are
+ * copied for refinement. Results are deterministic for a given seed.
+ * \tparam PointT point type
+ */
+template <typename PointT>
+class PlaneSegmentation {
+public:
+  using PointCloud = pcl::PointCloud<Spannable<PointT>>;
+
+  /**
+   * \brief Set the distance to the plane for a point to be an inlier
+   * \param threshold distance threshold
+   */
+  void
+  setDistanceThreshold(double threshold)
+  {
+    threshold_ = threshold;
+  }
+
+  /**
+   * \brief Set the maximum number of plane hypotheses
+   * \param max_iterations maximum number of hypotheses, 1000 by default
+   */
+  void
+  setMaxIterations(int max_iterations)
+  {
+    max_iterations_ = std::max(max_iterations, 1);
+  }
+
+  /**
+   * \brief Set the probability of choosing at least one sample free from outliers
+   * \param probability probability, 0.99 by default
+   */
+  void
+  setProbability(double probability)
+  {
+    probability_ = probability;
+  }
+
+  /**
+   * \brief Set whether the plane is refined by least squares over its inliers
+   * \param optimize true (default) to refine the plane
+   */
+  void
+  setOptimizeCoefficients(bool optimize)
+  {
+    optimize_coefficients_ = optimize;
+  }
+
+  /**
+   * \brief Set the number of points in the first scoring block
+   * \param block_size number of points, 256 by default
+   */
+  void
+  setBlockSize(std::size_t block_size)
+  {
+    block_size_ = std::max<std::size_t>(block_size, 1);
+  }
+
+  /**
+   * \brief Set the seed of the random generator
+   * \param seed seed
+   */
+  void
+  setSeed(std::uint64_t seed)
+  {
+    seed_ = seed;
+  }
+
+  /**
+   * \brief Set the number of threads to use
+   * \param nr_threads the number of hardware threads to use (0 sets the value back to
+   * automatic)
+   */
+  void
+  setNumberOfThreads(unsigned int nr_threads = 0)
+  {
+    threads_ = detail::resolveNumberOfThreads(nr_threads);
+  }
+
+  /**
+   * \brief Segment the dominant plane
+   * \param cloud point cloud span
+   * \param inliers sorted indices of points closer to the plane than the threshold,
+   * empty if no plane is found
+   * \param coefficients plane coefficients [normal_x normal_y normal_z d] with a unit
+   * normal, empty if no plane is found
+   * \throws pcl::BadArgumentException if the cloud is too large for pcl::index_t
+   */
+  void
+  segment(const PointCloud& cloud,
+          pcl::PointIndices& inliers,
+          pcl::ModelCoefficients& coefficients)
+  {
+    inliers.header = coefficients.header = cloud.header;
+    inliers.indices.clear();
+    coefficients.values.clear();
+    detail::checkIndexable(cloud.size());
+
+    gatherPoints(cloud);
+    if (x_.size() < 3) {
+      PCL_ERROR("[pcl_cloud_span::PlaneSegmentation::segment] Not enough points\n");
+      return;
+    }
+    generateHypotheses();
+    if (planes_.empty()) {
+      PCL_ERROR("[pcl_cloud_span::PlaneSegmentation::segment] No valid model found\n");
+      return;
+    }
+    Plane plane = planes_[scoreHypotheses()];
+
+    selectInliers(cloud, plane, inliers.indices);
+    if (optimize_coefficients_ && inliers.indices.size() >= 3 &&
+        refine(cloud, inliers.indices, plane))
+      selectInliers(cloud, plane, inliers.indices);
+
+    coefficients.values = {plane[0], plane[1], plane[2], plane[3]};
+  }
+
+private:
+  using Plane = std::array<float, 4>;
+
+  /**
+   * \brief Copy finite coordinates into contiguous arrays in pseudo-random order
+   * \details Points are visited at `i * stride mod n`, which is a permutation when the
+   * stride and n are coprime. A stride close to n divided by the golden ratio spreads
+   * every prefix of the order evenly over the cloud, so the first scoring block does
+   * not consist of neighboring points of an organized or sequential cloud.
+   */
+  void
+  gatherPoints(const PointCloud& cloud)
+  {
+    finite_.clear();
+    for (std::size_t i = 0; i < cloud.size(); ++i) {
+      const auto& point = cloud[i];
+      if (std::isfinite(point.x) && std::isfinite(point.y) && std::isfinite(point.z))
+        finite_.push_back(static_cast<pcl::index_t>(i));
+    }
+
+    const std::size_t size = finite_.size();
+    auto stride = static_cast<std::size_t>(static_cast<double>(size) * 0.6180339887);
+    stride = std::max<std::size_t>(stride, 1);
+    while (greatestCommonDivisor(stride, size) > 1)
+      ++stride;
+
+    x_.resize(size);
+    y_.resize(size);
+    z_.resize(size);
+    // positions advance by modular additions within chunks, i * stride may overflow
+    constexpr std::size_t chunk_size = 4096;
+    const auto chunks =
+        static_cast<std::ptrdiff_t>((size + chunk_size - 1) / chunk_size);
+#pragma omp parallel for num_threads(threads_) schedule(static)
+    for (std::ptrdiff_t chunk = 0; chunk < chunks; ++chunk) {
+      const auto begin = static_cast<std::size_t>(chunk) * chunk_size;
+      const auto end = std::min(begin + chunk_size, size);
+      std::size_t position = multiplyModulo(begin, stride, size);
+      for (std::size_t i = begin; i < end; ++i) {
+        const auto& point = cloud[static_cast<std::size_t>(finite_[position])];
+        x_[i] = point.x;
+        y_[i] = point.y;
+        z_[i] = point.z;
+        position = addModulo(position, stride, size);
+      }
+    }
+  }
+
+  /** \brief Greatest common divisor, a if b is 0. */
+  static std::size_t
+  greatestCommonDivisor(std::size_t a, std::size_t b)
+  {
+    while (b != 0)
+      a = std::exchange(b, a % b);
+    return a;
+  }
+
+  /** \brief (a + b) mod m for a, b < m without overflow. */
+  static std::size_t
+  addModulo(std::size_t a, std::size_t b, std::size_t m)
+  {
+    return a >= m - b ? a - (m - b) : a + b;
+  }
+
+  /** \brief (a * b) mod m for b < m without overflow. */
+  static std::size_t
+  multiplyModulo(std::size_t a, std::size_t b, std::size_t m)
+  {
+    std::size_t result = 0;
+    for (a %= m; a > 0; a >>= 1) {
+      if (a & 1)
+        result = addModulo(result, b, m);
+      b = addModulo(b, b, m);
+    }
+    return result;
+  }
+
+  /** \brief Fit planes through pseudo-random triplets of points. */
+  void
+  generateHypotheses()
+  {
+    const auto nr_hypotheses = static_cast<std::ptrdiff_t>(max_iterations_);
+    const std::uint64_t size = x_.size();
+    planes_.resize(static_cast<std::size_t>(max_iterations_));
+    valid_.resize(static_cast<std::size_t>(max_iterations_));
+#pragma omp parallel for num_threads(threads_) schedule(static)
+    for (std::ptrdiff_t h = 0; h < nr_hypotheses; ++h) {
+      const auto hypothesis = static_cast<std::size_t>(h);
+      valid_[hypothesis] = false;
+      // a few attempts to draw a non-degenerate sample
+      for (std::uint64_t attempt = 0; attempt < 8 && !valid_[hypothesis]; ++attempt) {
+        const std::uint64_t counter = (hypothesis * 8 + attempt) * 3;
+        const auto i0 = detail::randomPriority(seed_, counter) % size;
+        const auto i1 = detail::randomPriority(seed_, counter + 1) % size;
+        const auto i2 = detail::randomPriority(seed_, counter + 2) % size;
+        if (i0 == i1 || i0 == i2 || i1 == i2)
+          continue;
+        const Eigen::Vector3f p0(x_[i0], y_[i0], z_[i0]);
+        const Eigen::Vector3f p1(x_[i1], y_[i1], z_[i1]);
+        const Eigen::Vector3f p2(x_[i2], y_[i2], z_[i2]);
+        const Eigen::Vector3f normal = (p1 - p0).cross(p2 - p0);
+        const float norm = normal.norm();
+        if (!(norm > std::numeric_limits<float>::epsilon()))
+          continue;
+        const Eigen::Vector3f unit = normal / norm;
+        planes_[hypothesis] = {unit.x(), unit.y(), unit.z(), -unit.dot(p0)};
+        valid_[hypothesis] = true;
+      }
+    }
+
+    std::size_t nr_valid = 0;
+    for (std::size_t h = 0; h < planes_.size(); ++h)
+      if (valid_[h])
+        planes_[nr_valid++] = planes_[h];
+    planes_.resize(nr_valid);
+  }
+
+  /** \brief Number of points of [begin, end) closer to the plane than threshold. */
+  std::size_t
+  countInliers(const Plane& plane, std::size_t begin, std::size_t end) const
+  {
+    const float a = plane[0], b = plane[1], c = plane[2], d = plane[3];
+    const auto threshold = static_cast<float>(threshold_);
+    const float* x = x_.data();
+    const float* y = y_.data();
+    const float* z = z_.data();
+    std::size_t count = 0;
+    for (std::size_t i = begin; i < end; ++i)
+      count += std::abs(a * x[i] + b * y[i] + c * z[i] + d) < threshold ? 1u : 0u;
+    return count;
+  }
+
+  /**
+   * \brief Preemptive scoring of hypotheses
+   * \return index of the winning hypothesis
+   */
+  std::size_t
+  scoreHypotheses()
+  {
+    order_.resize(planes_.size());
+    std::iota(order_.begin(), order_.end(), 0);
+    counts_.assign(planes_.size(), 0);
+
+    std::size_t alive = order_.size();
+    std::size_t block = block_size_;
+    std::size_t begin = 0;
+    bool first_block = true;
+    while (alive > 1 && begin < x_.size()) {
+      const std::size_t end = std::min(begin + block, x_.size());
+      const auto nr_alive = static_cast<std::ptrdiff_t>(alive);
+#pragma omp parallel for num_threads(threads_) schedule(static)
+      for (std::ptrdiff_t i = 0; i < nr_alive; ++i) {
+        const std::size_t hypothesis = order_[static_cast<std::size_t>(i)];
+        counts_[hypothesis] += countInliers(planes_[hypothesis], begin, end);
+      }
+
+      std::stable_sort(order_.begin(),
+                       order_.begin() + nr_alive,
+                       [this](std::size_t a, std::size_t b) {
+                         return counts_[a] > counts_[b];
+                       });
+      if (first_block) {
+        alive = std::min(alive, requiredHypotheses(end - begin));
+        first_block = false;
+      }
+      else
+        alive = (alive + 1) / 2;
+      begin = end;
+      block *= 2;
+    }
+    return order_[0];
+  }
+
+  /** \brief Number of hypotheses RANSAC needs given the best inlier ratio so far. */
+  std::size_t
+  requiredHypotheses(std::size_t block) const
+  {
+    const std::size_t best = counts_[order_[0]];
+    const double ratio = static_cast<double>(best) / static_cast<double>(block);
+    const double p_no_outliers = 1. - ratio * ratio * ratio;
+    if (!(p_no_outliers > 0))
+      return 1;
+    if (!(p_no_outliers < 1))
+      return order_.size();
+    const double required = std::ceil(std::log(1. - probability_) /
+                                      std::log(p_no_outliers));
+    return static_cast<std::size_t>(
+        std::max(1., std::min(required, static_cast<double>(order_.size()))));
+  }
+
+  /** \brief Select points of the span closer to the plane than threshold. */
+  void
+  selectInliers(const PointCloud& cloud, const Plane& plane, pcl::Indices& inliers)
+  {
+    const float a = plane[0], b = plane[1], c = plane[2], d = plane[3];
+    const auto threshold = static_cast<float>(threshold_);
+    const auto size = static_cast<std::ptrdiff_t>(finite_.size());
+    valid_.resize(finite_.size());
+#pragma omp parallel for num_threads(threads_) schedule(static)
+    for (std::ptrdiff_t i = 0; i < size; ++i) {
+      const auto index = static_cast<std::size_t>(i);
+      const auto& point = cloud[static_cast<std::size_t>(finite_[index])];
+      valid_[index] = std::abs(a * point.x + b * point.y + c * point.z + d) < threshold;
+    }
+
+    inliers.clear();
+    for (std::size_t i = 0; i < finite_.size(); ++i)
+      if (valid_[i])
+        inliers.push_back(finite_[i]);
+  }
+
+  /**
+   * \brief Least squares plane through inliers
+   * \details Sums are accumulated over fixed chunks of inliers and combined in order,
+   * so the result does not depend on the number of threads.
+   * \return false if the inliers do not define a plane
+   */
+  bool
+  refine(const PointCloud& cloud, const pcl::Indices& inliers, Plane& plane)
+  {
+    constexpr std::size_t chunk_size = 4096;
+    const std::size_t nr_chunks = (inliers.size() + chunk_size - 1) / chunk_size;
+    sums_.assign(nr_chunks * 9, 0.);
+
+    // shift coordinates by the first inlier for numerical stability
+    const auto& origin = cloud[static_cast<std::size_t>(inliers.front())];
+    const auto chunks = static_cast<std::ptrdiff_t>(nr_chunks);
+#pragma omp parallel for num_threads(threads_) schedule(static)
+    for (std::ptrdiff_t chunk = 0; chunk < chunks; ++chunk) {
+      const auto begin = static_cast<std::size_t>(chunk) * chunk_size;
+      double* sums = sums_.data() + begin / chunk_size * 9;
+      const std::size_t end = std::min(inliers.size(), begin + chunk_size);
+      for (std::size_t i = begin; i < end; ++i) {
+        const auto& point = cloud[static_cast<std::size_t>(inliers[i])];
+        const double x = point.x - origin.x;
+        const double y = point.y - origin.y;
+        const double z = point.z - origin.z;
+        sums[0] += x;
+        sums[1] += y;
+        sums[2] += z;
+        sums[3] += x * x;
+        sums[4] += x * y;
+        sums[5] += x * z;
+        sums[6] += y * y;
+        sums[7] += y * z;
+        sums[8] += z * z;
+      }
+    }
+
+    double total[9] = {};
+    for (std::size_t chunk = 0; chunk < nr_chunks; ++chunk)
+      for (std::size_t k = 0; k < 9; ++k)
+        total[k] += sums_[chunk * 9 + k];
+
+    const auto n = static_cast<double>(inliers.size());
+    const Eigen::Vector3d mean(total[0] / n, total[1] / n, total[2] / n);
+    Eigen::Matrix3d covariance;
+    covariance << total[3] / n, total[4] / n, total[5] / n, total[4] / n,
+        total[6] / n, total[7] / n, total[5] / n, total[7] / n, total[8] / n;
+    covariance -= mean * mean.transpose();
+
+    const Eigen::SelfAdjointEigenSolver<Eigen::Matrix3d> solver(covariance);
+    if (solver.info() != Eigen::Success)
+      return false;
+    Eigen::Vector3d normal = solver.eigenvectors().col(0);
+    // keep the orientation of the hypothesis
+    if (normal.dot(Eigen::Vector3d(plane[0], plane[1], plane[2])) < 0)
+      normal = -normal;
+    const Eigen::Vector3d centroid =
+        mean + Eigen::Vector3d(origin.x, origin.y, origin.z);
+    plane = {static_cast<float>(normal.x()),
+             static_cast<float>(normal.y()),
+             static_cast<float>(normal.z()),
+             static_cast<float>(-normal.dot(centroid))};
+    return true;
+  }
+
+  double threshold_ = 0;
+  int max_iterations_ = 1000;
+  double probability_ = 0.99;
+  bool optimize_coefficients_ = true;
+  std::size_t block_size_ = 256;
+  std::uint64_t seed_ = 0;
+  unsigned int threads_ = 1;
+
+  pcl::Indices finite_;
+  std::vector<float> x_;
+  std::vector<float> y_;
+  std::vector<float> z_;
+  std::vector<Plane> planes_;
+  std::vector<std::uint8_t> valid_;
+  std::vector<std::size_t> order_;
+  std::vector<std::size_t> counts_;
+  std::vector<double> sums_;
+};
+
+} // namespace pcl_cloud_span
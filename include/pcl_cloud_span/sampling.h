@@ -0,0 +1,439 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2023 Ilia Kovalev
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include <pcl_cloud_span/pcl_cloud_span.h>
+
+#include <pcl/exceptions.h>
+
+#include "impl/parallel.h"
+#include "impl/point_count.h"
+#include "impl/random.h"
+#include "impl/voxel_key.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace pcl_cloud_span {
+namespace detail {
+
+/** \brief Pair of a sort key and a point index. */
+using KeyedIndex = std::pair<std::uint64_t, std::uint64_t>;
+
+/** \brief Index of entries of ignored points. */
+constexpr std::uint64_t invalid_index = std::numeric_limits<std::uint64_t>::max();
+
+/** \brief Collect the indices of the first `count` entries in ascending order. */
+template <typename IndexT>
+void
+extractSortedIndices(const std::vector<KeyedIndex>& entries,
+                     std::size_t count,
+                     std::vector<IndexT>& indices)
+{
+  indices.resize(count);
+  for (std::size_t i = 0; i < count; ++i)
+    indices[i] = static_cast<IndexT>(entries[i].second);
+  std::sort(indices.begin(), indices.end());
+}
+
+} // namespace detail
+
+/**
+ * \brief Random sampling of a point cloud span returning point indices
+ * \details Every point gets a pseudo-random priority computed in parallel from the
+ * seed and its index, and the points with the smallest priorities are selected. The
+ * result is deterministic for a given seed regardless of the number of threads.
+ * \tparam PointT point type
+ */
+template <typename PointT>
+class RandomSampling {
+public:
+  using PointCloud = pcl::PointCloud<Spannable<PointT>>;
+
+  /**
+   * \brief Set the number of points to sample
+   * \param sample number of points
+   */
+  void
+  setSample(std::size_t sample)
+  {
+    sample_ = sample;
+  }
+
+  /**
+   * \brief Set the seed of the random generator
+   * \param seed seed
+   */
+  void
+  setSeed(std::uint64_t seed)
+  {
+    seed_ = seed;
+  }
+
+  /**
+   * \brief Set the number of threads to use
+   * \param nr_threads the number of hardware threads to use (0 sets the value back to
+   * automatic)
+   */
+  void
+  setNumberOfThreads(unsigned int nr_threads = 0)
+  {
+    threads_ = detail::resolveNumberOfThreads(nr_threads);
+  }
+
+  /**
+   * \brief Sample points
+   * \tparam IndexT pcl::index_t or std::uint64_t for LargeIndices
+   * \param cloud point cloud span
+   * \param indices indices of sampled points in ascending order, all points if the
+   * cloud has no more than the requested number of points
+   * \throws pcl::BadArgumentException if the cloud is too large for IndexT
+   */
+  template <typename IndexT>
+  void
+  sample(const PointCloud& cloud, std::vector<IndexT>& indices)
+  {
+    detail::checkIndexable<IndexT>(cloud.size());
+    const auto size = static_cast<std::ptrdiff_t>(cloud.size());
+    entries_.resize(cloud.size());
+#pragma omp parallel for num_threads(threads_) schedule(static)
+    for (std::ptrdiff_t i = 0; i < size; ++i)
+      entries_[static_cast<std::size_t>(i)] = {
+          detail::randomPriority(seed_, static_cast<std::uint64_t>(i)),
+          static_cast<std::uint64_t>(i)};
+
+    const std::size_t count = std::min(sample_, cloud.size());
+    std::nth_element(entries_.begin(),
+                     entries_.begin() + static_cast<std::ptrdiff_t>(count),
+                     entries_.end());
+    detail::extractSortedIndices(entries_, count, indices);
+  }
+
+private:
+  std::size_t sample_ = 0;
+  std::uint64_t seed_ = 0;
+  unsigned int threads_ = 1;
+  std::vector<detail::KeyedIndex> entries_;
+};
+
+/**
+ * \brief Uniform sampling of a point cloud span returning point indices
+ * \details Like pcl::UniformSampling, one point is selected in every voxel of a grid:
+ * the point closest to the voxel center, the one with the smallest index on ties.
+ * Points with non-finite coordinates are ignored. Keys are computed and sorted in
+ * parallel.
+ * \tparam PointT point type
+ */
+template <typename PointT>
+class UniformSampling {
+public:
+  using PointCloud = pcl::PointCloud<Spannable<PointT>>;
+
+  /**
+   * \brief Set the voxel size
+   * \param leaf_size voxel size
+   * \throws pcl::BadArgumentException if leaf size is not positive
+   */
+  void
+  setLeafSize(float leaf_size)
+  {
+    if (!(leaf_size > 0))
+      PCL_THROW_EXCEPTION(pcl::BadArgumentException, "Leaf size must be positive");
+    leaf_size_ = leaf_size;
+  }
+
+  /**
+   * \brief Set the number of threads to use
+   * \param nr_threads the number of hardware threads to use (0 sets the value back to
+   * automatic)
+   */
+  void
+  setNumberOfThreads(unsigned int nr_threads = 0)
+  {
+    threads_ = detail::resolveNumberOfThreads(nr_threads);
+  }
+
+  /**
+   * \brief Sample points
+   * \tparam IndexT pcl::index_t or std::uint64_t for LargeIndices
+   * \param cloud point cloud span
+   * \param indices indices of sampled points in ascending order
+   * \throws pcl::BadArgumentException if the cloud is too large for IndexT
+   */
+  template <typename IndexT>
+  void
+  sample(const PointCloud& cloud, std::vector<IndexT>& indices)
+  {
+    detail::checkIndexable<IndexT>(cloud.size());
+    // entries hold indices of the result type, pcl::index_t keeps them at 16 bytes
+    auto& entries = workspace(indices);
+    using KeyedIndex = typename std::decay_t<decltype(entries)>::value_type;
+    constexpr auto invalid = std::numeric_limits<IndexT>::max();
+    const auto size = static_cast<std::ptrdiff_t>(cloud.size());
+    const float inverse_leaf_size = 1.f / leaf_size_;
+    entries.resize(cloud.size());
+#pragma omp parallel for num_threads(threads_) schedule(static)
+    for (std::ptrdiff_t i = 0; i < size; ++i) {
+      const auto point = static_cast<std::size_t>(i);
+      auto& entry = entries[point];
+      entry.second =
+          detail::computeVoxelKey(cloud[point], inverse_leaf_size, entry.first)
+              ? static_cast<IndexT>(i)
+              : invalid;
+    }
+    entries.erase(
+        std::remove_if(entries.begin(),
+                       entries.end(),
+                       [](const KeyedIndex& entry) { return entry.second == invalid; }),
+        entries.end());
+    detail::parallelSort(
+        entries.begin(),
+        entries.end(),
+        [](const KeyedIndex& a, const KeyedIndex& b) { return a.first < b.first; },
+        threads_);
+
+    voxel_begins_.clear();
+    for (std::size_t i = 0; i < entries.size(); ++i)
+      if (i == 0 || entries[i].first != entries[i - 1].first)
+        voxel_begins_.push_back(i);
+    voxel_begins_.push_back(entries.size());
+
+    const auto nr_voxels = static_cast<std::ptrdiff_t>(voxel_begins_.size() - 1);
+    indices.resize(voxel_begins_.size() - 1);
+#pragma omp parallel for num_threads(threads_) schedule(static)
+    for (std::ptrdiff_t i_voxel = 0; i_voxel < nr_voxels; ++i_voxel) {
+      const auto voxel = static_cast<std::size_t>(i_voxel);
+      const auto& key = entries[voxel_begins_[voxel]].first;
+      const float cx = (static_cast<float>(key.x) + .5f) * leaf_size_;
+      const float cy = (static_cast<float>(key.y) + .5f) * leaf_size_;
+      const float cz = (static_cast<float>(key.z) + .5f) * leaf_size_;
+      IndexT best = invalid;
+      float best_distance = 0;
+      for (std::size_t i = voxel_begins_[voxel]; i < voxel_begins_[voxel + 1]; ++i) {
+        const IndexT index = entries[i].second;
+        const auto& point = cloud[static_cast<std::size_t>(index)];
+        const float dx = point.x - cx, dy = point.y - cy, dz = point.z - cz;
+        const float distance = dx * dx + dy * dy + dz * dz;
+        // ties are broken by the smaller index
+        if (best == invalid ||
+            std::make_pair(distance, index) < std::make_pair(best_distance, best)) {
+          best = index;
+          best_distance = distance;
+        }
+      }
+      indices[voxel] = best;
+    }
+    std::sort(indices.begin(), indices.end());
+  }
+
+private:
+  template <typename IndexT>
+  using Entry = std::pair<detail::VoxelKey, IndexT>;
+
+  std::vector<Entry<pcl::index_t>>&
+  workspace(const pcl::Indices&)
+  {
+    return entries_;
+  }
+
+  std::vector<Entry<std::uint64_t>>&
+  workspace(const LargeIndices&)
+  {
+    return large_entries_;
+  }
+
+  float leaf_size_ = 1.f;
+  unsigned int threads_ = 1;
+  std::vector<Entry<pcl::index_t>> entries_;
+  std::vector<Entry<std::uint64_t>> large_entries_;
+  std::vector<std::size_t> voxel_begins_;
+};
+
+/**
+ * \brief Normal space sampling of a point cloud span returning point indices
+ * \details Like pcl::NormalSpaceSampling, normals are binned into a grid over the
+ * normal space and points are drawn from all bins as evenly as possible, so that
+ * points with rare normal directions are preserved. Points are drawn from each bin in
+ * pseudo-random order given by the seed; the result does not depend on the number of
+ * threads. Points with non-finite normals are ignored.
+ * \tparam NormalT point type with normal_x, normal_y and normal_z fields
+ */
+template <typename NormalT>
+class NormalSpaceSampling {
+public:
+  using NormalCloud = pcl::PointCloud<Spannable<NormalT>>;
+
+  /**
+   * \brief Set the number of points to sample
+   * \param sample number of points
+   */
+  void
+  setSample(std::size_t sample)
+  {
+    sample_ = sample;
+  }
+
+  /**
+   * \brief Set the seed of the random generator
+   * \param seed seed
+   */
+  void
+  setSeed(std::uint64_t seed)
+  {
+    seed_ = seed;
+  }
+
+  /**
+   * \brief Set the number of bins along each axis of the normal space
+   * \param binsx number of bins along x
+   * \param binsy number of bins along y
+   * \param binsz number of bins along z
+   * \throws pcl::BadArgumentException if a number of bins is zero
+   */
+  void
+  setBins(unsigned int binsx, unsigned int binsy, unsigned int binsz)
+  {
+    if (binsx == 0 || binsy == 0 || binsz == 0)
+      PCL_THROW_EXCEPTION(pcl::BadArgumentException,
+                          "Number of bins must be positive");
+    binsx_ = binsx;
+    binsy_ = binsy;
+    binsz_ = binsz;
+  }
+
+  /**
+   * \brief Set the number of threads to use
+   * \param nr_threads the number of hardware threads to use (0 sets the value back to
+   * automatic)
+   */
+  void
+  setNumberOfThreads(unsigned int nr_threads = 0)
+  {
+    threads_ = detail::resolveNumberOfThreads(nr_threads);
+  }
+
+  /**
+   * \brief Sample points
+   * \tparam IndexT pcl::index_t or std::uint64_t for LargeIndices
+   * \param normals normals of the points
+   * \param indices indices of sampled points in ascending order
+   * \throws pcl::BadArgumentException if the cloud is too large for IndexT
+   */
+  template <typename IndexT>
+  void
+  sample(const NormalCloud& normals, std::vector<IndexT>& indices)
+  {
+    detail::checkIndexable<IndexT>(normals.size());
+    // sort key: bin number in the high bits, random priority in the low bits
+    const auto size = static_cast<std::ptrdiff_t>(normals.size());
+    entries_.resize(normals.size());
+#pragma omp parallel for num_threads(threads_) schedule(static)
+    for (std::ptrdiff_t i = 0; i < size; ++i) {
+      const auto& normal = normals[static_cast<std::size_t>(i)];
+      auto& entry = entries_[static_cast<std::size_t>(i)];
+      entry.second = detail::invalid_index;
+      if (!std::isfinite(normal.normal_x) || !std::isfinite(normal.normal_y) ||
+          !std::isfinite(normal.normal_z))
+        continue;
+      const std::uint64_t bin =
+          (binIndex(normal.normal_x, binsx_) * binsy_ +
+           binIndex(normal.normal_y, binsy_)) *
+              binsz_ +
+          binIndex(normal.normal_z, binsz_);
+      entry.first = (bin << bin_shift_) |
+                    (detail::randomPriority(seed_, static_cast<std::uint64_t>(i)) >>
+                     (64 - bin_shift_));
+      entry.second = static_cast<std::uint64_t>(i);
+    }
+    entries_.erase(std::remove_if(entries_.begin(),
+                                  entries_.end(),
+                                  [](const detail::KeyedIndex& entry) {
+                                    return entry.second == detail::invalid_index;
+                                  }),
+                   entries_.end());
+    detail::parallelSort(entries_.begin(),
+                         entries_.end(),
+                         std::less<detail::KeyedIndex>(),
+                         threads_);
+
+    bin_begins_.clear();
+    for (std::size_t i = 0; i < entries_.size(); ++i)
+      if (i == 0 || (entries_[i].first >> bin_shift_) !=
+                        (entries_[i - 1].first >> bin_shift_))
+        bin_begins_.push_back(i);
+    bin_begins_.push_back(entries_.size());
+
+    // Draw points in rounds, one point from every non-empty bin per round. Entries are
+    // reordered by (round, random priority of the bin's point), so the sample is a
+    // prefix of them.
+    const auto nr_bins = static_cast<std::ptrdiff_t>(bin_begins_.size() - 1);
+#pragma omp parallel for num_threads(threads_) schedule(static)
+    for (std::ptrdiff_t i_bin = 0; i_bin < nr_bins; ++i_bin) {
+      const auto bin = static_cast<std::size_t>(i_bin);
+      for (std::size_t i = bin_begins_[bin]; i < bin_begins_[bin + 1]; ++i) {
+        const std::uint64_t round = i - bin_begins_[bin];
+        const std::uint64_t priority_mask = (std::uint64_t{1} << bin_shift_) - 1;
+        entries_[i].first = (round << bin_shift_) | (entries_[i].first & priority_mask);
+      }
+    }
+    const std::size_t count = std::min(sample_, entries_.size());
+    if (count < entries_.size())
+      std::nth_element(entries_.begin(),
+                       entries_.begin() + static_cast<std::ptrdiff_t>(count),
+                       entries_.end());
+    detail::extractSortedIndices(entries_, count, indices);
+  }
+
+private:
+  /** \brief Number of low bits of sort keys holding random priorities. */
+  static constexpr unsigned int bin_shift_ = 32;
+
+  static std::uint64_t
+  binIndex(float value, unsigned int bins)
+  {
+    const auto bin = static_cast<std::int64_t>(std::floor((value + 1.f) * .5f *
+                                                          static_cast<float>(bins)));
+    return static_cast<std::uint64_t>(
+        std::min<std::int64_t>(std::max<std::int64_t>(bin, 0), bins - 1));
+  }
+
+  std::size_t sample_ = 0;
+  std::uint64_t seed_ = 0;
+  unsigned int binsx_ = 4;
+  unsigned int binsy_ = 4;
+  unsigned int binsz_ = 4;
+  unsigned int threads_ = 1;
+  std::vector<detail::KeyedIndex> entries_;
+  std::vector<std::size_t> bin_begins_;
+};
+
+} // namespace pcl_cloud_span
@@ -0,0 +1,566 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2023 Ilia Kovalev
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include <pcl_cloud_span/pcl_cloud_span.h>
+
+#include <pcl/exceptions.h>
+#include <pcl/pcl_base.h>
+#include <pcl/types.h>
+
+#include <Eigen/Core>
+
+#include "impl/field_access.h"
+#include "impl/parallel.h"
+#include "impl/point_count.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace pcl_cloud_span {
+namespace detail {
+
+/** \brief Number of points per word of a selection bitmask. */
+constexpr std::size_t selection_word_bits = 64;
+
+/** \brief Number of words of a selection processed by one parallel task. */
+constexpr std::size_t selection_block_words = 1024;
+
+inline unsigned int
+popcount(std::uint64_t word)
+{
+#if defined(__GNUC__) || defined(__clang__)
+  return static_cast<unsigned int>(__builtin_popcountll(word));
+#else
+  word = word - ((word >> 1) & 0x5555555555555555ull);
+  word = (word & 0x3333333333333333ull) + ((word >> 2) & 0x3333333333333333ull);
+  word = (word + (word >> 4)) & 0x0f0f0f0f0f0f0f0full;
+  return static_cast<unsigned int>((word * 0x0101010101010101ull) >> 56);
+#endif
+}
+
+/** \brief Position of the lowest set bit of a non-zero word. */
+inline unsigned int
+lowestBit(std::uint64_t word)
+{
+#if defined(__GNUC__) || defined(__clang__)
+  return static_cast<unsigned int>(__builtin_ctzll(word));
+#else
+  return popcount((word & (~word + 1)) - 1);
+#endif
+}
+
+} // namespace detail
+
+/**
+ * \brief Selection of points of a cloud stored as a bitmask
+ * \details Point-local filters write their decisions into a selection instead of
+ * compacting an output cloud, selections of several filters are combined word by word
+ * and the points are compacted or their indices extracted once at the end. Bits past
+ * the number of points are always zero.
+ */
+class PointSelection {
+public:
+  PointSelection() = default;
+
+  /**
+   * \brief Create a selection
+   * \param size number of points
+   * \param value whether all points are selected
+   */
+  explicit PointSelection(std::size_t size, bool value = false) { assign(size, value); }
+
+  /**
+   * \brief Resize the selection setting all points to the same value
+   * \param size number of points
+   * \param value whether all points are selected
+   */
+  void
+  assign(std::size_t size, bool value = false)
+  {
+    size_ = size;
+    const std::size_t nr_words =
+        (size + detail::selection_word_bits - 1) / detail::selection_word_bits;
+    words_.assign(nr_words, value ? ~std::uint64_t{0} : 0);
+    clearTail();
+  }
+
+  /** \brief Number of points. */
+  std::size_t
+  size() const
+  {
+    return size_;
+  }
+
+  bool
+  empty() const
+  {
+    return size_ == 0;
+  }
+
+  /** \brief Number of 64-bit words, point `i` is bit `i % 64` of word `i / 64`. */
+  std::size_t
+  getNumberOfWords() const
+  {
+    return words_.size();
+  }
+
+  std::uint64_t*
+  data()
+  {
+    return words_.data();
+  }
+
+  const std::uint64_t*
+  data() const
+  {
+    return words_.data();
+  }
+
+  /** \brief Whether a point is selected. */
+  bool
+  test(std::size_t index) const
+  {
+    return (words_[index / detail::selection_word_bits] >>
+            (index % detail::selection_word_bits)) &
+           1u;
+  }
+
+  /**
+   * \brief Select or deselect a point
+   * \param index point index
+   * \param value whether the point is selected
+   */
+  void
+  set(std::size_t index, bool value = true)
+  {
+    const std::uint64_t bit = std::uint64_t{1} << (index % detail::selection_word_bits);
+    auto& word = words_[index / detail::selection_word_bits];
+    word = value ? word | bit : word & ~bit;
+  }
+
+  /**
+   * \brief Select points
+   * \param indices indices of points to select
+   */
+  void
+  set(const pcl::Indices& indices)
+  {
+    for (const auto index : indices)
+      set(static_cast<std::size_t>(index));
+  }
+
+  /** \brief Invert the selection. */
+  void
+  flip()
+  {
+    for (auto& word : words_)
+      word = ~word;
+    clearTail();
+  }
+
+  /**
+   * \brief Keep points selected in both selections
+   * \throws pcl::BadArgumentException if sizes differ
+   */
+  PointSelection&
+  operator&=(const PointSelection& other)
+  {
+    checkSize(other);
+    for (std::size_t i = 0; i < words_.size(); ++i)
+      words_[i] &= other.words_[i];
+    return *this;
+  }
+
+  /**
+   * \brief Add points selected in another selection
+   * \throws pcl::BadArgumentException if sizes differ
+   */
+  PointSelection&
+  operator|=(const PointSelection& other)
+  {
+    checkSize(other);
+    for (std::size_t i = 0; i < words_.size(); ++i)
+      words_[i] |= other.words_[i];
+    return *this;
+  }
+
+  /**
+   * \brief Remove points selected in another selection
+   * \throws pcl::BadArgumentException if sizes differ
+   */
+  PointSelection&
+  subtract(const PointSelection& other)
+  {
+    checkSize(other);
+    for (std::size_t i = 0; i < words_.size(); ++i)
+      words_[i] &= ~other.words_[i];
+    return *this;
+  }
+
+  /** \brief Number of selected points. */
+  std::size_t
+  count() const
+  {
+    std::size_t count = 0;
+    for (const auto word : words_)
+      count += detail::popcount(word);
+    return count;
+  }
+
+  /**
+   * \brief Extract indices of selected points
+   * \tparam IndexT pcl::index_t or std::uint64_t for LargeIndices
+   * \param indices indices of selected points in ascending order
+   * \param nr_threads number of threads to use (0 means the number of cores)
+   * \throws pcl::BadArgumentException if indices of the points exceed IndexT
+   */
+  template <typename IndexT>
+  void
+  toIndices(std::vector<IndexT>& indices, unsigned int nr_threads = 0) const
+  {
+    detail::checkIndexable<IndexT>(size_);
+    const std::size_t nr_blocks =
+        (words_.size() + detail::selection_block_words - 1) /
+        detail::selection_block_words;
+    const auto blocks = static_cast<std::ptrdiff_t>(nr_blocks);
+    std::vector<std::size_t> offsets(nr_blocks + 1, 0);
+    const unsigned int threads = detail::resolveNumberOfThreads(nr_threads);
+#pragma omp parallel for num_threads(threads) schedule(static)
+    for (std::ptrdiff_t i_block = 0; i_block < blocks; ++i_block) {
+      const auto block = static_cast<std::size_t>(i_block);
+      offsets[block + 1] = countWords(block);
+    }
+    for (std::size_t block = 0; block < nr_blocks; ++block)
+      offsets[block + 1] += offsets[block];
+
+    indices.resize(offsets.back());
+#pragma omp parallel for num_threads(threads) schedule(static)
+    for (std::ptrdiff_t i_block = 0; i_block < blocks; ++i_block) {
+      const auto block = static_cast<std::size_t>(i_block);
+      auto* out = indices.data() + offsets[block];
+      forEachWord(block, [&](std::size_t w) {
+        for (auto word = words_[w]; word != 0; word &= word - 1)
+          *out++ = static_cast<IndexT>(w * detail::selection_word_bits +
+                                       detail::lowestBit(word));
+      });
+    }
+  }
+
+private:
+  void
+  clearTail()
+  {
+    const std::size_t tail = size_ % detail::selection_word_bits;
+    if (tail != 0)
+      words_.back() &= (std::uint64_t{1} << tail) - 1;
+  }
+
+  void
+  checkSize(const PointSelection& other) const
+  {
+    if (other.size_ != size_)
+      PCL_THROW_EXCEPTION(pcl::BadArgumentException,
+                          "Selections of " << size_ << " and " << other.size_
+                                           << " points can not be combined");
+  }
+
+  template <typename Function>
+  void
+  forEachWord(std::size_t block, Function function) const
+  {
+    const std::size_t begin = block * detail::selection_block_words;
+    const std::size_t end =
+        std::min(words_.size(), begin + detail::selection_block_words);
+    for (std::size_t w = begin; w < end; ++w)
+      function(w);
+  }
+
+  std::size_t
+  countWords(std::size_t block) const
+  {
+    std::size_t count = 0;
+    forEachWord(block, [&](std::size_t w) { count += detail::popcount(words_[w]); });
+    return count;
+  }
+
+  std::size_t size_ = 0;
+  std::vector<std::uint64_t> words_;
+};
+
+/** \brief Points selected in both selections. */
+inline PointSelection
+operator&(PointSelection a, const PointSelection& b)
+{
+  return a &= b;
+}
+
+/** \brief Points selected in any of selections. */
+inline PointSelection
+operator|(PointSelection a, const PointSelection& b)
+{
+  return a |= b;
+}
+
+/** \brief Points not selected. */
+inline PointSelection
+operator~(PointSelection a)
+{
+  a.flip();
+  return a;
+}
+
+/**
+ * \brief Select points of a cloud satisfying a predicate
+ * \details Points are tested in parallel, every task writes whole words of the mask.
+ * \param cloud pcl::PointCloud or point cloud span
+ * \param predicate function taking a point and returning whether to select it
+ * \param selection selection resized to the cloud
+ * \param nr_threads number of threads to use (0 means the number of cores)
+ */
+template <typename CloudT, typename Predicate>
+void
+selectPoints(const CloudT& cloud,
+             Predicate predicate,
+             PointSelection& selection,
+             unsigned int nr_threads = 0)
+{
+  selection.assign(cloud.size());
+  const auto nr_words = static_cast<std::ptrdiff_t>(selection.getNumberOfWords());
+  auto* words = selection.data();
+  const unsigned int threads = detail::resolveNumberOfThreads(nr_threads);
+#pragma omp parallel for num_threads(threads) schedule(static)
+  for (std::ptrdiff_t w = 0; w < nr_words; ++w) {
+    const std::size_t begin = static_cast<std::size_t>(w) * detail::selection_word_bits;
+    const std::size_t end = std::min(cloud.size(), begin + detail::selection_word_bits);
+    std::uint64_t word = 0;
+    for (std::size_t i = begin; i < end; ++i)
+      word |= static_cast<std::uint64_t>(predicate(cloud[i]) ? 1 : 0) << (i - begin);
+    words[w] = word;
+  }
+}
+
+/**
+ * \brief Deselect points of a cloud not satisfying a predicate
+ * \details The predicate is evaluated only for selected points, so chaining filters
+ * costs less with every stage. Words without selected points are skipped.
+ * \param cloud pcl::PointCloud or point cloud span
+ * \param predicate function taking a point and returning whether to keep it
+ * \param selection selection of points of the cloud to refine
+ * \param nr_threads number of threads to use (0 means the number of cores)
+ * \throws pcl::BadArgumentException if the selection size differs from the cloud size
+ */
+template <typename CloudT, typename Predicate>
+void
+refineSelection(const CloudT& cloud,
+                Predicate predicate,
+                PointSelection& selection,
+                unsigned int nr_threads = 0)
+{
+  if (selection.size() != cloud.size())
+    PCL_THROW_EXCEPTION(pcl::BadArgumentException,
+                        "Selection size does not match the cloud");
+  const auto nr_words = static_cast<std::ptrdiff_t>(selection.getNumberOfWords());
+  auto* words = selection.data();
+  const unsigned int threads = detail::resolveNumberOfThreads(nr_threads);
+#pragma omp parallel for num_threads(threads) schedule(static)
+  for (std::ptrdiff_t w = 0; w < nr_words; ++w) {
+    const std::size_t begin = static_cast<std::size_t>(w) * detail::selection_word_bits;
+    std::uint64_t word = words[w];
+    for (auto bits = word; bits != 0; bits &= bits - 1) {
+      const unsigned int bit = detail::lowestBit(bits);
+      if (!predicate(cloud[begin + bit]))
+        word &= ~(std::uint64_t{1} << bit);
+    }
+    words[w] = word;
+  }
+}
+
+namespace detail {
+
+/**
+ * \brief Deselect points of a cloud rejected by a PCL filter
+ * \details Selected points become the indices of the filter, so only they are
+ * classified while neighbors are searched in the whole cloud, as with
+ * `pcl::Filter::setIndices`. The filter keeps the cloud and these indices.
+ * \param filter filter with `setInputCloud`, `setIndices` and `filter(pcl::Indices&)`
+ * \param cloud point cloud to filter
+ * \param selection selection of points of the cloud to refine
+ * \param selected storage for indices of selected points, reused between calls
+ * \param inliers storage for indices of points passing the filter
+ * \param nr_threads number of threads to use (0 means the number of cores)
+ * \throws pcl::BadArgumentException if the selection size differs from the cloud size
+ */
+template <typename Filter, typename CloudPtr>
+void
+filterSelection(Filter& filter,
+                const CloudPtr& cloud,
+                PointSelection& selection,
+                pcl::IndicesPtr& selected,
+                pcl::Indices& inliers,
+                unsigned int nr_threads = 0)
+{
+  if (selection.size() != cloud->size())
+    PCL_THROW_EXCEPTION(pcl::BadArgumentException,
+                        "Selection size does not match the cloud");
+  if (!selected)
+    selected = std::make_shared<pcl::Indices>();
+  selection.toIndices(*selected, nr_threads);
+  filter.setInputCloud(cloud);
+  filter.setIndices(selected);
+  filter.filter(inliers);
+  selection.assign(cloud->size());
+  selection.set(inliers);
+}
+
+} // namespace detail
+
+/**
+ * \brief Move selected points of a span to the front of its buffer
+ * \details Same as the overload taking indices, scans only words of the selection.
+ * \tparam PointT point type
+ * \param cloud point cloud span to compact
+ * \param selection selection of points of the cloud to keep
+ * \return unorganized point cloud span over the selected points at the beginning of
+ * the buffer of `cloud`
+ * \throws pcl::BadArgumentException if the selection size differs from the cloud size
+ * or more points than the 32-bit width are selected
+ */
+template <typename PointT>
+pcl::PointCloud<Spannable<PointT>>
+compactInPlace(pcl::PointCloud<Spannable<PointT>>& cloud,
+               const PointSelection& selection)
+{
+  if (selection.size() != cloud.size())
+    PCL_THROW_EXCEPTION(pcl::BadArgumentException,
+                        "Selection size does not match the cloud");
+  if (cloud.size() > detail::max_chunk_points)
+    detail::checkChunkSize(selection.count());
+  auto* data = cloud.data();
+  const auto* words = selection.data();
+  std::size_t size = 0;
+  for (std::size_t w = 0; w < selection.getNumberOfWords(); ++w) {
+    const std::size_t begin = w * detail::selection_word_bits;
+    // runs of selected points at the beginning stay in place
+    if (words[w] == ~std::uint64_t{0} && size == begin) {
+      size += detail::selection_word_bits;
+      continue;
+    }
+    for (auto word = words[w]; word != 0; word &= word - 1) {
+      const std::size_t index = begin + detail::lowestBit(word);
+      if (index != size)
+        data[size] = data[index];
+      ++size;
+    }
+  }
+
+  auto compacted = makeCloudSpan(reinterpret_cast<PointT*>(data),
+                                 static_cast<std::uint32_t>(size));
+  compacted.header = cloud.header;
+  compacted.is_dense = cloud.is_dense;
+  compacted.sensor_origin_ = cloud.sensor_origin_;
+  compacted.sensor_orientation_ = cloud.sensor_orientation_;
+  return compacted;
+}
+
+/** \brief Predicate of points with finite coordinates. */
+struct FinitePredicate {
+  template <typename PointT>
+  bool
+  operator()(const PointT& point) const
+  {
+    return std::isfinite(point.x) && std::isfinite(point.y) && std::isfinite(point.z);
+  }
+};
+
+/**
+ * \brief Predicate of points inside an axis-aligned box
+ * \details Bounds are inclusive as in pcl::CropBox without a transform, points with
+ * non-finite coordinates are outside.
+ */
+class BoxPredicate {
+public:
+  /**
+   * \brief Constructor
+   * \param min minimal corner of the box
+   * \param max maximal corner of the box
+   */
+  BoxPredicate(const Eigen::Vector3f& min, const Eigen::Vector3f& max)
+  : min_(min), max_(max)
+  {}
+
+  template <typename PointT>
+  bool
+  operator()(const PointT& point) const
+  {
+    return point.x >= min_.x() && point.x <= max_.x() && point.y >= min_.y() &&
+           point.y <= max_.y() && point.z >= min_.z() && point.z <= max_.z();
+  }
+
+private:
+  Eigen::Vector3f min_;
+  Eigen::Vector3f max_;
+};
+
+/**
+ * \brief Predicate of points with a field value in a range
+ * \details Limits are inclusive as in pcl::PassThrough, points with a non-finite value
+ * are outside.
+ * \tparam PointT point type
+ */
+template <typename PointT>
+class FieldRangePredicate {
+public:
+  /**
+   * \brief Constructor
+   * \param field_name name of a registered field, its first element is tested
+   * \param min minimal value
+   * \param max maximal value
+   * \throws pcl::BadArgumentException if the point type has no such field
+   */
+  FieldRangePredicate(const std::string& field_name, double min, double max)
+  : field_(detail::findField<Spannable<PointT>>(field_name)), min_(min), max_(max)
+  {}
+
+  template <typename CloudPointT>
+  bool
+  operator()(const CloudPointT& point) const
+  {
+    const double value = field_.read(&point);
+    return value >= min_ && value <= max_;
+  }
+
+private:
+  detail::FieldAccessor field_;
+  double min_;
+  double max_;
+};
+
+} // namespace pcl_cloud_span
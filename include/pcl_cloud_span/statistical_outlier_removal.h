@@ -0,0 +1,204 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2023 Ilia Kovalev
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include <pcl_cloud_span/pcl_cloud_span.h>
+
+#include <pcl_cloud_span/compact.h>
+#include <pcl_cloud_span/kdtree.h>
+#include <pcl_cloud_span/selection.h>
+
+#include <pcl/filters/statistical_outlier_removal.h>
+
+#include "impl/parallel.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace pcl_cloud_span {
+
+/**
+ * \brief pcl::StatisticalOutlierRemoval for point cloud spans
+ * \details Drop-in replacement of the PCL filter producing the same inliers. Neighbors
+ * are searched with the non-copying search::KdTree and mean distances to the k nearest
+ * neighbors are computed in parallel. Besides the inherited `filter` overloads
+ * returning indices or an output cloud, `filterInPlace` compacts inliers to the front
+ * of the input span and `filterSelection` deselects outliers in a point selection.
+ * \tparam PointT point type
+ */
+template <typename PointT>
+class StatisticalOutlierRemoval
+: public pcl::StatisticalOutlierRemoval<Spannable<PointT>> {
+  using Base = pcl::StatisticalOutlierRemoval<Spannable<PointT>>;
+
+public:
+  using PointCloud = typename Base::PointCloud;
+
+  /**
+   * \brief Constructor
+   * \param extract_removed_indices set to true if the filtered data indices should be
+   * saved in a separate list
+   */
+  explicit StatisticalOutlierRemoval(bool extract_removed_indices = false)
+  : Base(extract_removed_indices)
+  {}
+
+  /**
+   * \brief Set the number of threads to use
+   * \param nr_threads the number of hardware threads to use (0 sets the value back to
+   * automatic)
+   */
+  void
+  setNumberOfThreads(unsigned int nr_threads = 0)
+  {
+    threads_ = detail::resolveNumberOfThreads(nr_threads);
+  }
+
+  /**
+   * \brief Filter a span in place
+   * \details The span becomes the input cloud, inliers are moved to the front of its
+   * buffer in their original order.
+   * \param cloud point cloud span to filter
+   * \return point cloud span over inliers at the beginning of the buffer of `cloud`
+   */
+  PointCloud
+  filterInPlace(const typename PointCloud::Ptr& cloud)
+  {
+    this->setInputCloud(cloud);
+    this->filter(inliers_);
+    if (!std::is_sorted(inliers_.begin(), inliers_.end()))
+      std::sort(inliers_.begin(), inliers_.end());
+    return compactInPlace(*cloud, inliers_);
+  }
+
+  /**
+   * \brief Filter the selected points of a span deselecting the rejected ones
+   * \details Selected points become the indices of the filter, unselected points stay
+   * unselected and are only considered as neighbors. Selections of several filters can
+   * be chained or combined and compacted once.
+   * \param cloud point cloud span to filter
+   * \param selection selection of points of the cloud to refine
+   * \throws pcl::BadArgumentException if the selection size differs from the cloud size
+   */
+  void
+  filterSelection(const typename PointCloud::ConstPtr& cloud, PointSelection& selection)
+  {
+    detail::filterSelection(*this, cloud, selection, selected_, inliers_, threads_);
+  }
+
+protected:
+  using Base::applyFilter;
+
+  /**
+   * \brief Filtered results are indexed by an indices array
+   * \param indices the resultant point cloud indices
+   */
+  void
+  applyFilter(pcl::Indices& indices) override
+  {
+    const int mean_k = this->mean_k_;
+    if (mean_k < 1) {
+      PCL_ERROR("[pcl_cloud_span::StatisticalOutlierRemoval::applyFilter] Mean k must "
+                "be positive\n");
+      indices.clear();
+      this->removed_indices_->clear();
+      return;
+    }
+
+    tree_.setInputCloud(this->input_);
+    const auto& input = *this->input_;
+    const auto& input_indices = *this->indices_;
+    const auto size = static_cast<std::ptrdiff_t>(input_indices.size());
+    distances_.resize(input_indices.size());
+    std::ptrdiff_t valid_distances = 0;
+
+    // First pass: mean distances to the k nearest neighbors, 0 for invalid points
+#pragma omp parallel num_threads(threads_) reduction(+ : valid_distances)
+    {
+      pcl::Indices nn_indices(static_cast<std::size_t>(mean_k) + 1);
+      std::vector<float> nn_dists(nn_indices.size());
+#pragma omp for schedule(dynamic, 256)
+      for (std::ptrdiff_t i = 0; i < size; ++i) {
+        const auto index = static_cast<std::size_t>(i);
+        const auto& point = input[static_cast<std::size_t>(input_indices[index])];
+        distances_[index] = 0.f;
+        if (!std::isfinite(point.x) || !std::isfinite(point.y) ||
+            !std::isfinite(point.z))
+          continue;
+
+        const int found = tree_.nearestKSearch(point, mean_k + 1, nn_indices, nn_dists);
+        if (found == 0)
+          continue;
+
+        // the first neighbor is the query point itself
+        double dist_sum = 0.0;
+        for (std::size_t k = 1; k < static_cast<std::size_t>(found); ++k)
+          dist_sum += static_cast<double>(std::sqrt(nn_dists[k]));
+        distances_[index] = static_cast<float>(dist_sum / mean_k);
+        ++valid_distances;
+      }
+    }
+
+    // Mean and standard deviation are accumulated as in PCL to get the same threshold
+    double sum = 0, sq_sum = 0;
+    for (const float distance : distances_) {
+      sum += static_cast<double>(distance);
+      sq_sum += static_cast<double>(distance * distance);
+    }
+    const auto valid = static_cast<double>(valid_distances);
+    const double mean = sum / valid;
+    const double variance = (sq_sum - sum * sum / valid) / (valid - 1);
+    const double distance_threshold = mean + this->std_mul_ * std::sqrt(variance);
+
+    // Second pass: classify points
+    indices.resize(input_indices.size());
+    this->removed_indices_->resize(input_indices.size());
+    std::size_t oii = 0, rii = 0;
+    for (std::size_t i = 0; i < input_indices.size(); ++i) {
+      const bool outlier = static_cast<double>(distances_[i]) > distance_threshold;
+      if (outlier != this->negative_) {
+        if (this->extract_removed_indices_)
+          (*this->removed_indices_)[rii++] = input_indices[i];
+        continue;
+      }
+      indices[oii++] = input_indices[i];
+    }
+    indices.resize(oii);
+    this->removed_indices_->resize(rii);
+  }
+
+private:
+  search::KdTree<Spannable<PointT>> tree_;
+  unsigned int threads_ = 1;
+
+  std::vector<float> distances_;
+  pcl::Indices inliers_;
+  pcl::IndicesPtr selected_;
+};
+
+} // namespace pcl_cloud_span
@@ -0,0 +1,238 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2023 Ilia Kovalev
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include <pcl_cloud_span/pcl_cloud_span.h>
+
+#include <pcl/exceptions.h>
+
+#include <Eigen/Geometry>
+
+#include "impl/parallel.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+
+namespace pcl_cloud_span {
+namespace detail {
+
+/** \brief Number of points transformed by one iteration of the transform kernel. */
+constexpr std::ptrdiff_t transform_block_size = 16;
+
+/** \brief Minimal number of points to split the transform between threads. */
+constexpr std::size_t transform_parallel_threshold = 32768;
+
+/**
+ * \brief Apply a rigid transform to coordinates of a block of points
+ * \details Coordinates are gathered into local arrays first, so the arithmetic is a
+ * loop over plain arrays that the compiler vectorizes for any point layout (packed or
+ * padded). Only x, y and z of `out` are written, so other fields and padding are left
+ * untouched. `in` and `out` may point to the same memory.
+ * \tparam CheckFinite if true, points with non-finite coordinates are not transformed,
+ * their input coordinates are written to `out` as they are
+ */
+template <bool CheckFinite, typename Scalar, typename PointT>
+inline void
+transformBlock(const PointT* in,
+               PointT* out,
+               std::ptrdiff_t count,
+               const Eigen::Matrix<Scalar, 4, 4>& transform)
+{
+  Scalar x[transform_block_size], y[transform_block_size], z[transform_block_size];
+  for (std::ptrdiff_t i = 0; i < count; ++i) {
+    x[i] = static_cast<Scalar>(in[i].x);
+    y[i] = static_cast<Scalar>(in[i].y);
+    z[i] = static_cast<Scalar>(in[i].z);
+  }
+
+  const Scalar m00 = transform(0, 0), m01 = transform(0, 1), m02 = transform(0, 2);
+  const Scalar m10 = transform(1, 0), m11 = transform(1, 1), m12 = transform(1, 2);
+  const Scalar m20 = transform(2, 0), m21 = transform(2, 1), m22 = transform(2, 2);
+  const Scalar t0 = transform(0, 3), t1 = transform(1, 3), t2 = transform(2, 3);
+
+  Scalar tx[transform_block_size], ty[transform_block_size], tz[transform_block_size];
+  for (std::ptrdiff_t i = 0; i < count; ++i) {
+    tx[i] = m00 * x[i] + m01 * y[i] + m02 * z[i] + t0;
+    ty[i] = m10 * x[i] + m11 * y[i] + m12 * z[i] + t1;
+    tz[i] = m20 * x[i] + m21 * y[i] + m22 * z[i] + t2;
+  }
+
+  for (std::ptrdiff_t i = 0; i < count; ++i) {
+    if (CheckFinite &&
+        !(std::isfinite(x[i]) && std::isfinite(y[i]) && std::isfinite(z[i]))) {
+      out[i].x = in[i].x;
+      out[i].y = in[i].y;
+      out[i].z = in[i].z;
+      continue;
+    }
+    out[i].x = static_cast<float>(tx[i]);
+    out[i].y = static_cast<float>(ty[i]);
+    out[i].z = static_cast<float>(tz[i]);
+  }
+}
+
+/**
+ * \brief Transform `size` points from `in` to `out` block by block in parallel
+ */
+template <typename Scalar, typename PointT>
+void
+transformPoints(const PointT* in,
+                PointT* out,
+                std::size_t size,
+                bool is_dense,
+                bool copy_all_fields,
+                const Eigen::Matrix<Scalar, 4, 4>& transform,
+                unsigned int nr_threads)
+{
+  const auto points = static_cast<std::ptrdiff_t>(size);
+  const std::ptrdiff_t blocks =
+      (points + transform_block_size - 1) / transform_block_size;
+  const unsigned int threads =
+      size < transform_parallel_threshold ? 1 : resolveNumberOfThreads(nr_threads);
+  const bool copy = copy_all_fields && in != out;
+
+#pragma omp parallel for num_threads(threads) schedule(static)
+  for (std::ptrdiff_t block = 0; block < blocks; ++block) {
+    const std::ptrdiff_t begin = block * transform_block_size;
+    const std::ptrdiff_t count = std::min(transform_block_size, points - begin);
+    if (copy)
+      std::copy(in + begin, in + begin + count, out + begin);
+    if (is_dense)
+      transformBlock<false>(in + begin, out + begin, count, transform);
+    else
+      transformBlock<true>(in + begin, out + begin, count, transform);
+  }
+}
+
+} // namespace detail
+
+/**
+ * \brief Apply a rigid transform to a point cloud span in place
+ * \details Only x, y and z are modified, all other fields and padding stay untouched.
+ * Points with non-finite coordinates are left unchanged if the cloud is not dense.
+ * Large clouds are transformed in parallel.
+ * \tparam PointT point type
+ * \tparam Scalar type of transform coefficients, computation is done in this type
+ * \param cloud point cloud span to transform
+ * \param transform rigid transform
+ * \param nr_threads number of threads to use (0 means the number of cores)
+ */
+template <typename PointT, typename Scalar>
+void
+transformPointCloudInPlace(pcl::PointCloud<Spannable<PointT>>& cloud,
+                           const Eigen::Matrix<Scalar, 4, 4>& transform,
+                           unsigned int nr_threads = 0)
+{
+  detail::transformPoints(cloud.data(),
+                          cloud.data(),
+                          cloud.size(),
+                          cloud.is_dense,
+                          false,
+                          transform,
+                          nr_threads);
+}
+
+/**
+ * \brief Apply a rigid transform to a point cloud span in place
+ * \overload
+ */
+template <typename PointT, typename Scalar>
+void
+transformPointCloudInPlace(pcl::PointCloud<Spannable<PointT>>& cloud,
+                           const Eigen::Transform<Scalar, 3, Eigen::Affine>& transform,
+                           unsigned int nr_threads = 0)
+{
+  transformPointCloudInPlace(cloud, transform.matrix(), nr_threads);
+}
+
+/**
+ * \brief Apply a rigid transform to a point cloud span writing results into storage
+ * of another span
+ * \details Unlike pcl::transformPointCloud the output is never reallocated, so it can
+ * be a span over a caller-provided buffer. `cloud_out` may be the same cloud as
+ * `cloud_in`. Points with non-finite coordinates of a non-dense input keep their
+ * coordinates in the output as in pcl::transformPointCloud. Large clouds are
+ * transformed in parallel.
+ * \tparam PointT point type
+ * \tparam Scalar type of transform coefficients, computation is done in this type
+ * \param cloud_in input point cloud span
+ * \param cloud_out output point cloud span with the same number of points
+ * \param transform rigid transform
+ * \param copy_all_fields if true, fields other than x, y and z are copied from the
+ * input, otherwise they are left untouched in the output
+ * \param nr_threads number of threads to use (0 means the number of cores)
+ * \throws pcl::BadArgumentException if sizes of clouds differ
+ */
+template <typename PointT, typename Scalar>
+void
+transformPointCloud(const pcl::PointCloud<Spannable<PointT>>& cloud_in,
+                    pcl::PointCloud<Spannable<PointT>>& cloud_out,
+                    const Eigen::Matrix<Scalar, 4, 4>& transform,
+                    bool copy_all_fields = true,
+                    unsigned int nr_threads = 0)
+{
+  if (cloud_in.size() != cloud_out.size())
+    PCL_THROW_EXCEPTION(pcl::BadArgumentException,
+                        "Output span has " << cloud_out.size() << " points, but "
+                                           << cloud_in.size()
+                                           << " points are expected");
+
+  if (&cloud_in != &cloud_out) {
+    cloud_out.header = cloud_in.header;
+    cloud_out.width = cloud_in.width;
+    cloud_out.height = cloud_in.height;
+    cloud_out.is_dense = cloud_in.is_dense;
+    cloud_out.sensor_origin_ = cloud_in.sensor_origin_;
+    cloud_out.sensor_orientation_ = cloud_in.sensor_orientation_;
+  }
+
+  detail::transformPoints(cloud_in.data(),
+                          cloud_out.data(),
+                          cloud_in.size(),
+                          cloud_in.is_dense,
+                          copy_all_fields,
+                          transform,
+                          nr_threads);
+}
+
+/**
+ * \brief Apply a rigid transform to a point cloud span writing results into storage
+ * of another span
+ * \overload
+ */
+template <typename PointT, typename Scalar>
+void
+transformPointCloud(const pcl::PointCloud<Spannable<PointT>>& cloud_in,
+                    pcl::PointCloud<Spannable<PointT>>& cloud_out,
+                    const Eigen::Transform<Scalar, 3, Eigen::Affine>& transform,
+                    bool copy_all_fields = true,
+                    unsigned int nr_threads = 0)
+{
+  transformPointCloud(
+      cloud_in, cloud_out, transform.matrix(), copy_all_fields, nr_threads);
+}
+
+} // namespace pcl_cloud_span
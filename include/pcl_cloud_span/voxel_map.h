@@ -0,0 +1,443 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2023 Ilia Kovalev
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include <pcl_cloud_span/pcl_cloud_span.h>
+
+#include <pcl/exceptions.h>
+
+#include <Eigen/Core>
+
+#include "impl/field_access.h"
+#include "impl/parallel.h"
+#include "impl/point_count.h"
+#include "impl/voxel_key.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <limits>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+namespace pcl_cloud_span {
+
+/**
+ * \brief Persistent voxel map accumulating point cloud span frames
+ * \details Every inserted frame updates running per-voxel sums, so the cost of an
+ * insertion depends on the frame size only and the map never re-downsamples already
+ * accumulated data. Voxel centroids are stored contiguously and exposed as a span over
+ * the internal storage. All float fields except packed colors are averaged, other
+ * fields are taken from the first point of the voxel.
+ *
+ * Voxels can be evicted by age (not observed during a number of frames) and by
+ * distance of their centroids from the sensor origin of the last frame. Age eviction
+ * only visits voxels of the frame leaving the age window. Distance eviction visits
+ * voxels of the frame and voxels whose distance margin at their last check has been
+ * used up by the travel of the origin since, so a static map is not rescanned.
+ * \tparam PointT point type
+ */
+template <typename PointT>
+class VoxelMap {
+public:
+  using PointCloud = pcl::PointCloud<Spannable<PointT>>;
+
+  /**
+   * \brief Set the leaf size, clears the map
+   * \param leaf_size leaf size
+   * \throws pcl::BadArgumentException if leaf size is not positive
+   */
+  void
+  setLeafSize(float leaf_size)
+  {
+    if (!(leaf_size > 0))
+      PCL_THROW_EXCEPTION(pcl::BadArgumentException, "Leaf size must be positive");
+    leaf_size_ = leaf_size;
+    clear();
+  }
+
+  /**
+   * \brief Set the maximum age of voxels, clears the map
+   * \param nr_frames voxels not observed in this many last frames are removed (0, the
+   * default, disables age eviction)
+   */
+  void
+  setMaxAge(std::uint32_t nr_frames)
+  {
+    max_age_ = nr_frames;
+    clear();
+  }
+
+  /**
+   * \brief Set the maximum distance of voxel centroids from the sensor origin
+   * \param distance maximum distance (infinity by default)
+   * \throws pcl::BadArgumentException if distance is not positive
+   */
+  void
+  setMaxDistance(float distance)
+  {
+    if (!(distance > 0))
+      PCL_THROW_EXCEPTION(pcl::BadArgumentException, "Distance must be positive");
+    max_distance_ = distance;
+    max_sqr_distance_ = distance * distance;
+    far_checks_.clear();
+  }
+
+  /**
+   * \brief Set the number of threads to use
+   * \param nr_threads the number of hardware threads to use (0 sets the value back to
+   * automatic)
+   */
+  void
+  setNumberOfThreads(unsigned int nr_threads = 0)
+  {
+    threads_ = detail::resolveNumberOfThreads(nr_threads);
+  }
+
+  /**
+   * \brief Insert a frame using its sensor origin for distance eviction
+   * \param frame point cloud span in the map frame
+   */
+  void
+  insert(const PointCloud& frame)
+  {
+    insert(frame, frame.sensor_origin_.template head<3>());
+  }
+
+  /**
+   * \brief Insert a frame
+   * \details Points with non-finite coordinates are ignored.
+   * \param frame point cloud span in the map frame
+   * \param origin sensor origin used for distance eviction
+   */
+  void
+  insert(const PointCloud& frame, const Eigen::Vector3f& origin)
+  {
+    if (averaged_.empty())
+      averaged_ = detail::getAveragedFieldOffsets<Spannable<PointT>>();
+    ++frame_number_;
+
+    computeKeys(frame);
+    accumulate(frame);
+    updateCentroids();
+    // slots move on eviction, voxels of the frame are tracked by their keys from here
+    touched_keys_.clear();
+    for (const std::size_t slot : touched_)
+      touched_keys_.push_back(keys_[slot]);
+    if (max_age_ > 0)
+      evictOld();
+    if (max_sqr_distance_ < std::numeric_limits<float>::max())
+      evictFar(origin);
+
+    detail::checkChunkSize(points_.size());
+    centroids_ = makeCloudSpanPtr(reinterpret_cast<PointT*>(points_.data()),
+                                  static_cast<std::uint32_t>(points_.size()));
+    centroids_->header = frame.header;
+  }
+
+  /** \brief Remove all voxels. */
+  void
+  clear()
+  {
+    map_.clear();
+    keys_.clear();
+    points_.clear();
+    sums_.clear();
+    counts_.clear();
+    last_seen_.clear();
+    far_sequences_.clear();
+    history_.clear();
+    far_checks_.clear();
+    centroids_ = std::make_shared<PointCloud>();
+  }
+
+  /** \brief Number of voxels in the map. */
+  std::size_t
+  size() const
+  {
+    return points_.size();
+  }
+
+  /** \brief Whether the map has no voxels. */
+  bool
+  empty() const
+  {
+    return points_.empty();
+  }
+
+  /**
+   * \brief Get voxel centroids
+   * \details The returned cloud is a span over storage of the map, it stays valid until
+   * the next modification of the map.
+   * \return voxel centroids
+   */
+  typename PointCloud::ConstPtr
+  getCentroids() const
+  {
+    return centroids_;
+  }
+
+  /**
+   * \brief Get the number of accumulated points in each voxel
+   * \return point counts in the order of centroids
+   */
+  const std::vector<std::uint32_t>&
+  getPointCounts() const
+  {
+    return counts_;
+  }
+
+private:
+  /** \brief Pending distance check of a voxel. */
+  struct FarCheck {
+    /** \brief Distance travelled by the origin at which the voxel may be too far. */
+    double travelled;
+    detail::VoxelKey key;
+    /** \brief Number of the check, outdated if the voxel was checked again since. */
+    std::uint64_t sequence;
+  };
+
+  void
+  computeKeys(const PointCloud& frame)
+  {
+    const auto size = static_cast<std::ptrdiff_t>(frame.size());
+    const float inverse_leaf_size = 1.f / leaf_size_;
+    frame_keys_.resize(frame.size());
+    frame_valid_.resize(frame.size());
+#pragma omp parallel for num_threads(threads_) schedule(static)
+    for (std::ptrdiff_t i = 0; i < size; ++i) {
+      const auto point = static_cast<std::size_t>(i);
+      frame_valid_[point] = detail::computeVoxelKey(
+          frame[point], inverse_leaf_size, frame_keys_[point]);
+    }
+  }
+
+  void
+  accumulate(const PointCloud& frame)
+  {
+    const std::size_t nr_fields = averaged_.size();
+    touched_.clear();
+    for (std::size_t i = 0; i < frame.size(); ++i) {
+      if (!frame_valid_[i])
+        continue;
+      const auto inserted = map_.emplace(frame_keys_[i], points_.size());
+      const std::size_t slot = inserted.first->second;
+      if (inserted.second) {
+        keys_.push_back(frame_keys_[i]);
+        points_.push_back(frame[i]);
+        sums_.resize(sums_.size() + nr_fields);
+        counts_.push_back(0);
+        last_seen_.push_back(0);
+        far_sequences_.push_back(0);
+      }
+      if (last_seen_[slot] != frame_number_) {
+        last_seen_[slot] = frame_number_;
+        touched_.push_back(slot);
+      }
+
+      const auto* point = reinterpret_cast<const std::uint8_t*>(&frame[i]);
+      double* sums = sums_.data() + slot * nr_fields;
+      for (std::size_t f = 0; f < nr_fields; ++f) {
+        float value;
+        std::memcpy(&value, point + averaged_[f], sizeof(float));
+        sums[f] += static_cast<double>(value);
+      }
+      ++counts_[slot];
+    }
+  }
+
+  void
+  updateCentroids()
+  {
+    const std::size_t nr_fields = averaged_.size();
+    const auto nr_touched = static_cast<std::ptrdiff_t>(touched_.size());
+#pragma omp parallel for num_threads(threads_) schedule(static)
+    for (std::ptrdiff_t i = 0; i < nr_touched; ++i) {
+      const std::size_t slot = touched_[static_cast<std::size_t>(i)];
+      const double* sums = sums_.data() + slot * nr_fields;
+      const auto count = static_cast<double>(counts_[slot]);
+      auto* point = reinterpret_cast<std::uint8_t*>(&points_[slot]);
+      for (std::size_t f = 0; f < nr_fields; ++f) {
+        const auto value = static_cast<float>(sums[f] / count);
+        std::memcpy(point + averaged_[f], &value, sizeof(float));
+      }
+    }
+  }
+
+  void
+  evictOld()
+  {
+    std::vector<detail::VoxelKey> keys;
+    keys.swap(recycled_keys_);
+    keys.assign(touched_keys_.begin(), touched_keys_.end());
+    history_.push_back(std::move(keys));
+
+    if (history_.size() <= max_age_)
+      return;
+    const std::uint64_t oldest = frame_number_ - max_age_;
+    for (const auto& key : history_.front()) {
+      const auto it = map_.find(key);
+      if (it != map_.end() && last_seen_[it->second] == oldest)
+        evict(it->second);
+    }
+    recycled_keys_.swap(history_.front());
+    history_.pop_front();
+  }
+
+  /**
+   * \brief Evict voxels with centroids farther than the maximum distance from origin
+   * \details A voxel at distance d from the origin stays within the maximum distance
+   * until its centroid changes or the origin travels further than the margin left
+   * at that check. Checks are queued by the travelled distance at which the margin
+   * is used up, and only voxels of the frame and voxels with a used up margin are
+   * visited. All voxels are checked once after the maximum distance is set.
+   */
+  void
+  evictFar(const Eigen::Vector3f& origin)
+  {
+    far_keys_.clear();
+    if (far_checks_.empty()) {
+      travelled_ = 0;
+      far_keys_.assign(keys_.begin(), keys_.end());
+    }
+    else {
+      travelled_ += static_cast<double>((origin - previous_origin_).norm());
+      far_keys_.assign(touched_keys_.begin(), touched_keys_.end());
+      while (!far_checks_.empty() && far_checks_.front().travelled < travelled_) {
+        std::pop_heap(far_checks_.begin(), far_checks_.end(), laterCheck);
+        const auto& check = far_checks_.back();
+        const auto it = map_.find(check.key);
+        if (it != map_.end() && far_sequences_[it->second] == check.sequence)
+          far_keys_.push_back(check.key);
+        far_checks_.pop_back();
+      }
+    }
+    previous_origin_ = origin;
+
+    const float origin_norm = origin.norm();
+    for (const auto& key : far_keys_) {
+      const auto it = map_.find(key);
+      if (it == map_.end())
+        continue;
+      const std::size_t slot = it->second;
+      const auto centroid = points_[slot].getVector3fMap();
+      const float sqr_distance = (centroid - origin).squaredNorm();
+      if (sqr_distance > max_sqr_distance_) {
+        evict(slot);
+        continue;
+      }
+      // the margin is reduced by the rounding error of the float distance
+      const float tolerance = 4 * std::numeric_limits<float>::epsilon() *
+                              (centroid.norm() + origin_norm + max_distance_);
+      const float margin = max_distance_ - std::sqrt(sqr_distance) - tolerance;
+      far_sequences_[slot] = ++far_sequence_;
+      far_checks_.push_back(
+          {travelled_ + static_cast<double>(margin), key, far_sequence_});
+      std::push_heap(far_checks_.begin(), far_checks_.end(), laterCheck);
+    }
+
+    // voxels of every frame leave outdated checks behind, drop them once they dominate
+    if (far_checks_.size() > 2 * points_.size() + 1024) {
+      far_checks_.erase(std::remove_if(far_checks_.begin(),
+                                       far_checks_.end(),
+                                       [this](const FarCheck& check) {
+                                         const auto it = map_.find(check.key);
+                                         return it == map_.end() ||
+                                                far_sequences_[it->second] !=
+                                                    check.sequence;
+                                       }),
+                        far_checks_.end());
+      std::make_heap(far_checks_.begin(), far_checks_.end(), laterCheck);
+    }
+  }
+
+  /** \brief Heap order putting the check with the smallest travelled distance first. */
+  static bool
+  laterCheck(const FarCheck& a, const FarCheck& b)
+  {
+    return a.travelled > b.travelled;
+  }
+
+  /** \brief Remove a voxel moving the last voxel into its slot. */
+  void
+  evict(std::size_t slot)
+  {
+    const std::size_t nr_fields = averaged_.size();
+    const std::size_t last = points_.size() - 1;
+    map_.erase(keys_[slot]);
+    if (slot != last) {
+      map_[keys_[last]] = slot;
+      keys_[slot] = keys_[last];
+      points_[slot] = points_[last];
+      std::copy(sums_.data() + last * nr_fields,
+                sums_.data() + sums_.size(),
+                sums_.data() + slot * nr_fields);
+      counts_[slot] = counts_[last];
+      last_seen_[slot] = last_seen_[last];
+      far_sequences_[slot] = far_sequences_[last];
+    }
+    keys_.pop_back();
+    points_.pop_back();
+    sums_.resize(last * nr_fields);
+    counts_.pop_back();
+    last_seen_.pop_back();
+    far_sequences_.pop_back();
+  }
+
+  float leaf_size_ = 1.f;
+  std::uint32_t max_age_ = 0;
+  float max_distance_ = std::numeric_limits<float>::max();
+  float max_sqr_distance_ = std::numeric_limits<float>::max();
+  unsigned int threads_ = 1;
+
+  std::unordered_map<detail::VoxelKey, std::size_t, detail::VoxelKeyHash> map_;
+  std::vector<detail::VoxelKey> keys_;
+  std::vector<Spannable<PointT>, Eigen::aligned_allocator<Spannable<PointT>>> points_;
+  std::vector<double> sums_;
+  std::vector<std::uint32_t> counts_;
+  std::vector<std::uint64_t> last_seen_;
+  std::vector<std::uint64_t> far_sequences_;
+  std::uint64_t frame_number_ = 0;
+  std::deque<std::vector<detail::VoxelKey>> history_;
+  std::vector<FarCheck> far_checks_;
+  std::uint64_t far_sequence_ = 0;
+  double travelled_ = 0;
+  Eigen::Vector3f previous_origin_ = Eigen::Vector3f::Zero();
+  typename PointCloud::Ptr centroids_ = std::make_shared<PointCloud>();
+
+  std::vector<std::uint32_t> averaged_;
+  std::vector<detail::VoxelKey> frame_keys_;
+  std::vector<std::uint8_t> frame_valid_;
+  std::vector<std::size_t> touched_;
+  std::vector<detail::VoxelKey> touched_keys_;
+  std::vector<detail::VoxelKey> far_keys_;
+  std::vector<detail::VoxelKey> recycled_keys_;
+};
+
+} // namespace pcl_cloud_span
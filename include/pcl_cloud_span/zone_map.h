@@ -0,0 +1,543 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2023 Ilia Kovalev
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include <pcl_cloud_span/pcl_cloud_span.h>
+
+#include <pcl_cloud_span/selection.h>
+
+#include <pcl/exceptions.h>
+#include <pcl/types.h>
+
+#include <Eigen/Core>
+
+#include "impl/field_access.h"
+#include "impl/parallel.h"
+#include "impl/point_count.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <istream>
+#include <limits>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace pcl_cloud_span {
+
+/** \brief Inclusive range of values of a point field. */
+struct FieldRange {
+  /** \brief Field name. */
+  std::string field;
+  /** \brief Minimal value. */
+  double min;
+  /** \brief Maximal value. */
+  double max;
+};
+
+/**
+ * \brief Zone map of a point cloud: value ranges of fields over fixed-size chunks
+ * \details For every chunk of consecutive points the map stores the minimum and
+ * maximum of x, y, z (the bounding box) and of additionally tracked fields. Range
+ * queries (crop box, pass-through, conjunctions of field ranges) skip chunks whose
+ * ranges do not intersect the query, select chunks lying entirely inside it without
+ * reading their points, and test points only in the remaining chunks, in parallel. On
+ * spatially coherent data the cost of a query follows the size of the result rather
+ * than the size of the cloud. The map is built once per cloud and can be saved next
+ * to the data.
+ * \tparam PointT point type
+ */
+template <typename PointT>
+class ZoneMap {
+public:
+  using PointCloud = pcl::PointCloud<Spannable<PointT>>;
+
+  /**
+   * \brief Set the number of points in a chunk for the following build
+   * \param chunk_size number of points, a multiple of 64, 4096 by default
+   * \throws pcl::BadArgumentException if chunk_size is zero or not a multiple of 64
+   */
+  void
+  setChunkSize(std::uint32_t chunk_size)
+  {
+    if (chunk_size == 0 || chunk_size % detail::selection_word_bits != 0)
+      PCL_THROW_EXCEPTION(pcl::BadArgumentException,
+                          "Chunk size must be a positive multiple of "
+                              << detail::selection_word_bits);
+    chunk_size_ = chunk_size;
+  }
+
+  /**
+   * \brief Set fields tracked besides x, y and z for the following build
+   * \param fields names of registered fields, the first element of each is tracked
+   * \throws pcl::BadArgumentException if the point type has no such field
+   */
+  void
+  setFields(const std::vector<std::string>& fields)
+  {
+    std::vector<detail::FieldAccessor> accessors = {findField("x"),
+                                                    findField("y"),
+                                                    findField("z")};
+    for (const auto& field : fields)
+      if (field != "x" && field != "y" && field != "z")
+        accessors.push_back(findField(field));
+    fields_ = std::move(accessors);
+  }
+
+  /**
+   * \brief Set the number of threads to use
+   * \param nr_threads the number of hardware threads to use (0 sets the value back to
+   * automatic)
+   */
+  void
+  setNumberOfThreads(unsigned int nr_threads = 0)
+  {
+    threads_ = detail::resolveNumberOfThreads(nr_threads);
+  }
+
+  /** \brief Number of points of the cloud the map was built for. */
+  std::size_t
+  size() const
+  {
+    return nr_points_;
+  }
+
+  /** \brief Number of chunks. */
+  std::size_t
+  getNumberOfChunks() const
+  {
+    return (nr_points_ + stored_chunk_size_ - 1) / stored_chunk_size_;
+  }
+
+  /** \brief Number of points of every chunk but the last one in the built map. */
+  std::uint32_t
+  getChunkSize() const
+  {
+    return stored_chunk_size_;
+  }
+
+  /**
+   * \brief Value range of a tracked field in a chunk
+   * \details The range covers finite values only and is empty (min > max) if the
+   * chunk has none.
+   * \param chunk chunk number
+   * \param field name of a tracked field
+   * \param min minimal value
+   * \param max maximal value
+   * \throws pcl::BadArgumentException if the field is not tracked
+   */
+  void
+  getRange(std::size_t chunk, const std::string& field, double& min, double& max) const
+  {
+    const auto f = trackedField(field);
+    if (f == stored_fields_.size())
+      PCL_THROW_EXCEPTION(pcl::BadArgumentException,
+                          "Field " << field << " is not tracked");
+    min = mins_[chunk * stored_fields_.size() + f];
+    max = maxs_[chunk * stored_fields_.size() + f];
+  }
+
+  /**
+   * \brief Compute the map of a point cloud
+   * \details Chunk size and tracked fields set before are fixed for the built map,
+   * later setter calls only affect the next build.
+   * \param cloud pcl::PointCloud or point cloud span
+   */
+  template <typename CloudT>
+  void
+  build(const CloudT& cloud)
+  {
+    if (fields_.empty())
+      setFields({});
+    stored_chunk_size_ = chunk_size_;
+    stored_fields_ = fields_;
+    nr_points_ = cloud.size();
+    const std::size_t nr_fields = stored_fields_.size();
+    const std::size_t nr_chunks = getNumberOfChunks();
+    mins_.assign(nr_chunks * nr_fields, std::numeric_limits<double>::infinity());
+    maxs_.assign(nr_chunks * nr_fields, -std::numeric_limits<double>::infinity());
+    finite_.assign(nr_chunks * nr_fields, 1);
+
+    const auto chunks = static_cast<std::ptrdiff_t>(nr_chunks);
+#pragma omp parallel for num_threads(threads_) schedule(dynamic)
+    for (std::ptrdiff_t i_chunk = 0; i_chunk < chunks; ++i_chunk) {
+      const auto chunk = static_cast<std::size_t>(i_chunk);
+      const std::size_t begin = chunk * stored_chunk_size_;
+      const std::size_t end = std::min(nr_points_, begin + stored_chunk_size_);
+      for (std::size_t f = 0; f < nr_fields; ++f) {
+        const std::size_t k = chunk * nr_fields + f;
+        double min = mins_[k], max = maxs_[k];
+        bool finite = true;
+        for (std::size_t i = begin; i < end; ++i) {
+          const double value = stored_fields_[f].read(&cloud[i]);
+          if (!std::isfinite(value)) {
+            finite = false;
+            continue;
+          }
+          min = std::min(min, value);
+          max = std::max(max, value);
+        }
+        mins_[k] = min;
+        maxs_[k] = max;
+        finite_[k] = finite;
+      }
+    }
+  }
+
+  /**
+   * \brief Select points with all given fields in their ranges
+   * \details Equivalent to testing every point with FieldRangePredicate for every
+   * range. Ranges on untracked fields are tested point by point in chunks that can not
+   * be skipped because of the tracked ones.
+   * \param cloud point cloud the map was built for
+   * \param ranges field ranges, all have to hold
+   * \param selection selection resized to the cloud
+   * \throws pcl::BadArgumentException if the cloud size differs from the map or a field
+   * does not exist
+   */
+  template <typename CloudT>
+  void
+  filter(const CloudT& cloud,
+         const std::vector<FieldRange>& ranges,
+         PointSelection& selection) const
+  {
+    const auto query = prepare(cloud, ranges);
+    selection.assign(cloud.size());
+    auto* words = selection.data();
+    const auto nr_candidates = static_cast<std::ptrdiff_t>(query.candidates.size());
+#pragma omp parallel for num_threads(threads_) schedule(dynamic)
+    for (std::ptrdiff_t i_candidate = 0; i_candidate < nr_candidates; ++i_candidate) {
+      const auto c = static_cast<std::size_t>(i_candidate);
+      const auto& candidate = query.candidates[c];
+      const std::size_t end =
+          std::min(nr_points_, candidate.begin + stored_chunk_size_);
+      for (std::size_t w = candidate.begin; w < end; w += detail::selection_word_bits) {
+        std::uint64_t word = 0;
+        const std::size_t word_end = std::min(end, w + detail::selection_word_bits);
+        for (std::size_t i = w; i < word_end; ++i)
+          if (candidate.inside || query.test(cloud[i]))
+            word |= std::uint64_t{1} << (i - w);
+        words[w / detail::selection_word_bits] = word;
+      }
+    }
+  }
+
+  /**
+   * \brief Indices of points with all given fields in their ranges
+   * \tparam IndexT pcl::index_t or std::uint64_t for LargeIndices
+   * \param cloud point cloud the map was built for
+   * \param ranges field ranges, all have to hold
+   * \param indices indices of selected points in ascending order
+   * \throws pcl::BadArgumentException if the cloud size differs from the map, a field
+   * does not exist or the cloud is too large for IndexT
+   */
+  template <typename CloudT, typename IndexT>
+  void
+  filter(const CloudT& cloud,
+         const std::vector<FieldRange>& ranges,
+         std::vector<IndexT>& indices) const
+  {
+    detail::checkIndexable<IndexT>(cloud.size());
+    const auto query = prepare(cloud, ranges);
+    const auto nr_candidates = static_cast<std::ptrdiff_t>(query.candidates.size());
+    std::vector<std::vector<IndexT>> chunk_indices(query.candidates.size());
+#pragma omp parallel for num_threads(threads_) schedule(dynamic)
+    for (std::ptrdiff_t i_candidate = 0; i_candidate < nr_candidates; ++i_candidate) {
+      const auto c = static_cast<std::size_t>(i_candidate);
+      const auto& candidate = query.candidates[c];
+      const std::size_t end =
+          std::min(nr_points_, candidate.begin + stored_chunk_size_);
+      auto& out = chunk_indices[c];
+      for (std::size_t i = candidate.begin; i < end; ++i)
+        if (candidate.inside || query.test(cloud[i]))
+          out.push_back(static_cast<IndexT>(i));
+    }
+
+    std::size_t size = 0;
+    for (const auto& chunk : chunk_indices)
+      size += chunk.size();
+    indices.clear();
+    indices.reserve(size);
+    for (const auto& chunk : chunk_indices)
+      indices.insert(indices.end(), chunk.begin(), chunk.end());
+  }
+
+  /**
+   * \brief Indices of points inside an axis-aligned box, as pcl::CropBox
+   * \tparam IndexT pcl::index_t or std::uint64_t for LargeIndices
+   * \param cloud point cloud the map was built for
+   * \param min minimal corner of the box
+   * \param max maximal corner of the box
+   * \param indices indices of points inside the box in ascending order
+   */
+  template <typename CloudT, typename IndexT>
+  void
+  cropBox(const CloudT& cloud,
+          const Eigen::Vector3f& min,
+          const Eigen::Vector3f& max,
+          std::vector<IndexT>& indices) const
+  {
+    filter(cloud,
+           {{"x", min.x(), max.x()}, {"y", min.y(), max.y()}, {"z", min.z(), max.z()}},
+           indices);
+  }
+
+  /**
+   * \brief Indices of points with a field value in a range, as pcl::PassThrough
+   * \details As in PCL, points with non-finite x, y or z are dropped if the cloud is
+   * not dense, whatever the filtered field.
+   * \tparam IndexT pcl::index_t or std::uint64_t for LargeIndices
+   * \param cloud point cloud the map was built for
+   * \param field field name
+   * \param min minimal value
+   * \param max maximal value
+   * \param indices indices of selected points in ascending order
+   */
+  template <typename CloudT, typename IndexT>
+  void
+  passThrough(const CloudT& cloud,
+              const std::string& field,
+              double min,
+              double max,
+              std::vector<IndexT>& indices) const
+  {
+    std::vector<FieldRange> ranges = {{field, min, max}};
+    if (!cloud.is_dense)
+      for (const char* axis : {"x", "y", "z"})
+        if (field != axis)
+          ranges.push_back({axis,
+                            std::numeric_limits<double>::lowest(),
+                            std::numeric_limits<double>::max()});
+    filter(cloud, ranges, indices);
+  }
+
+  /**
+   * \brief Write the map to a stream
+   * \param stream binary output stream
+   */
+  void
+  save(std::ostream& stream) const
+  {
+    stream.write(magic_, sizeof(magic_));
+    write(stream, version_);
+    write(stream, static_cast<std::uint32_t>(sizeof(PointT)));
+    write(stream, stored_chunk_size_);
+    write(stream, static_cast<std::uint64_t>(nr_points_));
+    write(stream, static_cast<std::uint32_t>(stored_fields_.size()));
+    for (const auto& field : stored_fields_) {
+      write(stream, static_cast<std::uint32_t>(field.name.size()));
+      stream.write(field.name.data(), static_cast<std::streamsize>(field.name.size()));
+    }
+    writeArray(stream, mins_);
+    writeArray(stream, maxs_);
+    writeArray(stream, finite_);
+  }
+
+  /**
+   * \brief Read a map written by save
+   * \param stream binary input stream
+   * \throws pcl::IOException if the stream is not a zone map of PointT
+   */
+  void
+  load(std::istream& stream)
+  {
+    char magic[sizeof(magic_)];
+    stream.read(magic, sizeof(magic));
+    if (!stream || std::memcmp(magic, magic_, sizeof(magic)) != 0 ||
+        read<std::uint32_t>(stream) != version_)
+      PCL_THROW_EXCEPTION(pcl::IOException, "Not a zone map");
+    if (read<std::uint32_t>(stream) != sizeof(PointT))
+      PCL_THROW_EXCEPTION(pcl::IOException, "Point type does not match");
+    const auto chunk_size = read<std::uint32_t>(stream);
+    const auto nr_points = read<std::uint64_t>(stream);
+    const auto nr_fields = read<std::uint32_t>(stream);
+    if (!stream || chunk_size == 0 || chunk_size % detail::selection_word_bits != 0 ||
+        nr_fields < 3 || nr_fields > 1024)
+      PCL_THROW_EXCEPTION(pcl::IOException, "Corrupted zone map");
+
+    std::vector<detail::FieldAccessor> fields;
+    for (std::uint32_t f = 0; f < nr_fields; ++f) {
+      const auto length = read<std::uint32_t>(stream);
+      if (!stream || length > 1024)
+        PCL_THROW_EXCEPTION(pcl::IOException, "Corrupted zone map");
+      std::string name(length, '\0');
+      stream.read(&name[0], length);
+      try {
+        fields.push_back(findField(name));
+      } catch (const pcl::BadArgumentException&) {
+        PCL_THROW_EXCEPTION(pcl::IOException, "Point type does not match");
+      }
+    }
+
+    stored_chunk_size_ = chunk_size;
+    nr_points_ = static_cast<std::size_t>(nr_points);
+    stored_fields_ = std::move(fields);
+    const std::size_t values = getNumberOfChunks() * stored_fields_.size();
+    if (!readArray(stream, mins_, values) || !readArray(stream, maxs_, values) ||
+        !readArray(stream, finite_, values)) {
+      nr_points_ = 0;
+      PCL_THROW_EXCEPTION(pcl::IOException, "Truncated zone map");
+    }
+  }
+
+private:
+  /** \brief Chunk of a query that can not be skipped. */
+  struct Candidate {
+    std::size_t begin;
+    /** \brief All points of the chunk satisfy the query. */
+    bool inside;
+  };
+
+  /** \brief Field ranges resolved for a query with chunks to visit. */
+  struct Query {
+    std::vector<detail::FieldAccessor> fields;
+    std::vector<FieldRange> ranges;
+    std::vector<Candidate> candidates;
+
+    template <typename CloudPointT>
+    bool
+    test(const CloudPointT& point) const
+    {
+      for (std::size_t r = 0; r < ranges.size(); ++r) {
+        const double value = fields[r].read(&point);
+        if (!(value >= ranges[r].min && value <= ranges[r].max))
+          return false;
+      }
+      return true;
+    }
+  };
+
+  static constexpr char magic_[8] = {'P', 'C', 'S', 'Z', 'O', 'N', 'E', 'S'};
+  static constexpr std::uint32_t version_ = 1;
+
+  template <typename CloudT>
+  Query
+  prepare(const CloudT& cloud, const std::vector<FieldRange>& ranges) const
+  {
+    if (cloud.size() != nr_points_)
+      PCL_THROW_EXCEPTION(pcl::BadArgumentException,
+                          "Zone map was built for a cloud of " << nr_points_
+                                                               << " points");
+    Query query;
+    query.ranges = ranges;
+    std::vector<std::size_t> tracked;
+    for (const auto& range : ranges) {
+      query.fields.push_back(findField(range.field));
+      tracked.push_back(trackedField(range.field));
+    }
+
+    const std::size_t nr_fields = stored_fields_.size();
+    for (std::size_t chunk = 0; chunk < getNumberOfChunks(); ++chunk) {
+      bool skip = false;
+      bool inside = true;
+      for (std::size_t r = 0; r < ranges.size() && !skip; ++r) {
+        if (tracked[r] == nr_fields) {
+          inside = false;
+          continue;
+        }
+        const std::size_t k = chunk * nr_fields + tracked[r];
+        skip = maxs_[k] < ranges[r].min || mins_[k] > ranges[r].max;
+        inside = inside && finite_[k] && mins_[k] >= ranges[r].min &&
+                 maxs_[k] <= ranges[r].max;
+      }
+      if (!skip)
+        query.candidates.push_back({chunk * stored_chunk_size_, inside});
+    }
+    return query;
+  }
+
+  static detail::FieldAccessor
+  findField(const std::string& name)
+  {
+    return detail::findField<Spannable<PointT>>(name);
+  }
+
+  /** \brief Position of a field among tracked ones, the number of them if untracked. */
+  std::size_t
+  trackedField(const std::string& name) const
+  {
+    std::size_t f = 0;
+    while (f < stored_fields_.size() && stored_fields_[f].name != name)
+      ++f;
+    return f;
+  }
+
+  template <typename T>
+  static void
+  write(std::ostream& stream, const T& value)
+  {
+    stream.write(reinterpret_cast<const char*>(&value), sizeof(T));
+  }
+
+  template <typename T>
+  static T
+  read(std::istream& stream)
+  {
+    T value{};
+    stream.read(reinterpret_cast<char*>(&value), sizeof(T));
+    return value;
+  }
+
+  template <typename T>
+  static void
+  writeArray(std::ostream& stream, const std::vector<T>& values)
+  {
+    stream.write(reinterpret_cast<const char*>(values.data()),
+                 static_cast<std::streamsize>(values.size() * sizeof(T)));
+  }
+
+  template <typename T>
+  static bool
+  readArray(std::istream& stream, std::vector<T>& values, std::size_t size)
+  {
+    values.resize(size);
+    stream.read(reinterpret_cast<char*>(values.data()),
+                static_cast<std::streamsize>(size * sizeof(T)));
+    return static_cast<bool>(stream);
+  }
+
+  std::uint32_t chunk_size_ = 4096;
+  unsigned int threads_ = 1;
+  std::vector<detail::FieldAccessor> fields_;
+
+  /** \brief Chunk size and tracked fields of the built or loaded map. */
+  std::uint32_t stored_chunk_size_ = 4096;
+  std::vector<detail::FieldAccessor> stored_fields_;
+  std::size_t nr_points_ = 0;
+  std::vector<double> mins_;
+  std::vector<double> maxs_;
+  std::vector<std::uint8_t> finite_;
+};
+
+template <typename PointT>
+constexpr char ZoneMap<PointT>::magic_[8];
+
+template <typename PointT>
+constexpr std::uint32_t ZoneMap<PointT>::version_;
+
+} // namespace pcl_cloud_span
@@ -0,0 +1,503 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2023 Ilia Kovalev
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <pcl_cloud_span/pcl_cloud_span.h>
+
+#include <pcl_cloud_span/extract_clusters.h>
+#include <pcl_cloud_span/pyramid.h>
+#include <pcl_cloud_span/radius_outlier_removal.h>
+#include <pcl_cloud_span/sac_segmentation.h>
+#include <pcl_cloud_span/sampling.h>
+#include <pcl_cloud_span/statistical_outlier_removal.h>
+#include <pcl_cloud_span/transforms.h>
+
+#include <pcl/point_types.h>
+#include <pcl/register_point_struct.h>
+
+#include <pybind11/eigen.h>
+#include <pybind11/numpy.h>
+#include <pybind11/pybind11.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace py = pybind11;
+
+namespace pcl_cloud_span_python {
+
+/**
+ * \brief Point of a (N, 3) float32 array or a structured array with x, y, z
+ * \details The point is packed into 12 bytes, so it has only 3D Eigen maps. 4D maps
+ * would read past the last point of the array, algorithms using them (e.g.
+ * pcl::VoxelGrid) do not compile for this type.
+ */
+struct PointXYZ {
+  union {
+    float data[3];
+    struct {
+      float x;
+      float y;
+      float z;
+    };
+  };
+
+  pcl::Vector3fMap
+  getVector3fMap()
+  {
+    return pcl::Vector3fMap(data);
+  }
+
+  pcl::Vector3fMapConst
+  getVector3fMap() const
+  {
+    return pcl::Vector3fMapConst(data);
+  }
+
+  pcl::Array3fMap
+  getArray3fMap()
+  {
+    return pcl::Array3fMap(data);
+  }
+
+  pcl::Array3fMapConst
+  getArray3fMap() const
+  {
+    return pcl::Array3fMapConst(data);
+  }
+};
+
+/** \brief Point of a (N, 4) float32 array or a structured array with intensity. */
+struct PointXYZI {
+  union {
+    float data[4];
+    struct {
+      float x;
+      float y;
+      float z;
+      float intensity;
+    };
+  };
+  PCL_ADD_EIGEN_MAPS_POINT4D
+};
+
+} // namespace pcl_cloud_span_python
+
+// cppcheck-suppress unknownMacro
+POINT_CLOUD_REGISTER_POINT_STRUCT(
+    pcl_cloud_span::Spannable<pcl_cloud_span_python::PointXYZ>,
+    (float, x, x)(float, y, y)(float, z, z))
+// cppcheck-suppress unknownMacro
+POINT_CLOUD_REGISTER_POINT_STRUCT(
+    pcl_cloud_span::Spannable<pcl_cloud_span_python::PointXYZI>,
+    (float, x, x)(float, y, y)(float, z, z)(float, intensity, intensity))
+
+namespace pcl_cloud_span_python {
+
+using pcl_cloud_span::Spannable;
+
+/** \brief Check that a dtype is native float32. */
+bool
+isFloat(const py::handle& dtype)
+{
+  return py::dtype::of<float>().attr("__eq__")(dtype).cast<bool>();
+}
+
+/** \brief Check that a structured dtype has only the given float32 fields, packed. */
+bool
+hasFields(const py::dtype& dtype, const std::vector<std::string>& names)
+{
+  const py::object fields = dtype.attr("fields");
+  if (fields.is_none() || py::len(fields) != names.size())
+    return false;
+  const py::dict dict = fields;
+  for (std::size_t i = 0; i < names.size(); ++i) {
+    if (!dict.contains(names[i]))
+      return false;
+    const py::tuple field = dict[py::str(names[i])];
+    if (!isFloat(field[0]) || field[1].cast<std::size_t>() != i * sizeof(float))
+      return false;
+  }
+  return true;
+}
+
+/**
+ * \brief Number of floats per point of an array if its memory can be used as a span
+ * \return 3, 4 or 0 if the array layout matches none of the point types
+ */
+std::size_t
+pointSize(const py::array& array)
+{
+  if (!(array.flags() & py::array::c_style))
+    return 0;
+  if (array.ndim() == 2 && isFloat(array.dtype()) &&
+      (array.shape(1) == 3 || array.shape(1) == 4))
+    return static_cast<std::size_t>(array.shape(1));
+  if (array.ndim() == 1 && array.itemsize() == 3 * sizeof(float) &&
+      hasFields(array.dtype(), {"x", "y", "z"}))
+    return 3;
+  if (array.ndim() == 1 && array.itemsize() == 4 * sizeof(float) &&
+      hasFields(array.dtype(), {"x", "y", "z", "intensity"}))
+    return 4;
+  return 0;
+}
+
+/** \brief Hand over a vector to numpy without copying its elements. */
+template <typename T, typename Allocator>
+py::array
+toArray(std::vector<T, Allocator>&& vector,
+        const py::dtype& dtype,
+        std::vector<py::ssize_t> shape,
+        std::vector<py::ssize_t> strides)
+{
+  auto* owner = new std::vector<T, Allocator>(std::move(vector));
+  const py::capsule capsule(
+      owner, [](void* data) { delete static_cast<std::vector<T, Allocator>*>(data); });
+  return py::array(dtype, std::move(shape), std::move(strides), owner->data(), capsule);
+}
+
+/** \brief Hand over indices to numpy as an int array without copying. */
+py::array
+toArray(pcl::Indices&& indices)
+{
+  const auto size = static_cast<py::ssize_t>(indices.size());
+  return toArray(std::move(indices),
+                 py::dtype::of<pcl::index_t>(),
+                 {size},
+                 {static_cast<py::ssize_t>(sizeof(pcl::index_t))});
+}
+
+/**
+ * \brief Point cloud span over the memory of a numpy array
+ * \details The span holds a reference to the array, so the memory stays valid as long
+ * as the span exists. Results are returned as numpy arrays over storage moved out of
+ * the algorithms, so nothing is copied on either side.
+ * \tparam PointT point type matching the array layout
+ */
+template <typename PointT>
+class CloudSpan {
+public:
+  using PointCloud = pcl::PointCloud<Spannable<PointT>>;
+
+  explicit CloudSpan(py::array array) : array_(std::move(array))
+  {
+    if (pointSize(array_) != sizeof(PointT) / sizeof(float))
+      throw py::type_error("Array layout does not match the point type");
+    if (array_.shape(0) > std::numeric_limits<std::uint32_t>::max())
+      throw py::value_error("Too many points for a cloud span");
+    if (reinterpret_cast<std::uintptr_t>(array_.data()) % alignof(PointT) != 0)
+      throw py::value_error("Array data is not aligned for the point type");
+    // read-only arrays are spanned too, algorithms writing points span mutable_data()
+    auto span = pcl_cloud_span::makeCloudSpan(static_cast<const PointT*>(array_.data()),
+                                              static_cast<std::uint32_t>(size()));
+    span.setDense(false);
+    cloud_ = span.getCloudPtr();
+  }
+
+  std::size_t
+  size() const
+  {
+    return static_cast<std::size_t>(array_.shape(0));
+  }
+
+  const py::array&
+  array() const
+  {
+    return array_;
+  }
+
+  void
+  transform(const Eigen::Matrix4f& matrix)
+  {
+    if (!array_.writeable())
+      throw py::value_error("Array is read-only");
+    auto* data = static_cast<PointT*>(array_.mutable_data());
+    auto cloud =
+        pcl_cloud_span::makeCloudSpan(data, static_cast<std::uint32_t>(size()));
+    cloud.is_dense = false;
+    const py::gil_scoped_release release;
+    pcl_cloud_span::transformPointCloudInPlace(cloud, matrix);
+  }
+
+  py::array
+  voxelGrid(float leaf_size, unsigned int min_points_per_voxel)
+  {
+    PointCloud output;
+    {
+      const py::gil_scoped_release release;
+      // the finest pyramid level has the centroids of pcl::VoxelGrid and reads only the
+      // fields of points, not 4 floats per point
+      pcl_cloud_span::VoxelPyramid<PointT> pyramid;
+      pyramid.setInputCloud(cloud_);
+      pyramid.setLeafSize(leaf_size);
+      const auto& voxels = *pyramid.getLevel(0);
+      const auto& counts = pyramid.getPointCounts(0);
+      for (std::size_t i = 0; i < voxels.size(); ++i)
+        if (counts[i] >= min_points_per_voxel)
+          output.push_back(voxels[i]);
+    }
+    return toPoints(std::move(output));
+  }
+
+  py::array
+  extract(const py::array_t<pcl::index_t, py::array::c_style | py::array::forcecast>&
+              indices)
+  {
+    PointCloud output;
+    output.resize(static_cast<std::size_t>(indices.size()));
+    const auto* data = indices.data();
+    for (py::ssize_t i = 0; i < indices.size(); ++i) {
+      if (data[i] < 0 || static_cast<std::size_t>(data[i]) >= size())
+        throw py::index_error("Point index out of range");
+      output[static_cast<std::size_t>(i)] =
+          (*cloud_)[static_cast<std::size_t>(data[i])];
+    }
+    return toPoints(std::move(output));
+  }
+
+  py::array
+  statisticalOutlierRemoval(int mean_k, double stddev_mul, unsigned int nr_threads)
+  {
+    pcl::Indices indices;
+    {
+      const py::gil_scoped_release release;
+      pcl_cloud_span::StatisticalOutlierRemoval<PointT> filter;
+      filter.setInputCloud(cloud_);
+      filter.setMeanK(mean_k);
+      filter.setStddevMulThresh(stddev_mul);
+      filter.setNumberOfThreads(nr_threads);
+      filter.filter(indices);
+    }
+    return toArray(std::move(indices));
+  }
+
+  py::array
+  radiusOutlierRemoval(double radius, int min_neighbors, unsigned int nr_threads)
+  {
+    pcl::Indices indices;
+    {
+      const py::gil_scoped_release release;
+      pcl_cloud_span::RadiusOutlierRemoval<PointT> filter;
+      filter.setInputCloud(cloud_);
+      filter.setRadiusSearch(radius);
+      filter.setMinNeighborsInRadius(min_neighbors);
+      filter.setNumberOfThreads(nr_threads);
+      filter.filter(indices);
+    }
+    return toArray(std::move(indices));
+  }
+
+  py::array
+  randomSample(std::size_t count, std::uint64_t seed, unsigned int nr_threads)
+  {
+    pcl::Indices indices;
+    {
+      const py::gil_scoped_release release;
+      pcl_cloud_span::RandomSampling<PointT> sampling;
+      sampling.setSample(count);
+      sampling.setSeed(seed);
+      sampling.setNumberOfThreads(nr_threads);
+      sampling.sample(*cloud_, indices);
+    }
+    return toArray(std::move(indices));
+  }
+
+  py::array
+  uniformSample(float leaf_size, unsigned int nr_threads)
+  {
+    pcl::Indices indices;
+    {
+      const py::gil_scoped_release release;
+      pcl_cloud_span::UniformSampling<PointT> sampling;
+      sampling.setLeafSize(leaf_size);
+      sampling.setNumberOfThreads(nr_threads);
+      sampling.sample(*cloud_, indices);
+    }
+    return toArray(std::move(indices));
+  }
+
+  py::tuple
+  segmentPlane(double distance_threshold,
+               int max_iterations,
+               std::uint64_t seed,
+               unsigned int nr_threads)
+  {
+    pcl::PointIndices inliers;
+    pcl::ModelCoefficients coefficients;
+    {
+      const py::gil_scoped_release release;
+      pcl_cloud_span::PlaneSegmentation<PointT> segmentation;
+      segmentation.setDistanceThreshold(distance_threshold);
+      segmentation.setMaxIterations(max_iterations);
+      segmentation.setSeed(seed);
+      segmentation.setNumberOfThreads(nr_threads);
+      segmentation.segment(*cloud_, inliers, coefficients);
+    }
+    const auto nr_coefficients = static_cast<py::ssize_t>(coefficients.values.size());
+    return py::make_tuple(toArray(std::move(coefficients.values),
+                                  py::dtype::of<float>(),
+                                  {nr_coefficients},
+                                  {static_cast<py::ssize_t>(sizeof(float))}),
+                          toArray(std::move(inliers.indices)));
+  }
+
+  py::tuple
+  euclideanClusters(double tolerance,
+                    std::size_t min_size,
+                    std::size_t max_size,
+                    unsigned int nr_threads)
+  {
+    pcl::Indices indices;
+    std::vector<std::size_t> offsets;
+    {
+      const py::gil_scoped_release release;
+      pcl_cloud_span::EuclideanClusterExtraction<PointT> extraction;
+      extraction.setClusterTolerance(tolerance);
+      extraction.setMinClusterSize(min_size);
+      extraction.setMaxClusterSize(max_size);
+      extraction.setNumberOfThreads(nr_threads);
+      extraction.extract(*cloud_, indices, offsets);
+    }
+    const auto nr_offsets = static_cast<py::ssize_t>(offsets.size());
+    return py::make_tuple(toArray(std::move(indices)),
+                          toArray(std::move(offsets),
+                                  py::dtype::of<std::size_t>(),
+                                  {nr_offsets},
+                                  {static_cast<py::ssize_t>(sizeof(std::size_t))}));
+  }
+
+private:
+  /** \brief Return points in the layout of the input array. */
+  py::array
+  toPoints(PointCloud&& cloud) const
+  {
+    auto points = pcl_cloud_span::convertToPCL(std::move(cloud));
+    const auto size = static_cast<py::ssize_t>(points.size());
+    constexpr auto point_step = static_cast<py::ssize_t>(sizeof(PointT));
+    if (array_.ndim() == 2)
+      return toArray(std::move(points.points),
+                     array_.dtype(),
+                     {size, array_.shape(1)},
+                     {point_step, static_cast<py::ssize_t>(sizeof(float))});
+    return toArray(std::move(points.points), array_.dtype(), {size}, {point_step});
+  }
+
+  py::array array_;
+  typename PointCloud::ConstPtr cloud_;
+};
+
+template <typename PointT>
+void
+bindCloudSpan(py::module_& module, const char* name)
+{
+  using Span = CloudSpan<PointT>;
+  py::class_<Span>(module, name)
+      .def(py::init<py::array>(), py::arg("array"))
+      .def("__len__", &Span::size)
+      .def_property_readonly("array", &Span::array)
+      .def("transform",
+           &Span::transform,
+           py::arg("matrix"),
+           "Transform points in place with a 4x4 rigid transform")
+      .def("voxel_grid",
+           &Span::voxelGrid,
+           py::arg("leaf_size"),
+           py::arg("min_points_per_voxel") = 0,
+           "Downsample to voxel centroids as pcl::VoxelGrid, returns points in the "
+           "input layout")
+      .def("extract",
+           &Span::extract,
+           py::arg("indices"),
+           "Copy points with the given indices into a new array")
+      .def("statistical_outlier_removal",
+           &Span::statisticalOutlierRemoval,
+           py::arg("mean_k"),
+           py::arg("stddev_mul"),
+           py::arg("threads") = 0,
+           "Indices of inliers of statistical outlier removal")
+      .def("radius_outlier_removal",
+           &Span::radiusOutlierRemoval,
+           py::arg("radius"),
+           py::arg("min_neighbors"),
+           py::arg("threads") = 0,
+           "Indices of inliers of radius outlier removal")
+      .def("random_sample",
+           &Span::randomSample,
+           py::arg("count"),
+           py::arg("seed") = 0,
+           py::arg("threads") = 0,
+           "Indices of a random sample of points")
+      .def("uniform_sample",
+           &Span::uniformSample,
+           py::arg("leaf_size"),
+           py::arg("threads") = 0,
+           "Indices of points closest to voxel centers")
+      .def("segment_plane",
+           &Span::segmentPlane,
+           py::arg("distance_threshold"),
+           py::arg("max_iterations") = 1000,
+           py::arg("seed") = 0,
+           py::arg("threads") = 0,
+           "RANSAC plane, returns plane coefficients and inlier indices")
+      .def("euclidean_clusters",
+           &Span::euclideanClusters,
+           py::arg("tolerance"),
+           py::arg("min_size") = 1,
+           py::arg("max_size") = std::numeric_limits<std::size_t>::max(),
+           py::arg("threads") = 0,
+           "Euclidean clusters as point indices and offsets of clusters in them");
+}
+
+} // namespace pcl_cloud_span_python
+
+PYBIND11_MODULE(pcl_cloud_span, module)
+{
+  using namespace pcl_cloud_span_python;
+
+  module.doc() = "Zero-copy point cloud spans over numpy arrays for PCL algorithms";
+
+  bindCloudSpan<PointXYZ>(module, "CloudSpanXYZ");
+  bindCloudSpan<PointXYZI>(module, "CloudSpanXYZI");
+
+  module.def(
+      "cloud_span",
+      [](py::array array) -> py::object {
+        switch (pointSize(array)) {
+        case 3:
+          return py::cast(CloudSpan<PointXYZ>(std::move(array)));
+        case 4:
+          return py::cast(CloudSpan<PointXYZI>(std::move(array)));
+        default:
+          throw py::type_error("Expected a C-contiguous float32 array of shape (N, 3) "
+                               "or (N, 4), or a structured array with float32 fields "
+                               "x, y, z and optionally intensity");
+        }
+      },
+      py::arg("array"),
+      "Create a cloud span over the memory of a numpy array without copying");
+}
@@ -0,0 +1,92 @@
+import unittest
+
+import numpy as np
+
+import pcl_cloud_span
+
+
+class CloudSpanTest(unittest.TestCase):
+    def setUp(self):
+        rng = np.random.default_rng(0)
+        self.points = rng.uniform(-1, 1, (1000, 3)).astype(np.float32)
+
+    def test_span_shares_memory(self):
+        span = pcl_cloud_span.cloud_span(self.points)
+        self.assertIsInstance(span, pcl_cloud_span.CloudSpanXYZ)
+        self.assertEqual(len(span), 1000)
+        self.assertIs(span.array, self.points)
+
+        matrix = np.eye(4, dtype=np.float32)
+        matrix[:3, 3] = [1, 2, 3]
+        expected = self.points + [1, 2, 3]
+        span.transform(matrix)
+        np.testing.assert_allclose(self.points, expected, rtol=1e-6)
+
+    def test_layouts(self):
+        with_intensity = np.zeros((10, 4), dtype=np.float32)
+        self.assertIsInstance(
+            pcl_cloud_span.cloud_span(with_intensity), pcl_cloud_span.CloudSpanXYZI
+        )
+
+        structured = np.zeros(
+            10, dtype=[("x", "f4"), ("y", "f4"), ("z", "f4"), ("intensity", "f4")]
+        )
+        self.assertIsInstance(
+            pcl_cloud_span.cloud_span(structured), pcl_cloud_span.CloudSpanXYZI
+        )
+
+        with self.assertRaises(TypeError):
+            pcl_cloud_span.cloud_span(self.points.astype(np.float64))
+        with self.assertRaises(TypeError):
+            pcl_cloud_span.cloud_span(self.points[::2])
+
+    def test_read_only(self):
+        self.points.flags.writeable = False
+        span = pcl_cloud_span.cloud_span(self.points)
+        self.assertEqual(len(span.random_sample(10)), 10)
+        with self.assertRaises(ValueError):
+            span.transform(np.eye(4, dtype=np.float32))
+
+    def test_voxel_grid(self):
+        span = pcl_cloud_span.cloud_span(self.points)
+        downsampled = span.voxel_grid(0.5)
+        self.assertEqual(downsampled.dtype, np.float32)
+        self.assertEqual(downsampled.shape[1], 3)
+        self.assertGreater(len(downsampled), 0)
+        self.assertLessEqual(len(downsampled), 64)
+
+    def test_voxel_grid_centroids(self):
+        span = pcl_cloud_span.cloud_span(self.points)
+        downsampled = span.voxel_grid(0.5, min_points_per_voxel=20)
+
+        keys, inverse, counts = np.unique(
+            np.floor(self.points * np.float32(2)),
+            axis=0,
+            return_inverse=True,
+            return_counts=True,
+        )
+        sums = np.zeros((len(keys), 3))
+        np.add.at(sums, inverse.ravel(), self.points)
+        expected = (sums / counts[:, None])[counts >= 20]
+        np.testing.assert_allclose(downsampled, expected, rtol=1e-5, atol=1e-6)
+
+    def test_indices(self):
+        span = pcl_cloud_span.cloud_span(self.points)
+        inliers = span.statistical_outlier_removal(8, 1.0)
+        self.assertTrue(np.all(np.diff(inliers) > 0))
+        np.testing.assert_array_equal(span.extract(inliers), self.points[inliers])
+
+        indices, offsets = span.euclidean_clusters(0.2)
+        self.assertEqual(offsets[-1], len(indices))
+        self.assertEqual(len(np.unique(indices)), len(indices))
+
+    def test_segment_plane(self):
+        self.points[:800, 2] = 0.5
+        span = pcl_cloud_span.cloud_span(self.points)
+        coefficients, inliers = span.segment_plane(0.01, seed=1)
+        np.testing.assert_allclose(np.abs(coefficients), [0, 0, 1, 0.5], atol=1e-4)
+        self.assertGreaterEqual(len(inliers), 800)
+
+
+if __name__ == "__main__":
+    unittest.main()
@@ -0,0 +1,127 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2023 Ilia Kovalev
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "test_utils.h"
+
+#include <pcl_cloud_span/change_detector.h>
+
+#include <gmock/gmock.h>
+
+#include <cmath>
+#include <limits>
+#include <map>
+#include <tuple>
+
+using pcl_cloud_span::ChangeDetector;
+
+namespace {
+
+using Key = std::tuple<int, int, int>;
+
+Key
+computeKey(const Point& point, float resolution)
+{
+  return std::make_tuple(static_cast<int>(std::floor(point.x * (1.f / resolution))),
+                         static_cast<int>(std::floor(point.y * (1.f / resolution))),
+                         static_cast<int>(std::floor(point.z * (1.f / resolution))));
+}
+
+std::map<Key, std::size_t>
+countPoints(const Cloud& cloud, float resolution)
+{
+  std::map<Key, std::size_t> counts;
+  for (const auto& point : cloud)
+    ++counts[computeKey(point, resolution)];
+  return counts;
+}
+
+pcl::Indices
+computeDifference(const Cloud& a, const Cloud& b, float resolution, std::size_t min)
+{
+  const auto counts_a = countPoints(a, resolution);
+  const auto counts_b = countPoints(b, resolution);
+  pcl::Indices indices;
+  for (std::size_t i = 0; i < a.size(); ++i) {
+    const auto key = computeKey(a[i], resolution);
+    const auto it = counts_b.find(key);
+    if (counts_a.at(key) >= min && (it == counts_b.end() || it->second < min))
+      indices.push_back(static_cast<pcl::index_t>(i));
+  }
+  return indices;
+}
+
+} // namespace
+
+TEST(ChangeDetectorTest, FindsNewAndRemovedPointsTest)
+{
+  auto previous = makeRandomCloud(100000, -10, 10, 0);
+  auto current = makeRandomCloud(100000, -8, 12, 1);
+
+  ChangeDetector<Point> detector;
+  detector.setResolution(.5f);
+  detector.setNumberOfThreads(3);
+  detector.addFrame(makeCloudSpan(previous.data(), previous.width));
+  EXPECT_FALSE(detector.hasPreviousFrame());
+  detector.addFrame(makeCloudSpan(current.data(), current.width));
+  EXPECT_TRUE(detector.hasPreviousFrame());
+
+  pcl::Indices indices;
+  detector.getNewPoints(indices);
+  EXPECT_EQ(indices, computeDifference(current, previous, .5f, 1));
+  EXPECT_FALSE(indices.empty());
+  detector.getRemovedPoints(indices);
+  EXPECT_EQ(indices, computeDifference(previous, current, .5f, 1));
+  EXPECT_FALSE(indices.empty());
+
+  detector.setMinPointsPerVoxel(3);
+  detector.getNewPoints(indices);
+  EXPECT_EQ(indices, computeDifference(current, previous, .5f, 3));
+  detector.getRemovedPoints(indices);
+  EXPECT_EQ(indices, computeDifference(previous, current, .5f, 3));
+}
+
+TEST(ChangeDetectorTest, StaticSceneHasNoChangesTest)
+{
+  auto frame = makeRandomCloud(1000, -1, 1, 0);
+  frame[5].x = std::numeric_limits<float>::quiet_NaN();
+  auto span = makeCloudSpan(frame.data(), frame.width);
+
+  ChangeDetector<Point> detector;
+  detector.setResolution(.1f);
+  detector.addFrame(span);
+
+  pcl::Indices indices;
+  detector.getNewPoints(indices);
+  EXPECT_EQ(indices.size(), frame.size() - 1);
+
+  detector.addFrame(span);
+  detector.getNewPoints(indices);
+  EXPECT_TRUE(indices.empty());
+  detector.getRemovedPoints(indices);
+  EXPECT_TRUE(indices.empty());
+
+  detector.reset();
+  EXPECT_FALSE(detector.hasPreviousFrame());
+  EXPECT_THROW(detector.setResolution(-1), pcl::BadArgumentException);
+}
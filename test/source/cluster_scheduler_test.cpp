@@ -0,0 +1,124 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2023 Ilia Kovalev
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "test_utils.h"
+
+#include <pcl_cloud_span/cluster_scheduler.h>
+
+#include <gmock/gmock.h>
+
+#include <numeric>
+
+using pcl_cloud_span::ClusterScheduler;
+using pcl_cloud_span::RaggedPointCloud;
+
+namespace {
+
+struct Sum {
+  double intensity = 0;
+  std::size_t count = 0;
+};
+
+RaggedPointCloud<Point>
+makeClusters(const std::vector<std::size_t>& sizes)
+{
+  RaggedPointCloud<Point> clusters;
+  for (const auto size : sizes) {
+    Cloud cloud(static_cast<std::uint32_t>(size), 1, Point{});
+    for (std::size_t i = 0; i < size; ++i)
+      cloud[i].intensity = static_cast<float>(i);
+    clusters.append(cloud);
+  }
+  return clusters;
+}
+
+double
+expectedSum(std::size_t size)
+{
+  return static_cast<double>(size) * static_cast<double>(size - 1) / 2;
+}
+
+} // namespace
+
+TEST(ClusterSchedulerTest, RunsOperationOnEveryClusterTest)
+{
+  const std::vector<std::size_t> sizes = {3, 1000, 1, 20000, 50};
+  auto clusters = makeClusters(sizes);
+
+  ClusterScheduler<Point> scheduler;
+  scheduler.setNumberOfThreads(3);
+  std::vector<Sum> results;
+  scheduler.run(
+      clusters,
+      [](CloudSpan& cluster) {
+        Sum sum;
+        for (const auto& point : cluster)
+          sum.intensity += static_cast<double>(point.intensity);
+        sum.count = cluster.size();
+        return sum;
+      },
+      results);
+
+  ASSERT_EQ(results.size(), sizes.size());
+  for (std::size_t i = 0; i < sizes.size(); ++i) {
+    EXPECT_EQ(results[i].count, sizes[i]);
+    EXPECT_DOUBLE_EQ(results[i].intensity, expectedSum(sizes[i]));
+  }
+}
+
+TEST(ClusterSchedulerTest, SplitsLargeClustersTest)
+{
+  ClusterScheduler<Point> scheduler;
+  scheduler.setNumberOfThreads(2);
+  scheduler.setSplitSize(100);
+  std::vector<Sum> results;
+
+  // the second run reuses partial results of the first one
+  const std::vector<std::vector<std::size_t>> frames = {{10, 1001, 250, 1}, {520, 3}};
+  for (const auto& sizes : frames) {
+    auto clusters = makeClusters(sizes);
+    scheduler.run(
+        clusters,
+        [](CloudSpan& part) {
+          Sum sum;
+          for (const auto& point : part)
+            sum.intensity += static_cast<double>(point.intensity);
+          sum.count = part.size();
+          EXPECT_LE(part.size(), 100u);
+          return sum;
+        },
+        [](Sum& result, const Sum& part) {
+          result.intensity += part.intensity;
+          result.count += part.count;
+        },
+        results);
+
+    ASSERT_EQ(results.size(), sizes.size());
+    for (std::size_t i = 0; i < sizes.size(); ++i) {
+      EXPECT_EQ(results[i].count, sizes[i]);
+      EXPECT_DOUBLE_EQ(results[i].intensity, expectedSum(sizes[i]));
+    }
+  }
+  EXPECT_THROW(scheduler.setSplitSize(0), pcl::BadArgumentException);
+}
@@ -0,0 +1,251 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2023 Ilia Kovalev
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "test_utils.h"
+
+#include <pcl_cloud_span/compressed_point_cloud.h>
+
+#include <gmock/gmock.h>
+
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <sstream>
+
+using pcl_cloud_span::CompressedPointCloud;
+using pcl_cloud_span::CompressionCodec;
+
+namespace {
+
+Cloud
+makeCloud(std::size_t size)
+{
+  auto cloud = Cloud(static_cast<std::uint32_t>(size), 1, Point{});
+  for (std::size_t i = 0; i < size; ++i) {
+    const auto value = static_cast<float>(i);
+    cloud[i] = {0.01f * value, std::sin(0.1f * value), -3.f, static_cast<float>(i % 7)};
+  }
+  cloud.header.frame_id = "frame";
+  cloud.header.stamp = 42;
+  return cloud;
+}
+
+} // namespace
+
+TEST(CompressedPointCloudTest, LosslessTest)
+{
+  auto cloud = makeCloud(1000);
+  cloud[10].x = std::numeric_limits<float>::quiet_NaN();
+  cloud.width = 100;
+  cloud.height = 10;
+  cloud.is_dense = false;
+
+  CompressedPointCloud<Point> compressed;
+  compressed.setChunkSize(128);
+  compressed.setNumberOfThreads(2);
+  compressed.compress(cloud);
+  EXPECT_EQ(compressed.size(), 1000);
+  EXPECT_EQ(compressed.getNumberOfChunks(), 8);
+  EXPECT_EQ(compressed.getChunkSize(7), 1000 - 7 * 128);
+
+  CompressedPointCloud<Point>::VectorType arena;
+  const auto result = compressed.decompress(arena);
+  EXPECT_EQ(result.width, 100);
+  EXPECT_EQ(result.height, 10);
+  EXPECT_FALSE(result.is_dense);
+  EXPECT_EQ(result.header.frame_id, "frame");
+  EXPECT_EQ(result.data(), arena.data());
+  ASSERT_EQ(result.size(), cloud.size());
+  for (std::size_t i = 0; i < cloud.size(); ++i)
+    EXPECT_EQ(std::memcmp(&result[i], &cloud[i], sizeof(Point)), 0) << i;
+}
+
+TEST(CompressedPointCloudTest, QuantizedTest)
+{
+  const auto cloud = makeCloud(5000);
+  const double resolution = 0.001;
+
+  CompressedPointCloud<Point> lossless;
+  lossless.compress(cloud);
+  CompressedPointCloud<Point> compressed;
+  compressed.setResolution(resolution);
+  compressed.setChunkSize(1000);
+  compressed.compress(cloud);
+  EXPECT_LT(compressed.getCompressedSize(), lossless.getCompressedSize());
+  EXPECT_LT(compressed.getCompressedSize(), cloud.size() * sizeof(Point) / 2);
+
+  CompressedPointCloud<Point>::VectorType arena;
+  const auto result = compressed.decompress(arena);
+  ASSERT_EQ(result.size(), cloud.size());
+  const auto tolerance = static_cast<float>(resolution / 2 + 1e-5);
+  for (std::size_t i = 0; i < cloud.size(); ++i) {
+    EXPECT_NEAR(result[i].x, cloud[i].x, tolerance) << i;
+    EXPECT_NEAR(result[i].y, cloud[i].y, tolerance) << i;
+    EXPECT_NEAR(result[i].z, cloud[i].z, tolerance) << i;
+    EXPECT_EQ(result[i].intensity, cloud[i].intensity) << i;
+  }
+}
+
+TEST(CompressedPointCloudTest, ChunkAccessTest)
+{
+  const auto cloud = makeCloud(1000);
+
+  CompressedPointCloud<Point> compressed;
+  compressed.setChunkSize(300);
+  compressed.setResolution(0.01);
+  compressed.compress(cloud);
+  // settings apply to the following compression only
+  compressed.setChunkSize(64);
+  compressed.setResolution(0);
+
+  CompressedPointCloud<Point>::VectorType all;
+  const auto expected = compressed.decompress(all);
+  CompressedPointCloud<Point>::VectorType arena;
+  const auto chunk = compressed.decompressChunk(3, arena);
+  EXPECT_EQ(compressed.getNumberOfChunks(), 4);
+  EXPECT_EQ(compressed.getChunkSize(3), 100);
+  ASSERT_EQ(chunk.size(), 100);
+  EXPECT_EQ(chunk.header.frame_id, "frame");
+  for (std::size_t i = 0; i < chunk.size(); ++i)
+    EXPECT_EQ(chunk[i], expected[900 + i]) << i;
+  EXPECT_THROW(compressed.decompressChunk(4, arena), pcl::BadArgumentException);
+}
+
+TEST(CompressedPointCloudTest, SaveLoadTest)
+{
+  const auto cloud = makeCloud(1000);
+
+  CompressedPointCloud<Point> compressed;
+  compressed.setChunkSize(256);
+  compressed.setResolution(0.001);
+  compressed.compress(cloud);
+  std::stringstream stream;
+  compressed.save(stream);
+
+  CompressedPointCloud<Point> loaded;
+  loaded.setChunkSize(100);
+  loaded.load(stream);
+  EXPECT_EQ(loaded.size(), compressed.size());
+  EXPECT_EQ(loaded.getNumberOfChunks(), compressed.getNumberOfChunks());
+  EXPECT_EQ(loaded.header.stamp, 42);
+
+  CompressedPointCloud<Point>::VectorType expected_arena, arena;
+  const auto expected = compressed.decompress(expected_arena);
+  const auto result = loaded.decompress(arena);
+  ASSERT_EQ(result.size(), expected.size());
+  for (std::size_t i = 0; i < result.size(); ++i)
+    EXPECT_EQ(std::memcmp(&result[i], &expected[i], sizeof(Point)), 0) << i;
+
+  // loading keeps the chunk size set for the following compression
+  loaded.compress(cloud);
+  EXPECT_EQ(loaded.getNumberOfChunks(), 10);
+
+  auto data = stream.str();
+  data.resize(data.size() - 10);
+  std::stringstream truncated(data);
+  EXPECT_THROW(loaded.load(truncated), pcl::IOException);
+  std::stringstream garbage("not a cloud");
+  EXPECT_THROW(loaded.load(garbage), pcl::IOException);
+}
+
+TEST(CompressedPointCloudTest, CodecTest)
+{
+  const auto cloud = makeCloud(5000);
+
+  CompressedPointCloud<Point> run_length;
+  run_length.compress(cloud);
+  CompressedPointCloud<Point> compressed;
+#ifdef PCL_CLOUD_SPAN_WITH_ZSTD
+  compressed.setCodec(CompressionCodec::zstd);
+#else
+  EXPECT_THROW(compressed.setCodec(CompressionCodec::zstd),
+               pcl::BadArgumentException);
+#endif
+  compressed.setChunkSize(1000);
+  compressed.compress(cloud);
+#ifdef PCL_CLOUD_SPAN_WITH_ZSTD
+  EXPECT_LT(compressed.getCompressedSize(), run_length.getCompressedSize());
+#endif
+
+  // chunks of either codec are read regardless of the codec set for compression
+  std::stringstream stream;
+  compressed.save(stream);
+  run_length.load(stream);
+  CompressedPointCloud<Point>::VectorType arena;
+  const auto result = run_length.decompress(arena);
+  ASSERT_EQ(result.size(), cloud.size());
+  for (std::size_t i = 0; i < cloud.size(); ++i)
+    EXPECT_EQ(std::memcmp(&result[i], &cloud[i], sizeof(Point)), 0) << i;
+
+  compressed.setResolution(0.001);
+  compressed.compress(cloud);
+  const auto chunk = compressed.decompressChunk(2, arena);
+  ASSERT_EQ(chunk.size(), 1000);
+  for (std::size_t i = 0; i < chunk.size(); ++i)
+    EXPECT_NEAR(chunk[i].y, cloud[2000 + i].y, 0.00051f) << i;
+}
+
+TEST(CompressedPointCloudTest, VersionOneTest)
+{
+  const auto cloud = makeCloud(1000);
+
+  CompressedPointCloud<Point> compressed;
+  compressed.setResolution(0.001);
+  compressed.compress(cloud);
+  std::stringstream stream;
+  compressed.save(stream);
+
+  // run-length chunks did not change since the first version
+  auto data = stream.str();
+  const std::uint32_t version = 1;
+  std::memcpy(&data[8], &version, sizeof(version));
+  std::stringstream old(data);
+  CompressedPointCloud<Point> loaded;
+  loaded.load(old);
+
+  CompressedPointCloud<Point>::VectorType expected_arena, arena;
+  const auto expected = compressed.decompress(expected_arena);
+  const auto result = loaded.decompress(arena);
+  ASSERT_EQ(result.size(), expected.size());
+  for (std::size_t i = 0; i < result.size(); ++i)
+    EXPECT_EQ(std::memcmp(&result[i], &expected[i], sizeof(Point)), 0) << i;
+
+  const std::uint32_t future = 3;
+  std::memcpy(&data[8], &future, sizeof(future));
+  std::stringstream newer(data);
+  EXPECT_THROW(loaded.load(newer), pcl::IOException);
+}
+
+TEST(CompressedPointCloudTest, EmptyTest)
+{
+  CompressedPointCloud<Point> compressed;
+  EXPECT_THROW(compressed.setChunkSize(0), pcl::BadArgumentException);
+  EXPECT_THROW(compressed.setResolution(-1), pcl::BadArgumentException);
+  compressed.compress(Cloud());
+  EXPECT_TRUE(compressed.empty());
+  EXPECT_EQ(compressed.getNumberOfChunks(), 0);
+
+  CompressedPointCloud<Point>::VectorType arena;
+  EXPECT_TRUE(compressed.decompress(arena).empty());
+}
@@ -0,0 +1,132 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2023 Ilia Kovalev
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "test_utils.h"
+
+#include <pcl_cloud_span/conversions.h>
+
+#include <pcl/conversions.h>
+
+#include <gmock/gmock.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+
+using pcl_cloud_span::convertToPCLPointCloud2;
+using pcl_cloud_span::extractToPCLPointCloud2;
+using pcl_cloud_span::makePCLPointCloud2Span;
+
+namespace {
+
+/** \brief Organized random cloud with a header, as received from a sensor. */
+Cloud
+makeSensorCloud(std::uint32_t width, std::uint32_t height)
+{
+  auto cloud = makeRandomCloud(std::size_t{width} * height, -1, 1, 0);
+  cloud.width = width;
+  cloud.height = height;
+  cloud.header.frame_id = "sensor";
+  cloud.is_dense = false;
+  return cloud;
+}
+
+void
+expectSameMessages(const pcl::PCLPointCloud2& msg, const pcl::PCLPointCloud2& expected)
+{
+  EXPECT_EQ(msg.header.frame_id, expected.header.frame_id);
+  EXPECT_EQ(msg.width, expected.width);
+  EXPECT_EQ(msg.height, expected.height);
+  EXPECT_EQ(msg.point_step, expected.point_step);
+  EXPECT_EQ(msg.row_step, expected.row_step);
+  EXPECT_EQ(msg.is_dense, expected.is_dense);
+  ASSERT_EQ(msg.fields.size(), expected.fields.size());
+  for (std::size_t i = 0; i < msg.fields.size(); ++i) {
+    EXPECT_EQ(msg.fields[i].name, expected.fields[i].name);
+    EXPECT_EQ(msg.fields[i].offset, expected.fields[i].offset);
+    EXPECT_EQ(msg.fields[i].datatype, expected.fields[i].datatype);
+    EXPECT_EQ(msg.fields[i].count, expected.fields[i].count);
+  }
+  EXPECT_THAT(msg.data, ::testing::ContainerEq(expected.data));
+}
+
+} // namespace
+
+TEST(ConversionsTest, ConvertToPCLPointCloud2Test)
+{
+  auto cloud = makeSensorCloud(20, 5);
+  auto span = makeCloudSpan(cloud.data(), cloud.width, cloud.height);
+  span.header = cloud.header;
+  span.is_dense = cloud.is_dense;
+
+  pcl::PCLPointCloud2 expected;
+  pcl::toPCLPointCloud2(cloud, expected);
+
+  expectSameMessages(convertToPCLPointCloud2(span), expected);
+
+  auto moved = convertToPCLPointCloud2(std::move(span));
+  expectSameMessages(moved, expected);
+}
+
+TEST(ConversionsTest, WriteIntoMessageTest)
+{
+  auto cloud = makeSensorCloud(30, 1);
+
+  pcl::PCLPointCloud2 msg;
+  auto span = makePCLPointCloud2Span<Point>(msg, cloud.width);
+  const auto* data = msg.data.data();
+  ASSERT_EQ(span.size(), cloud.size());
+  for (std::size_t i = 0; i < cloud.size(); ++i)
+    span[i] = SpannablePoint(cloud[i]);
+  span.header = cloud.header;
+  span.is_dense = cloud.is_dense;
+
+  convertToPCLPointCloud2(span, msg);
+  EXPECT_EQ(msg.data.data(), data);
+
+  pcl::PCLPointCloud2 expected;
+  pcl::toPCLPointCloud2(cloud, expected);
+  expectSameMessages(msg, expected);
+}
+
+TEST(ConversionsTest, ExtractToPCLPointCloud2Test)
+{
+  auto cloud = makeSensorCloud(10, 10);
+  auto span = makeCloudSpan(cloud.data(), cloud.width, cloud.height);
+  span.header = cloud.header;
+  span.is_dense = cloud.is_dense;
+  const pcl::Indices indices = {3, 1, 4, 15, 92, 65};
+
+  pcl::PCLPointCloud2 msg;
+  extractToPCLPointCloud2(span, indices, msg, 2);
+
+  Cloud selected;
+  for (const auto index : indices)
+    selected.push_back(cloud[static_cast<std::size_t>(index)]);
+  selected.header = cloud.header;
+  selected.is_dense = cloud.is_dense;
+  pcl::PCLPointCloud2 expected;
+  pcl::toPCLPointCloud2(selected, expected);
+  expectSameMessages(msg, expected);
+}
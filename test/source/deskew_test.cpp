@@ -0,0 +1,178 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2023 Ilia Kovalev
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "test_utils.h"
+
+#include <pcl_cloud_span/deskew.h>
+
+#include <gmock/gmock.h>
+
+#include <cstdint>
+#include <limits>
+#include <random>
+
+using pcl_cloud_span::MotionDeskew;
+using pcl_cloud_span::Trajectory;
+
+namespace {
+
+// Intensity holds point timestamps in these tests.
+constexpr auto time_field = "intensity";
+
+Cloud
+makeWorldCloud(std::size_t size)
+{
+  auto cloud = Cloud(static_cast<std::uint32_t>(size), 1, Point{});
+  std::default_random_engine eng(0);
+  std::uniform_real_distribution<float> coord_dis(-10, 10);
+
+  for (std::size_t i = 0; i < size; ++i) {
+    const float time = static_cast<float>(i) / static_cast<float>(size - 1);
+    cloud[i] = {coord_dis(eng), coord_dis(eng), coord_dis(eng), time};
+  }
+  return cloud;
+}
+
+Trajectory::Ptr
+makeTrajectory()
+{
+  auto trajectory = std::make_shared<Trajectory>();
+  for (int i = 0; i <= 4; ++i) {
+    const double time = i * .25;
+    Eigen::Isometry3d pose = Eigen::Isometry3d::Identity();
+    pose.translate(Eigen::Vector3d(2 * time, -time, .5 * time));
+    pose.rotate(Eigen::AngleAxisd(.4 * time, Eigen::Vector3d::UnitZ()));
+    trajectory->addPose(time, pose);
+  }
+  return trajectory;
+}
+
+/** Express world points in the sensor frame at their timestamps. */
+Cloud
+makeSweep(const Cloud& world, const Trajectory& trajectory)
+{
+  auto sweep = world;
+  for (auto& point : sweep) {
+    const Eigen::Isometry3d to_sensor =
+        trajectory.interpolate(point.intensity).inverse();
+    point.getVector3fMap() =
+        (to_sensor * point.getVector3fMap().cast<double>()).cast<float>();
+  }
+  return sweep;
+}
+
+} // namespace
+
+TEST(DeskewTest, TrajectoryInterpolationTest)
+{
+  const auto trajectory = makeTrajectory();
+  const auto pose = trajectory->interpolate(.125);
+  EXPECT_TRUE(pose.translation().isApprox(Eigen::Vector3d(.25, -.125, .0625)));
+  EXPECT_NEAR(Eigen::AngleAxisd(pose.linear()).angle(), .05, 1e-9);
+
+  EXPECT_TRUE(trajectory->interpolate(-1).isApprox(trajectory->interpolate(0)));
+  EXPECT_TRUE(trajectory->interpolate(2).isApprox(trajectory->interpolate(1)));
+  EXPECT_THROW(trajectory->addPose(.5, Eigen::Isometry3d::Identity()),
+               pcl::BadArgumentException);
+}
+
+TEST(DeskewTest, MovesPointsToReferenceFrameTest)
+{
+  const auto trajectory = makeTrajectory();
+  const auto world = makeWorldCloud(10000);
+  auto sweep = makeSweep(world, *trajectory);
+
+  auto span = makeCloudSpan(sweep.data(), sweep.width);
+  MotionDeskew<Point> deskew;
+  deskew.setTrajectory(trajectory);
+  deskew.setTimeField(time_field);
+  deskew.setTimeResolution(1e-6);
+  deskew.setNumberOfThreads(2);
+  deskew.deskew(span);
+
+  // Reference time defaults to the latest point, i.e. the end of the trajectory.
+  const Eigen::Isometry3d to_reference = trajectory->interpolate(1).inverse();
+  for (std::size_t i = 0; i < world.size(); ++i) {
+    const Eigen::Vector3f expected =
+        (to_reference * world[i].getVector3fMap().cast<double>()).cast<float>();
+    ASSERT_TRUE(sweep[i].getVector3fMap().isApprox(expected, 1e-4f)) << i;
+    ASSERT_EQ(sweep[i].intensity, world[i].intensity);
+  }
+}
+
+TEST(DeskewTest, TimeScaleOffsetAndReferenceTest)
+{
+  const auto trajectory = makeTrajectory();
+  const auto world = makeWorldCloud(1000);
+  auto sweep = makeSweep(world, *trajectory);
+  for (auto& point : sweep)
+    point.intensity = (point.intensity - .5f) * 1000; // milliseconds from the middle
+
+  auto span = makeCloudSpan(sweep.data(), sweep.width);
+  MotionDeskew<Point> deskew;
+  deskew.setTrajectory(trajectory);
+  deskew.setTimeField(time_field);
+  deskew.setTimeScale(1e-3);
+  deskew.setTimeOffset(.5);
+  deskew.setReferenceTime(0);
+  deskew.setTimeResolution(1e-6);
+  deskew.deskew(span);
+
+  for (std::size_t i = 0; i < world.size(); ++i)
+    ASSERT_TRUE(sweep[i].getVector3fMap().isApprox(world[i].getVector3fMap(), 1e-4f))
+        << i;
+}
+
+TEST(DeskewTest, SkipsNonFinitePointsTest)
+{
+  const auto trajectory = makeTrajectory();
+  auto sweep = makeWorldCloud(3);
+  const float nan = std::numeric_limits<float>::quiet_NaN();
+  sweep[1].x = nan;
+  sweep[2].intensity = nan;
+  const auto expected = sweep[2];
+
+  auto span = makeCloudSpan(sweep.data(), sweep.width);
+  span.is_dense = false;
+  MotionDeskew<Point> deskew;
+  deskew.setTrajectory(trajectory);
+  deskew.setTimeField(time_field);
+  deskew.deskew(span);
+
+  EXPECT_TRUE(std::isnan(sweep[1].x));
+  EXPECT_TRUE(sweep[2].getVector3fMap().isApprox(expected.getVector3fMap()));
+}
+
+TEST(DeskewTest, ThrowsOnInvalidSetupTest)
+{
+  auto sweep = makeWorldCloud(3);
+  auto span = makeCloudSpan(sweep.data(), sweep.width);
+
+  MotionDeskew<Point> deskew;
+  EXPECT_THROW(deskew.deskew(span), pcl::InitFailedException);
+
+  deskew.setTrajectory(makeTrajectory());
+  EXPECT_THROW(deskew.deskew(span), pcl::BadArgumentException);
+  EXPECT_THROW(deskew.setTimeResolution(0), pcl::BadArgumentException);
+}
@@ -0,0 +1,106 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2023 Ilia Kovalev
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "test_utils.h"
+
+#include <pcl_cloud_span/duplicate_removal.h>
+
+#include <gmock/gmock.h>
+
+#include <cmath>
+#include <cstring>
+#include <random>
+
+using pcl_cloud_span::DuplicateRemoval;
+
+namespace {
+
+/** \brief Indices of first occurrences found by comparing every pair of points. */
+pcl::Indices
+findUniqueNaive(const Cloud& cloud, bool compare_intensity)
+{
+  pcl::Indices indices;
+  for (std::size_t i = 0; i < cloud.size(); ++i) {
+    bool duplicate = false;
+    for (std::size_t j = 0; j < i && !duplicate; ++j)
+      duplicate = std::memcmp(cloud[i].data, cloud[j].data, 3 * sizeof(float)) == 0 &&
+                  (!compare_intensity || std::memcmp(&cloud[i].intensity,
+                                                     &cloud[j].intensity,
+                                                     sizeof(float)) == 0);
+    if (!duplicate)
+      indices.push_back(static_cast<pcl::index_t>(i));
+  }
+  return indices;
+}
+
+} // namespace
+
+TEST(DuplicateRemovalTest, FindUniqueTest)
+{
+  auto cloud = Cloud(2000, 1, Point{});
+  std::default_random_engine eng(0);
+  std::uniform_int_distribution<int> dis(0, 9);
+  for (auto& point : cloud)
+    point = {static_cast<float>(dis(eng)),
+             static_cast<float>(dis(eng)),
+             static_cast<float>(dis(eng) / 5),
+             static_cast<float>(dis(eng) / 5)};
+  // padding does not take part in comparison
+  cloud[1] = cloud[0];
+  cloud[1].data[3] = 5;
+  const auto span = makeCloudSpan(cloud.data(), cloud.width);
+
+  DuplicateRemoval<Point> removal;
+  removal.setNumberOfThreads(2);
+  pcl::Indices indices;
+  removal.findUnique(span, indices);
+  EXPECT_EQ(indices, findUniqueNaive(cloud, true));
+  EXPECT_EQ(indices[1], 2);
+
+  removal.setFields({"x", "y", "z"});
+  removal.findUnique(span, indices);
+  EXPECT_EQ(indices, findUniqueNaive(cloud, false));
+  EXPECT_THROW(removal.setFields({"normal_x"}), pcl::BadArgumentException);
+}
+
+TEST(DuplicateRemovalTest, RemoveInPlaceTest)
+{
+  auto cloud = Cloud(100, 1, Point{});
+  for (std::size_t i = 0; i < cloud.size(); ++i)
+    cloud[i] = {static_cast<float>(i % 30), 1, 2, 3};
+  cloud[99].x = -0.f;
+  cloud.header.frame_id = "frame";
+  auto span = makeCloudSpan(cloud.data(), cloud.width);
+  span.header = cloud.header;
+
+  DuplicateRemoval<Point> removal;
+  const auto unique = removal.removeInPlace(span);
+  // -0 differs from 0 bitwise
+  ASSERT_EQ(unique.size(), 31);
+  EXPECT_EQ(unique.data(), span.data());
+  EXPECT_EQ(unique.header.frame_id, "frame");
+  for (std::size_t i = 0; i < 30; ++i)
+    EXPECT_EQ(unique[i].x, static_cast<float>(i)) << i;
+  EXPECT_TRUE(std::signbit(unique[30].x));
+}
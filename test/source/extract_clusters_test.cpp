@@ -0,0 +1,200 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2023 Ilia Kovalev
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "test_utils.h"
+
+#include <pcl_cloud_span/extract_clusters.h>
+
+#include <pcl/segmentation/extract_clusters.h>
+
+#include <gmock/gmock.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <limits>
+#include <random>
+
+using pcl_cloud_span::EuclideanClusterExtraction;
+using pcl_cloud_span::RaggedPointCloud;
+
+namespace {
+
+// blobs of different sizes and density plus sparse background points around offset
+Cloud
+makeClusteredCloud(float offset = 0)
+{
+  Cloud cloud;
+  std::default_random_engine eng(0);
+  std::normal_distribution<float> blob_dis(0, .15f);
+  std::uniform_real_distribution<float> coord_dis(offset - 10, offset + 10);
+
+  for (int blob = 0; blob < 20; ++blob) {
+    const Point center{coord_dis(eng), coord_dis(eng), coord_dis(eng)};
+    for (int i = 0; i < 10 + 15 * blob; ++i)
+      cloud.push_back({center.x + blob_dis(eng),
+                       center.y + blob_dis(eng),
+                       center.z + blob_dis(eng),
+                       static_cast<float>(blob)});
+  }
+  for (int i = 0; i < 500; ++i)
+    cloud.push_back({coord_dis(eng), coord_dis(eng), coord_dis(eng), -1});
+  std::shuffle(cloud.begin(), cloud.end(), eng);
+  return cloud;
+}
+
+std::vector<pcl::Indices>
+sortClusters(const std::vector<pcl::PointIndices>& clusters)
+{
+  std::vector<pcl::Indices> result;
+  for (const auto& cluster : clusters)
+    result.push_back(cluster.indices);
+  std::sort(result.begin(), result.end());
+  return result;
+}
+
+} // namespace
+
+TEST(ExtractClustersTest, ExtractTest)
+{
+  const auto cloud = std::make_shared<Cloud>(makeClusteredCloud());
+  const auto span = makeCloudSpan(cloud->data(), cloud->width);
+
+  for (const double tolerance : {.05, .2, .5, 1.5}) {
+    EuclideanClusterExtraction<Point> extraction;
+    extraction.setClusterTolerance(tolerance);
+    extraction.setNumberOfThreads(4);
+    std::vector<pcl::PointIndices> clusters;
+    extraction.extract(span, clusters);
+
+    pcl::EuclideanClusterExtraction<Point> pcl_extraction;
+    pcl_extraction.setInputCloud(cloud);
+    pcl_extraction.setClusterTolerance(tolerance);
+    std::vector<pcl::PointIndices> expected;
+    pcl_extraction.extract(expected);
+
+    EXPECT_THAT(sortClusters(clusters), ::testing::ContainerEq(sortClusters(expected)))
+        << "tolerance " << tolerance;
+    EXPECT_TRUE(std::is_sorted(
+        clusters.begin(),
+        clusters.end(),
+        [](const pcl::PointIndices& a, const pcl::PointIndices& b) {
+          return a.indices.size() > b.indices.size();
+        }));
+  }
+}
+
+TEST(ExtractClustersTest, FarFromOriginTest)
+{
+  // float spacing far from zero is a noticeable fraction of small tolerances
+  const auto cloud = std::make_shared<Cloud>(makeClusteredCloud(-30000));
+  const auto span = makeCloudSpan(cloud->data(), cloud->width);
+
+  for (const double tolerance : {.05, .2}) {
+    EuclideanClusterExtraction<Point> extraction;
+    extraction.setClusterTolerance(tolerance);
+    extraction.setNumberOfThreads(4);
+    std::vector<pcl::PointIndices> clusters;
+    extraction.extract(span, clusters);
+
+    pcl::EuclideanClusterExtraction<Point> pcl_extraction;
+    pcl_extraction.setInputCloud(cloud);
+    pcl_extraction.setClusterTolerance(tolerance);
+    std::vector<pcl::PointIndices> expected;
+    pcl_extraction.extract(expected);
+
+    EXPECT_THAT(sortClusters(clusters), ::testing::ContainerEq(sortClusters(expected)))
+        << "tolerance " << tolerance;
+  }
+}
+
+TEST(ExtractClustersTest, ClusterSizeTest)
+{
+  auto cloud = std::make_shared<Cloud>(makeClusteredCloud());
+  (*cloud)[3].z = std::numeric_limits<float>::quiet_NaN();
+  (*cloud)[7].x = std::numeric_limits<float>::infinity();
+  const auto span = makeCloudSpan(cloud->data(), cloud->width);
+
+  EuclideanClusterExtraction<Point> extraction;
+  extraction.setClusterTolerance(.3);
+  extraction.setMinClusterSize(40);
+  extraction.setMaxClusterSize(200);
+  std::vector<pcl::PointIndices> clusters;
+  extraction.extract(span, clusters);
+
+  pcl::EuclideanClusterExtraction<Point> pcl_extraction;
+  pcl_extraction.setInputCloud(cloud);
+  pcl_extraction.setClusterTolerance(.3);
+  pcl_extraction.setMinClusterSize(40);
+  pcl_extraction.setMaxClusterSize(200);
+  std::vector<pcl::PointIndices> expected;
+  pcl_extraction.extract(expected);
+
+  ASSERT_FALSE(clusters.empty());
+  EXPECT_THAT(sortClusters(clusters), ::testing::ContainerEq(sortClusters(expected)));
+}
+
+TEST(ExtractClustersTest, OutputFormsTest)
+{
+  auto cloud = makeClusteredCloud();
+  const auto span = makeCloudSpan(cloud.data(), cloud.width);
+
+  EuclideanClusterExtraction<Point> extraction;
+  extraction.setClusterTolerance(.3);
+  extraction.setMinClusterSize(5);
+  pcl::Indices indices;
+  std::vector<std::size_t> offsets;
+  extraction.extract(span, indices, offsets);
+
+  extraction.setNumberOfThreads(4);
+  std::vector<pcl::PointIndices> clusters;
+  extraction.extract(span, clusters);
+  RaggedPointCloud<Point> ragged;
+  extraction.extract(span, ragged);
+
+  ASSERT_EQ(offsets.size(), clusters.size() + 1);
+  ASSERT_EQ(ragged.size(), clusters.size());
+  EXPECT_EQ(offsets.back(), indices.size());
+  for (std::size_t i = 0; i < clusters.size(); ++i) {
+    const pcl::Indices range(indices.begin() + static_cast<std::ptrdiff_t>(offsets[i]),
+                             indices.begin() +
+                                 static_cast<std::ptrdiff_t>(offsets[i + 1]));
+    EXPECT_THAT(range, ::testing::ContainerEq(clusters[i].indices));
+
+    const auto cluster = ragged.at(i);
+    ASSERT_EQ(cluster.size(), range.size());
+    for (std::size_t j = 0; j < range.size(); ++j)
+      EXPECT_EQ(cluster[j], span[static_cast<std::size_t>(range[j])]);
+  }
+}
+
+TEST(ExtractClustersTest, NoToleranceTest)
+{
+  auto cloud = makeClusteredCloud();
+  const auto span = makeCloudSpan(cloud.data(), cloud.width);
+
+  EuclideanClusterExtraction<Point> extraction;
+  std::vector<pcl::PointIndices> clusters;
+  EXPECT_THROW(extraction.extract(span, clusters), pcl::InitFailedException);
+  EXPECT_THROW(extraction.setClusterTolerance(0), pcl::BadArgumentException);
+}
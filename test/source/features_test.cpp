@@ -0,0 +1,255 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2023 Ilia Kovalev
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "test_utils.h"
+
+#include <pcl_cloud_span/features.h>
+
+#include <gmock/gmock.h>
+
+#include <memory>
+
+using SpannableNormal = Spannable<pcl::Normal>;
+using SpannableFPFH = Spannable<pcl::FPFHSignature33>;
+using SpannableSHOT = Spannable<pcl::SHOT352>;
+
+POINT_CLOUD_REGISTER_POINT_STRUCT(
+    SpannableNormal,
+    (float, normal_x, normal_x)(float, normal_y, normal_y)(float, normal_z, normal_z)(
+        float, curvature, curvature))
+
+POINT_CLOUD_REGISTER_POINT_STRUCT(SpannableFPFH, (float[33], histogram, fpfh))
+
+POINT_CLOUD_REGISTER_POINT_STRUCT(SpannableSHOT,
+                                  (float[9], rf, rf)(float[352], descriptor, shot))
+
+namespace {
+
+/** \brief Random points in a thin slab, so that normals are well defined. */
+Cloud::Ptr
+makeSlab(std::size_t size)
+{
+  const auto cloud = std::make_shared<Cloud>(makeRandomCloud(size, -1, 1, 0));
+  for (auto& point : *cloud)
+    point.z *= .1f;
+  return cloud;
+}
+
+pcl::PointCloud<pcl::Normal>::Ptr
+computeNormals(const Cloud::ConstPtr& cloud)
+{
+  pcl::NormalEstimation<Point, pcl::Normal> estimation;
+  estimation.setInputCloud(cloud);
+  estimation.setKSearch(10);
+  const auto normals = std::make_shared<pcl::PointCloud<pcl::Normal>>();
+  estimation.compute(*normals);
+  return normals;
+}
+
+} // namespace
+
+TEST(FeaturesTest, NormalEstimationInPlaceTest)
+{
+  const auto in_cloud = makeSlab(300);
+  const auto in_cloud_span = std::make_shared<const CloudSpan>(
+      makeCloudSpan(in_cloud->data(), in_cloud->width));
+
+  pcl::PointCloud<pcl::Normal> out_buffer(in_cloud->width, 1);
+  auto out = makeCloudSpan(out_buffer.data(), out_buffer.width);
+
+  pcl_cloud_span::NormalEstimationOMP<Point> estimation_span(2);
+  estimation_span.setInputCloud(in_cloud_span);
+  estimation_span.setKSearch(10);
+  estimation_span.computeInPlace(out);
+
+  pcl::NormalEstimationOMP<Point, pcl::Normal> estimation(2);
+  estimation.setInputCloud(in_cloud);
+  estimation.setKSearch(10);
+  pcl::PointCloud<pcl::Normal> expected;
+  estimation.compute(expected);
+
+  ASSERT_EQ(out.data(), reinterpret_cast<SpannableNormal*>(out_buffer.data()));
+  ASSERT_EQ(out_buffer.size(), expected.size());
+  for (std::size_t i = 0; i < expected.size(); ++i) {
+    EXPECT_NEAR(out_buffer[i].normal_x, expected[i].normal_x, 1e-4);
+    EXPECT_NEAR(out_buffer[i].normal_y, expected[i].normal_y, 1e-4);
+    EXPECT_NEAR(out_buffer[i].normal_z, expected[i].normal_z, 1e-4);
+    EXPECT_NEAR(out_buffer[i].curvature, expected[i].curvature, 1e-4);
+  }
+  EXPECT_EQ(in_cloud->data(), in_cloud_span->data());
+}
+
+TEST(FeaturesTest, NormalEstimationOutputSizeMismatchTest)
+{
+  const auto in_cloud = makeSlab(100);
+  const auto in_cloud_span = std::make_shared<const CloudSpan>(
+      makeCloudSpan(in_cloud->data(), in_cloud->width));
+
+  pcl::PointCloud<pcl::Normal> out_buffer(in_cloud->width - 1, 1);
+  auto out = makeCloudSpan(out_buffer.data(), out_buffer.width);
+
+  pcl_cloud_span::NormalEstimationOMP<Point> estimation;
+  estimation.setInputCloud(in_cloud_span);
+  estimation.setKSearch(10);
+  EXPECT_THROW(estimation.computeInPlace(out), pcl::BadArgumentException);
+}
+
+TEST(FeaturesTest, FPFHEstimationInPlaceTest)
+{
+  const auto in_cloud = makeSlab(300);
+  const auto in_normals = computeNormals(in_cloud);
+  const auto in_cloud_span = std::make_shared<const CloudSpan>(
+      makeCloudSpan(in_cloud->data(), in_cloud->width));
+  const auto in_normals_span = std::make_shared<const pcl::PointCloud<SpannableNormal>>(
+      makeCloudSpan(in_normals->data(), in_normals->width));
+
+  pcl::PointCloud<pcl::FPFHSignature33> out_buffer(in_cloud->width, 1);
+  auto out = makeCloudSpan(out_buffer.data(), out_buffer.width);
+
+  pcl_cloud_span::FPFHEstimationOMP<Point> estimation_span(2);
+  estimation_span.setInputCloud(in_cloud_span);
+  estimation_span.setInputNormals(in_normals_span);
+  estimation_span.setRadiusSearch(.3);
+  estimation_span.computeInPlace(out);
+
+  pcl::FPFHEstimationOMP<Point, pcl::Normal, pcl::FPFHSignature33> estimation(2);
+  estimation.setInputCloud(in_cloud);
+  estimation.setInputNormals(in_normals);
+  estimation.setRadiusSearch(.3);
+  pcl::PointCloud<pcl::FPFHSignature33> expected;
+  estimation.compute(expected);
+
+  ASSERT_EQ(out.data(), reinterpret_cast<SpannableFPFH*>(out_buffer.data()));
+  ASSERT_EQ(out_buffer.size(), expected.size());
+  for (std::size_t i = 0; i < expected.size(); ++i)
+    for (std::size_t d = 0; d < 33; ++d)
+      EXPECT_NEAR(out_buffer[i].histogram[d], expected[i].histogram[d], 1e-3);
+  EXPECT_EQ(in_cloud->data(), in_cloud_span->data());
+  EXPECT_EQ(in_normals->data(), in_normals_span->data());
+}
+
+TEST(FeaturesTest, SHOTEstimationInPlaceTest)
+{
+  const auto in_cloud = makeSlab(300);
+  const auto in_normals = computeNormals(in_cloud);
+  const auto in_cloud_span = std::make_shared<const CloudSpan>(
+      makeCloudSpan(in_cloud->data(), in_cloud->width));
+  const auto in_normals_span = std::make_shared<const pcl::PointCloud<SpannableNormal>>(
+      makeCloudSpan(in_normals->data(), in_normals->width));
+
+  pcl::PointCloud<pcl::SHOT352> out_buffer(in_cloud->width, 1);
+  auto out = makeCloudSpan(out_buffer.data(), out_buffer.width);
+
+  pcl_cloud_span::SHOTEstimationOMP<Point> estimation_span(2);
+  estimation_span.setInputCloud(in_cloud_span);
+  estimation_span.setInputNormals(in_normals_span);
+  estimation_span.setRadiusSearch(.4);
+  estimation_span.computeInPlace(out);
+
+  pcl::SHOTEstimationOMP<Point, pcl::Normal, pcl::SHOT352> estimation(2);
+  estimation.setInputCloud(in_cloud);
+  estimation.setInputNormals(in_normals);
+  estimation.setRadiusSearch(.4);
+  pcl::PointCloud<pcl::SHOT352> expected;
+  estimation.compute(expected);
+
+  ASSERT_EQ(out.data(), reinterpret_cast<SpannableSHOT*>(out_buffer.data()));
+  ASSERT_EQ(out_buffer.size(), expected.size());
+  for (std::size_t i = 0; i < expected.size(); ++i)
+    for (std::size_t d = 0; d < 352; ++d)
+      EXPECT_NEAR(out_buffer[i].descriptor[d], expected[i].descriptor[d], 1e-3);
+  EXPECT_EQ(in_cloud->data(), in_cloud_span->data());
+}
+
+TEST(FeaturesTest, SHOTEstimationReferenceFramesTest)
+{
+  const auto in_cloud = makeSlab(300);
+  const auto in_normals = computeNormals(in_cloud);
+  const auto in_cloud_span = std::make_shared<const CloudSpan>(
+      makeCloudSpan(in_cloud->data(), in_cloud->width));
+  const auto in_normals_span = std::make_shared<const pcl::PointCloud<SpannableNormal>>(
+      makeCloudSpan(in_normals->data(), in_normals->width));
+  const auto expectEqual = [](const pcl::PointCloud<pcl::SHOT352>& out,
+                              const pcl::PointCloud<pcl::SHOT352>& expected) {
+    ASSERT_EQ(out.size(), expected.size());
+    for (std::size_t i = 0; i < expected.size(); ++i) {
+      for (std::size_t d = 0; d < 9; ++d)
+        EXPECT_NEAR(out[i].rf[d], expected[i].rf[d], 1e-4);
+      for (std::size_t d = 0; d < 352; ++d)
+        EXPECT_NEAR(out[i].descriptor[d], expected[i].descriptor[d], 1e-3);
+    }
+  };
+
+  pcl::SHOTEstimationOMP<Point, pcl::Normal, pcl::SHOT352> estimation(2);
+  estimation.setInputCloud(in_cloud);
+  estimation.setInputNormals(in_normals);
+  estimation.setRadiusSearch(.4);
+  estimation.setLRFRadius(.2f);
+  pcl::PointCloud<pcl::SHOT352> expected;
+  estimation.compute(expected);
+
+  // frames are estimated with the span kd-tree for every input
+  pcl_cloud_span::SHOTEstimationOMP<Point> estimation_span(2);
+  estimation_span.setInputCloud(in_cloud_span);
+  estimation_span.setInputNormals(in_normals_span);
+  estimation_span.setRadiusSearch(.4);
+  estimation_span.setLRFRadius(.2f);
+  pcl::PointCloud<pcl::SHOT352> out_buffer(in_cloud->width, 1);
+  auto out = makeCloudSpan(out_buffer.data(), out_buffer.width);
+  estimation_span.computeInPlace(out);
+  expectEqual(out_buffer, expected);
+
+  const auto indices = std::make_shared<pcl::Indices>();
+  for (pcl::index_t i = 0; i < 300; i += 3)
+    indices->push_back(i);
+  estimation.setIndices(indices);
+  estimation.compute(expected);
+  estimation_span.setIndices(indices);
+  pcl::PointCloud<pcl::SHOT352> subset_buffer(100, 1);
+  auto subset = makeCloudSpan(subset_buffer.data(), subset_buffer.width);
+  estimation_span.computeInPlace(subset);
+  expectEqual(subset_buffer, expected);
+
+  // frames set by the user are used as given
+  pcl::SHOTLocalReferenceFrameEstimation<Point, pcl::ReferenceFrame> lrf;
+  lrf.setInputCloud(in_cloud);
+  lrf.setRadiusSearch(.2);
+  const auto frames = std::make_shared<pcl::PointCloud<pcl::ReferenceFrame>>();
+  lrf.compute(*frames);
+  pcl::SHOTEstimationOMP<Point, pcl::Normal, pcl::SHOT352> given_estimation(2);
+  given_estimation.setInputCloud(in_cloud);
+  given_estimation.setInputNormals(in_normals);
+  given_estimation.setRadiusSearch(.4);
+  given_estimation.setInputReferenceFrames(frames);
+  given_estimation.compute(expected);
+
+  pcl_cloud_span::SHOTEstimationOMP<Point> given_frames(2);
+  given_frames.setInputCloud(in_cloud_span);
+  given_frames.setInputNormals(in_normals_span);
+  given_frames.setRadiusSearch(.4);
+  given_frames.setLRFRadius(.3f);
+  given_frames.setInputReferenceFrames(frames);
+  given_frames.computeInPlace(out);
+  expectEqual(out_buffer, expected);
+}
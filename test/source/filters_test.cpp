@@ -22,11 +22,7 @@
  * SOFTWARE.
  */
 
-#ifdef _MSC_VER
-typedef unsigned long long pop_t;
-#endif // _MSC_VER
-
-#include <pcl_cloud_span/pcl_cloud_span.h>
+#include "test_utils.h"
 
 #include <pcl/filters/approximate_voxel_grid.h>
 #include <pcl/filters/bilateral.h>
@@ -39,28 +35,6 @@ typedef unsigned long long pop_t;
 
 #include <random>
 
-using pcl_cloud_span::convertToPCL;
-using pcl_cloud_span::makeCloudSpan;
-using pcl_cloud_span::Spannable;
-
-using Point = pcl::PointXYZI;
-using SpannablePoint = Spannable<Point>;
-using CloudSpan = pcl::PointCloud<SpannablePoint>;
-using Cloud = pcl::PointCloud<Point>;
-
-POINT_CLOUD_REGISTER_POINT_STRUCT(SpannablePoint,
-                                  (float, x, x)(float, y, y)(float, z, z)(float,
-                                                                          intensity,
-                                                                          intensity))
-
-namespace pcl {
-bool
-operator==(const Point& a, const Point& b)
-{
-  return a.getArray4fMap().isApprox(b.getArray4fMap());
-}
-} // namespace pcl
-
 TEST(FilterTest, ApproximateVoxelGridTest)
 {
   const auto in_cloud = std::make_shared<Cloud>(100, 1, Point{});
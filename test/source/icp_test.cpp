@@ -0,0 +1,128 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2023 Ilia Kovalev
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "test_utils.h"
+
+#include <pcl_cloud_span/icp.h>
+
+#include <gmock/gmock.h>
+
+#include <limits>
+
+namespace {
+
+/** \brief Random points in a slab, denser towards its middle plane. */
+Cloud
+makeSlab()
+{
+  auto cloud = makeRandomCloud(2000, -1, 1, 0);
+  for (auto& point : cloud)
+    point.z *= .5f * (2 * point.intensity - 1);
+  return cloud;
+}
+
+Eigen::Matrix4f
+makeTransform()
+{
+  const Eigen::Affine3f transform =
+      Eigen::Translation3f(.05f, -.03f, .02f) *
+      Eigen::AngleAxisf(.05f, Eigen::Vector3f(1, 2, 3).normalized());
+  return transform.matrix();
+}
+
+} // namespace
+
+TEST(IcpTest, RecoversTransformationTest)
+{
+  auto target = makeSlab();
+  auto source = target;
+  const Eigen::Matrix4f transform = makeTransform();
+  const Eigen::Matrix4f inverse = transform.inverse();
+  for (auto& point : source)
+    point.getVector3fMap() =
+        inverse.block<3, 3>(0, 0) * point.getVector3fMap() + inverse.block<3, 1>(0, 3);
+
+  const auto target_span =
+      std::make_shared<const CloudSpan>(makeCloudSpan(target.data(), target.width));
+  const auto source_span =
+      std::make_shared<const CloudSpan>(makeCloudSpan(source.data(), source.width));
+
+  pcl_cloud_span::IterativeClosestPoint<Point> icp;
+  icp.setInputTarget(target_span);
+  icp.setInputSource(source_span);
+  icp.setMaximumIterations(50);
+  icp.setMaxCorrespondenceDistance(.5);
+  icp.setTransformationEpsilon(1e-10);
+  icp.setNumberOfThreads(2);
+
+  Cloud out_buffer(source.width, 1);
+  auto out = makeCloudSpan(out_buffer.data(), out_buffer.width);
+  icp.align(out);
+
+  EXPECT_TRUE(icp.hasConverged());
+  EXPECT_TRUE(icp.getFinalTransformation().isApprox(transform, 1e-3f));
+  EXPECT_LT(icp.getFitnessScore(), 1e-6);
+  EXPECT_THAT(out_buffer.points, ::testing::ContainerEq(target.points));
+  EXPECT_EQ(out.data(), reinterpret_cast<SpannablePoint*>(out_buffer.data()));
+  EXPECT_EQ(source.data(), reinterpret_cast<const Point*>(source_span->data()));
+}
+
+TEST(IcpTest, NonDenseSourceTest)
+{
+  auto target = makeSlab();
+  auto source = target;
+  const Eigen::Matrix4f transform = makeTransform();
+  const Eigen::Matrix4f inverse = transform.inverse();
+  for (auto& point : source)
+    point.getVector3fMap() =
+        inverse.block<3, 3>(0, 0) * point.getVector3fMap() + inverse.block<3, 1>(0, 3);
+  for (std::size_t i = 0; i < source.size(); i += 10)
+    source[i].x = std::numeric_limits<float>::quiet_NaN();
+  source.is_dense = false;
+
+  const auto target_span =
+      std::make_shared<const CloudSpan>(makeCloudSpan(target.data(), target.width));
+  auto source_span = makeCloudSpan(source.data(), source.width);
+  source_span.is_dense = false;
+
+  pcl_cloud_span::IterativeClosestPoint<Point> icp;
+  icp.setInputTarget(target_span);
+  icp.setInputSource(std::make_shared<const CloudSpan>(std::move(source_span)));
+  icp.setMaximumIterations(50);
+  icp.setMaxCorrespondenceDistance(.5);
+  icp.setTransformationEpsilon(1e-10);
+  icp.setNumberOfThreads(2);
+  icp.align();
+
+  EXPECT_TRUE(icp.hasConverged());
+  EXPECT_TRUE(icp.getFinalTransformation().isApprox(transform, 1e-3f));
+  for (std::size_t i = 0; i < source.size(); ++i) {
+    if (i % 10 == 0) {
+      EXPECT_EQ(icp.getCorrespondences()[i], -1);
+    }
+    else {
+      EXPECT_GE(icp.getCorrespondences()[i], 0);
+    }
+  }
+}
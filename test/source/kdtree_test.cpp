@@ -0,0 +1,122 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2023 Ilia Kovalev
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "test_utils.h"
+
+#include <pcl_cloud_span/kdtree.h>
+
+#include <gmock/gmock.h>
+
+#include <algorithm>
+#include <numeric>
+#include <random>
+
+using pcl_cloud_span::search::KdTree;
+
+namespace {
+
+std::vector<std::pair<float, pcl::index_t>>
+bruteForce(const Cloud& cloud, const Point& query)
+{
+  std::vector<std::pair<float, pcl::index_t>> result;
+  for (std::size_t i = 0; i < cloud.size(); ++i) {
+    const float dx = cloud[i].x - query.x;
+    const float dy = cloud[i].y - query.y;
+    const float dz = cloud[i].z - query.z;
+    result.emplace_back(dx * dx + dy * dy + dz * dz, static_cast<pcl::index_t>(i));
+  }
+  std::sort(result.begin(), result.end());
+  return result;
+}
+
+} // namespace
+
+TEST(KdTreeTest, NearestKSearchTest)
+{
+  const auto in_cloud = std::make_shared<Cloud>(1000, 1, Point{});
+  std::default_random_engine eng(0);
+  std::uniform_real_distribution<float> dis(-1, 1);
+
+  std::generate(in_cloud->begin(), in_cloud->end(), [&]() -> Point {
+    return {dis(eng), dis(eng), dis(eng)};
+  });
+
+  const auto in_cloud_span = std::make_shared<const CloudSpan>(
+      makeCloudSpan(in_cloud->data(), in_cloud->width));
+
+  KdTree<SpannablePoint> tree;
+  tree.setInputCloud(in_cloud_span);
+
+  for (std::size_t q = 0; q < 20; ++q) {
+    const Point query{dis(eng), dis(eng), dis(eng)};
+    const auto expected = bruteForce(*in_cloud, query);
+
+    pcl::Indices indices;
+    std::vector<float> distances;
+    ASSERT_EQ(tree.nearestKSearch(SpannablePoint{query}, 10, indices, distances), 10);
+    for (std::size_t i = 0; i < 10; ++i) {
+      EXPECT_EQ(indices[i], expected[i].second);
+      EXPECT_EQ(distances[i], expected[i].first);
+    }
+
+    pcl::index_t nearest;
+    float distance;
+    ASSERT_TRUE(tree.nearestSearch(SpannablePoint{query}, nearest, distance));
+    EXPECT_EQ(nearest, expected[0].second);
+  }
+  EXPECT_EQ(in_cloud->data(), in_cloud_span->data());
+}
+
+TEST(KdTreeTest, RadiusSearchTest)
+{
+  const auto in_cloud = std::make_shared<Cloud>(1000, 1, Point{});
+  std::default_random_engine eng(0);
+  std::uniform_real_distribution<float> dis(-1, 1);
+
+  std::generate(in_cloud->begin(), in_cloud->end(), [&]() -> Point {
+    return {dis(eng), dis(eng), dis(eng)};
+  });
+  (*in_cloud)[0].x = std::numeric_limits<float>::quiet_NaN();
+
+  const auto in_cloud_span = std::make_shared<const CloudSpan>(
+      makeCloudSpan(in_cloud->data(), in_cloud->width));
+
+  KdTree<SpannablePoint> tree;
+  tree.setInputCloud(in_cloud_span);
+
+  for (std::size_t q = 0; q < 20; ++q) {
+    const Point query{dis(eng), dis(eng), dis(eng)};
+    const auto all = bruteForce(*in_cloud, query);
+    pcl::Indices expected;
+    for (const auto& neighbor : all)
+      if (neighbor.first <= .3f * .3f)
+        expected.push_back(neighbor.second);
+
+    pcl::Indices indices;
+    std::vector<float> distances;
+    tree.radiusSearch(SpannablePoint{query}, .3, indices, distances);
+    EXPECT_THAT(indices, ::testing::ContainerEq(expected));
+    EXPECT_TRUE(std::is_sorted(distances.begin(), distances.end()));
+  }
+}
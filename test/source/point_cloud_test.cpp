@@ -0,0 +1,178 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2023 Ilia Kovalev
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "test_utils.h"
+
+#include <pcl_cloud_span/duplicate_removal.h>
+#include <pcl_cloud_span/sampling.h>
+#include <pcl_cloud_span/selection.h>
+#include <pcl_cloud_span/zone_map.h>
+
+#include <gmock/gmock.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <type_traits>
+
+using pcl_cloud_span::LargeIndices;
+using pcl_cloud_span::makeCloudSpanChunks;
+using pcl_cloud_span::makeCloudSpanPtr;
+
+TEST(PointCloudTest, LargeDimensionsTest)
+{
+  if (sizeof(std::size_t) < sizeof(std::uint64_t))
+    return;
+
+  // points are never accessed, the span only has to report its size
+  Point point;
+  const auto cloud = makeCloudSpan(&point, 1u << 20, 1u << 13);
+  EXPECT_EQ(cloud.size(), std::size_t{1} << 33);
+  EXPECT_EQ(cloud.width, 1u << 20);
+  EXPECT_EQ(cloud.height, 1u << 13);
+  EXPECT_EQ(&cloud.at(5, 1u << 12), cloud.data() + (std::size_t{1} << 32) + 5);
+
+  if (cloud.size() <= pcl_cloud_span::detail::max_indexable_points)
+    return;
+  pcl_cloud_span::RandomSampling<Point> sampler;
+  pcl::Indices indices;
+  EXPECT_THROW(sampler.sample(cloud, indices), pcl::BadArgumentException);
+}
+
+TEST(PointCloudTest, LargeIndicesTest)
+{
+  auto cloud = Cloud(1000, 1, Point{});
+  for (std::size_t i = 0; i < cloud.size(); ++i)
+    cloud[i] = {static_cast<float>(i % 37) * .1f, static_cast<float>(i % 4), 0, 0};
+  const auto span = makeCloudSpan(cloud.data(), cloud.width);
+  const auto expectEqual = [](const pcl::Indices& indices, const LargeIndices& large) {
+    ASSERT_EQ(large.size(), indices.size());
+    EXPECT_TRUE(std::equal(indices.begin(), indices.end(), large.begin()));
+  };
+  pcl::Indices indices;
+  LargeIndices large;
+
+  pcl_cloud_span::RandomSampling<Point> random;
+  random.setSample(100);
+  random.sample(span, indices);
+  random.sample(span, large);
+  expectEqual(indices, large);
+
+  pcl_cloud_span::UniformSampling<Point> uniform;
+  uniform.setLeafSize(.5f);
+  uniform.sample(span, indices);
+  uniform.sample(span, large);
+  expectEqual(indices, large);
+
+  pcl_cloud_span::ZoneMap<Point> map;
+  map.setChunkSize(128);
+  map.build(span);
+  map.passThrough(span, "y", 2, 3, indices);
+  map.passThrough(span, "y", 2, 3, large);
+  expectEqual(indices, large);
+
+  pcl_cloud_span::PointSelection selection;
+  map.filter(span, {{"x", 1, 2}}, selection);
+  selection.toIndices(indices);
+  selection.toIndices(large);
+  expectEqual(indices, large);
+
+  pcl_cloud_span::DuplicateRemoval<Point> removal;
+  removal.findUnique(span, indices);
+  removal.findUnique(span, large);
+  EXPECT_EQ(indices.size(), 37 * 4);
+  expectEqual(indices, large);
+}
+
+TEST(PointCloudTest, ChunksTest)
+{
+  auto cloud = Cloud(10, 1, Point{});
+  for (std::size_t i = 0; i < cloud.size(); ++i)
+    cloud[i].x = static_cast<float>(i);
+
+  const auto chunks = makeCloudSpanChunks(cloud.data(), cloud.size(), 4);
+  ASSERT_EQ(chunks.size(), 3);
+  EXPECT_EQ(chunks[0]->size(), 4);
+  EXPECT_EQ(chunks[2]->size(), 2);
+  EXPECT_EQ(chunks[2]->width, 2);
+  EXPECT_EQ(chunks[2]->height, 1);
+  EXPECT_EQ(chunks[1]->data(), cloud.data() + 4);
+  EXPECT_EQ((*chunks[2])[1].x, 9.f);
+
+  EXPECT_EQ(makeCloudSpanChunks(cloud.data(), cloud.size()).size(), 1);
+  EXPECT_TRUE(makeCloudSpanChunks(cloud.data(), 0).empty());
+  EXPECT_THROW(makeCloudSpanChunks(cloud.data(), cloud.size(), 0),
+               pcl::BadArgumentException);
+}
+
+TEST(PointCloudTest, ConstSpanTest)
+{
+  auto cloud = Cloud(10, 1, Point{});
+  for (std::size_t i = 0; i < cloud.size(); ++i)
+    cloud[i].x = static_cast<float>(i);
+  const Point* data = cloud.data();
+
+  static_assert(
+      std::is_same<decltype(makeCloudSpan(cloud.data(), 10)), CloudSpan>::value,
+      "Mutable data must give a mutable span");
+  static_assert(
+      std::is_same<decltype(makeCloudSpanPtr(data, 10)), CloudSpan::ConstPtr>::value,
+      "Immutable data must give a const span");
+
+  auto span = makeCloudSpan(data, 5, 2);
+  span.setDense(false);
+  EXPECT_EQ(span->size(), 10);
+  EXPECT_EQ(span->height, 2);
+  EXPECT_EQ(span->data(), reinterpret_cast<const SpannablePoint*>(data));
+  EXPECT_FALSE(span.isOwned());
+
+  pcl_cloud_span::RandomSampling<Point> sampler;
+  sampler.setSample(3);
+  pcl::Indices indices;
+  sampler.sample(*span, indices);
+  EXPECT_EQ(indices.size(), 3);
+
+  const auto input = span.getCloudPtr();
+  pcl::PCLHeader header;
+  header.frame_id = "frame";
+  span.setHeader(header);
+  EXPECT_EQ(span->header.frame_id, "frame");
+  EXPECT_TRUE(input->header.frame_id.empty());
+  EXPECT_EQ(span->data(), input->data());
+  EXPECT_FALSE(span.isOwned());
+
+  auto& mutable_cloud = span.getMutableCloud();
+  EXPECT_TRUE(span.isOwned());
+  EXPECT_FALSE(mutable_cloud.is_dense);
+  EXPECT_EQ(mutable_cloud.height, 2);
+  EXPECT_EQ(mutable_cloud.header.frame_id, "frame");
+  mutable_cloud[0].x = 100;
+  EXPECT_EQ(cloud[0].x, 0);
+  EXPECT_EQ((*input)[0].x, 0);
+  EXPECT_EQ(span->data(), mutable_cloud.data());
+  EXPECT_EQ(&span.getMutableCloud(), &mutable_cloud);
+
+  const auto chunks = makeCloudSpanChunks(data, cloud.size(), 4);
+  ASSERT_EQ(chunks.size(), 3);
+  EXPECT_EQ((*chunks[2])[1].x, 9.f);
+}
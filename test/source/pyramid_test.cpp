@@ -0,0 +1,135 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2023 Ilia Kovalev
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "test_utils.h"
+
+#include <pcl_cloud_span/pyramid.h>
+
+#include <gmock/gmock.h>
+
+#include <array>
+#include <cmath>
+#include <limits>
+#include <map>
+#include <tuple>
+
+using pcl_cloud_span::VoxelPyramid;
+
+namespace {
+
+int
+floorDiv(int value, int divisor)
+{
+  return static_cast<int>(std::floor(static_cast<double>(value) / divisor));
+}
+
+/** Centroids of voxels of size leaf_size * factor computed directly from the cloud. */
+std::vector<std::pair<Point, std::uint32_t>>
+computeCentroids(const Cloud& cloud, float leaf_size, int factor)
+{
+  std::map<std::tuple<int, int, int>, std::array<double, 5>> voxels;
+  for (const auto& point : cloud) {
+    if (!point.getVector3fMap().allFinite())
+      continue;
+    const auto key = std::make_tuple(
+        floorDiv(static_cast<int>(std::floor(point.x * (1.f / leaf_size))), factor),
+        floorDiv(static_cast<int>(std::floor(point.y * (1.f / leaf_size))), factor),
+        floorDiv(static_cast<int>(std::floor(point.z * (1.f / leaf_size))), factor));
+    auto& voxel = voxels[key];
+    voxel[0] += static_cast<double>(point.x);
+    voxel[1] += static_cast<double>(point.y);
+    voxel[2] += static_cast<double>(point.z);
+    voxel[3] += static_cast<double>(point.intensity);
+    voxel[4] += 1;
+  }
+
+  std::vector<std::pair<Point, std::uint32_t>> centroids;
+  for (const auto& voxel : voxels) {
+    const auto& sums = voxel.second;
+    centroids.emplace_back(Point{static_cast<float>(sums[0] / sums[4]),
+                                 static_cast<float>(sums[1] / sums[4]),
+                                 static_cast<float>(sums[2] / sums[4]),
+                                 static_cast<float>(sums[3] / sums[4])},
+                           static_cast<std::uint32_t>(sums[4]));
+  }
+  return centroids;
+}
+
+} // namespace
+
+TEST(PyramidTest, LevelsMatchDirectDownsamplingTest)
+{
+  auto cloud = makeRandomCloud(20000, -5, 5, 0);
+  cloud[10].x = std::numeric_limits<float>::quiet_NaN();
+  cloud[20].z = std::numeric_limits<float>::infinity();
+
+  VoxelPyramid<Point> pyramid;
+  pyramid.setInputCloud(pcl_cloud_span::makeCloudSpanPtr(cloud.data(), cloud.width));
+  pyramid.setLeafSize(.25f);
+  pyramid.setNumberOfThreads(2);
+
+  int factor = 1;
+  for (std::size_t level = 0; level < 4; ++level, factor *= 2) {
+    const auto expected = computeCentroids(cloud, .25f, factor);
+    const auto actual = pyramid.getLevel(level);
+    const auto& counts = pyramid.getPointCounts(level);
+
+    EXPECT_FLOAT_EQ(pyramid.getLeafSize(level), .25f * static_cast<float>(factor));
+    ASSERT_EQ(actual->size(), expected.size());
+    ASSERT_EQ(counts.size(), expected.size());
+    for (std::size_t i = 0; i < expected.size(); ++i) {
+      const auto& centroid = expected[i].first;
+      ASSERT_TRUE(
+          (*actual)[i].getArray4fMap().isApprox(centroid.getArray4fMap(), 1e-5f))
+          << level << ' ' << i;
+      ASSERT_EQ(counts[i], expected[i].second);
+    }
+  }
+}
+
+TEST(PyramidTest, ComputesLevelsLazilyTest)
+{
+  auto cloud = makeRandomCloud(1000, -5, 5, 0);
+  VoxelPyramid<Point> pyramid;
+  pyramid.setInputCloud(pcl_cloud_span::makeCloudSpanPtr(cloud.data(), cloud.width));
+  pyramid.setScaleFactor(3);
+  EXPECT_EQ(pyramid.getNumberOfComputedLevels(), 0u);
+
+  const auto level = pyramid.getLevel(2);
+  EXPECT_EQ(pyramid.getNumberOfComputedLevels(), 3u);
+  EXPECT_EQ(pyramid.getLevel(2), level);
+  EXPECT_EQ(pyramid.getLevel(1)->size(), computeCentroids(cloud, 1, 3).size());
+  EXPECT_EQ(pyramid.getNumberOfComputedLevels(), 3u);
+
+  pyramid.setLeafSize(.5f);
+  EXPECT_EQ(pyramid.getNumberOfComputedLevels(), 0u);
+}
+
+TEST(PyramidTest, ThrowsOnInvalidSetupTest)
+{
+  VoxelPyramid<Point> pyramid;
+  EXPECT_THROW(pyramid.getLevel(0), pcl::InitFailedException);
+  EXPECT_THROW(pyramid.setLeafSize(0), pcl::BadArgumentException);
+  EXPECT_THROW(pyramid.setScaleFactor(1), pcl::BadArgumentException);
+}
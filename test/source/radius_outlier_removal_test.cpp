@@ -0,0 +1,148 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2023 Ilia Kovalev
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "test_utils.h"
+
+#include <pcl_cloud_span/radius_outlier_removal.h>
+
+#include <pcl/filters/radius_outlier_removal.h>
+
+#include <gmock/gmock.h>
+
+#include <limits>
+#include <random>
+
+namespace {
+
+std::shared_ptr<Cloud>
+makeNoisyCloud(std::size_t size, float offset = 0.f)
+{
+  const auto cloud =
+      std::make_shared<Cloud>(static_cast<std::uint32_t>(size), 1, Point{});
+  std::default_random_engine eng(0);
+  std::normal_distribution<float> coord_dis(0, 1);
+  std::uniform_real_distribution<float> intencity_dis(0, 1);
+
+  for (auto& point : *cloud)
+    point = {offset + coord_dis(eng),
+             offset + coord_dis(eng),
+             offset + coord_dis(eng),
+             intencity_dis(eng)};
+  return cloud;
+}
+
+pcl::Indices
+filterWithPCL(const std::shared_ptr<Cloud>& cloud,
+              int min_neighbors,
+              bool negative,
+              pcl::Indices& removed)
+{
+  pcl::RadiusOutlierRemoval<Point> filter(true);
+  filter.setInputCloud(cloud);
+  filter.setRadiusSearch(.3);
+  filter.setMinNeighborsInRadius(min_neighbors);
+  filter.setNegative(negative);
+  pcl::Indices indices;
+  filter.filter(indices);
+  removed = *filter.getRemovedIndices();
+  return indices;
+}
+
+} // namespace
+
+TEST(RadiusOutlierRemovalTest, MatchesPCLTest)
+{
+  const auto cloud = makeNoisyCloud(3000);
+  (*cloud)[3].y = std::numeric_limits<float>::quiet_NaN();
+
+  for (const bool is_dense : {true, false}) {
+    if (is_dense)
+      (*cloud)[3].y = 0;
+    else
+      (*cloud)[3].y = std::numeric_limits<float>::quiet_NaN();
+    cloud->is_dense = is_dense;
+    const auto span = pcl_cloud_span::makeCloudSpanPtr(cloud->data(), cloud->width);
+    span->is_dense = is_dense;
+
+    for (const int min_neighbors : {0, 1, 5, 20})
+      for (const bool negative : {false, true}) {
+        pcl_cloud_span::RadiusOutlierRemoval<Point> filter(true);
+        filter.setInputCloud(span);
+        filter.setRadiusSearch(.3);
+        filter.setMinNeighborsInRadius(min_neighbors);
+        filter.setNegative(negative);
+        filter.setNumberOfThreads(2);
+        pcl::Indices indices;
+        filter.filter(indices);
+
+        pcl::Indices expected_removed;
+        const auto expected =
+            filterWithPCL(cloud, min_neighbors, negative, expected_removed);
+        EXPECT_EQ(indices, expected) << is_dense << ' ' << min_neighbors;
+        EXPECT_EQ(*filter.getRemovedIndices(), expected_removed)
+            << is_dense << ' ' << min_neighbors;
+      }
+  }
+}
+
+TEST(RadiusOutlierRemovalTest, InPlaceTest)
+{
+  const auto cloud = makeNoisyCloud(1000);
+  const auto original = *cloud;
+  pcl::Indices removed;
+  const auto expected = filterWithPCL(cloud, 5, false, removed);
+  ASSERT_FALSE(removed.empty());
+
+  pcl_cloud_span::RadiusOutlierRemoval<Point> filter;
+  filter.setRadiusSearch(.3);
+  filter.setMinNeighborsInRadius(5);
+  const auto span = pcl_cloud_span::makeCloudSpanPtr(cloud->data(), cloud->width);
+  const auto inliers = filter.filterInPlace(span);
+
+  ASSERT_EQ(inliers.size(), expected.size());
+  EXPECT_EQ(inliers.data(), span->data());
+  for (std::size_t i = 0; i < expected.size(); ++i)
+    EXPECT_EQ(inliers[i], original[static_cast<std::size_t>(expected[i])]);
+}
+
+TEST(RadiusOutlierRemovalTest, FarFromOriginTest)
+{
+  // tens of kilometers from zero, as with UTM coordinates
+  const auto cloud = makeNoisyCloud(2000, -30000.f);
+  const auto span = pcl_cloud_span::makeCloudSpanPtr(cloud->data(), cloud->width);
+
+  for (const int min_neighbors : {1, 5}) {
+    pcl_cloud_span::RadiusOutlierRemoval<Point> filter;
+    filter.setInputCloud(span);
+    filter.setRadiusSearch(.3);
+    filter.setMinNeighborsInRadius(min_neighbors);
+    filter.setNumberOfThreads(2);
+    pcl::Indices indices;
+    filter.filter(indices);
+
+    pcl::Indices removed;
+    EXPECT_EQ(indices, filterWithPCL(cloud, min_neighbors, false, removed))
+        << min_neighbors;
+  }
+}
@@ -0,0 +1,117 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2023 Ilia Kovalev
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "test_utils.h"
+
+#include <pcl_cloud_span/ragged_point_cloud.h>
+
+#include <gmock/gmock.h>
+
+#include <numeric>
+
+using pcl_cloud_span::RaggedPointCloud;
+
+namespace {
+
+Cloud
+makeCloud(std::size_t size)
+{
+  auto cloud = Cloud(static_cast<std::uint32_t>(size), 1, Point{});
+  for (std::size_t i = 0; i < size; ++i) {
+    const auto value = static_cast<float>(i);
+    cloud[i] = {value, -value, 2 * value, value};
+  }
+  return cloud;
+}
+
+} // namespace
+
+TEST(RaggedPointCloudTest, AssignClustersTest)
+{
+  auto cloud = makeCloud(100);
+  cloud.header.frame_id = "frame";
+  std::vector<pcl::PointIndices> clusters(3);
+  clusters[0].indices = {5, 1, 7};
+  clusters[2].indices.resize(50);
+  std::iota(clusters[2].indices.begin(), clusters[2].indices.end(), 50);
+
+  RaggedPointCloud<Point> ragged;
+  ragged.assign(cloud, clusters, 2);
+  ASSERT_EQ(ragged.size(), 3u);
+  EXPECT_EQ(ragged.getNumberOfPoints(), 53u);
+  EXPECT_THAT(ragged.getOffsets(), testing::ElementsAre(0, 3, 3, 53));
+
+  for (std::size_t i = 0; i < clusters.size(); ++i) {
+    const auto span = ragged.at(i);
+    ASSERT_EQ(span.size(), clusters[i].indices.size());
+    EXPECT_EQ(span.width, span.size());
+    EXPECT_EQ(span.header.frame_id, "frame");
+    EXPECT_EQ(span.data(), ragged.getPoints().data() + ragged.getOffsets()[i]);
+    for (std::size_t j = 0; j < span.size(); ++j)
+      EXPECT_EQ(span[j], cloud[static_cast<std::size_t>(clusters[i].indices[j])]);
+  }
+
+  auto first = ragged.getCloudPtr(0);
+  (*first)[0].intensity = -1;
+  EXPECT_EQ(ragged.getPoints()[0].intensity, -1);
+
+  // re-targeting keeps the span object and does not copy points
+  const auto* object = first.get();
+  ragged.getCloudPtr(2, first);
+  EXPECT_EQ(first.get(), object);
+  EXPECT_EQ(first->size(), 50u);
+  EXPECT_EQ(first->header.frame_id, "frame");
+  EXPECT_EQ(first->data(), ragged.getPoints().data() + 3);
+  decltype(first) empty;
+  ragged.getCloudPtr(0, empty);
+  ASSERT_TRUE(empty);
+  EXPECT_EQ(empty->data(), ragged.getPoints().data());
+  EXPECT_EQ(ragged.getAllPoints().size(), 53u);
+}
+
+TEST(RaggedPointCloudTest, AppendTest)
+{
+  auto cloud = makeCloud(10);
+  auto span = makeCloudSpan(cloud.data(), cloud.width);
+  span.is_dense = false;
+
+  RaggedPointCloud<Point> ragged;
+  ragged.reserve(3, 20);
+  ragged.append(cloud);
+  EXPECT_TRUE(ragged.is_dense);
+  ragged.append(span, pcl::Indices{9, 0});
+  ragged.append(cloud.begin() + 2, cloud.begin() + 4);
+  EXPECT_FALSE(ragged.is_dense);
+
+  ASSERT_EQ(ragged.size(), 3u);
+  EXPECT_THAT(ragged.getOffsets(), testing::ElementsAre(0, 10, 12, 14));
+  EXPECT_EQ(ragged.at(1)[0], cloud[9]);
+  EXPECT_EQ(ragged.at(1)[1], cloud[0]);
+  EXPECT_EQ(ragged.at(2)[1], cloud[3]);
+  EXPECT_FALSE(ragged.at(2).is_dense);
+
+  ragged.clear();
+  EXPECT_TRUE(ragged.empty());
+  EXPECT_EQ(ragged.getNumberOfPoints(), 0u);
+}
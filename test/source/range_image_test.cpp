@@ -0,0 +1,105 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2023 Ilia Kovalev
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "test_utils.h"
+
+#include <pcl_cloud_span/range_image.h>
+
+#include <gmock/gmock.h>
+
+#include <algorithm>
+#include <limits>
+#include <random>
+
+using pcl_cloud_span::EMPTY_PIXEL;
+using pcl_cloud_span::IndexImage;
+using pcl_cloud_span::PinholeProjection;
+using pcl_cloud_span::RangeImageProjector;
+using pcl_cloud_span::SphericalProjection;
+
+TEST(RangeImageTest, SphericalProjectionKeepsClosestPoint)
+{
+  auto in_cloud = Cloud(10000, 1, Point{});
+  std::default_random_engine eng(0);
+  std::uniform_real_distribution<float> dis(-10, 10);
+
+  std::generate(in_cloud.begin(), in_cloud.end(), [&]() -> Point {
+    return {dis(eng), dis(eng), .2f * dis(eng)};
+  });
+
+  const auto in_cloud_span = makeCloudSpan(in_cloud.data(), in_cloud.width);
+
+  const SphericalProjection projection(90, 16, -.4f, .4f);
+  RangeImageProjector<Point, SphericalProjection> projector(projection);
+  projector.setNumberOfThreads(4);
+  IndexImage image;
+  projector.project(in_cloud_span, image);
+
+  pcl::Indices expected_indices(90 * 16, EMPTY_PIXEL);
+  std::vector<float> expected_ranges(90 * 16, std::numeric_limits<float>::infinity());
+  for (std::size_t i = 0; i < in_cloud.size(); ++i) {
+    std::uint32_t pixel;
+    float range;
+    const auto& p = in_cloud[i];
+    if (projection.project(p.x, p.y, p.z, pixel, range) &&
+        range < expected_ranges[pixel]) {
+      expected_ranges[pixel] = range;
+      expected_indices[pixel] = static_cast<pcl::index_t>(i);
+    }
+  }
+
+  EXPECT_EQ(image.width, 90u);
+  EXPECT_EQ(image.height, 16u);
+  EXPECT_THAT(image.indices, ::testing::ContainerEq(expected_indices));
+  EXPECT_THAT(image.ranges, ::testing::ContainerEq(expected_ranges));
+}
+
+TEST(RangeImageTest, PinholeProjectionTest)
+{
+  auto in_cloud = Cloud();
+  in_cloud.push_back({0, 0, 2});
+  in_cloud.push_back({0, 0, 1});
+  in_cloud.push_back({1, 1, 1});
+  in_cloud.push_back({0, 0, -1});
+  in_cloud.push_back({100, 0, 1});
+
+  const auto in_cloud_span = makeCloudSpan(in_cloud.data(), in_cloud.width);
+
+  RangeImageProjector<Point, PinholeProjection> projector(
+      PinholeProjection(4, 4, 1, 1, 2, 2));
+  IndexImage image;
+  projector.project(in_cloud_span, image);
+
+  EXPECT_EQ(image.at(2, 2), 1);
+  EXPECT_FLOAT_EQ(image.rangeAt(2, 2), 1.f);
+  EXPECT_EQ(image.at(3, 3), 2);
+  EXPECT_EQ(std::count(image.indices.begin(), image.indices.end(), EMPTY_PIXEL), 14);
+
+  // the closer points at depth 1 are out of the limits
+  projector.setRangeLimits(1.5f, 3);
+  projector.project(in_cloud_span, image);
+  EXPECT_EQ(image.at(2, 2), 0);
+  EXPECT_FLOAT_EQ(image.rangeAt(2, 2), 2.f);
+  EXPECT_EQ(image.at(3, 3), EMPTY_PIXEL);
+}
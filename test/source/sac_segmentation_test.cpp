@@ -0,0 +1,180 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2023 Ilia Kovalev
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "test_utils.h"
+
+#include <pcl_cloud_span/sac_segmentation.h>
+
+#include <gmock/gmock.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <random>
+
+using pcl_cloud_span::PlaneSegmentation;
+
+namespace {
+
+// points 0..plane_size-1 lie on the plane z = .1x - .2y + 1 with small noise, the rest
+// are outliers well away from it
+Cloud
+makePlaneCloud(std::size_t plane_size, std::size_t outliers_size)
+{
+  const auto size = static_cast<std::uint32_t>(plane_size + outliers_size);
+  auto cloud = Cloud(size, 1, Point{});
+  std::default_random_engine eng(0);
+  std::uniform_real_distribution<float> coord_dis(-5, 5);
+  std::uniform_real_distribution<float> noise_dis(-.005f, .005f);
+  std::uniform_real_distribution<float> offset_dis(.5f, 3);
+
+  for (std::size_t i = 0; i < cloud.size(); ++i) {
+    const float x = coord_dis(eng);
+    const float y = coord_dis(eng);
+    const float z = .1f * x - .2f * y + 1;
+    if (i < plane_size)
+      cloud[i] = {x, y, z + noise_dis(eng), 0};
+    else
+      cloud[i] = {x, y, z + offset_dis(eng), 1};
+  }
+  return cloud;
+}
+
+} // namespace
+
+TEST(SACSegmentationTest, PlaneTest)
+{
+  auto cloud = makePlaneCloud(3000, 1000);
+  cloud[10].x = std::numeric_limits<float>::quiet_NaN();
+  const auto span = makeCloudSpan(cloud.data(), cloud.width);
+
+  PlaneSegmentation<Point> segmentation;
+  segmentation.setDistanceThreshold(.05);
+  segmentation.setSeed(3);
+  pcl::PointIndices inliers;
+  pcl::ModelCoefficients coefficients;
+  segmentation.segment(span, inliers, coefficients);
+
+  ASSERT_EQ(coefficients.values.size(), 4u);
+  const Eigen::Vector3f normal(
+      coefficients.values[0], coefficients.values[1], coefficients.values[2]);
+  const Eigen::Vector3f expected = Eigen::Vector3f(.1f, -.2f, -1).normalized();
+  EXPECT_NEAR(normal.norm(), 1, 1e-5);
+  EXPECT_NEAR(std::abs(normal.dot(expected)), 1, 1e-4);
+
+  pcl::Indices expected_inliers;
+  for (std::size_t i = 0; i < 3000; ++i)
+    if (i != 10)
+      expected_inliers.push_back(static_cast<pcl::index_t>(i));
+  EXPECT_THAT(inliers.indices, ::testing::ContainerEq(expected_inliers));
+}
+
+TEST(SACSegmentationTest, SequentialCloudTest)
+{
+  // the leading quarter of the cloud lies on another plane, scoring blocks following
+  // the order of the cloud would see only that plane and keep the wrong hypothesis
+  auto cloud = makePlaneCloud(100000, 0);
+  for (std::size_t i = 0; i < 25000; ++i)
+    cloud[i].z = 20;
+  const auto span = makeCloudSpan(cloud.data(), cloud.width);
+
+  PlaneSegmentation<Point> segmentation;
+  segmentation.setDistanceThreshold(.05);
+  pcl::PointIndices inliers;
+  pcl::ModelCoefficients coefficients;
+  segmentation.segment(span, inliers, coefficients);
+
+  ASSERT_EQ(coefficients.values.size(), 4u);
+  const Eigen::Vector3f normal(
+      coefficients.values[0], coefficients.values[1], coefficients.values[2]);
+  const Eigen::Vector3f expected = Eigen::Vector3f(.1f, -.2f, -1).normalized();
+  EXPECT_NEAR(std::abs(normal.dot(expected)), 1, 1e-4);
+  EXPECT_EQ(inliers.indices.size(), 75000u);
+}
+
+TEST(SACSegmentationTest, NoOptimizationTest)
+{
+  auto cloud = makePlaneCloud(2000, 2000);
+  const auto span = makeCloudSpan(cloud.data(), cloud.width);
+
+  PlaneSegmentation<Point> segmentation;
+  segmentation.setDistanceThreshold(.05);
+  segmentation.setOptimizeCoefficients(false);
+  pcl::PointIndices inliers;
+  pcl::ModelCoefficients coefficients;
+  segmentation.segment(span, inliers, coefficients);
+
+  ASSERT_EQ(coefficients.values.size(), 4u);
+  ASSERT_FALSE(inliers.indices.empty());
+  EXPECT_TRUE(std::is_sorted(inliers.indices.begin(), inliers.indices.end()));
+  EXPECT_GT(inliers.indices.size(), 1900u);
+  for (const auto index : inliers.indices) {
+    const auto& point = cloud[static_cast<std::size_t>(index)];
+    EXPECT_EQ(point.intensity, 0);
+    EXPECT_LT(std::abs(coefficients.values[0] * point.x +
+                       coefficients.values[1] * point.y +
+                       coefficients.values[2] * point.z + coefficients.values[3]),
+              .05f);
+  }
+}
+
+TEST(SACSegmentationTest, DeterminismTest)
+{
+  auto cloud = makePlaneCloud(5000, 5000);
+  const auto span = makeCloudSpan(cloud.data(), cloud.width);
+
+  PlaneSegmentation<Point> segmentation;
+  segmentation.setDistanceThreshold(.05);
+  segmentation.setSeed(7);
+  segmentation.setBlockSize(64);
+  pcl::PointIndices expected_inliers;
+  pcl::ModelCoefficients expected_coefficients;
+  segmentation.segment(span, expected_inliers, expected_coefficients);
+
+  segmentation.setNumberOfThreads(4);
+  pcl::PointIndices inliers;
+  pcl::ModelCoefficients coefficients;
+  segmentation.segment(span, inliers, coefficients);
+
+  EXPECT_THAT(inliers.indices, ::testing::ContainerEq(expected_inliers.indices));
+  EXPECT_THAT(coefficients.values,
+              ::testing::ContainerEq(expected_coefficients.values));
+}
+
+TEST(SACSegmentationTest, NotEnoughPointsTest)
+{
+  auto cloud = makePlaneCloud(2, 0);
+  const auto span = makeCloudSpan(cloud.data(), cloud.width);
+
+  PlaneSegmentation<Point> segmentation;
+  segmentation.setDistanceThreshold(.05);
+  pcl::PointIndices inliers{};
+  inliers.indices = {0};
+  pcl::ModelCoefficients coefficients;
+  segmentation.segment(span, inliers, coefficients);
+
+  EXPECT_TRUE(inliers.indices.empty());
+  EXPECT_TRUE(coefficients.values.empty());
+}
@@ -0,0 +1,147 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2023 Ilia Kovalev
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "test_utils.h"
+
+#include <pcl_cloud_span/sampling.h>
+
+#include <gmock/gmock.h>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <map>
+#include <tuple>
+
+using pcl_cloud_span::NormalSpaceSampling;
+using pcl_cloud_span::RandomSampling;
+using pcl_cloud_span::UniformSampling;
+
+TEST(SamplingTest, RandomSamplingTest)
+{
+  auto cloud = makeRandomCloud(100000, -5, 5, 0);
+  const auto span = makeCloudSpan(cloud.data(), cloud.width);
+
+  RandomSampling<Point> sampling;
+  sampling.setSample(1000);
+  sampling.setSeed(42);
+  pcl::Indices indices;
+  sampling.sample(span, indices);
+
+  ASSERT_EQ(indices.size(), 1000u);
+  EXPECT_TRUE(std::is_sorted(indices.begin(), indices.end()));
+  EXPECT_EQ(std::adjacent_find(indices.begin(), indices.end()), indices.end());
+  EXPECT_GE(indices.front(), 0);
+  EXPECT_LT(indices.back(), 100000);
+
+  pcl::Indices parallel;
+  sampling.setNumberOfThreads(3);
+  sampling.sample(span, parallel);
+  EXPECT_EQ(parallel, indices);
+
+  pcl::Indices other_seed;
+  sampling.setSeed(43);
+  sampling.sample(span, other_seed);
+  EXPECT_NE(other_seed, indices);
+
+  sampling.setSample(200000);
+  sampling.sample(span, indices);
+  EXPECT_EQ(indices.size(), cloud.size());
+}
+
+TEST(SamplingTest, UniformSamplingTest)
+{
+  auto cloud = makeRandomCloud(20000, -5, 5, 0);
+  cloud[3].x = std::numeric_limits<float>::quiet_NaN();
+  const auto span = makeCloudSpan(cloud.data(), cloud.width);
+
+  UniformSampling<Point> sampling;
+  sampling.setLeafSize(.5f);
+  pcl::Indices indices;
+  sampling.sample(span, indices);
+
+  std::map<std::tuple<int, int, int>, pcl::index_t> best;
+  for (std::size_t i = 0; i < cloud.size(); ++i) {
+    const auto& point = cloud[i];
+    if (!point.getVector3fMap().allFinite())
+      continue;
+    const auto distance = [](const Point& p) {
+      const Eigen::Array3f key = (p.getArray3fMap() * (1.f / .5f)).floor();
+      return ((key + .5f) * .5f - p.getArray3fMap()).matrix().squaredNorm();
+    };
+    const Eigen::Array3f key = (point.getArray3fMap() * (1.f / .5f)).floor();
+    const auto it = best.emplace(std::make_tuple(static_cast<int>(key.x()),
+                                                 static_cast<int>(key.y()),
+                                                 static_cast<int>(key.z())),
+                                 static_cast<pcl::index_t>(i));
+    if (!it.second &&
+        distance(point) < distance(cloud[static_cast<std::size_t>(it.first->second)]))
+      it.first->second = static_cast<pcl::index_t>(i);
+  }
+  pcl::Indices expected;
+  for (const auto& voxel : best)
+    expected.push_back(voxel.second);
+  std::sort(expected.begin(), expected.end());
+  EXPECT_EQ(indices, expected);
+
+  pcl::Indices parallel;
+  sampling.setNumberOfThreads(3);
+  sampling.sample(span, parallel);
+  EXPECT_EQ(parallel, indices);
+  EXPECT_THROW(sampling.setLeafSize(0), pcl::BadArgumentException);
+}
+
+TEST(SamplingTest, NormalSpaceSamplingTest)
+{
+  pcl::PointCloud<pcl::Normal> normals(1000, 1);
+  for (std::size_t i = 0; i < normals.size(); ++i) {
+    auto& normal = normals[i];
+    normal.normal_x = i % 10 == 0 ? -1.f : 0.f;
+    normal.normal_y = 0;
+    normal.normal_z = i % 10 == 0 ? 0.f : 1.f;
+  }
+  normals[5].normal_x = std::numeric_limits<float>::quiet_NaN();
+  const auto span = makeCloudSpan(normals.data(), normals.width);
+
+  NormalSpaceSampling<pcl::Normal> sampling;
+  sampling.setBins(2, 2, 2);
+  sampling.setSample(150);
+  sampling.setSeed(7);
+  pcl::Indices indices;
+  sampling.sample(span, indices);
+
+  ASSERT_EQ(indices.size(), 150u);
+  EXPECT_TRUE(std::is_sorted(indices.begin(), indices.end()));
+  EXPECT_EQ(std::count_if(indices.begin(),
+                          indices.end(),
+                          [](pcl::index_t index) { return index % 10 == 0; }),
+            75);
+  EXPECT_EQ(std::count(indices.begin(), indices.end(), 5), 0);
+
+  pcl::Indices parallel;
+  sampling.setNumberOfThreads(3);
+  sampling.sample(span, parallel);
+  EXPECT_EQ(parallel, indices);
+  EXPECT_THROW(sampling.setBins(0, 1, 1), pcl::BadArgumentException);
+}
@@ -0,0 +1,153 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2023 Ilia Kovalev
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "test_utils.h"
+
+#include <pcl_cloud_span/radius_outlier_removal.h>
+#include <pcl_cloud_span/selection.h>
+
+#include <gmock/gmock.h>
+
+#include <cmath>
+#include <cstdint>
+#include <limits>
+
+using pcl_cloud_span::PointSelection;
+
+namespace {
+
+Cloud
+makeCloud(std::size_t size)
+{
+  auto cloud = Cloud(static_cast<std::uint32_t>(size), 1, Point{});
+  for (std::size_t i = 0; i < size; ++i) {
+    const auto value = static_cast<float>(i);
+    cloud[i] = {value, -value, value / 2, static_cast<float>(i % 10)};
+  }
+  return cloud;
+}
+
+pcl::Indices
+selectNaive(const Cloud& cloud, float max_x, float min_intensity)
+{
+  pcl::Indices indices;
+  for (std::size_t i = 0; i < cloud.size(); ++i)
+    if (cloud[i].x <= max_x && cloud[i].intensity >= min_intensity)
+      indices.push_back(static_cast<pcl::index_t>(i));
+  return indices;
+}
+
+} // namespace
+
+TEST(SelectionTest, CombineTest)
+{
+  PointSelection a(130), b(130, true);
+  EXPECT_EQ(a.count(), 0);
+  EXPECT_EQ(b.count(), 130);
+  a.set(0);
+  a.set(64);
+  a.set(129);
+  b.set(64, false);
+
+  EXPECT_EQ((a & b).count(), 2);
+  EXPECT_EQ((a | b).count(), 130);
+  EXPECT_EQ((~a).count(), 127);
+  EXPECT_FALSE((~b).test(0));
+  EXPECT_TRUE((~b).test(64));
+  EXPECT_EQ(PointSelection(a).subtract(b).count(), 1);
+
+  pcl::Indices indices;
+  a.toIndices(indices, 2);
+  EXPECT_THAT(indices, testing::ElementsAre(0, 64, 129));
+  EXPECT_THROW(a &= PointSelection(10), pcl::BadArgumentException);
+}
+
+TEST(SelectionTest, SelectRefineTest)
+{
+  auto cloud = makeCloud(100000);
+  cloud[5].x = std::numeric_limits<float>::quiet_NaN();
+  auto span = makeCloudSpan(cloud.data(), cloud.width);
+
+  PointSelection selection;
+  pcl_cloud_span::selectPoints(
+      span,
+      pcl_cloud_span::BoxPredicate({-1, -1e6f, -1e6f}, {70000, 1e6f, 1e6f}),
+      selection,
+      2);
+  const pcl_cloud_span::FieldRangePredicate<Point> intensity("intensity", 3, 100);
+  pcl_cloud_span::refineSelection(span, intensity, selection, 2);
+  pcl_cloud_span::refineSelection(span, pcl_cloud_span::FinitePredicate(), selection);
+
+  const auto expected = selectNaive(cloud, 70000, 3);
+  pcl::Indices indices;
+  selection.toIndices(indices, 3);
+  EXPECT_EQ(indices, expected);
+  EXPECT_EQ(selection.count(), expected.size());
+
+  const auto compacted = pcl_cloud_span::compactInPlace(span, selection);
+  ASSERT_EQ(compacted.size(), expected.size());
+  EXPECT_EQ(compacted.data(), span.data());
+  for (std::size_t i = 0; i < expected.size(); ++i)
+    EXPECT_EQ(compacted[i].x, static_cast<float>(expected[i])) << i;
+}
+
+TEST(SelectionTest, FilterSelectionTest)
+{
+  auto cloud = makeCloud(200);
+  cloud[150].x = 1000;
+  const auto span = pcl_cloud_span::makeCloudSpanPtr(cloud.data(), cloud.width);
+
+  pcl_cloud_span::RadiusOutlierRemoval<Point> filter;
+  filter.setRadiusSearch(2);
+  filter.setMinNeighborsInRadius(1);
+  PointSelection selection(cloud.size(), true);
+  filter.filterSelection(span, selection);
+
+  pcl::Indices expected, indices;
+  pcl_cloud_span::RadiusOutlierRemoval<Point> reference;
+  reference.setRadiusSearch(2);
+  reference.setMinNeighborsInRadius(1);
+  reference.setInputCloud(span);
+  reference.filter(expected);
+  selection.toIndices(indices);
+  EXPECT_EQ(indices, expected);
+  EXPECT_FALSE(selection.test(150));
+
+  // only selected points are filtered, unselected ones still count as neighbors
+  filter.setMinNeighborsInRadius(2);
+  selection.assign(cloud.size());
+  for (std::size_t i = 0; i < cloud.size(); i += 2)
+    selection.set(i);
+  filter.filterSelection(span, selection);
+  selection.toIndices(indices);
+  expected.clear();
+  // the end point has one neighbor and the moved point has none
+  for (pcl::index_t i = 2; i < 200; i += 2)
+    if (i != 150)
+      expected.push_back(i);
+  EXPECT_EQ(indices, expected);
+
+  PointSelection wrong_size(10);
+  EXPECT_THROW(filter.filterSelection(span, wrong_size), pcl::BadArgumentException);
+}
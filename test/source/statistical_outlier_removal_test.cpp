@@ -0,0 +1,130 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2023 Ilia Kovalev
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "test_utils.h"
+
+#include <pcl_cloud_span/statistical_outlier_removal.h>
+
+#include <pcl/filters/statistical_outlier_removal.h>
+
+#include <gmock/gmock.h>
+
+#include <limits>
+#include <random>
+
+namespace {
+
+std::shared_ptr<Cloud>
+makeNoisyCloud(std::size_t size)
+{
+  const auto cloud = std::make_shared<Cloud>(size, 1, Point{});
+  std::default_random_engine eng(0);
+  std::normal_distribution<float> coord_dis(0, 1);
+  std::uniform_real_distribution<float> outlier_dis(-10, 10);
+  std::uniform_real_distribution<float> intencity_dis(0, 1);
+
+  for (std::size_t i = 0; i < size; ++i) {
+    auto& point = (*cloud)[i];
+    if (i % 20 == 0)
+      point = {outlier_dis(eng), outlier_dis(eng), outlier_dis(eng), 0};
+    else
+      point = {coord_dis(eng), coord_dis(eng), coord_dis(eng), 0};
+    point.intensity = intencity_dis(eng);
+  }
+  (*cloud)[7].x = std::numeric_limits<float>::quiet_NaN();
+  cloud->is_dense = false;
+  return cloud;
+}
+
+pcl::Indices
+filterWithPCL(const std::shared_ptr<Cloud>& cloud, bool negative, pcl::Indices& removed)
+{
+  pcl::StatisticalOutlierRemoval<Point> filter(true);
+  filter.setInputCloud(cloud);
+  filter.setMeanK(8);
+  filter.setStddevMulThresh(1.);
+  filter.setNegative(negative);
+  pcl::Indices indices;
+  filter.filter(indices);
+  removed = *filter.getRemovedIndices();
+  return indices;
+}
+
+} // namespace
+
+TEST(StatisticalOutlierRemovalTest, MatchesPCLTest)
+{
+  const auto cloud = makeNoisyCloud(2000);
+  const auto span = std::make_shared<CloudSpan>(makeCloudSpan(cloud->data(), 2000));
+  span->is_dense = false;
+
+  for (const bool negative : {false, true}) {
+    pcl_cloud_span::StatisticalOutlierRemoval<Point> filter(true);
+    filter.setInputCloud(span);
+    filter.setMeanK(8);
+    filter.setStddevMulThresh(1.);
+    filter.setNegative(negative);
+    filter.setNumberOfThreads(2);
+    pcl::Indices indices;
+    filter.filter(indices);
+
+    pcl::Indices expected_removed;
+    const auto expected = filterWithPCL(cloud, negative, expected_removed);
+    EXPECT_EQ(indices, expected);
+    EXPECT_EQ(*filter.getRemovedIndices(), expected_removed);
+    EXPECT_FALSE(expected.empty());
+    EXPECT_FALSE(expected_removed.empty());
+  }
+}
+
+TEST(StatisticalOutlierRemovalTest, OutputAndInPlaceTest)
+{
+  const auto cloud = makeNoisyCloud(1000);
+  const auto original = *cloud;
+  pcl::Indices removed;
+  const auto expected = filterWithPCL(cloud, false, removed);
+
+  pcl_cloud_span::StatisticalOutlierRemoval<Point> filter;
+  filter.setMeanK(8);
+  filter.setStddevMulThresh(1.);
+  filter.setNumberOfThreads(2);
+
+  filter.setInputCloud(
+      std::make_shared<const CloudSpan>(makeCloudSpan(cloud->data(), cloud->width)));
+  CloudSpan output;
+  filter.filter(output);
+  // the non-finite point is an inlier as in PCL, so points are compared by intensity
+  ASSERT_EQ(output.size(), expected.size());
+  for (std::size_t i = 0; i < expected.size(); ++i)
+    EXPECT_EQ(output[i].intensity,
+              original[static_cast<std::size_t>(expected[i])].intensity);
+
+  const auto span = pcl_cloud_span::makeCloudSpanPtr(cloud->data(), cloud->width);
+  const auto inliers = filter.filterInPlace(span);
+  ASSERT_EQ(inliers.size(), expected.size());
+  EXPECT_EQ(inliers.data(), span->data());
+  for (std::size_t i = 0; i < expected.size(); ++i)
+    EXPECT_EQ(inliers[i].intensity,
+              original[static_cast<std::size_t>(expected[i])].intensity);
+}
@@ -0,0 +1,83 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2023 Ilia Kovalev
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#ifdef _MSC_VER
+typedef unsigned long long pop_t;
+#endif // _MSC_VER
+
+#include <pcl_cloud_span/pcl_cloud_span.h>
+
+#include <pcl/point_types.h>
+#include <pcl/register_point_struct.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <random>
+
+using pcl_cloud_span::convertToPCL;
+using pcl_cloud_span::makeCloudSpan;
+using pcl_cloud_span::Spannable;
+
+using Point = pcl::PointXYZI;
+using SpannablePoint = Spannable<Point>;
+using CloudSpan = pcl::PointCloud<SpannablePoint>;
+using Cloud = pcl::PointCloud<Point>;
+
+POINT_CLOUD_REGISTER_POINT_STRUCT(SpannablePoint,
+                                  (float, x, x)(float, y, y)(float, z, z)(float,
+                                                                          intensity,
+                                                                          intensity))
+
+namespace pcl {
+inline bool
+operator==(const Point& a, const Point& b)
+{
+  return a.getArray4fMap().isApprox(b.getArray4fMap());
+}
+} // namespace pcl
+
+/**
+ * \brief Unorganized cloud of random points in a cube
+ * \param size number of points
+ * \param min minimal coordinate
+ * \param max maximal coordinate
+ * \param seed seed of the random engine
+ * \return cloud with x, y and z uniform in [min, max) and intensity in [0, 1)
+ */
+inline Cloud
+makeRandomCloud(std::size_t size, float min, float max, unsigned int seed)
+{
+  auto cloud = Cloud(static_cast<std::uint32_t>(size), 1, Point{});
+  std::default_random_engine eng(seed);
+  std::uniform_real_distribution<float> coord_dis(min, max);
+  std::uniform_real_distribution<float> intensity_dis(0, 1);
+
+  std::generate(cloud.begin(), cloud.end(), [&]() -> Point {
+    return {coord_dis(eng), coord_dis(eng), coord_dis(eng), intensity_dis(eng)};
+  });
+  return cloud;
+}
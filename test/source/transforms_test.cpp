@@ -0,0 +1,127 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2023 Ilia Kovalev
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "test_utils.h"
+
+#include <pcl_cloud_span/transforms.h>
+
+#include <pcl/common/transforms.h>
+
+#include <gmock/gmock.h>
+
+#include <limits>
+
+using pcl_cloud_span::transformPointCloud;
+using pcl_cloud_span::transformPointCloudInPlace;
+
+namespace {
+
+Eigen::Affine3f
+makeTransform()
+{
+  return Eigen::Translation3f(1.f, -2.f, .5f) *
+         Eigen::AngleAxisf(.3f, Eigen::Vector3f(1, 2, 3).normalized());
+}
+
+} // namespace
+
+TEST(TransformsTest, TransformIntoBufferTest)
+{
+  auto in_cloud = makeRandomCloud(100000, -1, 1, 0);
+  const auto in_cloud_span = makeCloudSpan(in_cloud.data(), in_cloud.width);
+
+  Cloud out_buffer(in_cloud.width, 1);
+  auto out = makeCloudSpan(out_buffer.data(), out_buffer.width);
+  transformPointCloud(in_cloud_span, out, makeTransform());
+
+  Cloud expected;
+  pcl::transformPointCloud(in_cloud, expected, makeTransform());
+
+  EXPECT_THAT(out_buffer.points, ::testing::ContainerEq(expected.points));
+  for (std::size_t i = 0; i < expected.size(); ++i)
+    EXPECT_EQ(out_buffer[i].intensity, in_cloud[i].intensity);
+  EXPECT_EQ(out.data(), reinterpret_cast<SpannablePoint*>(out_buffer.data()));
+}
+
+TEST(TransformsTest, TransformInPlaceTest)
+{
+  auto in_cloud = makeRandomCloud(1000, -1, 1, 0);
+  in_cloud[10].x = std::numeric_limits<float>::quiet_NaN();
+  in_cloud.is_dense = false;
+  const auto original = in_cloud;
+
+  auto in_cloud_span = makeCloudSpan(in_cloud.data(), in_cloud.width);
+  in_cloud_span.is_dense = false;
+  transformPointCloudInPlace(in_cloud_span, makeTransform().matrix());
+
+  Cloud expected;
+  pcl::transformPointCloud(original, expected, makeTransform());
+
+  for (std::size_t i = 0; i < expected.size(); ++i) {
+    EXPECT_EQ(in_cloud[i].intensity, original[i].intensity);
+    if (i != 10) {
+      EXPECT_EQ(in_cloud[i], expected[i]);
+    }
+  }
+  EXPECT_TRUE(std::isnan(in_cloud[10].x));
+  EXPECT_EQ(in_cloud[10].y, original[10].y);
+  EXPECT_EQ(in_cloud.data(), reinterpret_cast<Point*>(in_cloud_span.data()));
+}
+
+TEST(TransformsTest, TransformNonDenseWithoutFieldsTest)
+{
+  auto in_cloud = makeRandomCloud(100, -1, 1, 0);
+  in_cloud[10].x = std::numeric_limits<float>::quiet_NaN();
+  in_cloud.is_dense = false;
+  auto in_cloud_span = makeCloudSpan(in_cloud.data(), in_cloud.width);
+  in_cloud_span.is_dense = false;
+
+  Cloud out_buffer(in_cloud.width, 1, Point{42.f, 42.f, 42.f, 42.f});
+  auto out = makeCloudSpan(out_buffer.data(), out_buffer.width);
+  transformPointCloud(in_cloud_span, out, makeTransform(), false);
+
+  Cloud expected;
+  pcl::transformPointCloud(in_cloud, expected, makeTransform());
+
+  for (std::size_t i = 0; i < expected.size(); ++i) {
+    EXPECT_EQ(out_buffer[i].intensity, 42.f);
+    if (i != 10) {
+      EXPECT_EQ(out_buffer[i].getVector3fMap(), expected[i].getVector3fMap());
+    }
+  }
+  EXPECT_TRUE(std::isnan(out_buffer[10].x));
+  EXPECT_EQ(out_buffer[10].y, in_cloud[10].y);
+  EXPECT_EQ(out_buffer[10].z, in_cloud[10].z);
+}
+
+TEST(TransformsTest, OutputSizeMismatchTest)
+{
+  auto in_cloud = makeRandomCloud(10, -1, 1, 0);
+  const auto in_cloud_span = makeCloudSpan(in_cloud.data(), in_cloud.width);
+
+  Cloud out_buffer(in_cloud.width - 1, 1);
+  auto out = makeCloudSpan(out_buffer.data(), out_buffer.width);
+  EXPECT_THROW(transformPointCloud(in_cloud_span, out, makeTransform()),
+               pcl::BadArgumentException);
+}
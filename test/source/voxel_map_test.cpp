@@ -0,0 +1,206 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2023 Ilia Kovalev
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "test_utils.h"
+
+#include <pcl_cloud_span/voxel_map.h>
+
+#include <gmock/gmock.h>
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <map>
+#include <numeric>
+#include <tuple>
+
+using pcl_cloud_span::VoxelMap;
+
+namespace {
+
+std::vector<Point>
+sortedPoints(const CloudSpan& cloud)
+{
+  std::vector<Point> points(cloud.begin(), cloud.end());
+  std::sort(points.begin(), points.end(), [](const Point& a, const Point& b) {
+    return std::tie(a.x, a.y, a.z) < std::tie(b.x, b.y, b.z);
+  });
+  return points;
+}
+
+std::vector<Point>
+computeCentroids(const std::vector<Cloud>& frames, float leaf_size)
+{
+  std::map<std::tuple<int, int, int>, std::array<double, 5>> voxels;
+  for (const auto& frame : frames)
+    for (const auto& point : frame) {
+      auto& voxel = voxels[std::make_tuple(
+          static_cast<int>(std::floor(point.x * (1.f / leaf_size))),
+          static_cast<int>(std::floor(point.y * (1.f / leaf_size))),
+          static_cast<int>(std::floor(point.z * (1.f / leaf_size))))];
+      voxel[0] += static_cast<double>(point.x);
+      voxel[1] += static_cast<double>(point.y);
+      voxel[2] += static_cast<double>(point.z);
+      voxel[3] += static_cast<double>(point.intensity);
+      voxel[4] += 1;
+    }
+
+  std::vector<Point> centroids;
+  for (const auto& voxel : voxels) {
+    const auto& sums = voxel.second;
+    centroids.push_back({static_cast<float>(sums[0] / sums[4]),
+                         static_cast<float>(sums[1] / sums[4]),
+                         static_cast<float>(sums[2] / sums[4]),
+                         static_cast<float>(sums[3] / sums[4])});
+  }
+  std::sort(centroids.begin(), centroids.end(), [](const Point& a, const Point& b) {
+    return std::tie(a.x, a.y, a.z) < std::tie(b.x, b.y, b.z);
+  });
+  return centroids;
+}
+
+} // namespace
+
+TEST(VoxelMapTest, AccumulatesFramesTest)
+{
+  auto first = makeRandomCloud(5000, -5, 5, 0);
+  auto second = makeRandomCloud(5000, -3, 7, 1);
+
+  VoxelMap<Point> map;
+  map.setLeafSize(.5f);
+  map.setNumberOfThreads(2);
+  map.insert(makeCloudSpan(first.data(), first.width));
+  map.insert(makeCloudSpan(second.data(), second.width));
+
+  const auto centroids = map.getCentroids();
+  const auto expected = computeCentroids({first, second}, .5f);
+  ASSERT_EQ(map.size(), expected.size());
+  ASSERT_EQ(centroids->size(), expected.size());
+  EXPECT_EQ(std::accumulate(
+                map.getPointCounts().begin(), map.getPointCounts().end(), 0u),
+            10000u);
+
+  const auto actual = sortedPoints(*centroids);
+  for (std::size_t i = 0; i < expected.size(); ++i)
+    ASSERT_TRUE(actual[i].getArray4fMap().isApprox(expected[i].getArray4fMap(), 1e-5f))
+        << i;
+}
+
+TEST(VoxelMapTest, EvictsByAgeTest)
+{
+  auto first = Cloud(1, 1, Point{.5f, .5f, .5f, 1});
+  auto second = Cloud(1, 1, Point{1.5f, .5f, .5f, 2});
+  auto third = Cloud(1, 1, Point{.5f, .5f, .5f, 3});
+
+  VoxelMap<Point> map;
+  map.setMaxAge(2);
+  map.insert(makeCloudSpan(first.data(), first.width));
+  map.insert(makeCloudSpan(second.data(), second.width));
+  EXPECT_EQ(map.size(), 2u);
+  map.insert(makeCloudSpan(third.data(), third.width));
+  EXPECT_EQ(map.size(), 2u);
+  map.insert(makeCloudSpan(second.data(), second.width));
+  EXPECT_EQ(map.size(), 2u);
+  map.insert(makeCloudSpan(second.data(), second.width));
+  ASSERT_EQ(map.size(), 1u);
+  EXPECT_EQ((*map.getCentroids())[0].intensity, 2);
+  EXPECT_EQ(map.getPointCounts()[0], 3u);
+
+  map.setMaxAge(1);
+  EXPECT_TRUE(map.empty());
+  map.insert(makeCloudSpan(first.data(), first.width));
+  map.insert(makeCloudSpan(second.data(), second.width));
+  ASSERT_EQ(map.size(), 1u);
+  EXPECT_EQ((*map.getCentroids())[0].intensity, 2);
+}
+
+TEST(VoxelMapTest, EvictsByDistanceTest)
+{
+  auto frame = makeRandomCloud(5000, -10, 10, 0);
+  auto span = makeCloudSpan(frame.data(), frame.width);
+
+  VoxelMap<Point> map;
+  map.setLeafSize(.5f);
+  map.setMaxDistance(6);
+  map.insert(span, Eigen::Vector3f(1, 2, 3));
+
+  EXPECT_FALSE(map.empty());
+  for (const auto& centroid : *map.getCentroids())
+    EXPECT_LE((centroid.getVector3fMap() - Eigen::Vector3f(1, 2, 3)).norm(), 6);
+
+  span.sensor_origin_ = Eigen::Vector4f(100, 0, 0, 0);
+  map.insert(span);
+  EXPECT_TRUE(map.empty());
+  EXPECT_TRUE(map.getCentroids()->empty());
+  EXPECT_THROW(map.setMaxDistance(0), pcl::BadArgumentException);
+}
+
+TEST(VoxelMapTest, EvictsByDistanceAlongTrajectoryTest)
+{
+  VoxelMap<Point> map;
+  map.setLeafSize(.5f);
+  map.setMaxDistance(6);
+
+  // voxels of the reference map are checked against the origin after every frame
+  std::map<std::tuple<int, int, int>, std::array<double, 5>> voxels;
+  float max_distance = 6;
+  for (unsigned int i = 0; i < 40; ++i) {
+    if (i == 25) {
+      map.setMaxDistance(4);
+      max_distance = 4;
+    }
+    const Eigen::Vector3f origin(.3f * static_cast<float>(i), 0, 0);
+    auto frame = makeRandomCloud(500, -8, 8, i);
+    for (auto& point : frame)
+      point.getVector3fMap() += origin;
+    // the map is observed from several sides, every other frame sees a part of it
+    if (i % 2 == 1)
+      frame.resize(100);
+    map.insert(makeCloudSpan(frame.data(), frame.width), origin);
+
+    for (const auto& point : frame) {
+      auto& voxel = voxels[std::make_tuple(static_cast<int>(std::floor(point.x * 2)),
+                                           static_cast<int>(std::floor(point.y * 2)),
+                                           static_cast<int>(std::floor(point.z * 2)))];
+      voxel[0] += static_cast<double>(point.x);
+      voxel[1] += static_cast<double>(point.y);
+      voxel[2] += static_cast<double>(point.z);
+      voxel[3] += static_cast<double>(point.intensity);
+      voxel[4] += 1;
+    }
+    for (auto it = voxels.begin(); it != voxels.end();) {
+      const auto& sums = it->second;
+      const Eigen::Vector3f centroid(static_cast<float>(sums[0] / sums[4]),
+                                     static_cast<float>(sums[1] / sums[4]),
+                                     static_cast<float>(sums[2] / sums[4]));
+      if ((centroid - origin).squaredNorm() > max_distance * max_distance)
+        it = voxels.erase(it);
+      else
+        ++it;
+    }
+    ASSERT_EQ(map.size(), voxels.size()) << i;
+  }
+  for (const auto& centroid : *map.getCentroids())
+    EXPECT_LE((centroid.getVector3fMap() - Eigen::Vector3f(11.7f, 0, 0)).norm(), 4);
+}
@@ -0,0 +1,207 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2023 Ilia Kovalev
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "test_utils.h"
+
+#include <pcl_cloud_span/zone_map.h>
+
+#include <gmock/gmock.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <sstream>
+
+using pcl_cloud_span::FieldRange;
+using pcl_cloud_span::ZoneMap;
+
+namespace {
+
+/** \brief Points on a line so chunks are spatially coherent. */
+Cloud
+makeCloud(std::size_t size)
+{
+  auto cloud = Cloud(static_cast<std::uint32_t>(size), 1, Point{});
+  for (std::size_t i = 0; i < size; ++i) {
+    const auto value = static_cast<float>(i);
+    cloud[i] = {
+        value, value / 10, static_cast<float>(i % 3), static_cast<float>(i % 7)};
+  }
+  return cloud;
+}
+
+pcl::Indices
+filterNaive(const Cloud& cloud, const std::vector<FieldRange>& ranges)
+{
+  pcl::Indices indices;
+  for (std::size_t i = 0; i < cloud.size(); ++i) {
+    const auto& point = cloud[i];
+    bool inside = true;
+    for (const auto& range : ranges) {
+      const double value = range.field == "x"   ? point.x
+                           : range.field == "y" ? point.y
+                           : range.field == "z" ? point.z
+                                                : point.intensity;
+      inside = inside && value >= range.min && value <= range.max;
+    }
+    if (inside)
+      indices.push_back(static_cast<pcl::index_t>(i));
+  }
+  return indices;
+}
+
+} // namespace
+
+TEST(ZoneMapTest, CropBoxTest)
+{
+  auto cloud = makeCloud(10000);
+  cloud[2500].z = std::numeric_limits<float>::quiet_NaN();
+  const auto span = makeCloudSpan(cloud.data(), cloud.width);
+
+  ZoneMap<Point> map;
+  map.setChunkSize(256);
+  map.setNumberOfThreads(2);
+  map.build(span);
+  EXPECT_EQ(map.getNumberOfChunks(), 40);
+  double min, max;
+  map.getRange(1, "x", min, max);
+  EXPECT_EQ(min, 256);
+  EXPECT_EQ(max, 511);
+  EXPECT_THROW(map.getRange(1, "intensity", min, max), pcl::BadArgumentException);
+
+  pcl::Indices indices;
+  map.cropBox(span, {2000, 0, 0}, {3000.5f, 1000, 1}, indices);
+  EXPECT_EQ(indices,
+            filterNaive(cloud, {{"x", 2000, 3000.5}, {"y", 0, 1000}, {"z", 0, 1}}));
+
+  pcl_cloud_span::PointSelection selection;
+  map.filter(span, {{"x", 2000, 3000.5}, {"y", 0, 1000}, {"z", 0, 1}}, selection);
+  pcl::Indices selected;
+  selection.toIndices(selected);
+  EXPECT_EQ(selected, indices);
+
+  const auto part = makeCloudSpan(cloud.data(), 10);
+  EXPECT_THROW(map.cropBox(part, {0, 0, 0}, {1, 1, 1}, indices),
+               pcl::BadArgumentException);
+}
+
+TEST(ZoneMapTest, TrackedFieldTest)
+{
+  const auto cloud = makeCloud(5000);
+
+  ZoneMap<Point> map;
+  map.setChunkSize(128);
+  map.setFields({"intensity"});
+  map.build(cloud);
+
+  const std::vector<FieldRange> ranges = {{"intensity", 2, 4}, {"x", 100, 4000}};
+  pcl::Indices indices;
+  map.filter(cloud, ranges, indices);
+  EXPECT_EQ(indices, filterNaive(cloud, ranges));
+
+  map.passThrough(cloud, "y", 10, 20, indices);
+  EXPECT_EQ(indices, filterNaive(cloud, {{"y", 10, 20}}));
+  EXPECT_THROW(map.passThrough(cloud, "curvature", 0, 1, indices),
+               pcl::BadArgumentException);
+
+  // pcl::PassThrough drops points with non-finite coordinates unless dense
+  auto sparse = cloud;
+  sparse[303].y = std::numeric_limits<float>::quiet_NaN();
+  sparse[304].z = std::numeric_limits<float>::infinity();
+  sparse.is_dense = true;
+  map.build(sparse);
+  auto expected = filterNaive(sparse, {{"intensity", 2, 4}});
+  map.passThrough(sparse, "intensity", 2, 4, indices);
+  EXPECT_EQ(indices, expected);
+  sparse.is_dense = false;
+  map.passThrough(sparse, "intensity", 2, 4, indices);
+  expected.erase(std::remove_if(expected.begin(),
+                                expected.end(),
+                                [](pcl::index_t i) { return i == 303 || i == 304; }),
+                 expected.end());
+  EXPECT_EQ(indices, expected);
+  map.passThrough(sparse, "y", 30, 31, indices);
+  EXPECT_EQ(indices, filterNaive(sparse, {{"y", 30, 31}, {"z", -1, 3}}));
+}
+
+TEST(ZoneMapTest, SettingsAfterBuildTest)
+{
+  const auto cloud = makeCloud(5000);
+
+  ZoneMap<Point> map;
+  map.setChunkSize(128);
+  map.setFields({"intensity"});
+  map.build(cloud);
+  map.setChunkSize(1024);
+  map.setFields({});
+  EXPECT_EQ(map.getNumberOfChunks(), 40);
+  EXPECT_EQ(map.getChunkSize(), 128);
+  double min, max;
+  map.getRange(1, "intensity", min, max);
+  EXPECT_EQ(min, 0);
+  EXPECT_EQ(max, 6);
+
+  const std::vector<FieldRange> ranges = {{"intensity", 2, 4}, {"x", 100, 4000}};
+  pcl::Indices indices;
+  map.filter(cloud, ranges, indices);
+  EXPECT_EQ(indices, filterNaive(cloud, ranges));
+
+  map.build(cloud);
+  EXPECT_EQ(map.getNumberOfChunks(), 5);
+  EXPECT_THROW(map.getRange(1, "intensity", min, max), pcl::BadArgumentException);
+  map.filter(cloud, ranges, indices);
+  EXPECT_EQ(indices, filterNaive(cloud, ranges));
+}
+
+TEST(ZoneMapTest, SaveLoadTest)
+{
+  const auto cloud = makeCloud(1000);
+
+  ZoneMap<Point> map;
+  map.setChunkSize(64);
+  map.setFields({"intensity"});
+  map.build(cloud);
+  std::stringstream stream;
+  map.save(stream);
+
+  ZoneMap<Point> loaded;
+  loaded.load(stream);
+  EXPECT_EQ(loaded.size(), 1000);
+  EXPECT_EQ(loaded.getChunkSize(), 64);
+  double min, max;
+  loaded.getRange(3, "intensity", min, max);
+  EXPECT_EQ(min, 0);
+  EXPECT_EQ(max, 6);
+
+  pcl::Indices expected, indices;
+  map.passThrough(cloud, "intensity", 1, 1, expected);
+  loaded.passThrough(cloud, "intensity", 1, 1, indices);
+  EXPECT_EQ(indices, expected);
+
+  auto data = stream.str();
+  data.resize(data.size() - 1);
+  std::stringstream truncated(data);
+  EXPECT_THROW(loaded.load(truncated), pcl::IOException);
+  EXPECT_THROW(map.setChunkSize(100), pcl::BadArgumentException);
+}